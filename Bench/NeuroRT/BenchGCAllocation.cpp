@@ -0,0 +1,66 @@
+////////////////////////////////////////////////////////////////////////////////
+// Benchmark of the GC's allocation throughput. Allocates small trivial blocks
+// from an increasing number of threads at once and reports the total number of
+// allocations per second along with the speed-up relative to a single thread.
+//
+// Usage: BenchGCAllocation [allocations per thread] [max threads] [repetitions]
+//
+// Not a unit test, hence built apart from them and never run by the test runner.
+// -----
+// Copyright (c) Kiruse 2018 Germany
+// License: GPL 3.0
+#include "GC/NeuroGC.hpp"
+#include "NeuroRT/QuietGC.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <thread>
+
+using namespace Neuro;
+using namespace Neuro::Runtime;
+
+
+
+int main(int argc, char** argv)
+{
+    using clock = std::chrono::steady_clock;
+    
+    const uint32 allocations = argc > 1 ? std::atoi(argv[1]) : 200000;
+    const uint32 maxThreads  = argc > 2 ? std::atoi(argv[2]) : std::max(1u, std::thread::hardware_concurrency());
+    const uint32 repetitions = argc > 3 ? std::atoi(argv[3]) : 3;
+    
+    double baseline = 0;
+    for (uint32 numThreads = 1; ; numThreads = std::min(numThreads * 2, maxThreads)) {
+        double best = 0;
+        for (uint32 rep = 0; rep < repetitions; ++rep) {
+            // Every repetition starts out with a fresh heap.
+            auto* gc = new QuietGC();
+            GC::init(gc);
+            
+            std::unique_ptr<std::thread[]> threads(new std::thread[numThreads]);
+            auto start = clock::now();
+            for (uint32 t = 0; t < numThreads; ++t) {
+                threads[t] = std::thread([gc, allocations]() {
+                    for (uint32 i = 0; i < allocations; ++i) {
+                        gc->allocateTrivial(sizeof(uint64), 4);
+                    }
+                });
+            }
+            for (uint32 t = 0; t < numThreads; ++t) threads[t].join();
+            std::chrono::duration<double> dur = clock::now() - start;
+            
+            best = std::max(best, numThreads * allocations / dur.count());
+            GC::destroy();
+        }
+        if (numThreads == 1) baseline = best;
+        
+        std::cout << std::setw(3) << numThreads << " threads: "
+                  << std::fixed << std::setprecision(2) << std::setw(8) << best / 1e6 << "M allocs/s  "
+                  << "x" << (best / baseline) << std::endl;
+                  
+        if (numThreads >= maxThreads) break;
+    }
+}
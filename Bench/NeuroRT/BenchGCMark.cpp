@@ -0,0 +1,123 @@
+////////////////////////////////////////////////////////////////////////////////
+// Benchmark of the GC's parallel mark phase. Builds the same kind of neuron
+// graph as the TestGC stress test, then traces it from its root repeatedly with
+// an increasing number of mark workers and reports the best time per worker
+// count along with the speed-up relative to a single worker.
+//
+// Usage: BenchGCMark [neurons] [max workers] [repetitions]
+//
+// Not a unit test, hence built apart from them and never run by the test runner.
+// -----
+// Copyright (c) Kiruse 2018 Germany
+// License: GPL 3.0
+#include "GC/NeuroGC.hpp"
+#include "NeuroObject.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <sstream>
+
+using namespace Neuro;
+using namespace Neuro::Runtime;
+
+
+/**
+ * Exposes the otherwise protected mark phase and keeps the background thread
+ * from collecting (or racing) the graph while it is being built.
+ */
+class BenchGC : public GC {
+public:
+    void markAll() {
+        marks.reset(dataTable.countPages() * NEURO_MANAGEDMEMORYTABLE_RECORDS_PER_PAGE);
+        mark();
+    }
+    
+protected:
+    virtual void cycle(bool compacting, bool major) override {}
+};
+
+
+Pointer createListObject() {
+    Pointer list = Object::createObject(8, 8);
+    list->getProperty("length") = (uint32)0;
+    return list;
+}
+
+void appendList(Pointer list, Value val) {
+    std::stringstream ss;
+    
+    uint32 length = list->getProperty("length").getUInt();
+    ss << length;
+    
+    list->getProperty(ss.str().c_str()) = val;
+    list->getProperty("length") = length + 1;
+}
+
+Pointer createNeuron() {
+    Pointer neuron = Object::createObject(8);
+    neuron->getProperty("links") = createListObject();
+    return neuron;
+}
+
+void link(Pointer neuron1, Pointer neuron2) {
+    appendList(neuron1->getProperty("links").getManagedObject(), neuron2);
+    appendList(neuron2->getProperty("links").getManagedObject(), neuron1);
+}
+
+
+int main(int argc, char** argv)
+{
+    using clock = std::chrono::steady_clock;
+    
+    const uint32 numNeurons  = argc > 1 ? std::atoi(argv[1]) : 200000;
+    const uint32 maxWorkers  = argc > 2 ? std::atoi(argv[2]) : std::max(1u, std::thread::hardware_concurrency());
+    const uint32 repetitions = argc > 3 ? std::atoi(argv[3]) : 5;
+    
+    auto* gc = new BenchGC();
+    GC::init(gc);
+    
+    // Every new neuron links to a random existing neuron, growing a graph
+    // that is both wide and deep.
+    std::default_random_engine rndgen(42000);
+    Buffer<Pointer> neurons;
+    Pointer root = createNeuron();
+    root->root();
+    neurons.add(root);
+    
+    auto buildStart = clock::now();
+    for (uint32 i = 1; i < numNeurons; ++i) {
+        std::uniform_int_distribution<uint32> rnd(0u, neurons.length() - 1);
+        Pointer neuron = createNeuron();
+        link(neurons[rnd(rndgen)], neuron);
+        neurons.add(neuron);
+    }
+    auto buildDur = std::chrono::duration_cast<std::chrono::milliseconds>(clock::now() - buildStart);
+    std::cout << "Built graph of " << numNeurons << " neurons in " << buildDur.count() << "ms" << std::endl;
+    
+    double baseline = 0;
+    for (uint32 workers = 1; ; workers = std::min(workers * 2, maxWorkers)) {
+        gc->setWorkerThreads(workers);
+        
+        double best = std::numeric_limits<double>::max();
+        for (uint32 rep = 0; rep < repetitions; ++rep) {
+            auto start = clock::now();
+            gc->markAll();
+            std::chrono::duration<double, std::milli> dur = clock::now() - start;
+            best = std::min(best, dur.count());
+        }
+        if (workers == 1) baseline = best;
+        
+        std::cout << std::setw(3) << workers << " workers: "
+                  << std::fixed << std::setprecision(2) << std::setw(9) << best << "ms  "
+                  << "x" << (baseline / best) << std::endl;
+                  
+        if (workers >= maxWorkers) break;
+    }
+    
+    neurons.clear();
+    GC::destroy();
+}
@@ -0,0 +1,96 @@
+////////////////////////////////////////////////////////////////////////////////
+// Benchmark of property access through managed pointers. Reads a property of
+// many objects in turn, and separately resolves their pointers both inline,
+// as every property access does, and through the GC's virtual `resolve`, as
+// pointers did before resolving inline. Also reports the sizes of pointers,
+// values and properties, which determine how many fit in a cache line.
+//
+// Usage: BenchPropertyAccess [objects] [reads] [repetitions]
+//
+// Not a unit test, hence built apart from them and never run by the test runner.
+// -----
+// Copyright (c) Kiruse 2018 Germany
+// License: GPL 3.0
+#include "GC/NeuroGC.hpp"
+#include "NeuroObject.hpp"
+#include "NeuroRT/QuietGC.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <memory>
+
+using namespace Neuro;
+using namespace Neuro::Runtime;
+
+
+/**
+ * Prevents the compiler from optimizing the measured reads away.
+ */
+volatile uintptr_t sink;
+
+
+/**
+ * Returns the best time per read in nanoseconds over all repetitions.
+ */
+template<typename Read>
+double measure(const Pointer* objects, uint32 numObjects, uint32 reads, uint32 repetitions, Read read) {
+    using clock = std::chrono::steady_clock;
+    
+    double best = std::numeric_limits<double>::max();
+    for (uint32 rep = 0; rep < repetitions; ++rep) {
+        uintptr_t sum = 0;
+        auto start = clock::now();
+        for (uint32 i = 0, j = 0; i < reads; ++i) {
+            sum += read(objects[j]);
+            if (++j == numObjects) j = 0;
+        }
+        std::chrono::duration<double, std::nano> dur = clock::now() - start;
+        sink = sum;
+        best = std::min(best, dur.count() / reads);
+    }
+    return best;
+}
+
+void report(const char* label, double ns) {
+    std::cout << std::setw(20) << std::left << label << std::right
+              << std::fixed << std::setprecision(2) << std::setw(7) << ns << "ns/read  "
+              << std::setprecision(1) << std::setw(7) << 1000 / ns << "M reads/s" << std::endl;
+}
+
+
+int main(int argc, char** argv)
+{
+    const uint32 numObjects  = argc > 1 ? std::atoi(argv[1]) : 100000;
+    const uint32 reads       = argc > 2 ? std::atoi(argv[2]) : 10000000;
+    const uint32 repetitions = argc > 3 ? std::atoi(argv[3]) : 5;
+    
+    auto* gc = new QuietGC();
+    GC::init(gc);
+    
+    const Identifier id = Identifier::lookup("value");
+    std::unique_ptr<Pointer[]> objects(new Pointer[numObjects]);
+    for (uint32 i = 0; i < numObjects; ++i) {
+        objects[i] = Object::createObject(4);
+        objects[i]->getProperty(id) = i;
+    }
+    
+    std::cout << "sizeof(Pointer)  = " << sizeof(Pointer) << std::endl
+              << "sizeof(Value)    = " << sizeof(Value) << std::endl
+              << "sizeof(Property) = " << sizeof(Property) << std::endl;
+              
+    report("property read", measure(objects.get(), numObjects, reads, repetitions, [&](Pointer obj) {
+        return static_cast<uintptr_t>(obj->getProperty(id).getInt());
+    }));
+    report("inline resolve", measure(objects.get(), numObjects, reads, repetitions, [](Pointer obj) {
+        return reinterpret_cast<uintptr_t>(obj.get());
+    }));
+    report("virtual resolve", measure(objects.get(), numObjects, reads, repetitions, [](Pointer obj) {
+        return reinterpret_cast<uintptr_t>(GC::instance()->resolve(obj));
+    }));
+    
+    objects.reset();
+    GC::destroy();
+}
@@ -0,0 +1,111 @@
+////////////////////////////////////////////////////////////////////////////////
+// Benchmark of the write barrier on managed pointer stores. Compares storing
+// a managed pointer into a property of a young and an old object against
+// storing an integer, which passes no barrier, and reports the difference per
+// store. Since pointer and integer stores differ in more than the barrier, the
+// barrier is also measured on its own, both on a card of managed memory and
+// on the stack.
+//
+// Usage: BenchWriteBarrier [stores] [repetitions]
+//
+// Not a unit test, hence built apart from them and never run by the test runner.
+// -----
+// Copyright (c) Kiruse 2018 Germany
+// License: GPL 3.0
+#include "GC/NeuroGC.hpp"
+#include "NeuroObject.hpp"
+#include "NeuroRT/QuietGC.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+
+using namespace Neuro;
+using namespace Neuro::Runtime;
+
+
+
+/**
+ * Returns the best time per store in nanoseconds over all repetitions.
+ */
+template<typename T>
+double measure(Pointer obj, Identifier id, T value, uint32 stores, uint32 repetitions) {
+    using clock = std::chrono::steady_clock;
+    
+    double best = std::numeric_limits<double>::max();
+    for (uint32 rep = 0; rep < repetitions; ++rep) {
+        auto start = clock::now();
+        for (uint32 i = 0; i < stores; ++i) {
+            obj->getProperty(id) = value;
+        }
+        std::chrono::duration<double, std::nano> dur = clock::now() - start;
+        best = std::min(best, dur.count() / stores);
+    }
+    return best;
+}
+
+/**
+ * Returns the best time per barrier in nanoseconds over all repetitions.
+ */
+double measureBarrier(const void* slot, uint32 stores, uint32 repetitions) {
+    using clock = std::chrono::steady_clock;
+    
+    double best = std::numeric_limits<double>::max();
+    for (uint32 rep = 0; rep < repetitions; ++rep) {
+        auto start = clock::now();
+        for (uint32 i = 0; i < stores; ++i) {
+            writeBarrier(slot);
+        }
+        std::chrono::duration<double, std::nano> dur = clock::now() - start;
+        best = std::min(best, dur.count() / stores);
+    }
+    return best;
+}
+
+void report(const char* label, double ns, double baseline) {
+    std::cout << std::setw(20) << std::left << label << std::right
+              << std::fixed << std::setprecision(2) << std::setw(7) << ns << "ns/store  "
+              << std::showpos << (ns - baseline) << std::noshowpos << "ns" << std::endl;
+}
+
+
+int main(int argc, char** argv)
+{
+    const uint32 stores      = argc > 1 ? std::atoi(argv[1]) : 10000000;
+    const uint32 repetitions = argc > 2 ? std::atoi(argv[2]) : 5;
+    
+    auto* gc = new QuietGC();
+    GC::init(gc);
+    
+    // Promote one object into the old generation, whose stores dirty cards
+    // which are actually consulted.
+    Pointer old = Object::createObject(8);
+    old->root();
+    gc->collect();
+    gc->collect();
+    
+    Pointer young = Object::createObject(8);
+    young->root();
+    Pointer target = Object::createObject(8);
+    target->root();
+    
+    const Identifier id = Identifier::lookup("value");
+    old->getProperty(id) = Value::undefined;
+    young->getProperty(id) = Value::undefined;
+    
+    const double baseline = measure(young, id, (uint32)42, stores, repetitions);
+    report("integer (baseline)", baseline, baseline);
+    report("pointer into young", measure(young, id, target, stores, repetitions), baseline);
+    report("pointer into old", measure(old, id, target, stores, repetitions), baseline);
+    
+    Value local;
+    report("barrier on card", measureBarrier(&old->getProperty(id), stores, repetitions), 0);
+    report("barrier on stack", measureBarrier(&local, stores, repetitions), 0);
+    
+    old->unroot();
+    young->unroot();
+    target->unroot();
+    GC::destroy();
+}
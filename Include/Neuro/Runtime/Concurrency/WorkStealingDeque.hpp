@@ -0,0 +1,167 @@
+////////////////////////////////////////////////////////////////////////////////
+// A Chase-Lev work-stealing deque. Exactly one thread - the owner - pushes and
+// pops elements at the bottom end, whilst any number of other threads - the
+// thieves - may concurrently steal elements from the top end.
+//
+// Pushing and popping are wait-free except when the underlying circular array
+// needs to grow. Stealing is lock-free. The implementation follows "Correct and
+// Efficient Work-Stealing for Weak Memory Models" (Lê et al., 2013).
+//
+// Grown arrays are not freed immediately since a thief may still be reading
+// from them. They are chained up and released together with the deque, which
+// at most doubles the memory used by the deque.
+//
+// Elements must be trivially copyable, as they are stored in atomics.
+// -----
+// Copyright (c) Kiruse 2018
+// License: GPL 3.0
+#pragma once
+
+#include <atomic>
+#include <type_traits>
+
+#include "Numeric.hpp"
+
+namespace Neuro {
+    namespace Runtime {
+        namespace Concurrency
+        {
+            template<typename T>
+            class WorkStealingDeque {
+                static_assert(std::is_trivially_copyable_v<T>, "WorkStealingDeque elements must be trivially copyable");
+                
+            private: // Types
+                struct Array {
+                    int64 capacity;
+                    std::atomic<T>* elements;
+                    Array* previous;
+                    
+                    Array(int64 capacity, Array* previous) : capacity(capacity), elements(new std::atomic<T>[capacity]), previous(previous) {}
+                    Array(const Array&) = delete;
+                    Array& operator=(const Array&) = delete;
+                    ~Array() { delete[] elements; }
+                    
+                    T get(int64 index) const { return elements[index & (capacity - 1)].load(std::memory_order_relaxed); }
+                    void put(int64 index, T value) { elements[index & (capacity - 1)].store(value, std::memory_order_relaxed); }
+                };
+                
+            private: // Fields
+                std::atomic<int64> top;
+                std::atomic<int64> bottom;
+                std::atomic<Array*> array;
+                
+            public:  // RAII
+                /**
+                 * Capacity must be a power of two.
+                 */
+                WorkStealingDeque(int64 capacity = 256) : top(0), bottom(0), array(new Array(capacity, nullptr)) {}
+                WorkStealingDeque(const WorkStealingDeque&) = delete;
+                WorkStealingDeque(WorkStealingDeque&&) = delete;
+                WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+                WorkStealingDeque& operator=(WorkStealingDeque&&) = delete;
+                ~WorkStealingDeque() {
+                    Array* curr = array.load();
+                    while (curr) {
+                        Array* prev = curr->previous;
+                        delete curr;
+                        curr = prev;
+                    }
+                }
+                
+            public:  // Owner Interface
+                /**
+                 * Pushes an element onto the bottom end. Must only be called
+                 * by the owning thread.
+                 */
+                void push(T value) {
+                    const int64 b = bottom.load(std::memory_order_relaxed);
+                    const int64 t = top.load(std::memory_order_acquire);
+                    Array* a = array.load(std::memory_order_relaxed);
+                    
+                    if (b - t > a->capacity - 1) {
+                        a = grow(a, t, b);
+                    }
+                    
+                    a->put(b, value);
+                    std::atomic_thread_fence(std::memory_order_release);
+                    bottom.store(b + 1, std::memory_order_relaxed);
+                }
+                
+                /**
+                 * Pops the most recently pushed element off the bottom end.
+                 * Must only be called by the owning thread. Returns false if
+                 * the deque is empty or a thief stole the last element.
+                 */
+                bool pop(T& value) {
+                    const int64 b = bottom.load(std::memory_order_relaxed) - 1;
+                    Array* a = array.load(std::memory_order_relaxed);
+                    bottom.store(b, std::memory_order_relaxed);
+                    std::atomic_thread_fence(std::memory_order_seq_cst);
+                    int64 t = top.load(std::memory_order_relaxed);
+                    
+                    // Deque was already empty.
+                    if (t > b) {
+                        bottom.store(b + 1, std::memory_order_relaxed);
+                        return false;
+                    }
+                    
+                    value = a->get(b);
+                    
+                    // Racing thieves for the last element.
+                    if (t == b) {
+                        const bool won = top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+                        bottom.store(b + 1, std::memory_order_relaxed);
+                        return won;
+                    }
+                    
+                    return true;
+                }
+                
+            public:  // Thief Interface
+                /**
+                 * Steals the least recently pushed element off the top end.
+                 * May be called by any thread. Returns false if the deque is
+                 * empty or another thread won the race for the element.
+                 */
+                bool steal(T& value) {
+                    int64 t = top.load(std::memory_order_acquire);
+                    std::atomic_thread_fence(std::memory_order_seq_cst);
+                    const int64 b = bottom.load(std::memory_order_acquire);
+                    
+                    if (t >= b) return false;
+                    
+                    Array* a = array.load(std::memory_order_acquire);
+                    value = a->get(t);
+                    return top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+                }
+                
+                /**
+                 * Checks whether the deque currently appears empty. The result
+                 * is only a snapshot and may be outdated immediately.
+                 */
+                bool empty() const {
+                    return bottom.load(std::memory_order_acquire) <= top.load(std::memory_order_acquire);
+                }
+                
+                /**
+                 * Gets the number of elements currently in the deque. Just like
+                 * `empty`, the result is only a snapshot.
+                 */
+                uint64 size() const {
+                    const int64 length = bottom.load(std::memory_order_acquire) - top.load(std::memory_order_acquire);
+                    return length > 0 ? static_cast<uint64>(length) : 0;
+                }
+                
+            private: // Helpers
+                Array* grow(Array* old, int64 t, int64 b) {
+                    Array* grown = new Array(old->capacity * 2, old);
+                    for (int64 i = t; i < b; ++i) {
+                        grown->put(i, old->get(i));
+                    }
+                    array.store(grown, std::memory_order_release);
+                    return grown;
+                }
+            };
+        }
+    }
+}
@@ -0,0 +1,105 @@
+////////////////////////////////////////////////////////////////////////////////
+// A fixed group of persistent worker threads which run one job at a time in
+// parallel. The thread calling run() always participates as worker 0, so a pool
+// of N workers only spawns N-1 helper threads, and a pool of a single worker
+// degenerates to a plain function call without any synchronization.
+//
+// Helper threads sleep on a condition variable between jobs, which makes
+// repeated parallel phases (such as the GC's mark phase) cheap to dispatch.
+// -----
+// Copyright (c) Kiruse 2018
+// License: GPL 3.0
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "DLLDecl.h"
+#include "Delegate.hpp"
+#include "NeuroBuffer.hpp"
+#include "Numeric.hpp"
+
+#pragma warning(push)
+#pragma warning(disable: 4251) // class ... needs to have dll-interface ...
+
+namespace Neuro {
+    namespace Runtime {
+        namespace Concurrency
+        {
+            class NEURO_API WorkerPool {
+            public:  // Types
+                /**
+                 * Job signature. Receives the index of the executing worker
+                 * in the range [0, count()).
+                 */
+                using JobDelegate = Delegate<void, uint32>;
+                
+            private: // Properties
+                std::mutex syncMutex;
+                std::condition_variable startNotif;
+                std::condition_variable doneNotif;
+                
+                Buffer<std::thread*> threads;
+                
+                /**
+                 * The job currently being run. Only valid while `numPending`
+                 * is non-zero.
+                 */
+                const JobDelegate* job;
+                
+                /**
+                 * Incremented for every dispatched job so sleeping helpers can
+                 * tell a new job from a spurious wake-up.
+                 */
+                uint64 generation;
+                
+                /**
+                 * Number of helper threads which have not finished the current
+                 * job yet.
+                 */
+                uint32 numPending;
+                
+                bool terminate;
+                
+            public:  // RAII
+                WorkerPool(uint32 numWorkers = 1);
+                WorkerPool(const WorkerPool&) = delete;
+                WorkerPool(WorkerPool&&) = delete;
+                WorkerPool& operator=(const WorkerPool&) = delete;
+                WorkerPool& operator=(WorkerPool&&) = delete;
+                ~WorkerPool();
+                
+            public:  // Methods
+                /**
+                 * Runs the job on every worker in parallel and blocks until
+                 * all of them have returned. The calling thread runs the job
+                 * as worker 0.
+                 *
+                 * Must not be called concurrently or from within a job.
+                 */
+                void run(const JobDelegate& job);
+                
+                /**
+                 * Changes the number of workers, including the calling thread.
+                 * Spawns or joins helper threads as necessary. At least one
+                 * worker is always retained.
+                 *
+                 * Must not be called while a job is running.
+                 */
+                void resize(uint32 numWorkers);
+                
+                /**
+                 * Number of workers including the thread calling run().
+                 */
+                uint32 count() const { return threads.length() + 1; }
+                
+            private: // Helpers
+                void threadMain(uint32 workerIndex, uint64 seenGeneration);
+                void joinAll();
+            };
+        }
+    }
+}
+
+#pragma warning(pop)
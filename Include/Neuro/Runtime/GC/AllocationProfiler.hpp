@@ -0,0 +1,165 @@
+////////////////////////////////////////////////////////////////////////////////
+// Sampling profiler of the GC's allocations, revealing which call sites churn
+// through managed memory at a fraction of the cost of tracing every allocation.
+//
+// Like tcmalloc's heap sampler, a sample is taken roughly every `interval`
+// bytes. The number of bytes until the next sample is drawn from an exponential
+// distribution, such that samples form a Poisson process over the allocated
+// bytes and an allocation of `size` bytes is sampled with probability
+// `1 - exp(-size / interval)`. Dividing by this probability yields unbiased
+// estimates of the allocated objects and bytes regardless of their sizes.
+//
+// Every sample captures the native backtrace and the innermost allocation site
+// of the allocating thread. Allocation sites are labels set by the host, e.g.
+// the script path an interpreter is running, or the name of a native binding.
+// Samples with the same backtrace and site are aggregated right away, so that
+// memory only grows with the number of distinct call sites.
+//
+// Profiles are written in pprof's protocol buffer format, uncompressed, which
+// pprof reads just like its gzipped profiles.
+// -----
+// Copyright (c) Kiruse 2018
+// License: GPL 3.0
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "DLLDecl.h"
+#include "NeuroBuffer.hpp"
+#include "Numeric.hpp"
+
+/**
+ * Maximum number of native frames captured per sample.
+ */
+#define NEURO_GC_PROFILE_DEPTH 32
+
+namespace Neuro {
+    namespace Runtime
+    {
+        /**
+         * Labels the allocations of the calling thread during its lifetime.
+         * Sites nest; samples are attributed to the innermost one.
+         */
+        class NEURO_API AllocationSite
+        {
+        private:   // Properties
+            const char* previous;
+            
+        public:    // RAII
+            /**
+             * The label must outlive the site. Profilers keep copies of the
+             * labels they sampled.
+             */
+            AllocationSite(const char* label);
+            AllocationSite(const AllocationSite&) = delete;
+            AllocationSite& operator=(const AllocationSite&) = delete;
+            ~AllocationSite();
+            
+        public:    // Static Methods
+            /**
+             * Gets the label of the calling thread's innermost site, or null
+             * outside of any site.
+             */
+            static const char* current();
+        };
+        
+        class NEURO_API AllocationProfiler
+        {
+        public:    // Types
+            /**
+             * Aggregate of all samples with the same backtrace and site.
+             */
+            struct Sample {
+                void* frames[NEURO_GC_PROFILE_DEPTH];
+                uint32 numFrames;
+                
+                /**
+                 * Label of the allocation site, or null outside of any site.
+                 * Owned by the profiler.
+                 */
+                const char* site;
+                
+                uint64 numSamples;
+                
+                /**
+                 * Estimated number of allocations and of bytes allocated.
+                 */
+                double numObjects;
+                double bytes;
+            };
+            
+        private:   // Properties
+            const uint64 interval;
+            
+            /**
+             * Distinguishes this profiler's thread-local countdowns from those
+             * of profilers destroyed before, which may have lived at the same
+             * address.
+             */
+            const uint64 generation;
+            
+            std::atomic<uint64> numSamples;
+            
+            /**
+             * Aggregated samples, found by their frames and site. Labels of
+             * sites are copied, as sites may end before the profile is written.
+             */
+            mutable std::mutex samplesMutex;
+            Buffer<Sample> samples;
+            std::unordered_map<std::string, uint32> sampleIndices;
+            std::unordered_set<std::string> siteLabels;
+            
+        public:    // RAII
+            /**
+             * Creates a profiler taking a sample every `interval` bytes on
+             * average.
+             */
+            AllocationProfiler(uint64 interval);
+            AllocationProfiler(const AllocationProfiler&) = delete;
+            AllocationProfiler(AllocationProfiler&&) = delete;
+            AllocationProfiler& operator=(const AllocationProfiler&) = delete;
+            AllocationProfiler& operator=(AllocationProfiler&&) = delete;
+            
+        public:    // Methods
+            /**
+             * Accounts for an allocation of `bytes` bytes by the calling
+             * thread, taking a sample if its countdown runs out.
+             */
+            void allocated(uint64 bytes);
+            
+            /**
+             * Appends copies of the aggregated samples.
+             */
+            void collect(Buffer<Sample>& samples) const;
+            
+            /**
+             * Writes the aggregated samples as a pprof profile with the sample
+             * types `alloc_objects` and `alloc_space`. Frames are symbolized
+             * where the platform allows, and sites are attached as the label
+             * `site`.
+             */
+            void writePprof(std::ostream& out) const;
+            
+            /**
+             * Discards all samples taken so far.
+             */
+            void clear();
+            
+            uint64 getInterval() const { return interval; }
+            
+            /**
+             * Gets the number of samples taken since the profiler was created
+             * or last cleared.
+             */
+            uint64 countSamples() const { return numSamples.load(std::memory_order_relaxed); }
+            
+        protected: // Helpers
+            void record(uint64 bytes);
+        };
+    }
+}
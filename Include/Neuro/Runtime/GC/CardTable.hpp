@@ -0,0 +1,180 @@
+////////////////////////////////////////////////////////////////////////////////
+// Card tables of the GC's memory segments and the write barrier dirtying them.
+//
+// Every memory segment is divided into cards of 512 bytes, each represented by
+// a single byte in the segment's card table. Storing a managed pointer into
+// managed memory dirties the card containing the store, so that collectors
+// which skip parts of the heap (e.g. the old generation during minor cycles)
+// merely need to rescan the dirty cards of those parts.
+//
+// The barrier needs to find the card table of an arbitrary address quickly. To
+// this end, segments are aligned to and sized in multiples of 2MB regions, and
+// a global two-level region map associates every region with the card table
+// of the segment occupying it. Addresses outside of managed memory (e.g. the
+// stack) map to no card table, hence the barrier is safe on any Value.
+// -----
+// Copyright (c) Kiruse 2018 Germany
+// License: GPL 3.0
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#include "DLLDecl.h"
+#include "NeuroBuffer.hpp"
+#include "Numeric.hpp"
+
+namespace Neuro {
+    namespace Runtime
+    {
+        class NEURO_API CardTable
+        {
+        public:    // Constants
+            static constexpr uint32 CardShift = 9;
+            static constexpr uint32 CardSize = 1 << CardShift;
+            
+            static constexpr uint32 RegionShift = 21;
+            static constexpr uint32 RegionSize = 1 << RegionShift;
+            
+            /**
+             * Number of region bits resolved by the leaves of the region map.
+             * The directory resolves the next 14 bits, which suffices for 48
+             * bit address spaces. Other addresses are told apart by bounds.
+             */
+            static constexpr uint32 LeafBits = 13;
+            static constexpr uint32 DirectoryBits = 14;
+            
+        private:   // Statics
+            static std::atomic<std::atomic<CardTable*>*> directory[1 << DirectoryBits];
+            
+        private:   // Properties
+            /**
+             * First address covered by this table.
+             */
+            uint8* begin;
+            
+            /**
+             * Number of bytes covered by this table.
+             */
+            uint32 size;
+            
+            std::atomic<uint8>* cards;
+            
+        public:    // RAII
+            CardTable() : begin(nullptr), size(0), cards(nullptr) {}
+            CardTable(const CardTable&) = delete;
+            CardTable(CardTable&&) = delete;
+            CardTable& operator=(const CardTable&) = delete;
+            CardTable& operator=(CardTable&&) = delete;
+            ~CardTable();
+            
+        public:    // Methods
+            /**
+             * Covers the given region-aligned range of memory with clean cards
+             * and registers this table in the region map. Returns false if
+             * the cards could not be allocated.
+             */
+            bool attach(void* begin, uint32 size);
+            
+            /**
+             * Unregisters this table from the region map and releases its
+             * cards. Stores into the formerly covered memory are ignored.
+             */
+            void detach();
+            
+            /**
+             * Dirties the card containing the given address. Addresses beyond
+             * this table are ignored.
+             */
+            void dirty(const void* addr) {
+                const uintptr_t offset = reinterpret_cast<const uint8*>(addr) - begin;
+                if (offset < size) cards[offset >> CardShift].store(1, std::memory_order_relaxed);
+            }
+            
+            /**
+             * Dirties all cards overlapping the given range of memory.
+             */
+            void dirty(const void* addr, uint32 bytes);
+            
+            /**
+             * Tests whether any card overlapping the given range of memory is
+             * dirty.
+             */
+            bool isDirty(const void* addr, uint32 bytes) const;
+            
+            bool isDirty(uint32 cardIndex) const {
+                return cards[cardIndex].load(std::memory_order_relaxed);
+            }
+            
+            /**
+             * Cleans the card. Whoever cleans a card must inspect the memory
+             * it covers afterwards, so that a concurrent store is either seen
+             * or dirties the card again.
+             */
+            void clean(uint32 cardIndex) {
+                cards[cardIndex].store(0, std::memory_order_relaxed);
+            }
+            
+            /**
+             * Cleans all dirty cards, adding their indices to `indices` in
+             * ascending order. Returns the number of cards cleaned.
+             */
+            uint32 takeDirty(Buffer<uint32>& indices);
+            
+            /**
+             * Tests whether any card of this table is dirty.
+             */
+            bool anyDirty() const;
+            
+            /**
+             * Counts the dirty cards of this table.
+             */
+            uint32 countDirty() const;
+            
+            uint32 countCards() const {
+                return (size + CardSize - 1) >> CardShift;
+            }
+            
+            /**
+             * Gets the index of the card containing the given address, which
+             * must be covered by this table.
+             */
+            uint32 getCardIndex(const void* addr) const {
+                return static_cast<uint32>((reinterpret_cast<const uint8*>(addr) - begin) >> CardShift);
+            }
+            
+            uint8* getCardPointer(uint32 cardIndex) const {
+                return begin + (uintptr_t(cardIndex) << CardShift);
+            }
+            
+        public:    // Static Methods
+            /**
+             * Looks up the card table of the segment occupying the region of
+             * the given address. Returns nullptr outside of managed memory.
+             */
+            static CardTable* lookup(const void* addr) {
+                const uintptr_t region = reinterpret_cast<uintptr_t>(addr) >> RegionShift;
+                auto* leaf = directory[(region >> LeafBits) & ((1 << DirectoryBits) - 1)].load(std::memory_order_acquire);
+                if (!leaf) return nullptr;
+                return leaf[region & ((1 << LeafBits) - 1)].load(std::memory_order_acquire);
+            }
+        };
+        
+        /**
+         * Write barrier to be invoked whenever a managed pointer is stored at
+         * the given address. Dirties the corresponding card if the address
+         * lies in managed memory.
+         */
+        inline void writeBarrier(const void* slot) {
+            if (CardTable* table = CardTable::lookup(slot)) table->dirty(slot);
+        }
+        
+        /**
+         * Write barrier for bulk copies of memory which may contain managed
+         * pointers, e.g. when moving an object's properties.
+         */
+        inline void writeBarrier(const void* addr, uint32 bytes) {
+            if (CardTable* table = CardTable::lookup(addr)) table->dirty(addr, bytes);
+        }
+    }
+}
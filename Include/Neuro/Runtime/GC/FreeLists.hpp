@@ -0,0 +1,143 @@
+////////////////////////////////////////////////////////////////////////////////
+// Segregated free lists of swept memory blocks, which allow the GC to reuse the
+// memory of garbage without having to move live memory around.
+//
+// Blocks are binned by their total number of bytes, including their overhead,
+// into size classes. Every power of two is split into four classes, so a block
+// exceeds the lower bound of its class by less than 25%. Each class is guarded
+// by its own spinlock, and a bitmask of non-empty classes spares allocators
+// from touching empty lists at all.
+//
+// The lists merely hold on to the blocks. Splitting them up and keeping the
+// segments walkable is up to the GC.
+// -----
+// Copyright (c) Kiruse 2018
+// License: GPL 3.0
+#pragma once
+
+#include <atomic>
+
+#include "DLLDecl.h"
+#include "ManagedMemoryOverhead.hpp"
+#include "NeuroBuffer.hpp"
+#include "Numeric.hpp"
+
+namespace Neuro {
+    namespace Runtime
+    {
+        class NEURO_API FreeLists
+        {
+        public:    // Constants
+            /**
+             * Blocks below 64 bytes share the first class. Four classes per
+             * power of two follow, up to the largest possible block.
+             */
+            static constexpr uint32 MinClassShift = 6;
+            static constexpr uint32 NumClasses = 1 + (32 - MinClassShift) * 4;
+            
+            /**
+             * Number of blocks of a class inspected when looking for a block
+             * of a specific size.
+             */
+            static constexpr uint32 MaxCandidates = 8;
+            
+        private:   // Types
+            struct List {
+                std::atomic_flag locked;
+                Buffer<ManagedMemoryOverhead*> blocks;
+            };
+            
+            struct Lock {
+                List& list;
+                
+                Lock(List& list);
+                Lock(const Lock&) = delete;
+                Lock(Lock&&) = delete;
+                Lock& operator=(const Lock&) = delete;
+                Lock& operator=(Lock&&) = delete;
+                ~Lock();
+            };
+            
+        private:   // Properties
+            List lists[NumClasses];
+            
+            /**
+             * One bit per size class, set while its list holds any blocks.
+             */
+            std::atomic<uint64> nonEmpty[2];
+            
+            std::atomic<uint32> numBlocks;
+            std::atomic<uint64> numBytes;
+            
+        public:    // RAII
+            FreeLists();
+            FreeLists(const FreeLists&) = delete;
+            FreeLists(FreeLists&&) = delete;
+            FreeLists& operator=(const FreeLists&) = delete;
+            FreeLists& operator=(FreeLists&&) = delete;
+            ~FreeLists() = default;
+            
+        public:    // Methods
+            /**
+             * Adds the swept block to the list of its size class.
+             */
+            void add(ManagedMemoryOverhead* block);
+            
+            /**
+             * Takes a block of the size class of `bytes` or the next larger
+             * one which can hold exactly `bytes` bytes, optionally followed by
+             * a filler block. Returns nullptr if there is none.
+             */
+            ManagedMemoryOverhead* take(uint32 bytes);
+            
+            /**
+             * Takes a block of at least `bytes` bytes from the smallest size
+             * class holding one. Returns nullptr if there is none.
+             */
+            ManagedMemoryOverhead* takeAtLeast(uint32 bytes);
+            
+            /**
+             * Forgets all blocks, e.g. because they are about to be reclaimed
+             * by compaction.
+             */
+            void clear();
+            
+            uint32 count() const { return numBlocks.load(std::memory_order_relaxed); }
+            bool empty() const { return !count(); }
+            
+            /**
+             * Counts the bytes of all blocks, including their overheads.
+             */
+            uint64 countBytes() const { return numBytes.load(std::memory_order_relaxed); }
+            
+            /**
+             * Counts the blocks in the list of the given size class.
+             */
+            uint32 count(uint32 sizeClass);
+            
+        public:    // Static Methods
+            static uint32 getSizeClass(uint32 bytes);
+            
+            /**
+             * Gets the smallest number of bytes of a block in the given size
+             * class.
+             */
+            static uint32 getClassBytes(uint32 sizeClass);
+            
+            /**
+             * Tests whether `bytes` bytes can be allocated at the start of the
+             * block such that the remainder, if any, fits a filler block.
+             */
+            static bool fits(const ManagedMemoryOverhead* block, uint32 bytes) {
+                const uint32 total = block->getTotalBytes();
+                return total == bytes || total >= bytes + sizeof(ManagedMemoryOverhead);
+            }
+            
+        private:   // Helpers
+            /**
+             * Removes the block at the given index from the locked list.
+             */
+            ManagedMemoryOverhead* remove(uint32 sizeClass, uint32 index);
+        };
+    }
+}
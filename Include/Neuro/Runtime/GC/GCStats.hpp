@@ -0,0 +1,164 @@
+////////////////////////////////////////////////////////////////////////////////
+// Statistics on what the GC is doing, taken as a snapshot by `GC::getStats`.
+//
+// Durations are recorded in HDR-style latency histograms. Values are binned by
+// their power of two, and every power of two is split linearly into a fixed
+// number of sub-buckets, so that any recorded value is reproduced within about
+// 3% regardless of its magnitude. Recording is a mere increment and the
+// histograms never allocate, so they are cheap enough to record every cycle.
+// -----
+// Copyright (c) Kiruse 2018
+// License: GPL 3.0
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+
+#include "DLLDecl.h"
+#include "Numeric.hpp"
+
+namespace Neuro {
+    namespace Runtime
+    {
+        class NEURO_API LatencyHistogram
+        {
+        public:    // Constants
+            /**
+             * Every power of two is split into 2^SubBucketBits sub-buckets.
+             * Values below the number of sub-buckets are recorded exactly.
+             */
+            static constexpr uint32 SubBucketBits = 5;
+            static constexpr uint32 SubBucketCount = 1 << SubBucketBits;
+            static constexpr uint32 NumCounters = (64 - SubBucketBits + 1) * SubBucketCount;
+            
+        private:   // Properties
+            uint64 counters[NumCounters];
+            uint64 numValues;
+            uint64 minValue;
+            uint64 maxValue;
+            uint64 sum;
+            
+        public:    // RAII
+            LatencyHistogram();
+            
+        public:    // Methods
+            void record(uint64 value);
+            
+            void record(std::chrono::nanoseconds duration) {
+                record(static_cast<uint64>(std::max<int64>(duration.count(), 0)));
+            }
+            
+            /**
+             * Adds all values recorded by the other histogram to this one.
+             */
+            void merge(const LatencyHistogram& other);
+            
+            void reset();
+            
+            uint64 count() const { return numValues; }
+            uint64 min() const { return numValues ? minValue : 0; }
+            uint64 max() const { return maxValue; }
+            uint64 mean() const { return numValues ? sum / numValues : 0; }
+            
+            /**
+             * Gets the value at or below which the given percentage of all
+             * recorded values lie, i.e. the upper bound of the sub-bucket
+             * containing that value, clamped to the maximum. Returns 0 if
+             * nothing was recorded.
+             */
+            uint64 percentile(double percent) const;
+            
+        public:    // Static Methods
+            static uint32 getCounterIndex(uint64 value);
+            
+            /**
+             * Gets the smallest and the largest value recorded into the given
+             * counter.
+             */
+            static uint64 getLowestValue(uint32 index);
+            static uint64 getHighestValue(uint32 index);
+        };
+        
+        /**
+         * Snapshot of the GC's statistics. Durations are in nanoseconds.
+         */
+        struct GCStats {
+            /**
+             * Number of bytes handed out since the GC was created. Allocation
+             * buffers count as a whole once they are reserved.
+             */
+            uint64 bytesAllocated = 0;
+            
+            /**
+             * Number of bytes held by memory which survived the last cycle,
+             * including memory spared as newborn, memory reallocated but not
+             * yet reclaimed, and unused remainders of allocation buffers.
+             */
+            uint64 liveBytes = 0;
+            
+            /**
+             * Number of bytes of the segments' pages currently committed.
+             */
+            uint64 committedBytes = 0;
+            
+            /**
+             * Number of segments of the nursery and the old generation, and
+             * the number of large object regions, after the last cycle.
+             */
+            uint32 numNurserySegments = 0;
+            uint32 numDormantSegments = 0;
+            uint32 numLargeObjects = 0;
+            
+            /**
+             * Number of table records in use, i.e. of managed memory blocks.
+             */
+            uint32 numRecords = 0;
+            
+            /**
+             * Number of cycles completed, of which major.
+             */
+            uint64 numCycles = 0;
+            uint64 numMajorCycles = 0;
+            
+            /**
+             * Number of compactions skipped because the registered mutators
+             * did not reach a safepoint in time.
+             */
+            uint64 numSkippedCompactions = 0;
+            
+            /**
+             * Number of scans which freed no garbage because the registered
+             * mutators did not reach a safepoint in time for the final remark.
+             */
+            uint64 numSkippedCollections = 0;
+            
+            /**
+             * Durations of the phases of the last cycle. Phases of incremental
+             * cycles add up all of their steps.
+             */
+            std::chrono::nanoseconds lastScan = std::chrono::nanoseconds(0);
+            std::chrono::nanoseconds lastSweep = std::chrono::nanoseconds(0);
+            std::chrono::nanoseconds lastCompact = std::chrono::nanoseconds(0);
+            
+            /**
+             * Durations of the phases of all cycles.
+             */
+            LatencyHistogram scanTimes;
+            LatencyHistogram sweepTimes;
+            LatencyHistogram compactTimes;
+            
+            /**
+             * Durations for which the GC blocked the host, i.e. of explicit
+             * collections and incremental steps, including waiting for a cycle
+             * of the background thread to finish.
+             */
+            LatencyHistogram pauseTimes;
+            
+            /**
+             * Durations of stopping the registered mutators at a safepoint,
+             * including attempts which timed out.
+             */
+            LatencyHistogram safepointTimes;
+        };
+    }
+}
@@ -0,0 +1,151 @@
+////////////////////////////////////////////////////////////////////////////////
+// Offline analysis of a heap snapshot, answering where memory goes: which root
+// retains how much of the heap, how objects are distributed by their number of
+// properties, and how fragmented every segment is.
+//
+// Retained sizes are derived from the dominator tree of the object graph. An
+// object dominates another if every path from the roots to the other passes
+// through it, hence the memory retained by an object is all memory it
+// dominates, which would become garbage if the object did. All roots hang off
+// a virtual root, which dominates objects shared between several roots. The
+// tree is computed with the iterative algorithm by Cooper, Harvey and Kennedy.
+// -----
+// Copyright (c) Kiruse 2018
+// License: GPL 3.0
+#pragma once
+
+#include <memory>
+#include <unordered_map>
+
+#include "DLLDecl.h"
+#include "HeapSnapshot.hpp"
+#include "NeuroBuffer.hpp"
+#include "Numeric.hpp"
+
+namespace Neuro {
+    namespace Runtime
+    {
+        class NEURO_API HeapAnalysis
+        {
+        public:    // Types
+            struct RootSummary {
+                uint32 tableIndex;
+                uint32 node;
+                uint64 retainedBytes;
+                uint32 retainedObjects;
+            };
+            
+            /**
+             * Objects with `minProperties` to `maxProperties` properties in
+             * use, and the bytes they occupy.
+             */
+            struct PropertyBucket {
+                uint32 minProperties;
+                uint32 maxProperties;
+                uint32 numObjects;
+                uint64 bytes;
+            };
+            
+            /**
+             * Occupancy of a segment. Fragmentation is the share of its free
+             * bytes outside of its largest free block, i.e. 0 if all free
+             * memory is contiguous.
+             */
+            struct SegmentSummary {
+                uint32 segment;
+                uint64 usedBytes;
+                uint64 liveBytes;
+                uint64 freeBytes;
+                uint64 largestFreeBlock;
+                uint32 numLiveBlocks;
+                uint32 numFreeBlocks;
+                double fragmentation;
+            };
+            
+        private:   // Properties
+            const HeapSnapshot& snapshot;
+            
+            /**
+             * Nodes are the indices of the snapshot's objects. The virtual
+             * root is the node past the last object.
+             */
+            uint32 numNodes;
+            std::unordered_map<uint32, uint32> nodesByTableIndex;
+            
+            /**
+             * Immediate dominator of every node, or npos if the node cannot
+             * be reached from the roots.
+             */
+            std::unique_ptr<uint32[]> dominators;
+            
+            std::unique_ptr<uint64[]> shallowBytes;
+            std::unique_ptr<uint64[]> retainedBytes;
+            std::unique_ptr<uint32[]> retainedObjects;
+            
+            /**
+             * Children of every node in the dominator tree, i.e. the nodes it
+             * immediately dominates, are `children[firstChild[node], firstChild[node + 1])`.
+             */
+            std::unique_ptr<uint32[]> firstChild;
+            std::unique_ptr<uint32[]> children;
+            
+        public:    // RAII
+            /**
+             * Analyzes the snapshot, which needs to outlive the analysis.
+             */
+            HeapAnalysis(const HeapSnapshot& snapshot);
+            HeapAnalysis(const HeapAnalysis&) = delete;
+            HeapAnalysis& operator=(const HeapAnalysis&) = delete;
+            
+        public:    // Methods
+            uint32 countNodes() const { return numNodes; }
+            uint32 getVirtualRoot() const { return numNodes; }
+            
+            /**
+             * Finds the node of the object with the given table index, or
+             * npos if there is no such object.
+             */
+            uint32 findNode(uint32 tableIndex) const;
+            
+            const HeapSnapshot::ObjectNode& getObject(uint32 node) const { return snapshot.objects[node]; }
+            
+            bool isReachable(uint32 node) const { return node == numNodes || dominators[node] != npos; }
+            
+            /**
+             * Gets the immediate dominator of the node, which is the virtual
+             * root for roots and objects shared between roots, or npos if the
+             * node is unreachable.
+             */
+            uint32 getDominator(uint32 node) const { return dominators[node]; }
+            
+            uint64 getShallowBytes(uint32 node) const { return shallowBytes[node]; }
+            uint64 getRetainedBytes(uint32 node) const { return retainedBytes[node]; }
+            uint32 getRetainedObjects(uint32 node) const { return retainedObjects[node]; }
+            
+            /**
+             * Gets the nodes immediately dominated by the node, the ones
+             * retaining the most memory first.
+             */
+            void getDominated(uint32 node, Buffer<uint32>& dominated) const;
+            
+            /**
+             * Summarizes the memory retained by each root, the ones retaining
+             * the most memory first. Memory shared between roots, including
+             * roots referred to by other roots, is retained by none of them.
+             */
+            void summarizeRoots(Buffer<RootSummary>& roots) const;
+            
+            /**
+             * Counts objects in buckets of powers of two properties, i.e. 0,
+             * 1, 2-3, 4-7 and so forth, up to the largest bucket in use.
+             */
+            void summarizePropertyCounts(Buffer<PropertyBucket>& buckets) const;
+            
+            void summarizeSegments(Buffer<SegmentSummary>& segments) const;
+            
+        private:   // Helpers
+            void computeDominators();
+            void computeRetainedSizes();
+        };
+    }
+}
@@ -0,0 +1,142 @@
+////////////////////////////////////////////////////////////////////////////////
+// Snapshot of the managed heap written by `GC::dumpHeap` and read back by
+// offline tools such as the NeuroHeap analyzer.
+//
+// The snapshot describes the heap's layout rather than its contents: every
+// segment and large object region, the header of every block within them, the
+// records of the managed memory table, and the property graph of all objects,
+// i.e. which property of which object refers to which other object. Addresses
+// are those of the dumping process and merely serve to identify memory.
+//
+// The binary format is a magic number and version followed by sections of
+// fixed size entries, each preceded by its number of entries. All values are
+// written in the byte order of the dumping host.
+// -----
+// Copyright (c) Kiruse 2018
+// License: GPL 3.0
+#pragma once
+
+#include <istream>
+#include <ostream>
+
+#include "DLLDecl.h"
+#include "Error.hpp"
+#include "NeuroBuffer.hpp"
+#include "Numeric.hpp"
+
+namespace Neuro {
+    namespace Runtime
+    {
+        namespace EHeapSegmentFlags {
+            enum {
+                Trivial = 1,
+                Dormant = 2,
+                Large   = 4,
+            };
+        }
+        
+        namespace EHeapBlockFlags {
+            enum {
+                Trivial = 1,
+                Dormant = 2,
+                Object  = 4,
+                Large   = 8,
+            };
+        }
+        
+        struct NEURO_API HeapSnapshot
+        {
+        public:    // Constants
+            static constexpr uint32 Magic = 0x50534e48; // "NHSP"
+            static constexpr uint32 Version = 1;
+            
+        public:    // Types
+            /**
+             * Segment or large object region. Only the first `usedBytes` of
+             * a segment have been handed out.
+             */
+            struct Segment {
+                uint64 address;
+                uint64 size;
+                uint64 usedBytes;
+                uint32 flags;
+            };
+            
+            /**
+             * Header of a block of managed memory, including swept blocks and
+             * fillers, which are not referred to by any table record.
+             */
+            struct Block {
+                uint64 address;
+                uint32 totalBytes;
+                uint32 tableIndex;
+                uint32 segment;
+                uint8  flags;
+                uint8  garbageState;
+                uint8  age;
+            };
+            
+            /**
+             * Used record of the managed memory table, referring to the block
+             * at the given address.
+             */
+            struct Record {
+                uint32 index;
+                
+                /**
+                 * Generation of the record, i.e. how often it was freed before.
+                 * Only 32 bits are in use, but the field keeps its width so the
+                 * snapshot format remains unchanged.
+                 */
+                uint64 generation;
+                uint64 address;
+            };
+            
+            /**
+             * Object with the given number of property slots, of which
+             * `numProperties` are in use. Its references to other objects are
+             * `references[firstReference, firstReference + numReferences)`.
+             */
+            struct ObjectNode {
+                uint32 tableIndex;
+                uint32 capacity;
+                uint32 numProperties;
+                uint32 firstReference;
+                uint32 numReferences;
+            };
+            
+            /**
+             * Property of an object referring to the object with the given
+             * table index.
+             */
+            struct Reference {
+                uint32 propertyId;
+                uint32 target;
+            };
+            
+        public:    // Properties
+            Buffer<Segment> segments;
+            Buffer<Block> blocks;
+            Buffer<Record> records;
+            Buffer<ObjectNode> objects;
+            Buffer<Reference> references;
+            
+            /**
+             * Table indices of the rooted objects.
+             */
+            Buffer<uint32> roots;
+            
+        public:    // Methods
+            Error write(std::ostream& out) const;
+            
+            /**
+             * Replaces this snapshot with the one read from the stream.
+             * Fails with an InvalidArgumentError if the stream does not hold
+             * a snapshot of this version.
+             */
+            Error read(std::istream& in);
+            
+            void clear();
+        };
+    }
+}
@@ -1,18 +1,22 @@
 ////////////////////////////////////////////////////////////////////////////////
 // Overhead to a continuous managed memory buffer. Holds some meta data on the
 // associated buffer, including size and management flags.
+// 
+// Every allocation carries this header, hence it is kept at 16 bytes. How to
+// copy and destroy non-trivial memory is looked up in the type table by the
+// header's type id rather than stored in every header.
 // -----
 // Copyright (c) Kiruse 2018 Germany
 // License: GNU GPL-3.0
 #pragma once
 
-#include "Delegate.hpp"
-#include "Maybe.hpp"
 #include "Numeric.hpp"
 
 namespace Neuro {
     namespace Runtime
     {
+        struct TypeDescriptor;
+        
         namespace EGarbageState {
             enum {
                 Live,
@@ -45,20 +49,52 @@ namespace Neuro {
             uint32 garbageState : 2;
             
             /**
-             * Optional copy delegate. The GC ignores this when it assumes it
-             * operates on trivial memory.
+             * Number of collection cycles this memory has survived, saturating
+             * at 3. Memory which has not survived any cycle yet is never
+             * considered garbage as it may not have been linked yet.
+             */
+            uint32 age : 2;
+            
+            /**
+             * Whether this memory has been promoted out of the nursery into
+             * a dormant segment of the old generation.
+             */
+            uint32 isDormant : 1;
+            
+            /**
+             * Whether the GC has traced this memory as an Object, and hence
+             * knows where to find its pointers.
+             */
+            uint32 isObject : 1;
+            
+            /**
+             * Whether this memory occupies a large object region of its own
+             * rather than a segment. Such memory is never moved.
+             */
+            uint32 isLarge : 1;
+            
+            /**
+             * Id of the non-trivial type of the elements in the type table, or
+             * 0 if the memory is trivial.
              */
-            Maybe<Delegate<void, void*, const void*>> copyDelegate;
+            uint32 typeId : 16;
             
             /**
-             * Optional destruction delegate. The GC ignores this when it
-             * assumes it operates on trivial memory.
+             * Index of the table record referring to this memory, or npos
+             * until the memory has been registered with the table. Allows the
+             * compactor to update the record after moving the memory.
              */
-            Maybe<Delegate<void, void*>> destroyDelegate;
+            uint32 tableIndex;
             
             
             ManagedMemoryOverhead() = default;
-            ManagedMemoryOverhead(uint32 elementSize, uint32 count = 1) : elementSize(elementSize), count(count), garbageState(EGarbageState::Live) {}
+            ManagedMemoryOverhead(uint32 elementSize, uint32 count = 1) : elementSize(elementSize), count(count), garbageState(EGarbageState::Live), age(0), isDormant(0), isObject(0), isLarge(0), typeId(0), tableIndex(npos) {}
+            
+            /**
+             * Gets the descriptor of the non-trivial type of the elements, or
+             * null if there is none.
+             */
+            const TypeDescriptor* getType() const;
             
             /**
              * Gets the number of bytes in the subsequent memory buffer.
@@ -89,5 +125,20 @@ namespace Neuro {
                 return (uint8*)getBufferPointer() + elementSize * count;
             }
         };
+        
+        static_assert(sizeof(ManagedMemoryOverhead) == 16, "Headers of managed memory are expected to take 16 bytes");
+    }
+}
+
+// The type table refers to managed pointers, which in turn resolve to this
+// header, hence it is included only once the header is complete.
+#include "TypeTable.hpp"
+
+namespace Neuro {
+    namespace Runtime
+    {
+        inline const TypeDescriptor* ManagedMemoryOverhead::getType() const {
+            return typeId ? &TypeTable::get(typeId) : nullptr;
+        }
     }
 }
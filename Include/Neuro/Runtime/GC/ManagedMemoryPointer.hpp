@@ -14,14 +14,24 @@
 // 
 // As with all low level API, tampering with the data structures in an unforseen
 // way may completely break everything or lead to memory leaks and corruption.
+// 
+// Pointers are plain 8-byte handles, trivially copyable and without vtable, as
+// every Value and every Property embeds one. Resolving them is the hottest path
+// of the runtime, hence pointers resolve inline against the table of the main
+// GC instance and only call into a GC resolving them otherwise.
 // -----
 // Copyright (c) Kiruse 2018
 // License: GPL 3.0
 #pragma once
 
+#include <atomic>
+#include <type_traits>
+
 #include "DLLDecl.h"
 #include "Delegate.hpp"
 #include "HashCode.hpp"
+#include "ManagedMemoryOverhead.hpp"
+#include "ManagedMemoryTableRecord.hpp"
 #include "Numeric.hpp"
 
 namespace Neuro {
@@ -29,45 +39,69 @@ namespace Neuro {
         // Forward-declare Object class, as we need a pointer to it.
         class Object;
         
-        // Forward-declare overhead class, because this class is commonly used
-        // outside of the GC environment, yet the overhead struct is not.
-        struct ManagedMemoryOverhead;
-        
         class NEURO_API ManagedMemoryPointerBase {
             friend class GC;
             friend class GCInterface;
             friend class ManagedMemoryTable;
+            friend class MarkBitmap;
             
             /**
-             * Index of the managed memory descriptor within the internal
-             * global table.
+             * Pages of the table of the main GC instance, against which
+             * pointers resolve inline, or null if the main instance resolves
+             * pointers otherwise. Loaded once per resolution, so that it
+             * never resolves against a directory cleared in the meantime.
              */
-            uint32 tableIndex;
+            static std::atomic<const std::atomic<ManagedMemoryTablePage*>*> residentPages;
             
             /**
-             * Locally unique ID of the row, designed to minimize clashing
-             * potential. This is specifically used to account for weak pointers
-             * outside of the managed memory realm to ensure that the pointer
-             * they expect is still the same, even if the row has been reclaimed
-             * and reused.
+             * Index of the managed memory descriptor within the internal
+             * global table in the lower 32 bits, and the generation of the
+             * descriptor in the upper 32 bits. The table advances the
+             * generation whenever the descriptor is freed, such that pointers
+             * outliving their memory are detected exactly, even if the
+             * descriptor has been reclaimed and reused.
              */
-            hashT rowuid;
+            uint64 handle;
             
         public:  // RAII
-            ManagedMemoryPointerBase() : tableIndex(npos), rowuid(0) {}
-            virtual ~ManagedMemoryPointerBase() {}
+            ManagedMemoryPointerBase() : handle(npos) {}
             
         public:  // Methods
-            void* get(uint32 index = 0) const;
+            void* get(uint32 index = 0) const {
+                auto* head = getHeadPointer();
+                if (!head) return nullptr;
+                return reinterpret_cast<uint8*>(head->getBufferPointer()) + head->elementSize * index;
+            }
+            
+            /**
+             * Whether this pointer was never assigned any memory. Unlike
+             * testing the pointer itself, this does not resolve it.
+             */
+            bool isNull() const { return getTableIndex() == npos; }
             
         public:  // Operators
-            bool operator==(const ManagedMemoryPointerBase& other) const { return tableIndex == other.tableIndex; }
+            bool operator==(const ManagedMemoryPointerBase& other) const { return handle == other.handle; }
             bool operator!=(const ManagedMemoryPointerBase& other) const { return !(*this == other); }
             
-            operator bool() const { return tableIndex != npos && get() != nullptr; }
+            operator bool() const { return !isNull() && get() != nullptr; }
             
         private: // Utility
-            ManagedMemoryOverhead* getHeadPointer() const;
+            ManagedMemoryOverhead* getHeadPointer() const {
+                if (auto* pages = residentPages.load(std::memory_order_acquire)) return resolveRecord(pages, getTableIndex(), getGeneration());
+                return resolveHeadPointer();
+            }
+            
+            /**
+             * Resolves the pointer through the main GC instance.
+             */
+            ManagedMemoryOverhead* resolveHeadPointer() const;
+            
+            uint32 getTableIndex() const { return static_cast<uint32>(handle); }
+            uint32 getGeneration() const { return static_cast<uint32>(handle >> 32); }
+            
+            void setHandle(uint32 tableIndex, uint32 generation) {
+                handle = static_cast<uint64>(generation) << 32 | tableIndex;
+            }
         };
         
         template<typename T>
@@ -82,6 +116,8 @@ namespace Neuro {
             T* operator->() const { return get(); }
             T& operator[](uint32 index) const { return *get(index); }
         };
+        
+        static_assert(sizeof(ManagedMemoryPointerBase) == 8 && std::is_trivially_copyable_v<ManagedMemoryPointerBase>, "Managed pointers are expected to be plain 8-byte handles");
     }
     
     inline hashT calculateHash(const Runtime::ManagedMemoryPointerBase& pointer) {
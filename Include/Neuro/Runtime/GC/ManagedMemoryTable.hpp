@@ -3,29 +3,21 @@
 // 
 // Table structure:
 // + Table
-// |-+ Ledger
-//   |-+ 5 Pages
-//     |-+ 10 Sections
-//       |-- 100 Rows (pointers + minor overhead)
+// |-+ Directory of up to 65536 pages
+//   |-- 1024 Records (pointers + minor overhead)
 // 
-// One ledger is stored directly in the stack of the table itself. One additional
-// ledger is stored on heap. Further ledgers are created at runtime as needed.
+// Pages are allocated as the table grows and never move until the table is
+// destroyed. Growing merely publishes another page through its atomic
+// slot in the directory, which is allocated up front. Resolving a record thus
+// is lock-free and takes two indirections: one into the directory, one into
+// the page.
 // 
-// All nested structures are stack-based, with the exception of ledgers.
-// 
-// Ledgers *must* be heap-based in order to permit active users (threads) to use
-// them while the GC thread is adding additional ledgers. This fixes the number
-// of indirections to 3: 1 = list of ledgers, 2 = list of pages, 3 = stored pointer.
-// Additionally, LL-Cache may keep the list of ledgers, which is not possible
-// with a linked list.
-// 
-// It remains to be seen whether this is efficient enough. An alternative
-// solution would be implementation of a many-readers-one-writer lock system
-// which would mean a stop-the-world (for a few millis) while replacing the
-// ledgers, but at the same time copying all ledgers performs at O(n).
-// 
-// TODO: Optimize for systems where at least one of the atomics is not lock-less.
-// Most importantly the sections' ptrs array needs to be mutex-less.
+// Removed records are recycled through a lock-free stack of free records, such
+// that the table grows with the number of live records rather than with the
+// number of records ever added. Pages whose records are all free are released
+// when the GC scans for gaps: their memory is returned to the operating system
+// while they remain mapped, and their records remain reserved for the page
+// until it is reused, which happens before any fresh records are claimed.
 // -----
 // Copyright (c) Kiruse 2018
 // License: GPL 3.0
@@ -36,156 +28,22 @@
 #pragma warning(disable: 4251)
 
 #include <atomic>
+#include <mutex>
 #include <utility>
-#include <cstring>
 
 #include "DLLDecl.h"
+#include "Delegate.hpp"
 #include "Error.hpp"
 #include "ManagedMemoryPointer.hpp"
 #include "ManagedMemoryOverhead.hpp"
+#include "ManagedMemoryTableRecord.hpp"
+#include "NeuroBuffer.hpp"
 #include "NeuroSet.hpp"
 #include "Numeric.hpp"
-#include "Concurrency/ReverseSemaphore.hpp"
-
-#define NEURO_MANAGEDMEMORYTABLE_RECORDS_PER_PAGE 1000
 
 namespace Neuro {
     namespace Runtime
     {
-        struct ManagedMemoryTableRecord
-        {
-            /**
-             * Actual underlying physical address. Assumed to point to managed
-             * memory.
-             */
-            ManagedMemoryOverhead* ptr;
-            
-            /**
-             * Locally unique ID of the row, designed to minimize clashing
-             * potential. This is specifically used to account for weak pointers
-             * outside of the managed memory realm to ensure that the pointer
-             * they expect is still the same, even if the row has been reclaimed
-             * and reused.
-             */
-            hashT uid;
-        };
-        
-        struct ManagedMemoryTablePage
-        {
-            ManagedMemoryTableRecord records[NEURO_MANAGEDMEMORYTABLE_RECORDS_PER_PAGE];
-        };
-        
-        struct ManagedMemoryTableRange
-        {
-            std::atomic<uint32> start;
-            uint32 end;
-            
-            ManagedMemoryTableRange() = default;
-            ManagedMemoryTableRange(uint32 start, uint32 end) : start(start), end(end) {}
-            
-            uint32 claim() {
-                uint32 index = start.fetch_add(1);
-                if (index >= end) {
-                    start.fetch_sub(1);
-                    return npos;
-                }
-                return index;
-            }
-        };
-        
-        
-        /**
-         * Specialized RAII allocator designed for ManagedMemoryTablePages. Main
-         * distinction is that data is treated as bytewise copyable raw data.
-         */
-        struct ManagedMemoryTablePageAllocator {
-        public: // Properties
-            ManagedMemoryTablePage* m_buffer;
-            uint32 m_size;
-            
-        public: // RAII
-            ManagedMemoryTablePageAllocator() : m_buffer(nullptr), m_size(0) {}
-            ManagedMemoryTablePageAllocator(uint32 desiredSize) : m_buffer(alloc(desiredSize)), m_size(desiredSize) {
-                std::memset(m_buffer, 0, sizeof(ManagedMemoryTablePage) * desiredSize);
-            }
-            ManagedMemoryTablePageAllocator(const ManagedMemoryTablePageAllocator& other) : m_buffer(alloc(other.m_size)), m_size(other.m_size) {}
-            ManagedMemoryTablePageAllocator(ManagedMemoryTablePageAllocator&& other) : m_buffer(other.m_buffer), m_size(other.m_size) {
-                other.m_buffer = nullptr;
-                other.m_size = 0;
-            }
-            ManagedMemoryTablePageAllocator& operator=(const ManagedMemoryTablePageAllocator& other) {
-                if (m_buffer) delete[] m_buffer;
-                m_buffer = alloc(other.m_size);
-                m_size   = other.m_size;
-                copy(0, other.m_buffer, m_size);
-                return *this;
-            }
-            ManagedMemoryTablePageAllocator& operator=(ManagedMemoryTablePageAllocator&& other) {
-                if (m_buffer) delete[] m_buffer;
-                m_buffer = other.m_buffer;
-                m_size   = other.m_size;
-                other.m_buffer = nullptr;
-                other.m_size   = 0;
-                return *this;
-            }
-            ~ManagedMemoryTablePageAllocator() {
-                if (m_buffer) delete[] m_buffer;
-                m_buffer = nullptr;
-                m_size = 0;
-            }
-            
-        public: // Interface
-            void resize(uint32 desiredSize) {
-                if (m_buffer && desiredSize != m_size) {
-                    ManagedMemoryTablePage* tmp = m_buffer;
-                    m_buffer = alloc(desiredSize);
-                    if (m_buffer) {
-                        uint32 copysize = std::min(desiredSize, m_size);
-                        std::memset(m_buffer + copysize, 0, std::max(desiredSize, m_size) - copysize);
-                        std::memcpy(m_buffer, tmp, copysize);
-                        m_size = desiredSize;
-                        delete[] tmp;
-                    }
-                    else {
-                        m_size = 0;
-                    }
-                }
-            }
-            
-            void destroy(uint32 index, uint32 count) {}
-            
-            void copy(uint32 index, const ManagedMemoryTablePage* source, uint32 count) {
-                if (m_buffer) {
-                    count = std::min(count, m_size - index) * sizeof(ManagedMemoryTablePage);
-                    std::memcpy(m_buffer, source, count);
-                }
-            }
-            void copy(uint32 to, uint32 from, uint32 count) {
-                if (m_buffer) {
-                    count = std::min(m_size - to, count);
-                    count = std::min(m_size - from, count);
-                    std::memmove(m_buffer + to, m_buffer + from, count * sizeof(ManagedMemoryTablePage));
-                }
-            }
-            
-            ManagedMemoryTablePage* get(uint32 index) { return m_buffer + index; }
-            const ManagedMemoryTablePage* get(uint32 index) const { return m_buffer + index; }
-            
-            uint32 size() const { return m_size; }
-            uint32 actual_size() const { return m_size; }
-            uint32 numBytes() const { return m_size * sizeof(ManagedMemoryTablePage); }
-            
-            ManagedMemoryTablePage* data() { return m_buffer; }
-            const ManagedMemoryTablePage* data() const { return m_buffer; }
-            
-        protected: // Static helpers
-            static ManagedMemoryTablePage* alloc(uint32 desiredSize) {
-                if (!desiredSize) return nullptr;
-                return new ManagedMemoryTablePage[desiredSize];
-            }
-        };
-        
-        
         /**
          * The entire table that stores and manages our pointers to managed
          * memory. The ManagedMemoryPointerBase refers to such a table's row
@@ -229,8 +87,7 @@ namespace Neuro {
                 ManagedMemoryPointerBase operator*() const {
                     ManagedMemoryPointerBase ptr;
                     ManagedMemoryTableRecord* record = table->getRecord(tableIndex);
-                    ptr.tableIndex = tableIndex;
-                    ptr.rowuid = record->uid;
+                    ptr.setHandle(tableIndex, record->generation);
                     return ptr;
                 }
                 
@@ -246,53 +103,71 @@ namespace Neuro {
                     return !(*this==other);
                 }
             };
-        
+            
+        public:    // Constants
+            static constexpr uint32 PageSize = NEURO_MANAGEDMEMORYTABLE_RECORDS_PER_PAGE;
+            static constexpr uint32 MaxPages = NEURO_MANAGEDMEMORYTABLE_MAX_PAGES;
+            
         private:   // Properties
             /**
-             * Whether the table should be expanded.
+             * Whether records were freed since the last scan for gaps.
              */
-            std::atomic<bool> shouldExpand;
+            std::atomic<bool> shouldScanGaps;
             
             /**
-             * Whether we should scan for gaps eventually.
+             * Directory of MaxPages slots, each null until its page is
+             * allocated.
              */
-            std::atomic<bool> shouldScanGaps;
+            std::atomic<ManagedMemoryTablePage*>* pages;
             
             /**
-             * Underlying many-readers-one-writer sync mechanism.
+             * One past the index of the highest page allocated so far. Pages
+             * below may still be missing while another thread allocates them.
              */
-            mutable Concurrency::ReverseSemaphore semaphore;
-            
-            Buffer<ManagedMemoryTablePage, ManagedMemoryTablePageAllocator> pages;
+            std::atomic<uint32> numPages;
             
             /**
-             * Stores the index of the next record to be inserted.
+             * Stores the index of the next record never claimed before.
              */
             std::atomic<uint32> nextRecordIdx;
             
             /**
-             * Many-readers-one-writer sync mechanism for gaps detection.
+             * Number of records currently referring to memory.
              */
-            mutable Concurrency::ReverseSemaphore gapsSemaphore;
+            std::atomic<uint32> numRecords;
             
             /**
-             * Pointer to the buffer of currently available ranges. May also
-             * contain exhausted ranges.
+             * Head of the lock-free stack of free records, linked through their
+             * `next` indices. The lower 32 bits hold the index of the top record, or
+             * npos if the stack is empty, the upper 32 bits a tag incremented
+             * with every change to guard against ABA.
              */
-            ManagedMemoryTableRange* gaps;
+            std::atomic<uint64> freeHead;
             
             /**
-             * Number of currently available ranges.
+             * Pages released for being entirely free, along with the highest
+             * generation among their records. Reused pages continue from there,
+             * as the generations themselves are discarded with the page.
              */
-            uint32 numGaps;
+            struct ReleasedPage {
+                uint32 index;
+                uint32 generation;
+            };
+            Buffer<ReleasedPage> releasedPages;
+            std::mutex releasedPagesMutex;
+            std::atomic<uint32> numReleasedPages;
             
+        public:    // Delegates
             /**
-             * Next salt value for calculation of a hash-based UID.
+             * Invoked with the new number of pages after the table grew.
              */
-            std::atomic<uint32> uidsalt;
+            MulticastDelegate<void, uint32> onGrow;
             
         public:    // RAII
             ManagedMemoryTable();
+            ManagedMemoryTable(const ManagedMemoryTable&) = delete;
+            ManagedMemoryTable& operator=(const ManagedMemoryTable&) = delete;
+            ~ManagedMemoryTable();
             
         public:    // Methods
             
@@ -331,7 +206,7 @@ namespace Neuro {
             
             /**
              * Gets the pointer corresponding to the actual data behind the
-             * managed memory pointer.
+             * managed memory pointer. Lock-free.
              */
             void* get(const ManagedMemoryPointerBase& ptr) const;
             
@@ -340,27 +215,68 @@ namespace Neuro {
                 return reinterpret_cast<T*>(get((const ManagedMemoryPointerBase)ptr));
             }
             
+            /**
+             * Gets a managed memory pointer to the record at the given table
+             * index. If the record is unused or out of bounds, the returned
+             * pointer is invalid.
+             */
+            ManagedMemoryPointerBase getPointer(uint32 tableIndex) const;
+            
+            /**
+             * Lets all ManagedMemoryPointers resolve inline against the given
+             * table, or through the main GC instance if null.
+             */
+            static void makeResident(const ManagedMemoryTable* table) {
+                ManagedMemoryPointerBase::residentPages.store(table ? table->pages : nullptr, std::memory_order_release);
+            }
+            
             void collect(StandardHashSet<ManagedMemoryPointerBase>& pointers) const;
             
         public:    // Management
             /**
-             * Get the number of pages in this table.
+             * Get the number of pages in this table, i.e. one past the highest
+             * page allocated.
              */
             uint32 countPages() const {
-                return pages.length();
+                return numPages.load(std::memory_order_acquire);
+            }
+            
+            /**
+             * Gets the number of records ever claimed, free or not, i.e. the
+             * extent of the table in use.
+             */
+            uint32 countClaimedRecords() const {
+                return nextRecordIdx.load(std::memory_order_relaxed);
+            }
+            
+            /**
+             * Gets the number of pages currently released.
+             */
+            uint32 countReleasedPages() const {
+                return numReleasedPages.load(std::memory_order_relaxed);
             }
             
-            uint32 countRecordsEstimate() const;
+            /**
+             * Gets the number of records currently referring to memory.
+             */
+            uint32 countRecords() const {
+                return numRecords.load(std::memory_order_relaxed);
+            }
             
             /**
-             * Detects gaps in the table that were created upon removing a record.
+             * Orders the records freed upon removal so that they are reused
+             * lowest index first, releases pages whose records are all free,
+             * and returns the remaining free records at the very end of the
+             * table to its unclaimed remainder. Live records thus concentrate
+             * at the front of the table. Safe to call concurrently with the
+             * other methods, which merely claim fresh records meanwhile.
              */
-            void findGaps(uint32 minGapSize = 1);
+            void findGaps();
             
             
         public:    // Iterator
-            Iterator begin()  const { return Iterator(this, 0); }
-            Iterator cbegin() const { return Iterator(this, 0); }
+            Iterator begin()  const;
+            Iterator cbegin() const { return begin(); }
             Iterator end()    const { return Iterator(this, npos); }
             Iterator cend()   const { return Iterator(this, npos); }
             
@@ -368,9 +284,40 @@ namespace Neuro {
         protected: // Methods
             static void decomposeTableIndex(uint32 tableIndex, uint32& pageIndex, uint32& recordIndex);
             
+            /**
+             * Gets the record at the given table index, or null if its page
+             * has not been allocated.
+             */
             ManagedMemoryTableRecord* getRecord(uint32 tableIndex) const;
             
+            /**
+             * Gets the page of the given index, allocating it if necessary.
+             */
+            ManagedMemoryTablePage* reservePage(uint32 pageIndex);
+            
+            /**
+             * Claims a free record if available, otherwise a fresh one.
+             */
             uint32 claimIndex();
+            
+            /**
+             * Pushes the given records, linked in order, on top of the free
+             * records.
+             */
+            void releaseIndices(uint32 first, uint32 last);
+            
+            /**
+             * Returns the memory of an entirely free page to the operating
+             * system. Its records must not be among the free records.
+             */
+            void releasePage(uint32 pageIndex);
+            
+            /**
+             * Reuses a released page, if any, claiming its first record and
+             * pushing the others on top of the free records. Returns npos if
+             * no page is released.
+             */
+            uint32 reclaimPage();
         };
     }
 }
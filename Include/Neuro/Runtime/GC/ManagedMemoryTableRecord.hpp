@@ -0,0 +1,66 @@
+////////////////////////////////////////////////////////////////////////////////
+// Records and pages of the ManagedMemoryTable, separate from the table itself
+// so that ManagedMemoryPointers may resolve themselves inline without the
+// table's header depending on them in turn.
+// -----
+// Copyright (c) Kiruse 2018
+// License: GPL 3.0
+#pragma once
+
+#include <atomic>
+
+#include "Numeric.hpp"
+
+#define NEURO_MANAGEDMEMORYTABLE_RECORDS_PER_PAGE 1024
+#define NEURO_MANAGEDMEMORYTABLE_MAX_PAGES 65536
+
+namespace Neuro {
+    namespace Runtime
+    {
+        struct ManagedMemoryOverhead;
+        
+        struct ManagedMemoryTableRecord
+        {
+            /**
+             * Actual underlying physical address. Assumed to point to managed
+             * memory.
+             */
+            ManagedMemoryOverhead* ptr;
+            
+            /**
+             * Advanced whenever the record is freed. Pointers carry the
+             * generation of the record they were handed out for, which ensures
+             * that the record they expect is still the same, even if it has
+             * been reclaimed and reused.
+             */
+            uint32 generation;
+            
+            /**
+             * Index of the next free record while the record is free, i.e.
+             * `ptr` is null.
+             */
+            uint32 next;
+        };
+        
+        struct ManagedMemoryTablePage
+        {
+            ManagedMemoryTableRecord records[NEURO_MANAGEDMEMORYTABLE_RECORDS_PER_PAGE];
+        };
+        
+        /**
+         * Looks up the memory the given record refers to in a directory of
+         * pages, or null if the record is out of bounds, free, or has been
+         * reused since the given generation.
+         */
+        inline ManagedMemoryOverhead* resolveRecord(const std::atomic<ManagedMemoryTablePage*>* pages, uint32 tableIndex, uint32 generation) {
+            const uint32 pageIndex = tableIndex / NEURO_MANAGEDMEMORYTABLE_RECORDS_PER_PAGE;
+            if (pageIndex >= NEURO_MANAGEDMEMORYTABLE_MAX_PAGES) return nullptr;
+            
+            const ManagedMemoryTablePage* page = pages[pageIndex].load(std::memory_order_acquire);
+            if (!page) return nullptr;
+            
+            const ManagedMemoryTableRecord& record = page->records[tableIndex % NEURO_MANAGEDMEMORYTABLE_RECORDS_PER_PAGE];
+            return record.generation == generation ? record.ptr : nullptr;
+        }
+    }
+}
@@ -0,0 +1,138 @@
+////////////////////////////////////////////////////////////////////////////////
+// Dense side table of mark bits, one bit per ManagedMemoryTable record. Bit `i`
+// is set once the memory behind table index `i` has been reached during the
+// current scan phase.
+//
+// The bitmap lives alongside the table for the lifetime of the GC and is merely
+// cleared at the beginning of every scan, growing with the table's pages as
+// necessary. Marking is a single atomic fetch_or on the word containing the
+// bit, so any number of mark workers may mark concurrently.
+//
+// Bits beyond the number of records in the last word are permanently set so
+// that scanning for unmarked records never needs to special case them.
+// -----
+// Copyright (c) Kiruse 2018
+// License: GPL 3.0
+#pragma once
+
+#include <atomic>
+
+#include "DLLDecl.h"
+#include "ManagedMemoryPointer.hpp"
+#include "Numeric.hpp"
+
+namespace Neuro {
+    namespace Runtime
+    {
+        class NEURO_API MarkBitmap
+        {
+        public:    // Constants
+            static constexpr uint32 BitsPerWord = 64;
+            
+        private:   // Properties
+            std::atomic<uint64>* words;
+            
+            /**
+             * Number of words allocated. May exceed the number of words in use.
+             */
+            uint32 numWordsAllocated;
+            
+            /**
+             * Number of table records covered since the last reset.
+             */
+            uint32 numBits;
+            
+        public:    // RAII
+            MarkBitmap();
+            MarkBitmap(const MarkBitmap&) = delete;
+            MarkBitmap(MarkBitmap&&) = delete;
+            MarkBitmap& operator=(const MarkBitmap&) = delete;
+            MarkBitmap& operator=(MarkBitmap&&) = delete;
+            ~MarkBitmap();
+            
+        public:    // Methods
+            /**
+             * Clears all marks and resizes the bitmap to cover `numRecords`
+             * table records. Must not be called while marking.
+             */
+            void reset(uint32 numRecords);
+            
+            /**
+             * Resizes the bitmap to cover `numRecords` table records while
+             * retaining the marks of records covered before. Must not be
+             * called while marking.
+             */
+            void resize(uint32 numRecords);
+            
+            /**
+             * Marks the given table index. Returns true if this call set the
+             * bit, i.e. the caller is the first to reach the record. Indices
+             * beyond the bitmap are never marked.
+             */
+            bool mark(uint32 tableIndex) {
+                if (tableIndex >= numBits) return false;
+                const uint64 mask = uint64(1) << (tableIndex % BitsPerWord);
+                auto& word = words[tableIndex / BitsPerWord];
+                
+                // Test first to spare the cache line an atomic write if the
+                // record has already been reached.
+                if (word.load(std::memory_order_relaxed) & mask) return false;
+                return !(word.fetch_or(mask, std::memory_order_relaxed) & mask);
+            }
+            
+            bool mark(const ManagedMemoryPointerBase& ptr) {
+                return mark(ptr.getTableIndex());
+            }
+            
+            /**
+             * Clears the mark of the given table index.
+             */
+            void unmark(uint32 tableIndex) {
+                if (tableIndex >= numBits) return;
+                words[tableIndex / BitsPerWord].fetch_and(~(uint64(1) << (tableIndex % BitsPerWord)), std::memory_order_relaxed);
+            }
+            
+            /**
+             * Marks every record marked in `other` as well. Records beyond
+             * either bitmap are ignored.
+             */
+            void merge(const MarkBitmap& other);
+            
+            bool isMarked(uint32 tableIndex) const {
+                if (tableIndex >= numBits) return false;
+                return words[tableIndex / BitsPerWord].load(std::memory_order_relaxed) & (uint64(1) << (tableIndex % BitsPerWord));
+            }
+            
+            bool isMarked(const ManagedMemoryPointerBase& ptr) const {
+                return isMarked(ptr.getTableIndex());
+            }
+            
+            /**
+             * Gets an entire word of mark bits. Bit `b` of word `w` corresponds
+             * to table index `w * BitsPerWord + b`.
+             */
+            uint64 getWord(uint32 wordIndex) const {
+                return words[wordIndex].load(std::memory_order_relaxed);
+            }
+            
+            /**
+             * Number of words covering the table records since the last reset.
+             */
+            uint32 countWords() const {
+                return (numBits + BitsPerWord - 1) / BitsPerWord;
+            }
+            
+            /**
+             * Number of table records covered since the last reset.
+             */
+            uint32 countRecords() const {
+                return numBits;
+            }
+            
+            /**
+             * Counts the number of marked records.
+             */
+            uint32 countMarked() const;
+        };
+    }
+}
@@ -16,6 +16,37 @@
 extern "C" {
 #endif
 
+/**
+ * Snapshot of the Garbage Collector's statistics. Segments, large objects and
+ * live bytes are as of the end of the last cycle.
+ */
+struct neuroGCStats {
+    uint64_t bytesAllocated;
+    uint64_t liveBytes;
+    uint64_t committedBytes;
+    uint32_t numNurserySegments;
+    uint32_t numDormantSegments;
+    uint32_t numLargeObjects;
+    uint32_t numRecords;
+    uint64_t numCycles;
+    uint64_t numMajorCycles;
+    uint64_t lastScanNanoseconds;
+    uint64_t lastSweepNanoseconds;
+    uint64_t lastCompactNanoseconds;
+    uint64_t numSkippedCompactions;
+    uint64_t numSkippedCollections;
+};
+
+/** Latency histograms kept by the Garbage Collector. */
+enum neuroGCHistogram {
+    NGCH_Scan,
+    NGCH_Sweep,
+    NGCH_Compact,
+    NGCH_Pause,
+    NGCH_Safepoint,
+    NGCH_MAX
+};
+
 /** Allocates memory to a new managed object. */
 NEURO_API struct neuroObject* neuroGCAllocateObject();
 
@@ -42,6 +73,93 @@ NEURO_API int neuroGCMarkDead(struct neuroObject* object);
  */
 NEURO_API int neuroGCPurge();
 
+/**
+ * Advances an incremental collection by at most roughly the given number of
+ * microseconds, starting a new one if none is in progress. Meant to fill the
+ * idle time at the end of a frame.
+ * 
+ * Returns an estimate of the work remaining, or 0 once the collection has
+ * completed.
+ */
+NEURO_API uint64_t neuroGCStep(uint32_t budgetMicroseconds);
+
+/** Fills in the Garbage Collector's statistics. Returns 0 on success. */
+NEURO_API int neuroGCGetStats(struct neuroGCStats* stats);
+
+/**
+ * Gets the number of nanoseconds at or below which the given percentage of all
+ * durations recorded in the histogram lie, or 0 if none were recorded.
+ */
+NEURO_API uint64_t neuroGCGetLatencyPercentile(enum neuroGCHistogram histogram, double percentile);
+
+/** Gets the number of durations recorded in the histogram. */
+NEURO_API uint64_t neuroGCGetLatencyCount(enum neuroGCHistogram histogram);
+
+/** Clears the latency histograms. Returns 0 on success. */
+NEURO_API int neuroGCResetStats();
+
+/**
+ * Starts recording trace events of the Garbage Collector into a ring buffer of
+ * the given number of events, or of the default size if 0. The capacity is only
+ * considered the first time tracing is enabled. Returns 0 on success.
+ */
+NEURO_API int neuroGCEnableTracing(uint32_t capacity);
+
+/** Stops recording trace events. Returns 0 on success. */
+NEURO_API int neuroGCDisableTracing();
+
+/**
+ * Writes the trace events recorded so far to the given file as Chrome trace
+ * JSON, viewable in chrome://tracing or Perfetto. Returns 0 on success.
+ */
+NEURO_API int neuroGCWriteTrace(const char* path);
+
+/**
+ * Starts sampling allocations roughly every `interval` bytes, or the default
+ * interval if 0. The interval is only considered the first time profiling is
+ * enabled. Returns 0 on success.
+ */
+NEURO_API int neuroGCEnableProfiling(uint64_t interval);
+
+/** Stops sampling allocations. Returns 0 on success. */
+NEURO_API int neuroGCDisableProfiling();
+
+/**
+ * Writes the allocation samples taken so far as a pprof profile to the given
+ * file. Returns 0 on success.
+ */
+NEURO_API int neuroGCWriteProfile(const char* path);
+
+/**
+ * Writes a snapshot of the managed heap to the given file, to be analyzed by
+ * the NeuroHeap tool. No other thread may allocate or access managed memory
+ * meanwhile. Returns 0 on success.
+ */
+NEURO_API int neuroGCDumpHeap(const char* path);
+
+/**
+ * Registers the calling thread as a mutator, which the Garbage Collector stops
+ * at a safepoint before moving memory. Registrations nest. Returns 0 on success.
+ */
+NEURO_API int neuroGCRegisterThread();
+
+/** Undoes a registration of the calling thread. Returns 0 on success. */
+NEURO_API int neuroGCUnregisterThread();
+
+/**
+ * Parks the calling thread if the Garbage Collector is stopping the world. No
+ * native pointers into managed memory may be held across. Returns 0.
+ */
+NEURO_API int neuroGCSafepoint();
+
+/**
+ * Enters or leaves a region in which the calling thread does not access managed
+ * memory, e.g. while blocking. The Garbage Collector does not wait for threads
+ * in safe regions. Leaving blocks while the world is stopped. Returns 0.
+ */
+NEURO_API int neuroGCEnterSafeRegion();
+NEURO_API int neuroGCLeaveSafeRegion();
+
 /** Clears the entire managed memory and resets the Garbage Collector. */
 NEURO_API int neuroGCClear();
 
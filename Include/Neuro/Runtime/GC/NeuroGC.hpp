@@ -27,38 +27,100 @@
 
 #include <atomic>
 #include <chrono>
+#include <condition_variable>
 #include <cstddef>
 #include <cstdint>
+#include <memory>
 #include <mutex>
+#include <ostream>
 #include <thread>
 #include <utility>
 
+#include "CardTable.hpp"
 #include "DLLDecl.h"
 #include "Delegate.hpp"
+#include "AllocationProfiler.hpp"
 #include "Error.hpp"
+#include "FreeLists.hpp"
+#include "GCStats.hpp"
+#include "HeapSnapshot.hpp"
 #include "ManagedMemoryTable.hpp"
+#include "MarkBitmap.hpp"
 #include "MaybeAnError.hpp"
 #include "Misc.hpp"
 #include "NeuroObject.hpp"
 #include "NeuroSet.hpp"
+#include "Safepoints.hpp"
+#include "SegmentHeap.hpp"
+#include "TraceBuffer.hpp"
+#include "TypeTable.hpp"
+#include "Concurrency/WorkerPool.hpp"
+#include "Concurrency/WorkStealingDeque.hpp"
+
+/**
+ * Default number of bytes allocated after which the background thread runs a
+ * collection cycle without waiting for the scan interval to elapse.
+ */
+#define NEURO_GC_ALLOCATION_THRESHOLD (16 * 1024 * 1024)
+
+/**
+ * Number of bytes of a nursery segment reserved for a thread at once, in which
+ * it then allocates without synchronization. Larger allocations bypass these
+ * buffers.
+ */
+#define NEURO_GC_ALLOCATION_BUFFER_SIZE (32 * 1024)
+
+/**
+ * Default number of bytes above which memory is placed in a large object
+ * region of its own rather than a segment, so that it is never copied.
+ */
+#define NEURO_GC_LARGE_OBJECT_THRESHOLD (256 * 1024)
+
+/**
+ * Maximum number of garbage blocks an allocation sweeps at once. Garbage of the
+ * nursery is queued in groups of at most this many blocks of a single segment.
+ */
+#define NEURO_GC_LAZY_SWEEP_BLOCKS 1024
+
+/**
+ * Number of bytes of address space reserved for the segments up front. Only
+ * the pages of segments actually in use are committed. Segments beyond the
+ * reservation are mapped individually.
+ */
+#define NEURO_GC_HEAP_RESERVE (size_t(64) * 1024 * 1024 * 1024)
+
+/**
+ * Default number of cycles memory needs to survive in the nursery before it is
+ * promoted into the old generation. Ages saturate at 3.
+ */
+#define NEURO_GC_PROMOTION_AGE 2
+
+/**
+ * Default number of cycles after which a major cycle collects the entire heap.
+ * All other cycles merely collect the nursery.
+ */
+#define NEURO_GC_MAJOR_CYCLE_INTERVAL 8
+
+/**
+ * Default number of events the trace buffer holds before the oldest events are
+ * overwritten.
+ */
+#define NEURO_GC_TRACE_CAPACITY (64 * 1024)
+
+/**
+ * Default number of microseconds compaction waits for the registered mutators
+ * to reach a safepoint before it is skipped for the cycle.
+ */
+#define NEURO_GC_SAFEPOINT_TIMEOUT 10000
+
+/**
+ * Default average number of bytes allocated between two samples of the
+ * allocation profiler.
+ */
+#define NEURO_GC_PROFILE_INTERVAL (512 * 1024)
 
 namespace Neuro {
     namespace Runtime {
-        ////////////////////////////////////////////////////////////////////
-        // Helper Functions
-        ////////////////////////////////////////////////////////////////////
-        
-        template<typename T>
-        void copyNonTrivialType(void* target, const void* source) {
-            new (reinterpret_cast<T*>(target)) T(*reinterpret_cast<T*>(source));
-        }
-        
-        template<typename T>
-        void destroyNonTrivialType(void* target) {
-            reinterpret_cast<T*>(target)->~T();
-        }
-        
-        
         ////////////////////////////////////////////////////////////////////
         // Managed Memory Segment meta data
         // -----
@@ -89,9 +151,11 @@ namespace Neuro {
             std::atomic_bool compacting;
             
             /**
-             * Pointer to the first address guaranteed to be available.
+             * Pointer to the first address guaranteed to be available. Bumped
+             * by compare-exchange, so threads may reserve allocation buffers
+             * without taking the lock.
              */
-            uint8* ptr;
+            std::atomic<uint8*> ptr;
             
             /**
              * Number of bytes in this memory segment, including the segment
@@ -101,10 +165,17 @@ namespace Neuro {
             
             /**
              * Whether this memory segment is reserved for long-term memory
-             * that is known not to resize commonly and has survived multiple
-             * scans (e.g. roots).
+             * that has survived multiple scans (e.g. roots), i.e. belongs to
+             * the old generation rather than the nursery.
              */
-            uint32 dormant : 1; // TODO: Introduce "dormant" memory segments which contain objects that don't change in size anymore.
+            uint32 dormant : 1;
+            
+            /**
+             * Cards of this segment dirtied by stores of managed pointers.
+             * Only consulted for the old generation, as the nursery is traced
+             * in its entirety anyway.
+             */
+            CardTable cards;
             
             
             /**
@@ -126,6 +197,95 @@ namespace Neuro {
             };
         };
         
+        /**
+         * Range of the blocks laid out back to back within a segment, from
+         * its first block up to the given end, or its allocation pointer as
+         * of constructing the range. Meant for range-based for loops.
+         */
+        class SegmentBlocks
+        {
+        public:    // Types
+            class Iterator
+            {
+            private:   // Properties
+                ManagedMemoryOverhead* head;
+                
+            public:    // RAII
+                Iterator(ManagedMemoryOverhead* head) : head(head) {}
+                
+            public:    // Operators
+                ManagedMemoryOverhead* operator*() const { return head; }
+                
+                Iterator& operator++() {
+                    head = reinterpret_cast<ManagedMemoryOverhead*>(reinterpret_cast<uint8*>(head) + head->getTotalBytes());
+                    return *this;
+                }
+                
+                /**
+                 * Blocks may extend past the end only if the segment is
+                 * corrupt, which must not loop forever either.
+                 */
+                bool operator!=(const Iterator& end) const { return head < end.head; }
+            };
+            
+        private:   // Properties
+            ManagedMemoryOverhead* first;
+            ManagedMemoryOverhead* limit;
+            
+        public:    // RAII
+            SegmentBlocks(ManagedMemorySegment* segment) : SegmentBlocks(segment, segment->ptr.load()) {}
+            SegmentBlocks(ManagedMemorySegment* segment, uint8* end) : first(reinterpret_cast<ManagedMemoryOverhead*>(segment + 1)), limit(reinterpret_cast<ManagedMemoryOverhead*>(end)) {}
+            
+        public:    // Methods
+            Iterator begin() const { return first; }
+            Iterator end() const { return limit; }
+        };
+        
+        
+        ////////////////////////////////////////////////////////////////////
+        // Large Object Region meta data
+        // -----
+        // Precedes a single block of memory too large to be moved around
+        // economically, mapped directly from the operating system. Like
+        // segments, regions are aligned to and sized in multiples of the
+        // card tables' regions. The block's overhead immediately follows.
+        ////////////////////////////////////////////////////////////////////
+        
+        struct LargeObjectRegion {
+            /**
+             * Neighbors in the GC's intrusive list of regions.
+             */
+            LargeObjectRegion* prev;
+            LargeObjectRegion* next;
+            
+            /**
+             * Number of bytes mapped, including the region overhead.
+             */
+            size_t size;
+            
+            /**
+             * Cards of this region dirtied by stores of managed pointers.
+             * Only consulted once the block has been promoted.
+             */
+            CardTable cards;
+            
+            ManagedMemoryOverhead* getHead() {
+                return reinterpret_cast<ManagedMemoryOverhead*>(this + 1);
+            }
+        };
+        
+        
+        /**
+         * Phases of an incremental cycle advanced by `GC::step`.
+         */
+        namespace EIncrementalPhase {
+            enum {
+                Idle,
+                Marking,
+                Sweeping,
+            };
+        }
+        
         
         /**
          * Interface that other parts of the Runtime use, e.g. Object.
@@ -133,6 +293,11 @@ namespace Neuro {
         class NEURO_API GCInterface
         {
         public:
+            /**
+             * Main instances are destroyed through this interface.
+             */
+            virtual ~GCInterface() = default;
+            
             /**
              * Allocate `size` bytes of managed trivial memory.
              * 
@@ -145,12 +310,12 @@ namespace Neuro {
              * Allocate `size` bytes of managed non-trivial memory.
              * 
              * When the GC moves or destroys the allocated non-trivial memory,
-             * it consults the provided delegates.
+             * it consults the descriptor of the given type in the TypeTable.
              * 
              * Non-trivial memory differs from trivial memory in that its members
              * require per-member copy and destruction operations.
              */
-            virtual ManagedMemoryPointerBase allocateNonTrivial(uint32 elementSize, uint32 count, const Delegate<void, void*, const void*>& copyDeleg, const Delegate<void, void*>& destroyDeleg) = 0;
+            virtual ManagedMemoryPointerBase allocateNonTrivial(uint32 elementSize, uint32 count, uint16 typeId) = 0;
             
             /**
              * Reallocate the buffer underlying the given pointer such that all
@@ -163,9 +328,28 @@ namespace Neuro {
              */
 			virtual Error reallocate(ManagedMemoryPointerBase ptr, uint32 size, uint32 count, bool autocopy = true) = 0;
             
+            /**
+             * Constructs reallocated memory in the new buffer (first argument)
+             * from the old one (second argument).
+             */
+            using ReallocateDelegate = Delegate<void, void*, void*>;
+            
+            /**
+             * Reallocate the buffer like above, but construct the new buffer
+             * through the given delegate rather than copying the old one.
+             * 
+             * The new buffer is only published once constructed, so that the
+             * GC never traces it half-built.
+             */
+            virtual Error reallocate(ManagedMemoryPointerBase ptr, uint32 size, uint32 count, const ReallocateDelegate& construct) = 0;
+            
             /**
              * Roots the given managed object. The implementation may assume
              * that the object is actually managed by this GC.
+             * 
+             * Native memory allocated through `GC::allocate` may be rooted
+             * likewise, in which case the memory referred to by its pointer
+             * map is kept alive.
              */
             virtual Error root(Pointer obj) = 0;
             
@@ -180,28 +364,35 @@ namespace Neuro {
              */
             virtual void* resolve(ManagedMemoryPointerBase pointer) = 0;
             
+            /**
+             * Gets the table whose records `resolve` looks pointers up in, if
+             * any. Pointers resolve inline against the table of the main
+             * instance, bypassing `resolve` entirely.
+             */
+            virtual const ManagedMemoryTable* getTable() const { return nullptr; }
+            
         protected:
             /**
              * Helper function for non-ManagedMemoryTable based GC systems to
              * create a ManagedMemoryPointerBase from a given memory address.
              * 
-             * Hint: Pointers use 8 or 12 bytes of data. By design, one 32-bit
-             * integer describes the index of the pointer within a table, and
-             * another 32 or 64 bits store the pointer's unique hash, allowing
-             * us to identify obsolete and out of date pointers.
+             * Hint: Pointers carry a single 64-bit handle. By design, its lower
+             * 32 bits describe the index of the pointer within a table, and its
+             * upper 32 bits the generation of the table's record, allowing us
+             * to identify obsolete and out of date pointers.
              * 
              * However, one is not bound to these design choices as the
              * GCInterface exposes the `resolve` method as well. One might simply
              * reinterpret the bytes and store a pointer directly instead.
              */
-            ManagedMemoryPointerBase makePointer(uint32 index, hashT hash);
+            ManagedMemoryPointerBase makePointer(uint32 index, uint32 generation);
             
             /**
              * Inverse of `makePointer`. While `resolve` allows us to specify
              * which ManagedMemoryTable to use, this helper allows us to not
              * use any such table to begin with.
              */
-            void extractPointerData(ManagedMemoryPointerBase pointer, uint32& index, hashT& hash);
+            void extractPointerData(ManagedMemoryPointerBase pointer, uint32& index, uint32& generation);
         };
         
         
@@ -214,7 +405,7 @@ namespace Neuro {
         class NEURO_API GC : public GCInterface
         {
         public:    // Types
-            using ScannerDelegate = Delegate<void, StandardHashSet<ManagedMemoryPointerBase>&>;
+            using ScannerDelegate = Delegate<void, MarkBitmap&>;
             
         protected: // Fields
             // TODO: Implement wrappers for std types to ensure library interface consistency.
@@ -223,20 +414,211 @@ namespace Neuro {
             std::mutex scannersMutex;
             std::mutex rootsMutex;
             std::mutex markedObjectsMutex;
+            std::mutex markersMutex;
+            
+            /**
+             * Guards the background thread's sleep between two cycles. The
+             * thread wakes up when either `scanInterval` elapses or enough
+             * memory has been allocated since the last cycle.
+             */
+            std::mutex cycleMutex;
+            std::condition_variable cycleNotif;
+            
+            /**
+             * Serializes the background thread's cycles and explicit
+             * collections.
+             */
+            std::mutex collectMutex;
             
             std::atomic_bool terminate;
+            std::atomic_bool cycleRequested;
+            std::atomic_bool majorCycleRequested;
             std::thread backgroundThread;
             
-            MulticastDelegate<void, StandardHashSet<ManagedMemoryPointerBase>&> scanners;
+            MulticastDelegate<void, MarkBitmap&> scanners;
+            
+            /**
+             * Virtual memory all segments are carved out of. Declared before
+             * the segments as it needs to outlive them.
+             */
+            SegmentHeap segmentHeap;
             
             ManagedMemoryTable dataTable;
             ManagedMemorySegment* firstTrivialMemSeg;
             ManagedMemorySegment* firstNonTrivialMemSeg;
             
+            /**
+             * Dormant segments of the old generation. Memory surviving enough
+             * cycles in the nursery is promoted into these, after which only
+             * major cycles consider it.
+             */
+            ManagedMemorySegment* firstDormantTrivialMemSeg;
+            ManagedMemorySegment* firstDormantNonTrivialMemSeg;
+            
+            /**
+             * Swept blocks of the nursery by size class, rebuilt by every
+             * sweep. Allocations reuse these before bumping, so that long
+             * sessions need not move memory to reclaim it. Compaction
+             * reclaims the blocks by itself and hence clears the lists.
+             */
+            FreeLists trivialFreeBlocks;
+            FreeLists nonTrivialFreeBlocks;
+            
+            /**
+             * Young garbage awaiting its sweep, indexed by triviality like the
+             * allocation buffers. Blocks are kept in groups of a single
+             * segment each, in address order, and the sizes of the groups are
+             * kept alongside. An allocation missing the free lists sweeps the
+             * last group of its kind, so sweeping is spread across allocations
+             * rather than adding to the cycle. Compaction sweeps whatever is
+             * left first.
+             */
+            std::mutex unsweptMutex;
+            Buffer<ManagedMemoryOverhead*> unsweptBlocks[2];
+            Buffer<uint32> unsweptGroups[2];
+            std::atomic<uint32> numUnsweptGroups[2];
+            std::atomic<uint64> unsweptBytes;
+            
+            /**
+             * Regions of the large object space. Their memory is never moved,
+             * is promoted in place, and is unmapped as soon as it is swept.
+             */
+            std::mutex largeObjectsMutex;
+            LargeObjectRegion* firstLargeObject;
+            std::atomic<uint32> largeObjectThreshold;
+            
             Buffer<Pointer> roots;
-            Buffer<ManagedMemoryPointerBase> markedObjects;
+            Buffer<ManagedMemoryOverhead*> markedObjects;
+            
+            /**
+             * Segments emptied and unlinked by the compactor, and temporary
+             * blocks used to move memory within overlapping regions. Threads
+             * may still be reading from either briefly after compaction, hence
+             * they are only freed by the subsequent compaction.
+             */
+            Buffer<ManagedMemorySegment*> retiredSegments;
+            Buffer<void*> stagingBuffers;
+            
+            /**
+             * Memory left behind by reallocations since the previous cycle,
+             * and before it. Threads may still be reading from the former,
+             * hence only the latter is swept along with the garbage, unless
+             * the compactor reclaims it first.
+             */
+            std::mutex dyingMutex;
+            Buffer<ManagedMemoryOverhead*> recentlyDying;
+            Buffer<ManagedMemoryOverhead*> dyingBlocks;
             std::chrono::milliseconds scanInterval;
             
+            /**
+             * Number of microseconds to wait for the registered mutators to
+             * reach a safepoint before compaction is skipped, and whether the
+             * background thread's cycles compact as well.
+             */
+            std::atomic<uint32> safepointTimeout;
+            std::atomic_bool backgroundCompaction;
+            
+            /**
+             * Number of bytes handed out since the last cycle started, and
+             * the number of bytes after which the next cycle is triggered
+             * early.
+             */
+            std::atomic<uint64> allocatedSinceCycle;
+            std::atomic<uint64> allocationThreshold;
+            
+            /**
+             * Number of bytes handed out before the last cycle started.
+             */
+            std::atomic<uint64> allocatedBeforeCycle;
+            
+            /**
+             * Number of cycles survived after which memory is promoted, the
+             * number of cycles between two major cycles, and the number of
+             * minor cycles since the last major one.
+             */
+            std::atomic<uint32> promotionAge;
+            std::atomic<uint32> majorCycleInterval;
+            uint32 cyclesSinceMajor;
+            
+            /**
+             * Whether the current cycle collects the entire heap or only the
+             * nursery.
+             */
+            bool majorCycle;
+            
+            /**
+             * Workers tracing the object graph in parallel during the scan
+             * phase. Every worker owns one deque of blocks it still needs to
+             * trace, and steals from the others once it runs dry. Blocks are
+             * either Objects or native memory with a pointer map. The workers
+             * also sweep the queued garbage before compaction, and destroy the
+             * non-trivial segments upon teardown.
+             */
+            Concurrency::WorkerPool markers;
+            std::unique_ptr<Concurrency::WorkStealingDeque<ManagedMemoryOverhead*>[]> markDeques;
+            std::atomic<uint32> numActiveMarkers;
+            
+            /**
+             * Number of blocks the workers traced during their last run.
+             */
+            std::atomic<uint32> numTracedBlocks;
+            
+            /**
+             * Mark bits of the current scan, one per table record. Records
+             * added to the table after the scan started are not covered.
+             */
+            MarkBitmap marks;
+            
+            /**
+             * Table records referring to memory of the old generation. Minor
+             * cycles start out with these marked so they neither trace nor
+             * collect the old generation.
+             */
+            MarkBitmap dormantRecords;
+            
+            /**
+             * Phase of the incremental cycle in progress, if any, and its gray
+             * objects, i.e. those reached but not yet traced. Only accessed
+             * while holding `collectMutex`.
+             */
+            uint32 incrementalPhase;
+            Concurrency::WorkStealingDeque<ManagedMemoryOverhead*> incrementalGray;
+            
+            /**
+             * Statistics of all cycles completed so far. Counters which can be
+             * read at any time are filled in by `getStats`.
+             */
+            std::mutex statsMutex;
+            GCStats stats;
+            
+            /**
+             * Durations of the phases of the cycle in progress, and bytes of
+             * garbage of the old generation swept but not yet reclaimed by
+             * compaction. Only accessed while holding `collectMutex`.
+             */
+            std::chrono::nanoseconds cycleScanTime;
+            std::chrono::nanoseconds cycleSweepTime;
+            std::chrono::nanoseconds cycleCompactTime;
+            uint64 unreclaimedBytes;
+            
+            /**
+             * Sink of trace events, created upon first enabling tracing and
+             * kept until the GC is destroyed. `tracer` refers to it while
+             * tracing is enabled and is null otherwise.
+             */
+            std::mutex tracingMutex;
+            std::unique_ptr<TraceBuffer> traceBuffer;
+            std::atomic<TraceBuffer*> tracer;
+            
+            /**
+             * Allocation profiler, created upon first enabling profiling and
+             * kept until the GC is destroyed. `profiler` refers to it while
+             * profiling is enabled and is null otherwise.
+             */
+            std::mutex profilingMutex;
+            std::unique_ptr<AllocationProfiler> allocationProfiler;
+            std::atomic<AllocationProfiler*> profiler;
+            
         public:    // RAII
             GC();
             GC(const GC&) = delete;
@@ -247,14 +629,16 @@ namespace Neuro {
             
         public:    // GCInterface
             virtual ManagedMemoryPointerBase allocateTrivial(uint32 size, uint32 count) override;
-            virtual ManagedMemoryPointerBase allocateNonTrivial(uint32 size, uint32 count, const Delegate<void, void*, const void*>& copyDeleg, const Delegate<void, void*>& destroyDeleg) override;
+            virtual ManagedMemoryPointerBase allocateNonTrivial(uint32 size, uint32 count, uint16 typeId) override;
             
             virtual Error reallocate(ManagedMemoryPointerBase ptr, uint32 size, uint32 count, bool autocopy = true) override;
+            virtual Error reallocate(ManagedMemoryPointerBase ptr, uint32 size, uint32 count, const ReallocateDelegate& construct) override;
             
             virtual Error root(Pointer obj) override;
             virtual Error unroot(Pointer obj) override;
             
             virtual void* resolve(ManagedMemoryPointerBase pointer) override;
+            virtual const ManagedMemoryTable* getTable() const override { return &dataTable; }
             
             
         public:    // Methods
@@ -264,33 +648,302 @@ namespace Neuro {
              * it's not. The latter might be useful if the data type may not be
              * trivial, but trivially copyable, e.g. creates only flat copies.
              * Neuro's Objects are one such example.
+             * 
+             * Non-trivial types may declare the managed pointers they hold
+             * through a pointer map (see TypeTable.hpp), which the GC then
+             * traces. Memory allocated as trivial is never traced.
              */
             template<typename T>
             ManagedMemoryPointer<T> allocate(bool trivial = std::is_trivial_v<T>) {
                 if (trivial) {
-                    return ManagedMemoryPointer<T>(allocateTrivial(sizeof(T)));
+                    return ManagedMemoryPointer<T>(allocateTrivial(sizeof(T), 1));
                 }
-                return ManagedMemoryPointer<T>(allocateNonTrivial(sizeof(T), Delegate<void, void*, const void*>::FunctionDelegate<copyNonTrivialType<T>>(), Delegate<void, void*>::FunctionDelegate<destroyNonTrivialType<T>>()));
+                return ManagedMemoryPointer<T>(allocateNonTrivial(sizeof(T), 1, TypeTable::getTypeId<T>()));
             }
             
             /**
              * Registers a new scanner to call during the scan phase. It is
-             * expected that the scanner removes found pointers from the delegate's
-             * passed in argument.
+             * expected that the scanner marks every pointer it finds alive in
+             * the passed in bitmap. Whatever remains unmarked after all
+             * scanners ran is garbage.
              * 
              * The scanner for our Object type is one such scanner.
              */
-            Error registerMemoryScanner(const Delegate<void, StandardHashSet<ManagedMemoryPointerBase>&>& scanner);
+            Error registerMemoryScanner(const ScannerDelegate& scanner);
+            
+            /**
+             * Sets the maximum time the background thread sleeps between two
+             * collection cycles. Takes effect right away, even while it sleeps.
+             */
+            void setScanInterval(std::chrono::milliseconds interval);
+            
+            /**
+             * Sets the number of bytes which may be allocated before the
+             * background thread is woken up early to run a collection cycle.
+             */
+            void setAllocationThreshold(uint64 bytes);
+            
+            /**
+             * Sets the number of cycles memory needs to survive in the nursery
+             * before it is promoted into the old generation. Clamped to 1-3.
+             */
+            void setPromotionAge(uint32 cycles);
+            
+            /**
+             * Sets the number of cycles after which a major cycle collects the
+             * entire heap. An interval of 1 collects the entire heap every
+             * cycle.
+             */
+            void setMajorCycleInterval(uint32 cycles);
+            
+            /**
+             * Sets the number of bytes above which memory is allocated in a
+             * large object region of its own. Takes effect for subsequent
+             * allocations only.
+             */
+            void setLargeObjectThreshold(uint32 bytes);
+            
+            /**
+             * Sets whether subsequently created segments should be backed by
+             * transparent huge pages where the platform supports them. Huge
+             * pages spare the TLB but may waste memory in sparse segments.
+             */
+            void setHugePages(bool enable);
+            
+            /**
+             * Sets how long compaction waits for the registered mutators to
+             * reach a safepoint. If they do not in time, the cycle skips
+             * compaction rather than blocking the mutators which already did.
+             */
+            void setSafepointTimeout(std::chrono::microseconds timeout);
+            
+            /**
+             * Sets whether the background thread's cycles compact as well,
+             * stopping the registered mutators at a safepoint to do so. On by
+             * default, as only the compactor ages and promotes memory. To be
+             * turned off unless every thread accessing managed memory is
+             * registered with Safepoints and polls regularly.
+             */
+            void setBackgroundCompaction(bool enable);
+            
+            /**
+             * Wakes the background thread up to run a collection cycle as
+             * soon as possible. Does not wait for the cycle to finish. If
+             * `major` is set, the cycle collects the entire heap rather than
+             * just the nursery.
+             */
+            void requestCycle(bool major = false);
+            
+            /**
+             * Runs a collection cycle on the calling thread, including the
+             * compact phase. As compaction moves memory, registered mutators
+             * are stopped at a safepoint meanwhile, and the caller must ensure
+             * no unregistered thread accesses managed memory until this
+             * returns. Unless background compaction is turned off, the
+             * background thread's cycles move memory likewise. If `major` is
+             * set, the cycle collects the entire heap rather than just the
+             * nursery.
+             */
+            void collect(bool major = false);
+            
+            /**
+             * Advances an incremental collection cycle on the calling thread by
+             * roughly `budget` at most, starting a new cycle if none is in
+             * progress. Never moves memory. Returns an estimate of the work
+             * remaining, i.e. the number of objects left to trace or blocks
+             * left to sweep, or 0 once the cycle has completed.
+             * 
+             * The background thread leaves incremental cycles to the host,
+             * while `collect` completes them before compacting.
+             */
+            uint64 step(std::chrono::microseconds budget);
+            
+            /**
+             * Takes a snapshot of the statistics on the cycles so far. Meant to
+             * tune the scan interval and allocation threshold in production.
+             */
+            GCStats getStats();
+            
+            /**
+             * Clears the latency histograms, e.g. to start a new measurement.
+             * All other statistics are retained.
+             */
+            void resetStats();
+            
+            /**
+             * Starts recording timestamped events of the GC's phases, segment
+             * creation, table growth and reallocations into a ring buffer of
+             * `capacity` events. The capacity is only considered the first
+             * time tracing is enabled.
+             */
+            void enableTracing(uint32 capacity = NEURO_GC_TRACE_CAPACITY);
+            
+            /**
+             * Stops recording events. Events recorded so far are retained.
+             */
+            void disableTracing();
+            
+            /**
+             * Writes the events recorded so far as a Chrome trace JSON
+             * document, which chrome://tracing and Perfetto can display.
+             * Returns false if tracing was never enabled or writing failed.
+             */
+            bool writeTrace(std::ostream& out);
+            
+            /**
+             * Discards the events recorded so far.
+             */
+            void clearTrace();
+            
+            /**
+             * Starts sampling allocations roughly every `interval` bytes,
+             * capturing their backtraces and allocation sites. The interval
+             * is only considered the first time profiling is enabled.
+             */
+            void enableProfiling(uint64 interval = NEURO_GC_PROFILE_INTERVAL);
+            
+            /**
+             * Stops sampling allocations. Samples taken so far are retained.
+             */
+            void disableProfiling();
+            
+            /**
+             * Writes the samples taken so far as a pprof profile. Returns
+             * false if profiling was never enabled or writing failed.
+             */
+            bool writeProfile(std::ostream& out);
+            
+            /**
+             * Discards the samples taken so far.
+             */
+            void clearProfile();
+            
+            /**
+             * Takes a snapshot of the heap's layout and of the graph of all
+             * objects reachable from the roots or known to the GC as objects.
+             * Waits for a cycle in progress to finish. Like `collect`, the
+             * caller must ensure no other thread allocates or accesses managed
+             * memory until this returns.
+             */
+            void takeSnapshot(HeapSnapshot& snapshot);
+            
+            /**
+             * Writes a snapshot of the heap in the binary format read by the
+             * NeuroHeap analyzer. Same restrictions as `takeSnapshot` apply.
+             */
+            Error dumpHeap(std::ostream& out);
+            Error dumpHeap(const char* path);
+            
+            /**
+             * Sets the number of threads tracing the object graph during the
+             * scan phase, including the GC's own background thread. Blocks
+             * until an ongoing scan has finished.
+             */
+            void setWorkerThreads(uint32 count);
+            
+            /**
+             * Gets the number of threads tracing the object graph during the
+             * scan phase.
+             */
+            uint32 getWorkerThreads() const { return markers.count(); }
             
             
         protected: // Life Cycle
             virtual void threadMain();
+            virtual void cycle(bool compacting, bool major);
             virtual uint32 scan();
-            virtual void scanForObjects(StandardHashSet<ManagedMemoryPointerBase>& pointers);
+            
+            /**
+             * Starts a new cycle, deciding whether it collects the entire heap.
+             */
+            void beginCycle(bool major);
+            
+            /**
+             * Records the statistics of the cycle which just completed.
+             */
+            void finishCycle(bool compacted);
+            
+            /**
+             * Resets the mark bits for a new scan. Minor cycles start out with
+             * the old generation marked.
+             */
+            void resetMarks();
+            
+            /**
+             * Flags all unmarked memory as garbage and hands it to the sweep
+             * phase, sparing newborns once. Returns the amount of garbage.
+             */
+            uint32 collectGarbage();
+            
+            /**
+             * Rescans the roots and the objects on dirty cards with the
+             * mutators stopped, until no more memory is reached. Returns false
+             * if the mutators could not be stopped in time.
+             */
+            bool finishMark();
+            
+            /**
+             * Traces the roots and the objects on dirty cards once more with
+             * the mark workers. Returns true if the rescan reached no memory
+             * beyond them, i.e. marking has concluded.
+             */
+            bool rescan();
+            
+            /**
+             * Cleans the cards of young memory, so that the rescans only visit
+             * objects stored into since marking started. Adds the newborns on
+             * the cleaned cards to `newborns` as they need to be traced even if
+             * unreached.
+             */
+            void cleanNurseryCards(Buffer<ManagedMemoryOverhead*>& newborns);
+            virtual void scanForObjects(MarkBitmap& marks);
+            virtual void mark();
             virtual void sweep();
-            virtual void sweep(bool trivial);
+            
+            /**
+             * Sweeps the given garbage of the old generation and the large
+             * object space right away, and queues young garbage to be swept
+             * lazily by allocations.
+             */
+            void sweepGarbage(Buffer<ManagedMemoryOverhead*>& heads);
+            
+            /**
+             * Destroys the given garbage, all of which must be either trivial
+             * or non-trivial, and recycles or releases its memory.
+             */
+            void sweepBlocks(Buffer<ManagedMemoryOverhead*>& heads, bool trivial);
+            
+            /**
+             * Queues the given young garbage of the given chain of segments in
+             * groups of up to `NEURO_GC_LAZY_SWEEP_BLOCKS` blocks of a single
+             * segment.
+             */
+            void queueUnswept(Buffer<ManagedMemoryOverhead*>& heads, ManagedMemorySegment* chain, bool trivial);
+            
+            /**
+             * Sweeps the next queued group of young garbage of the given kind.
+             * Returns false if there was none.
+             */
+            bool sweepNextGroup(bool trivial);
+            
+            /**
+             * Sweeps all queued young garbage on the workers, e.g. before
+             * compacting.
+             */
+            void finishSweep();
+            void sweepWorker(uint32 workerIndex);
             virtual void compact();
-            virtual void compact(bool trivial);
+            virtual void compact(ManagedMemorySegment* chain, bool trivial);
+            
+            /**
+             * Slides all movable memory in the segment down towards its start,
+             * promoting memory of a nursery segment which has grown old enough
+             * into the old generation instead.
+             * Returns true if the segment ended up empty, in which case it is
+             * left flagged as compacting if `mayRetire` is set, so no further
+             * memory is allocated in it.
+             */
+            virtual bool compactSegment(ManagedMemorySegment* segment, bool trivial, bool mayRetire);
             
             
         public:    // Statics
@@ -325,6 +978,209 @@ namespace Neuro {
             static ManagedMemoryOverhead* getOverhead(ManagedMemoryPointerBase ptr) {
                 return ptr.getHeadPointer();
             }
+            
+        protected: // Incremental Cycles
+            /**
+             * Advances the incremental cycle in progress until it completes or
+             * the deadline passes. Returns the estimated work remaining.
+             */
+            uint64 advanceIncremental(std::chrono::steady_clock::time_point deadline);
+            
+            /**
+             * Marks the roots and pushes the objects to start tracing from.
+             */
+            void beginIncrementalMark();
+            
+            /**
+             * Traces gray objects until none are left or the deadline passes,
+             * then concludes marking with uninterrupted rescans. Returns true
+             * once marking has completed.
+             */
+            bool stepMark(std::chrono::steady_clock::time_point deadline);
+            
+            /**
+             * Pushes the objects to rescan onto the incremental gray deque.
+             * Returns the number of objects pushed.
+             */
+            uint32 remark();
+            
+            /**
+             * Collects new roots and the objects on dirty cards, which the
+             * mutators may have stored unmarked memory into since marking
+             * started.
+             */
+            void collectRescanObjects(Buffer<ManagedMemoryOverhead*>& objects);
+            
+            /**
+             * Sweeps garbage in batches until none is left or the deadline
+             * passes, queuing young garbage for the allocations instead.
+             * Returns true once sweeping has completed.
+             */
+            bool stepSweep(std::chrono::steady_clock::time_point deadline);
+            
+        protected: // Helpers
+            /**
+             * Records the duration for which the host was blocked by the GC.
+             */
+            void recordPause(std::chrono::nanoseconds duration);
+            
+            /**
+             * Records the time taken to stop the mutators at a safepoint, and
+             * whether they stopped in time for compaction or the final remark.
+             */
+            void recordSafepoint(std::chrono::nanoseconds duration, bool stopped, bool compacting);
+            
+            /**
+             * Acquires `collectMutex`. Registered mutators wait for it in a
+             * safe region, so the cycle holding it may stop the world.
+             */
+            std::unique_lock<std::mutex> lockCollection();
+            
+            /**
+             * Gets the trace buffer to record events into, or null if tracing
+             * is disabled.
+             */
+            TraceBuffer* getTracer() const {
+                return tracer.load(std::memory_order_acquire);
+            }
+            
+            /**
+             * Gets the profiler to account allocations to, or null if
+             * profiling is disabled.
+             */
+            AllocationProfiler* getProfiler() const {
+                return profiler.load(std::memory_order_acquire);
+            }
+            
+            /**
+             * Records the growth of the table and the creation of segments
+             * while tracing.
+             */
+            void traceTableGrowth(uint32 numPages);
+            void traceSegmentAllocation(size_t bytes);
+            
+            /**
+             * Accounts for `bytes` freshly allocated bytes and wakes the
+             * background thread if the allocation threshold was crossed.
+             */
+            void trackAllocation(uint32 bytes);
+            
+            /**
+             * Allocates memory in the nursery, usually by bumping the calling
+             * thread's allocation buffer. Buffers are accounted for as a
+             * whole when they are reserved.
+             */
+            ManagedMemoryOverhead* allocateNursery(bool trivial, uint32 elementSize, uint32 count);
+            
+            /**
+             * Maps a large object region for the memory and links it into the
+             * large object space.
+             */
+            ManagedMemoryOverhead* allocateLarge(uint32 elementSize, uint32 count);
+            
+            /**
+             * Allocates the new memory of a reallocation next to the old one,
+             * i.e. in the same generation. The new memory is neither flagged
+             * an Object nor typed yet, hence not traced before it is published.
+             */
+            ManagedMemoryOverhead* allocateReplacement(ManagedMemoryOverhead* oldHead, uint32 elementSize, uint32 count);
+            
+            /**
+             * Flags and types the constructed replacement like the old memory
+             * and publishes it in place of the latter, which dies.
+             */
+            Error publishReplacement(ManagedMemoryPointerBase ptr, ManagedMemoryOverhead* oldHead, ManagedMemoryOverhead* newHead);
+            
+            /**
+             * Unlinks the regions of the given swept large memory and returns
+             * them to the operating system.
+             */
+            void releaseLarge(const Buffer<ManagedMemoryOverhead*>& heads);
+            
+            /**
+             * Counterpart of the compactor for the large object space. Ages
+             * and promotes reached memory in place, and releases reallocated
+             * memory.
+             */
+            void compactLargeObjects();
+            
+            /**
+             * Hands the swept blocks of the sweep phase to the free lists,
+             * merging adjacent blocks first.
+             */
+            void recycleSwept(Buffer<ManagedMemoryOverhead*>& blocks, bool trivial);
+            
+            /**
+             * Moves the memory block to `target` and updates its table record.
+             * Returns false if the block is not referred to by the table and
+             * hence was not moved.
+             */
+            bool relocate(ManagedMemoryOverhead* head, ManagedMemoryOverhead* target, bool trivial);
+            
+            /**
+             * Moves the memory block into the old generation and updates its
+             * table record. Returns false if the block was not moved.
+             */
+            bool promote(ManagedMemoryOverhead* head, bool trivial);
+            
+            /**
+             * Cleans the cards of the old generation which no longer hold
+             * pointers to young memory.
+             */
+            void refineCards();
+            void refineCards(ManagedMemorySegment* segment);
+            void refineCards(LargeObjectRegion* region);
+            
+            /**
+             * Collects the live objects and native blocks with pointers of the
+             * large object space which overlap dirty cards, by default only
+             * those of the old generation.
+             */
+            void collectDirtyLargeObjects(Buffer<ManagedMemoryOverhead*>& blocks, bool includeYoung = false);
+            
+            /**
+             * Frees segments and staging blocks retired by the previous
+             * compaction.
+             */
+            void releaseRetired();
+            
+            /**
+             * Body of a single mark worker. Traces objects off its own deque,
+             * steals from the other workers' deques, and returns once all
+             * workers ran out of work.
+             */
+            void markWorker(uint32 workerIndex);
+            
+            /**
+             * Runs the mark workers, starting from the given blocks. Returns
+             * the number of blocks traced.
+             */
+            uint32 traceInParallel(const Buffer<ManagedMemoryOverhead*>& blocks);
+            
+            /**
+             * Traces the given block, either as an Object or through the
+             * pointer map of its native type.
+             */
+            void markBlock(Concurrency::WorkStealingDeque<ManagedMemoryOverhead*>& deque, ManagedMemoryOverhead* head);
+            
+            /**
+             * Pushes all objects referenced by `obj` which have not yet been
+             * reached onto the given deque.
+             */
+            void markObject(Concurrency::WorkStealingDeque<ManagedMemoryOverhead*>& deque, Object* obj);
+            
+            /**
+             * Marks the memory referenced by the pointer fields of every
+             * element of the given native block, and pushes the Objects and
+             * native blocks among them which have not yet been reached.
+             */
+            void markNative(Concurrency::WorkStealingDeque<ManagedMemoryOverhead*>& deque, ManagedMemoryOverhead* head, const TypeDescriptor& type);
+            
+            /**
+             * Attempts to steal a block off another worker's deque.
+             */
+            bool stealMarkWork(uint32 workerIndex, ManagedMemoryOverhead*& head);
+            
         };
     }
 }
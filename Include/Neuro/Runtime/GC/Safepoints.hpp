@@ -0,0 +1,149 @@
+////////////////////////////////////////////////////////////////////////////////
+// Safepoints at which mutator threads may be paused, so the GC can move memory
+// while no mutator holds native pointers into it.
+//
+// Threads accessing managed memory register themselves as mutators and poll
+// for safepoints regularly, e.g. once per iteration of an interpreter loop or
+// per backward branch. A poll is a single atomic load unless the GC requests a
+// stop, in which case the thread parks until the GC resumes the world. Native
+// pointers into managed memory must hence not be held across a poll.
+//
+// Threads about to block or to run lengthy native code which does not touch
+// managed memory enter a safe region instead. The GC does not wait for threads
+// in safe regions, but they cannot leave them while the world is stopped.
+//
+// Stopping the world waits for every registered thread, except the stopping
+// thread itself, to either park or be in a safe region, but only up to a given
+// timeout. Unregistered threads are not accounted for at all.
+// -----
+// Copyright (c) Kiruse 2018
+// License: GPL 3.0
+#pragma once
+
+#include <atomic>
+#include <chrono>
+
+#include "DLLDecl.h"
+#include "Numeric.hpp"
+
+namespace Neuro {
+    namespace Runtime
+    {
+        namespace EMutatorState {
+            enum {
+                Detached,
+                Running,
+                Parked,
+                Safe,
+            };
+        }
+        
+        class NEURO_API Safepoints
+        {
+        private:   // Statics
+            /**
+             * Set while a thread stops or has stopped the world.
+             */
+            static std::atomic<bool> stopRequested;
+            
+        public:    // RAII
+            Safepoints() = delete;
+            
+        public:    // Mutators
+            /**
+             * Registers the calling thread as a mutator. Registrations nest;
+             * the thread is unregistered once every registration has been
+             * undone, or when it exits.
+             */
+            static void registerThread();
+            static void unregisterThread();
+            
+            static bool isRegistered();
+            
+            /**
+             * Gets the number of threads currently registered.
+             */
+            static uint32 countThreads();
+            
+            /**
+             * Parks the calling thread if the world is being stopped, until it
+             * is resumed again. Does nothing for unregistered threads.
+             */
+            static void poll() {
+                if (stopRequested.load(std::memory_order_acquire)) park();
+            }
+            
+            /**
+             * Declares that the calling thread does not access managed memory
+             * until it leaves the safe region again. Leaving blocks while the
+             * world is stopped.
+             */
+            static void enterSafeRegion();
+            static void leaveSafeRegion();
+            
+        public:    // Handshake
+            /**
+             * Brings every registered thread other than the calling one to a
+             * safepoint or into a safe region. Gives up after `timeout`,
+             * releasing any threads parked so far, and returns false.
+             *
+             * Only one thread stops the world at a time. Another thread
+             * stopping the world meanwhile counts as parked.
+             */
+            static bool stop(std::chrono::microseconds timeout);
+            
+            /**
+             * Releases the threads of a successful stop.
+             */
+            static void resume();
+            
+            static bool isStopRequested() { return stopRequested.load(std::memory_order_relaxed); }
+            
+        protected: // Helpers
+            static void park();
+        };
+        
+        /**
+         * Registers the calling thread as a mutator during its lifetime.
+         */
+        class NEURO_API MutatorRegistration
+        {
+        public:    // RAII
+            MutatorRegistration() { Safepoints::registerThread(); }
+            MutatorRegistration(const MutatorRegistration&) = delete;
+            MutatorRegistration& operator=(const MutatorRegistration&) = delete;
+            ~MutatorRegistration() { Safepoints::unregisterThread(); }
+        };
+        
+        /**
+         * Keeps the calling thread in a safe region during its lifetime.
+         */
+        class NEURO_API SafeRegion
+        {
+        public:    // RAII
+            SafeRegion() { Safepoints::enterSafeRegion(); }
+            SafeRegion(const SafeRegion&) = delete;
+            SafeRegion& operator=(const SafeRegion&) = delete;
+            ~SafeRegion() { Safepoints::leaveSafeRegion(); }
+        };
+        
+        /**
+         * Stops the world during its lifetime, if possible within the given
+         * timeout.
+         */
+        class NEURO_API WorldStop
+        {
+        private:   // Properties
+            bool stopped;
+            
+        public:    // RAII
+            WorldStop(std::chrono::microseconds timeout) : stopped(Safepoints::stop(timeout)) {}
+            WorldStop(const WorldStop&) = delete;
+            WorldStop& operator=(const WorldStop&) = delete;
+            ~WorldStop() { if (stopped) Safepoints::resume(); }
+            
+        public:    // Operators
+            explicit operator bool() const { return stopped; }
+        };
+    }
+}
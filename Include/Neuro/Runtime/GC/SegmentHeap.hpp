@@ -0,0 +1,130 @@
+////////////////////////////////////////////////////////////////////////////////
+// Virtual memory backing the GC's segments.
+//
+// The heap reserves a large range of address space once and carves segments
+// out of it at the granularity of the card tables' regions. Pages are only
+// committed once a segment is handed out, and decommitted again as soon as the
+// segment is returned, so that memory is given back to the operating system
+// after load spikes rather than lingering in the allocator. Optionally, the
+// pages of new segments are backed by transparent huge pages.
+//
+// Should the reservation be exhausted or unavailable altogether, segments are
+// mapped individually instead.
+// -----
+// Copyright (c) Kiruse 2018
+// License: GPL 3.0
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+
+#include "CardTable.hpp"
+#include "DLLDecl.h"
+#include "Delegate.hpp"
+#include "Numeric.hpp"
+
+namespace Neuro {
+    namespace Runtime
+    {
+        class NEURO_API SegmentHeap
+        {
+        public:    // Constants
+            /**
+             * Segments occupy entire regions of the card tables' region map,
+             * which are also a multiple of the size of huge pages.
+             */
+            static constexpr size_t GranuleSize = CardTable::RegionSize;
+            
+        private:   // Properties
+            /**
+             * Guards the reservation and the bitmap of used granules.
+             */
+            std::mutex mutex;
+            
+            /**
+             * The reservation, which is made upon the first allocation.
+             */
+            uint8* base;
+            size_t reservedBytes;
+            bool reserveFailed;
+            
+            /**
+             * One bit per granule of the reservation, set while it belongs to
+             * a segment.
+             */
+            std::unique_ptr<uint64[]> used;
+            
+            std::atomic<size_t> committedBytes;
+            std::atomic_bool hugePages;
+            
+        public:    // Delegates
+            /**
+             * Invoked with the number of bytes of every successful allocation.
+             */
+            MulticastDelegate<void, size_t> onAllocate;
+            
+        public:    // RAII
+            SegmentHeap(size_t reservedBytes);
+            SegmentHeap(const SegmentHeap&) = delete;
+            SegmentHeap(SegmentHeap&&) = delete;
+            SegmentHeap& operator=(const SegmentHeap&) = delete;
+            SegmentHeap& operator=(SegmentHeap&&) = delete;
+            ~SegmentHeap();
+            
+        public:    // Methods
+            /**
+             * Commits zeroed, granule-aligned memory of at least `bytes` bytes,
+             * rounded up to whole granules. Returns nullptr if neither the
+             * reservation nor the operating system can provide it.
+             */
+            void* allocate(size_t bytes);
+            
+            /**
+             * Returns memory obtained from `allocate` with the same number of
+             * bytes. Its pages are decommitted immediately.
+             */
+            void free(void* addr, size_t bytes);
+            
+            /**
+             * Returns the memory of all pages entirely within the given range
+             * of an allocation to the operating system, without decommitting
+             * them. Their contents are undefined afterwards.
+             */
+            void discard(void* addr, size_t bytes);
+            
+            /**
+             * Tests whether the address lies within the reservation.
+             */
+            bool contains(const void* addr) const {
+                return base && addr >= base && addr < base + reservedBytes;
+            }
+            
+            /**
+             * Sets whether the pages of subsequently allocated memory should be
+             * backed by huge pages where the platform supports it.
+             */
+            void setHugePages(bool enable) { hugePages = enable; }
+            
+            /**
+             * Gets the number of bytes currently allocated, including memory
+             * mapped outside of the reservation.
+             */
+            size_t countCommittedBytes() const { return committedBytes.load(std::memory_order_relaxed); }
+            
+        private:   // Helpers
+            /**
+             * Finds `count` consecutive unused granules and returns the index
+             * of the first, or npos if there are none.
+             */
+            uint32 findUnused(uint32 count) const;
+            
+            void setUsed(uint32 first, uint32 count, bool value);
+            
+            uint32 countGranules() const {
+                return static_cast<uint32>(reservedBytes / GranuleSize);
+            }
+        };
+    }
+}
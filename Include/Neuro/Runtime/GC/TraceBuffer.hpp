@@ -0,0 +1,144 @@
+////////////////////////////////////////////////////////////////////////////////
+// Ring buffer of timestamped events on what the GC is doing, dumped in the
+// Chrome trace event format understood by chrome://tracing and Perfetto.
+//
+// Recording is lock-free: a writer claims the next slot with a single atomic
+// increment and publishes its event through the slot's sequence number, which
+// readers validate before and after copying the event, akin to a seqlock. Once
+// the ring is full, the oldest events are overwritten. Timestamps are taken
+// from the steady clock so that they line up with the host's own timeline.
+// -----
+// Copyright (c) Kiruse 2018
+// License: GPL 3.0
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <ostream>
+
+#include "DLLDecl.h"
+#include "NeuroBuffer.hpp"
+#include "Numeric.hpp"
+
+namespace Neuro {
+    namespace Runtime
+    {
+        class NEURO_API TraceBuffer
+        {
+        public:    // Types
+            struct Event {
+                /**
+                 * Names of the event and of its argument, if any. Must be
+                 * string literals or otherwise outlive the buffer.
+                 */
+                const char* name;
+                const char* argName;
+                uint64 arg;
+                
+                /**
+                 * Nanoseconds since the epoch of the steady clock.
+                 */
+                uint64 timestamp;
+                
+                /**
+                 * Small number identifying the recording thread, assigned in
+                 * order of the threads' first event.
+                 */
+                uint32 threadId;
+                
+                /**
+                 * 'B' begins a span, 'E' ends the innermost span of the same
+                 * thread, 'i' marks an instant.
+                 */
+                char phase;
+            };
+            
+        private:   // Types
+            /**
+             * The event's fields are atomics so that readers may copy them
+             * while a writer overwrites the slot. The copy is discarded if the
+             * sequence number changed meanwhile.
+             */
+            struct Slot {
+                /**
+                 * Index of the event plus one once it is complete, 0 while
+                 * it is being written.
+                 */
+                std::atomic<uint64> sequence;
+                std::atomic<const char*> name;
+                std::atomic<const char*> argName;
+                std::atomic<uint64> arg;
+                std::atomic<uint64> timestamp;
+                std::atomic<uint32> threadId;
+                std::atomic<char> phase;
+            };
+            
+        private:   // Properties
+            std::unique_ptr<Slot[]> slots;
+            const uint32 mask;
+            
+            /**
+             * Index of the next event to be recorded, and of the first event
+             * not yet cleared.
+             */
+            std::atomic<uint64> head;
+            std::atomic<uint64> tail;
+            
+        public:    // RAII
+            /**
+             * Creates a buffer holding the given number of events, rounded up
+             * to the next power of two.
+             */
+            TraceBuffer(uint32 capacity);
+            TraceBuffer(const TraceBuffer&) = delete;
+            TraceBuffer(TraceBuffer&&) = delete;
+            TraceBuffer& operator=(const TraceBuffer&) = delete;
+            TraceBuffer& operator=(TraceBuffer&&) = delete;
+            
+        public:    // Methods
+            void record(char phase, const char* name, const char* argName = nullptr, uint64 arg = 0);
+            
+            void begin(const char* name, const char* argName = nullptr, uint64 arg = 0) {
+                record('B', name, argName, arg);
+            }
+            void end(const char* name) {
+                record('E', name);
+            }
+            void instant(const char* name, const char* argName = nullptr, uint64 arg = 0) {
+                record('i', name, argName, arg);
+            }
+            
+            /**
+             * Appends copies of the events still held, oldest first. Events
+             * being written concurrently are skipped.
+             */
+            void collect(Buffer<Event>& events) const;
+            
+            /**
+             * Writes the events still held as a Chrome trace JSON document.
+             * Ends of spans whose beginning was already overwritten are
+             * omitted.
+             */
+            void writeChromeTrace(std::ostream& out) const;
+            
+            /**
+             * Discards all events recorded so far.
+             */
+            void clear();
+            
+            uint32 capacity() const { return mask + 1; }
+            
+            /**
+             * Gets the number of events recorded since the buffer was
+             * created, including those already overwritten.
+             */
+            uint64 countRecorded() const { return head.load(std::memory_order_relaxed); }
+            
+        public:    // Static Methods
+            static uint64 now() {
+                return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+            }
+        };
+    }
+}
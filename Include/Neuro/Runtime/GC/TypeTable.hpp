@@ -0,0 +1,266 @@
+////////////////////////////////////////////////////////////////////////////////
+// Process-wide table of descriptors of non-trivial managed types.
+//
+// Non-trivial memory needs to be copied and destroyed element by element. Rather
+// than storing the delegates doing so in the header of every block, each type
+// is registered once and its blocks merely refer to it by a 16 bit type id.
+// Id 0 denotes trivial memory without a descriptor.
+//
+// Descriptors further hold the pointer maps of native types, i.e. the offsets
+// of their ManagedMemoryPointer fields, which the GC traces just like the
+// properties of Objects. Native types declare these fields through a static
+// `describePointers` method:
+//
+//     struct Node {
+//         ManagedMemoryPointer<Node> next;
+//         Pointer value;
+//
+//         static void describePointers(PointerMap<Node>& map) {
+//             map.add(&Node::next).add(&Node::value);
+//         }
+//     };
+//
+// Like Objects' properties, mutators must invoke `writeBarrier` on the field
+// after storing a pointer into memory the GC may already have traced.
+//
+// Descriptors are never removed nor moved, hence looking them up is lock-free:
+// they are stored in pages of a fixed number of descriptors each, which are
+// allocated as the table grows and published through atomic pointers.
+// -----
+// Copyright (c) Kiruse 2018
+// License: GPL 3.0
+#pragma once
+
+#include <atomic>
+#include <type_traits>
+#include <utility>
+
+#include "DLLDecl.h"
+#include "Delegate.hpp"
+#include "Maybe.hpp"
+#include "NeuroBuffer.hpp"
+#include "Numeric.hpp"
+
+namespace Neuro {
+    namespace Runtime
+    {
+        // Pointer maps merely name managed pointers. Their header includes
+        // this one by way of the memory overhead, hence is included last.
+        class Object;
+        template<typename T> class NEURO_API ManagedMemoryPointer;
+        
+        ////////////////////////////////////////////////////////////////////
+        // Helper Functions
+        ////////////////////////////////////////////////////////////////////
+        
+        template<typename T>
+        void copyNonTrivialType(void* target, const void* source) {
+            new (reinterpret_cast<T*>(target)) T(*reinterpret_cast<const T*>(source));
+        }
+        
+        template<typename T>
+        void destroyNonTrivialType(void* target) {
+            reinterpret_cast<T*>(target)->~T();
+        }
+        
+        template<typename T>
+        void destroyNonTrivialTypes(void* const* targets, uint32 count) {
+            for (uint32 i = 0; i < count; ++i) {
+                reinterpret_cast<T*>(targets[i])->~T();
+            }
+        }
+        
+        
+        /**
+         * Offsets of the managed pointer fields within an element of a native
+         * type, split by whether they refer to Objects or to other managed
+         * memory.
+         */
+        struct NEURO_API PointerOffsets
+        {
+            Buffer<uint32> objects;
+            Buffer<uint32> memory;
+            
+            bool empty() const { return !objects.length() && !memory.length(); }
+            bool operator==(const PointerOffsets& other) const;
+        };
+        
+        /**
+         * Collects the pointer map of the native type T.
+         */
+        template<typename T>
+        class PointerMap
+        {
+        private:   // Properties
+            PointerOffsets& offsets;
+            
+        public:    // RAII
+            PointerMap(PointerOffsets& offsets) : offsets(offsets) {}
+            
+        public:    // Methods
+            /**
+             * Declares a field referring to an Object.
+             */
+            PointerMap& add(ManagedMemoryPointer<Object> T::*field) {
+                offsets.objects.add(getOffset(field));
+                return *this;
+            }
+            
+            /**
+             * Declares a field referring to other managed memory, which is
+             * traced in turn if its type has a pointer map itself.
+             */
+            template<typename U>
+            PointerMap& add(ManagedMemoryPointer<U> T::*field) {
+                offsets.memory.add(getOffset(field));
+                return *this;
+            }
+            
+            /**
+             * Declares every pointer of an array field.
+             */
+            template<typename U, size_t N>
+            PointerMap& add(ManagedMemoryPointer<U> (T::*field)[N]) {
+                const uint32 offset = getOffset(field);
+                for (uint32 i = 0; i < N; ++i) {
+                    (std::is_same_v<U, Object> ? offsets.objects : offsets.memory).add(offset + i * sizeof(ManagedMemoryPointer<U>));
+                }
+                return *this;
+            }
+            
+        protected: // Helpers
+            template<typename M>
+            static uint32 getOffset(M T::*field) {
+                alignas(T) uint8 storage[sizeof(T)];
+                const T* element = reinterpret_cast<const T*>(storage);
+                return static_cast<uint32>(reinterpret_cast<const uint8*>(&(element->*field)) - storage);
+            }
+        };
+        
+        /**
+         * Whether the native type T declares a pointer map.
+         */
+        template<typename T, typename = void>
+        struct HasPointerMap : std::false_type {};
+        
+        template<typename T>
+        struct HasPointerMap<T, std::void_t<decltype(T::describePointers(std::declval<PointerMap<T>&>()))>> : std::true_type {};
+        
+        
+        struct NEURO_API TypeDescriptor
+        {
+            Maybe<Delegate<void, void*, const void*>> copyDelegate;
+            Maybe<Delegate<void, void*>> destroyDelegate;
+            
+            /**
+             * Optionally destructs several elements in a single call, sparing
+             * the GC an indirect call per element when sweeping.
+             */
+            Maybe<Delegate<void, void* const*, uint32>> destroyBatchDelegate;
+            
+            /**
+             * Offsets of the fields referring to Objects, followed by those
+             * referring to other managed memory. Flattened into a single
+             * array so the marker's loops over them stay tight.
+             */
+            uint32* pointerOffsets = nullptr;
+            uint32 numObjectPointers = 0;
+            uint32 numMemoryPointers = 0;
+            
+            bool hasPointers() const { return numObjectPointers || numMemoryPointers; }
+            
+            const uint32* getObjectOffsets() const { return pointerOffsets; }
+            const uint32* getMemoryOffsets() const { return pointerOffsets + numObjectPointers; }
+            
+            /**
+             * Copy constructs an element at `target` from the one at `source`.
+             */
+            void copy(void* target, const void* source) const {
+                copyDelegate.get()(target, source);
+            }
+            
+            /**
+             * Destructs the element at `target`.
+             */
+            void destroy(void* target) const {
+                destroyDelegate.get()(target);
+            }
+            
+            /**
+             * Destructs the elements at each of the `count` targets.
+             */
+            void destroyBatch(void* const* targets, uint32 count) const {
+                if (destroyBatchDelegate) {
+                    destroyBatchDelegate.get()(targets, count);
+                    return;
+                }
+                for (uint32 i = 0; i < count; ++i) destroy(targets[i]);
+            }
+        };
+        
+        class NEURO_API TypeTable
+        {
+        public:    // Constants
+            static constexpr uint32 PageSize = 256;
+            static constexpr uint32 NumPages = 256;
+            
+            /**
+             * Type ids are 16 bits wide, and id 0 is reserved.
+             */
+            static constexpr uint32 MaxTypes = PageSize * NumPages - 1;
+            
+        private:   // Statics
+            static std::atomic<TypeDescriptor*> pages[NumPages];
+            
+        public:    // RAII
+            TypeTable() = delete;
+            
+        public:    // Static Methods
+            /**
+             * Registers a non-trivial type copied and destroyed through the
+             * given delegates and holding managed pointers at the given
+             * offsets, or finds the type registered likewise before. Returns
+             * its id, or 0 if the table is full. The optional batch delegate
+             * destroys several elements at once and must be equivalent to
+             * calling `destroy` on each.
+             */
+            static uint16 registerType(const Delegate<void, void*, const void*>& copy, const Delegate<void, void*>& destroy, const PointerOffsets& pointers = PointerOffsets(), const Delegate<void, void* const*, uint32>* destroyBatch = nullptr);
+            
+            /**
+             * Gets the id of the native type T, registering it upon first use
+             * along with its pointer map, if it declares one.
+             */
+            template<typename T>
+            static uint16 getTypeId() {
+                static const uint16 id = registerNativeType<T>();
+                return id;
+            }
+            
+            /**
+             * Gets the descriptor of a registered type. The id must not be 0.
+             */
+            static const TypeDescriptor& get(uint16 id) {
+                return pages[id / PageSize].load(std::memory_order_acquire)[id % PageSize];
+            }
+            
+            /**
+             * Gets the number of types registered so far.
+             */
+            static uint32 countTypes();
+            
+        protected: // Static Helpers
+            template<typename T>
+            static uint16 registerNativeType() {
+                PointerOffsets pointers;
+                if constexpr (HasPointerMap<T>::value) {
+                    PointerMap<T> map(pointers);
+                    T::describePointers(map);
+                }
+                const Delegate<void, void* const*, uint32>::FunctionDelegate<destroyNonTrivialTypes<T>> destroyBatch;
+                return registerType(Delegate<void, void*, const void*>::FunctionDelegate<copyNonTrivialType<T>>(), Delegate<void, void*>::FunctionDelegate<destroyNonTrivialType<T>>(), pointers, &destroyBatch);
+            }
+        };
+    }
+}
+
+#include "ManagedMemoryPointer.hpp"
@@ -94,6 +94,20 @@ namespace Neuro
             return *this;
         }
         
+        /**
+         * Constructs the contained value in place through the given callback,
+         * which receives a pointer to the uninitialized storage. Allows storing
+         * polymorphic values which only know how to copy themselves, such as
+         * Delegates.
+         */
+        template<typename Constructor>
+        Maybe& construct(Constructor&& constructor) {
+            clear();
+            constructor(reinterpret_cast<T*>(m_buffer));
+            m_valid = true;
+            return *this;
+        }
+        
         Maybe& clear() {
             if (m_valid) {
                 reinterpret_cast<T&>(m_buffer).~T();
@@ -6,6 +6,12 @@
 // License: GPL 3.0
 #pragma once
 
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#include "Numeric.hpp"
+
 namespace Neuro
 {
     /**
@@ -80,6 +86,37 @@ namespace Neuro
         return rhs | ~(lhs ^ rhs);
     }
     
+    /** Counts the set bits using the hardware population count where available. */
+    inline uint32 countSetBits(uint64 value) {
+#ifdef _MSC_VER
+        return static_cast<uint32>(__popcnt64(value));
+#else
+        return static_cast<uint32>(__builtin_popcountll(value));
+#endif
+    }
+    
+    /** Gets the index of the lowest set bit. Undefined if `value` is 0. */
+    inline uint32 countTrailingZeros(uint64 value) {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanForward64(&index, value);
+        return static_cast<uint32>(index);
+#else
+        return static_cast<uint32>(__builtin_ctzll(value));
+#endif
+    }
+    
+    /** Gets the number of zero bits above the highest set bit. Undefined if `value` is 0. */
+    inline uint32 countLeadingZeros(uint64 value) {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanReverse64(&index, value);
+        return 63 - static_cast<uint32>(index);
+#else
+        return static_cast<uint32>(__builtin_clzll(value));
+#endif
+    }
+    
     /**
      * Toggles between one of two types based on a boolean value. Assumes the
      * first data type if `Switch` is false, otherwise the second.
@@ -68,7 +68,7 @@ namespace Neuro {
                 operator bool() const { return inst && index < inst.capacity(); }
                 
                 PropertyIterator& operator++() {
-                    while (inst->props[++index].id == -1 && index < inst->capacity());
+                    while (++index < inst->capacity() && inst->props()[index].id == -1);
                     return *this;
                 }
                 PropertyIterator operator++(int) {
@@ -77,7 +77,7 @@ namespace Neuro {
                     return *this;
                 }
                 PropertyIterator& operator--() {
-                    while (inst->props[--index].id == -1 && index < inst->capacity());
+                    while (--index < inst->capacity() && inst->props()[index].id == -1);
                     return *this;
                 }
                 PropertyIterator operator--(int) {
@@ -86,19 +86,19 @@ namespace Neuro {
                     return *this;
                 }
                 
-                reference operator*() const { return inst->props[index]; }
-                pointer operator->() const { return inst->props + index; }
+                reference operator*() const { return inst->props()[index]; }
+                pointer operator->() const { return inst->props() + index; }
                 
             public:  // Static Methods
                 static PropertyIterator fromFirst(object_type* obj) {
                     for (uint32 i = 0; i < obj->capacity(); ++i) {
-                        if (obj->props[i].id != -1) return PropertyIterator(obj, i);
+                        if (obj->props()[i].id != -1) return PropertyIterator(obj, i);
                     }
                     return PropertyIterator(obj, obj->capacity());
                 }
                 static PropertyIterator fromLast(object_type* obj) {
                     for (uint32 i = obj->capacity() - 1; i < obj->capacity(); --i) {
-                        if (obj->props[i].id != -1) return PropertyIterator(obj, i);
+                        if (obj->props()[i].id != -1) return PropertyIterator(obj, i);
                     }
                     return PropertyIterator(obj, obj->capacity());
                 }
@@ -115,11 +115,6 @@ namespace Neuro {
              */
             Pointer self;
             
-            /**
-             * Pointer to the beginning of this object's property map.
-             */
-            Property* props;
-            
             /**
              * Maximum number of properties this object can hold.
              */
@@ -242,6 +237,15 @@ namespace Neuro {
             Pointer getPointer() const { return self; }
             
         private: // Internal helpers
+            /**
+             * Gets the beginning of this object's property map, which lies
+             * right behind the object. Computed rather than stored so the GC
+             * may move objects bytewise.
+             */
+            Property* props() const {
+                return reinterpret_cast<Property*>(const_cast<Object*>(this) + 1);
+            }
+            
             /**
              * Initializes the entire property map, which kinda sucks...
              */
@@ -270,8 +274,8 @@ namespace Neuro {
             ImmutablePropertyIterator cbegin() const { return ImmutablePropertyIterator::fromFirst(this); }
             MutablePropertyIterator begin() { return MutablePropertyIterator::fromFirst(this); }
             auto begin() const { return cbegin(); }
-            ImmutablePropertyIterator cend() const { return ImmutablePropertyIterator::fromLast(this); }
-            MutablePropertyIterator end() { return MutablePropertyIterator::fromLast(this); }
+            ImmutablePropertyIterator cend() const { return ImmutablePropertyIterator(this, capacity()); }
+            MutablePropertyIterator end() { return MutablePropertyIterator(this, capacity()); }
             auto end() const { return cend(); }
             
         public:  // External dependencies (delegates & statics)
@@ -26,6 +26,7 @@
 #include "Error.hpp"
 #include "NeuroTypes.h"
 
+#include "GC/CardTable.hpp"
 #include "GC/ManagedMemoryPointer.hpp"
 
 namespace Neuro
@@ -154,6 +155,7 @@ namespace Neuro
             clearManagedPointer();
             m_type = NVT_Object;
             m_objectValue = obj;
+            Runtime::writeBarrier(this);
             return *this;
         }
         Value& operator=(void* ptr) {
@@ -199,6 +201,7 @@ namespace Neuro
                 break;
             case NVT_Object:
 				m_objectValue = other.getManagedObject();
+                Runtime::writeBarrier(this);
                 break;
             }
             return *this;
@@ -16,6 +16,12 @@ namespace Neuro {
             using namespace Unix;
             
             inline bool isLinux() { return true; }
+            
+            /**
+             * Requests transparent huge pages for the given range, which
+             * spares the TLB lots of entries for large heaps.
+             */
+            NEURO_API bool adviseHugePages(void* addr, size_t bytes);
         }
     }
 }
@@ -7,6 +7,12 @@
 // License: GNU GPL 3.0
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "DLLDecl.h"
+
 namespace Neuro {
     namespace Platform {
         namespace Unix
@@ -17,6 +23,70 @@ namespace Neuro {
             inline bool isApple()   { return false; }
             
             extern constexpr char* PathSeparator = ":";
+            
+            /**
+             * Maps `bytes` bytes of zeroed, readable and writable pages whose
+             * address is a multiple of `alignment`. Both need to be multiples
+             * of the page size. Returns nullptr if no pages could be mapped.
+             */
+            NEURO_API void* mapPages(size_t bytes, size_t alignment);
+            
+            /**
+             * Returns pages mapped by `mapPages` or reserved by `reservePages`
+             * to the operating system.
+             */
+            NEURO_API void unmapPages(void* addr, size_t bytes);
+            
+            /**
+             * Reserves `bytes` bytes of address space aligned to `alignment`
+             * without backing it with memory. Pages need to be committed
+             * before they may be accessed. Returns nullptr if the address
+             * space could not be reserved.
+             */
+            NEURO_API void* reservePages(size_t bytes, size_t alignment);
+            
+            /**
+             * Makes reserved pages readable and writable. Their memory is
+             * zeroed when first touched. Returns false on failure.
+             */
+            NEURO_API bool commitPages(void* addr, size_t bytes);
+            
+            /**
+             * Returns the memory of committed pages to the operating system,
+             * leaving them reserved but inaccessible.
+             */
+            NEURO_API void decommitPages(void* addr, size_t bytes);
+            
+            /**
+             * Returns the memory of committed pages to the operating system,
+             * but leaves them accessible. Their contents are undefined.
+             */
+            NEURO_API void discardPages(void* addr, size_t bytes);
+            
+            /**
+             * Asks the operating system to back the given pages with huge
+             * pages where possible. Returns false if it does not support huge
+             * pages.
+             */
+            NEURO_API bool adviseHugePages(void* addr, size_t bytes);
+            
+            NEURO_API size_t getPageSize();
+            
+            /**
+             * Captures the return addresses of the calling thread's stack into
+             * `frames`, innermost first, skipping the `skip` innermost frames
+             * besides this function's own. Returns the number of addresses
+             * captured, or 0 if the platform cannot walk the stack.
+             */
+            NEURO_API uint32_t captureBacktrace(void** frames, uint32_t maxFrames, uint32_t skip);
+            
+            /**
+             * Looks up the name of the function containing the code address
+             * and the path of the module it was loaded from. Either is left
+             * empty if unknown. Returns false if nothing is known about the
+             * address.
+             */
+            NEURO_API bool describeAddress(const void* addr, std::string& function, std::string& module);
         }
     }
 }
@@ -0,0 +1,106 @@
+////////////////////////////////////////////////////////////////////////////////
+// Implementation of the worker pool.
+// -----
+// Copyright (c) Kiruse 2018
+// License: GPL 3.0
+#include "Concurrency/WorkerPool.hpp"
+
+namespace Neuro {
+    namespace Runtime {
+        namespace Concurrency
+        {
+            WorkerPool::WorkerPool(uint32 numWorkers)
+             : syncMutex()
+             , startNotif()
+             , doneNotif()
+             , threads()
+             , job(nullptr)
+             , generation(0)
+             , numPending(0)
+             , terminate(false)
+            {
+                resize(numWorkers);
+            }
+            
+            WorkerPool::~WorkerPool() {
+                joinAll();
+            }
+            
+            
+            void WorkerPool::run(const JobDelegate& job) {
+                if (threads.length() == 0) {
+                    job(0);
+                    return;
+                }
+                
+                {
+                    std::scoped_lock lock(syncMutex);
+                    this->job = &job;
+                    numPending = threads.length();
+                    ++generation;
+                }
+                startNotif.notify_all();
+                
+                job(0);
+                
+                std::unique_lock<std::mutex> lock(syncMutex);
+                doneNotif.wait(lock, [this]() { return numPending == 0; });
+                this->job = nullptr;
+            }
+            
+            void WorkerPool::resize(uint32 numWorkers) {
+                if (numWorkers < 1) numWorkers = 1;
+                if (numWorkers == count()) return;
+                
+                // Helper threads capture their index on spawn, hence shrinking
+                // restarts the whole pool rather than picking individual
+                // threads to stop. New threads are handed the current generation
+                // up front so they cannot miss a job dispatched before they got
+                // to run.
+                joinAll();
+                for (uint32 i = 1; i < numWorkers; ++i) {
+                    const uint64 gen = generation;
+                    threads.add(new std::thread([this, i, gen]() { threadMain(i, gen); }));
+                }
+            }
+            
+            
+            void WorkerPool::threadMain(uint32 workerIndex, uint64 seenGeneration) {
+                while (true) {
+                    const JobDelegate* curr;
+                    {
+                        std::unique_lock<std::mutex> lock(syncMutex);
+                        startNotif.wait(lock, [&]() { return terminate || generation != seenGeneration; });
+                        if (terminate) return;
+                        seenGeneration = generation;
+                        curr = job;
+                    }
+                    
+                    (*curr)(workerIndex);
+                    
+                    bool last;
+                    {
+                        std::scoped_lock lock(syncMutex);
+                        last = --numPending == 0;
+                    }
+                    if (last) doneNotif.notify_one();
+                }
+            }
+            
+            void WorkerPool::joinAll() {
+                {
+                    std::scoped_lock lock(syncMutex);
+                    terminate = true;
+                }
+                startNotif.notify_all();
+                
+                for (auto* thread : threads) {
+                    thread->join();
+                    delete thread;
+                }
+                threads.clear();
+                terminate = false;
+            }
+        }
+    }
+}
@@ -0,0 +1,294 @@
+////////////////////////////////////////////////////////////////////////////////
+// Implementation of the allocation sampling profiler and its pprof output.
+// -----
+// Copyright (c) Kiruse 2018
+// License: GPL 3.0
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include "GC/AllocationProfiler.hpp"
+#include "Platform/Broker.hpp"
+
+namespace Neuro {
+    namespace Runtime
+    {
+        ////////////////////////////////////////////////////////////////////////
+        // Statics
+        ////////////////////////////////////////////////////////////////////////
+        
+        thread_local const char* currentAllocationSite = nullptr;
+        
+        std::atomic<uint64> nextProfilerGeneration(1);
+        
+        /**
+         * Bytes the thread may still allocate before its next sample is due.
+         * Countdowns of a different generation belong to another profiler.
+         */
+        struct SampleCountdown {
+            uint64 generation = 0;
+            int64 bytesUntilSample = 0;
+            uint64 random = 0;
+        };
+        thread_local SampleCountdown localCountdown;
+        
+        /**
+         * Draws the number of bytes until the next sample from an exponential
+         * distribution with the given mean. Uses xorshift64*, which is plenty
+         * random for sampling and far cheaper than <random>'s engines.
+         */
+        int64 drawSampleInterval(SampleCountdown& countdown, uint64 interval) {
+            uint64& x = countdown.random;
+            x ^= x >> 12;
+            x ^= x << 25;
+            x ^= x >> 27;
+            const double uniform = static_cast<double>((x * 0x2545f4914f6cdd1dull) >> 11) / 9007199254740992.0;
+            return 1 + static_cast<int64>(-std::log(1.0 - uniform) * static_cast<double>(interval));
+        }
+        
+        
+        ////////////////////////////////////////////////////////////////////////
+        // Protocol Buffers
+        ////////////////////////////////////////////////////////////////////////
+        
+        /**
+         * Just enough of the protocol buffer wire format to write pprof's
+         * profile.proto. Messages are assembled in strings, as every
+         * embedded message is preceded by its length.
+         */
+        void writeProfileVarint(std::string& out, uint64 value) {
+            while (value >= 0x80) {
+                out += static_cast<char>((value & 0x7f) | 0x80);
+                value >>= 7;
+            }
+            out += static_cast<char>(value);
+        }
+        
+        void writeProfileField(std::string& out, uint32 field, uint64 value) {
+            writeProfileVarint(out, field << 3);
+            writeProfileVarint(out, value);
+        }
+        
+        void writeProfileField(std::string& out, uint32 field, const std::string& message) {
+            writeProfileVarint(out, (field << 3) | 2);
+            writeProfileVarint(out, message.length());
+            out += message;
+        }
+        
+        /**
+         * Strings are referred to by their index in the profile's string
+         * table, whose first string must be empty.
+         */
+        class ProfileStrings
+        {
+        private:   // Properties
+            std::unordered_map<std::string, uint64> indices;
+            std::vector<std::string> strings;
+            
+        public:    // RAII
+            ProfileStrings() { get(""); }
+            
+        public:    // Methods
+            uint64 get(const std::string& str) {
+                auto it = indices.find(str);
+                if (it != indices.end()) return it->second;
+                indices.emplace(str, strings.size());
+                strings.push_back(str);
+                return strings.size() - 1;
+            }
+            
+            void write(std::string& out) const {
+                for (const auto& str : strings) writeProfileField(out, 6, str);
+            }
+        };
+        
+        std::string writeProfileValueType(ProfileStrings& strings, const char* type, const char* unit) {
+            std::string message;
+            writeProfileField(message, 1, strings.get(type));
+            writeProfileField(message, 2, strings.get(unit));
+            return message;
+        }
+        
+        
+        ////////////////////////////////////////////////////////////////////////
+        // AllocationSite
+        ////////////////////////////////////////////////////////////////////////
+        
+        AllocationSite::AllocationSite(const char* label) : previous(currentAllocationSite) {
+            currentAllocationSite = label;
+        }
+        
+        AllocationSite::~AllocationSite() {
+            currentAllocationSite = previous;
+        }
+        
+        const char* AllocationSite::current() {
+            return currentAllocationSite;
+        }
+        
+        
+        ////////////////////////////////////////////////////////////////////////
+        // RAII
+        ////////////////////////////////////////////////////////////////////////
+        
+        AllocationProfiler::AllocationProfiler(uint64 interval)
+         : interval(interval ? interval : 1)
+         , generation(nextProfilerGeneration.fetch_add(1, std::memory_order_relaxed))
+         , numSamples(0)
+         , samplesMutex()
+         , samples()
+         , sampleIndices()
+         , siteLabels()
+        {}
+        
+        
+        ////////////////////////////////////////////////////////////////////////
+        // Methods
+        ////////////////////////////////////////////////////////////////////////
+        
+        void AllocationProfiler::allocated(uint64 bytes) {
+            SampleCountdown& countdown = localCountdown;
+            if (countdown.generation != generation) {
+                // Seed every thread differently, yet never with 0, which
+                // xorshift would never leave.
+                countdown.generation = generation;
+                countdown.random = (reinterpret_cast<uintptr_t>(&countdown) ^ std::chrono::steady_clock::now().time_since_epoch().count()) | 1;
+                countdown.bytesUntilSample = drawSampleInterval(countdown, interval);
+            }
+            
+            countdown.bytesUntilSample -= static_cast<int64>(bytes);
+            if (countdown.bytesUntilSample > 0) return;
+            
+            // The process is memoryless, hence the next interval may simply
+            // start after this allocation, however many samples fell into it.
+            countdown.bytesUntilSample = drawSampleInterval(countdown, interval);
+            record(bytes);
+        }
+        
+        void AllocationProfiler::record(uint64 bytes) {
+            Sample sample;
+            sample.numFrames = Platform::captureBacktrace(sample.frames, NEURO_GC_PROFILE_DEPTH, 2);
+            
+            // At least one sample fell into the allocation with probability
+            // 1 - exp(-bytes / interval).
+            const double weight = 1.0 / -std::expm1(-static_cast<double>(bytes) / static_cast<double>(interval));
+            
+            const char* site = AllocationSite::current();
+            std::string key(reinterpret_cast<const char*>(sample.frames), sample.numFrames * sizeof(void*));
+            if (site) key.append(1, '\0').append(site);
+            
+            std::scoped_lock lock(samplesMutex);
+            auto it = sampleIndices.find(key);
+            if (it == sampleIndices.end()) {
+                sample.site = site ? siteLabels.emplace(site).first->c_str() : nullptr;
+                sample.numSamples = 0;
+                sample.numObjects = 0;
+                sample.bytes = 0;
+                it = sampleIndices.emplace(std::move(key), samples.length()).first;
+                samples.add(sample);
+            }
+            
+            Sample& aggregate = samples[it->second];
+            aggregate.numSamples++;
+            aggregate.numObjects += weight;
+            aggregate.bytes += weight * static_cast<double>(bytes);
+            numSamples.fetch_add(1, std::memory_order_relaxed);
+        }
+        
+        void AllocationProfiler::collect(Buffer<Sample>& result) const {
+            std::scoped_lock lock(samplesMutex);
+            for (const auto& sample : samples) result.add(sample);
+        }
+        
+        void AllocationProfiler::writePprof(std::ostream& out) const {
+            Buffer<Sample> aggregates;
+            collect(aggregates);
+            
+            ProfileStrings strings;
+            std::string profile;
+            writeProfileField(profile, 1, writeProfileValueType(strings, "alloc_objects", "count"));
+            writeProfileField(profile, 1, writeProfileValueType(strings, "alloc_space", "bytes"));
+            
+            // Every distinct address becomes a location, and every distinct
+            // function name a function. Ids start at 1.
+            std::unordered_map<void*, uint64> locationIds;
+            std::unordered_map<std::string, uint64> functionIds;
+            std::string locations, functions;
+            std::string function, module;
+            
+            const uint64 siteKey = strings.get("site");
+            for (const auto& sample : aggregates) {
+                std::string locationList;
+                for (uint32 i = 0; i < sample.numFrames; ++i) {
+                    void* address = sample.frames[i];
+                    auto it = locationIds.find(address);
+                    if (it == locationIds.end()) {
+                        it = locationIds.emplace(address, locationIds.size() + 1).first;
+                        
+                        std::string location;
+                        writeProfileField(location, 1, it->second);
+                        writeProfileField(location, 3, reinterpret_cast<uintptr_t>(address));
+                        
+                        // Return addresses point past the call, which may
+                        // already be the next function.
+                        if (Platform::describeAddress(reinterpret_cast<const char*>(address) - 1, function, module) && !function.empty()) {
+                            auto fit = functionIds.find(function);
+                            if (fit == functionIds.end()) {
+                                fit = functionIds.emplace(function, functionIds.size() + 1).first;
+                                
+                                std::string message;
+                                writeProfileField(message, 1, fit->second);
+                                writeProfileField(message, 2, strings.get(function));
+                                writeProfileField(message, 3, strings.get(function));
+                                writeProfileField(message, 4, strings.get(module));
+                                writeProfileField(functions, 5, message);
+                            }
+                            
+                            std::string line;
+                            writeProfileField(line, 1, fit->second);
+                            writeProfileField(location, 4, line);
+                        }
+                        writeProfileField(locations, 4, location);
+                    }
+                    writeProfileVarint(locationList, it->second);
+                }
+                
+                std::string values;
+                writeProfileVarint(values, static_cast<uint64>(std::llround(sample.numObjects)));
+                writeProfileVarint(values, static_cast<uint64>(std::llround(sample.bytes)));
+                
+                std::string message;
+                writeProfileField(message, 1, locationList);
+                writeProfileField(message, 2, values);
+                if (sample.site) {
+                    std::string label;
+                    writeProfileField(label, 1, siteKey);
+                    writeProfileField(label, 2, strings.get(sample.site));
+                    writeProfileField(message, 3, label);
+                }
+                writeProfileField(profile, 2, message);
+            }
+            
+            profile += locations;
+            profile += functions;
+            
+            const auto now = std::chrono::system_clock::now().time_since_epoch();
+            writeProfileField(profile, 9, static_cast<uint64>(std::chrono::duration_cast<std::chrono::nanoseconds>(now).count()));
+            writeProfileField(profile, 11, writeProfileValueType(strings, "space", "bytes"));
+            writeProfileField(profile, 12, interval);
+            
+            // The string table is complete only now.
+            strings.write(profile);
+            out.write(profile.data(), profile.length());
+        }
+        
+        void AllocationProfiler::clear() {
+            std::scoped_lock lock(samplesMutex);
+            samples.clear();
+            sampleIndices.clear();
+            siteLabels.clear();
+            numSamples.store(0, std::memory_order_relaxed);
+        }
+    }
+}
@@ -0,0 +1,161 @@
+////////////////////////////////////////////////////////////////////////////////
+// Implementation of the card tables of the GC's memory segments.
+// -----
+// Copyright (c) Kiruse 2018
+// License: GPL 3.0
+#include <algorithm>
+#include <new>
+
+#include "GC/CardTable.hpp"
+
+namespace Neuro {
+    namespace Runtime
+    {
+        ////////////////////////////////////////////////////////////////////////
+        // Statics
+        ////////////////////////////////////////////////////////////////////////
+        
+        // Leaves are never released again, as the barrier may read them at any
+        // time without synchronization. They are few and small.
+        std::atomic<std::atomic<CardTable*>*> CardTable::directory[1 << CardTable::DirectoryBits] = {};
+        
+        
+        ////////////////////////////////////////////////////////////////////////
+        // Local Helpers
+        ////////////////////////////////////////////////////////////////////////
+        
+        /**
+         * Gets the region map entry of the given region, creating its leaf if
+         * necessary.
+         */
+        std::atomic<CardTable*>* getRegionEntry(std::atomic<std::atomic<CardTable*>*>* directory, uintptr_t region) {
+            auto& slot = directory[(region >> CardTable::LeafBits) & ((1 << CardTable::DirectoryBits) - 1)];
+            auto* leaf = slot.load(std::memory_order_acquire);
+            
+            if (!leaf) {
+                auto* newLeaf = new std::atomic<CardTable*>[1 << CardTable::LeafBits];
+                for (uint32 i = 0; i < (1 << CardTable::LeafBits); ++i) {
+                    newLeaf[i].store(nullptr, std::memory_order_relaxed);
+                }
+                
+                // Another thread may have beaten us to it.
+                if (slot.compare_exchange_strong(leaf, newLeaf, std::memory_order_acq_rel)) {
+                    leaf = newLeaf;
+                }
+                else {
+                    delete[] newLeaf;
+                }
+            }
+            
+            return leaf + (region & ((1 << CardTable::LeafBits) - 1));
+        }
+        
+        
+        ////////////////////////////////////////////////////////////////////////
+        // RAII
+        ////////////////////////////////////////////////////////////////////////
+        
+        CardTable::~CardTable() {
+            detach();
+        }
+        
+        
+        ////////////////////////////////////////////////////////////////////////
+        // Methods
+        ////////////////////////////////////////////////////////////////////////
+        
+        bool CardTable::attach(void* memory, uint32 bytes) {
+            detach();
+            
+            const uint32 numCards = (bytes + CardSize - 1) >> CardShift;
+            cards = new (std::nothrow) std::atomic<uint8>[numCards];
+            if (!cards) return false;
+            for (uint32 i = 0; i < numCards; ++i) {
+                cards[i].store(0, std::memory_order_relaxed);
+            }
+            
+            begin = reinterpret_cast<uint8*>(memory);
+            size = bytes;
+            
+            const uintptr_t first = reinterpret_cast<uintptr_t>(begin) >> RegionShift;
+            const uintptr_t last  = (reinterpret_cast<uintptr_t>(begin) + size - 1) >> RegionShift;
+            for (uintptr_t region = first; region <= last; ++region) {
+                getRegionEntry(directory, region)->store(this, std::memory_order_release);
+            }
+            return true;
+        }
+        
+        void CardTable::detach() {
+            if (!cards) return;
+            
+            // Only unregister regions still referring to us in case the memory
+            // has been handed to another segment already.
+            const uintptr_t first = reinterpret_cast<uintptr_t>(begin) >> RegionShift;
+            const uintptr_t last  = (reinterpret_cast<uintptr_t>(begin) + size - 1) >> RegionShift;
+            for (uintptr_t region = first; region <= last; ++region) {
+                CardTable* self = this;
+                getRegionEntry(directory, region)->compare_exchange_strong(self, nullptr, std::memory_order_acq_rel);
+            }
+            
+            delete[] cards;
+            cards = nullptr;
+            begin = nullptr;
+            size = 0;
+        }
+        
+        void CardTable::dirty(const void* addr, uint32 bytes) {
+            if (!bytes) return;
+            const uintptr_t offset = reinterpret_cast<const uint8*>(addr) - begin;
+            if (offset >= size) return;
+            
+            const uint32 first = static_cast<uint32>(offset >> CardShift);
+            const uint32 last  = static_cast<uint32>(std::min<uintptr_t>(offset + bytes - 1, size - 1) >> CardShift);
+            for (uint32 i = first; i <= last; ++i) {
+                cards[i].store(1, std::memory_order_relaxed);
+            }
+        }
+        
+        bool CardTable::isDirty(const void* addr, uint32 bytes) const {
+            if (!bytes) return false;
+            const uintptr_t offset = reinterpret_cast<const uint8*>(addr) - begin;
+            if (offset >= size) return false;
+            
+            const uint32 first = static_cast<uint32>(offset >> CardShift);
+            const uint32 last  = static_cast<uint32>(std::min<uintptr_t>(offset + bytes - 1, size - 1) >> CardShift);
+            for (uint32 i = first; i <= last; ++i) {
+                if (isDirty(i)) return true;
+            }
+            return false;
+        }
+        
+        uint32 CardTable::takeDirty(Buffer<uint32>& indices) {
+            const uint32 numCards = countCards();
+            uint32 count = 0;
+            for (uint32 i = 0; i < numCards; ++i) {
+                if (isDirty(i)) {
+                    clean(i);
+                    indices.add(i);
+                    ++count;
+                }
+            }
+            return count;
+        }
+        
+        bool CardTable::anyDirty() const {
+            const uint32 numCards = countCards();
+            for (uint32 i = 0; i < numCards; ++i) {
+                if (isDirty(i)) return true;
+            }
+            return false;
+        }
+        
+        uint32 CardTable::countDirty() const {
+            const uint32 numCards = countCards();
+            uint32 count = 0;
+            for (uint32 i = 0; i < numCards; ++i) {
+                if (isDirty(i)) ++count;
+            }
+            return count;
+        }
+    }
+}
@@ -0,0 +1,150 @@
+////////////////////////////////////////////////////////////////////////////////
+// Implementation of the GC's segregated free lists.
+// -----
+// Copyright (c) Kiruse 2018
+// License: GPL 3.0
+#include <algorithm>
+#include <thread>
+
+#include "GC/FreeLists.hpp"
+#include "Misc.hpp"
+
+namespace Neuro {
+    namespace Runtime
+    {
+        ////////////////////////////////////////////////////////////////////////
+        // RAII
+        ////////////////////////////////////////////////////////////////////////
+        
+        FreeLists::FreeLists()
+         : lists()
+         , numBlocks(0)
+         , numBytes(0)
+        {
+            for (auto& list : lists) {
+                list.locked.clear();
+            }
+            nonEmpty[0] = nonEmpty[1] = 0;
+        }
+        
+        FreeLists::Lock::Lock(List& list) : list(list) {
+            while (list.locked.test_and_set(std::memory_order_acquire)) std::this_thread::yield();
+        }
+        
+        FreeLists::Lock::~Lock() {
+            list.locked.clear(std::memory_order_release);
+        }
+        
+        
+        ////////////////////////////////////////////////////////////////////////
+        // Methods
+        ////////////////////////////////////////////////////////////////////////
+        
+        void FreeLists::add(ManagedMemoryOverhead* block) {
+            const uint32 sizeClass = getSizeClass(block->getTotalBytes());
+            {
+                Lock lock(lists[sizeClass]);
+                lists[sizeClass].blocks.add(block);
+                nonEmpty[sizeClass / 64].fetch_or(uint64(1) << (sizeClass % 64), std::memory_order_relaxed);
+            }
+            numBlocks.fetch_add(1, std::memory_order_relaxed);
+            numBytes.fetch_add(block->getTotalBytes(), std::memory_order_relaxed);
+        }
+        
+        ManagedMemoryOverhead* FreeLists::take(uint32 bytes) {
+            if (empty()) return nullptr;
+            
+            // Blocks of the class of `bytes` may be too small, those of the
+            // next class may be too large to fit a filler behind.
+            const uint32 sizeClass = getSizeClass(bytes);
+            const uint32 lastClass = std::min(sizeClass + 1, NumClasses - 1);
+            for (uint32 curr = sizeClass; curr <= lastClass; ++curr) {
+                if (!(nonEmpty[curr / 64].load(std::memory_order_relaxed) & (uint64(1) << (curr % 64)))) continue;
+                
+                Lock lock(lists[curr]);
+                auto& blocks = lists[curr].blocks;
+                const uint32 length = blocks.length();
+                for (uint32 i = length; i > 0 && length - i < MaxCandidates; --i) {
+                    if (fits(blocks[i - 1], bytes)) return remove(curr, i - 1);
+                }
+            }
+            return nullptr;
+        }
+        
+        ManagedMemoryOverhead* FreeLists::takeAtLeast(uint32 bytes) {
+            if (empty()) return nullptr;
+            
+            // Only the last block of the first class needs testing, all blocks
+            // of the classes above are large enough.
+            const uint32 sizeClass = getSizeClass(bytes);
+            for (uint32 curr = sizeClass; curr < NumClasses; ++curr) {
+                const uint64 word = nonEmpty[curr / 64].load(std::memory_order_relaxed) >> (curr % 64);
+                if (!word) {
+                    curr = (curr / 64 + 1) * 64 - 1;
+                    continue;
+                }
+                curr += countTrailingZeros(word);
+                
+                Lock lock(lists[curr]);
+                auto& blocks = lists[curr].blocks;
+                if (blocks.length() && blocks.last()->getTotalBytes() >= bytes) return remove(curr, blocks.length() - 1);
+            }
+            return nullptr;
+        }
+        
+        void FreeLists::clear() {
+            for (uint32 sizeClass = 0; sizeClass < NumClasses; ++sizeClass) {
+                Lock lock(lists[sizeClass]);
+                uint64 bytes = 0;
+                for (auto* block : lists[sizeClass].blocks) bytes += block->getTotalBytes();
+                numBlocks.fetch_sub(lists[sizeClass].blocks.length(), std::memory_order_relaxed);
+                numBytes.fetch_sub(bytes, std::memory_order_relaxed);
+                lists[sizeClass].blocks.clear();
+                nonEmpty[sizeClass / 64].fetch_and(~(uint64(1) << (sizeClass % 64)), std::memory_order_relaxed);
+            }
+        }
+        
+        uint32 FreeLists::count(uint32 sizeClass) {
+            Lock lock(lists[sizeClass]);
+            return lists[sizeClass].blocks.length();
+        }
+        
+        ManagedMemoryOverhead* FreeLists::remove(uint32 sizeClass, uint32 index) {
+            auto& blocks = lists[sizeClass].blocks;
+            ManagedMemoryOverhead* block = blocks[index];
+            
+            // The order of the blocks is irrelevant.
+            blocks[index] = blocks.last();
+            blocks.drop();
+            if (!blocks.length()) {
+                nonEmpty[sizeClass / 64].fetch_and(~(uint64(1) << (sizeClass % 64)), std::memory_order_relaxed);
+            }
+            
+            numBlocks.fetch_sub(1, std::memory_order_relaxed);
+            numBytes.fetch_sub(block->getTotalBytes(), std::memory_order_relaxed);
+            return block;
+        }
+        
+        
+        ////////////////////////////////////////////////////////////////////////
+        // Static Methods
+        ////////////////////////////////////////////////////////////////////////
+        
+        uint32 FreeLists::getSizeClass(uint32 bytes) {
+            if (bytes < (1u << MinClassShift)) return 0;
+            
+            // The two bits below the highest set bit select the quarter.
+            const uint32 shift = 63 - countLeadingZeros(bytes);
+            const uint32 quarter = (bytes >> (shift - 2)) & 3;
+            return 1 + (shift - MinClassShift) * 4 + quarter;
+        }
+        
+        uint32 FreeLists::getClassBytes(uint32 sizeClass) {
+            if (!sizeClass) return 0;
+            
+            const uint32 shift = MinClassShift + (sizeClass - 1) / 4;
+            const uint32 quarter = (sizeClass - 1) % 4;
+            return (4 + quarter) << (shift - 2);
+        }
+    }
+}
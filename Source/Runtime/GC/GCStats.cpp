@@ -0,0 +1,87 @@
+////////////////////////////////////////////////////////////////////////////////
+// Implementation of the GC's latency histograms.
+// -----
+// Copyright (c) Kiruse 2018
+// License: GPL 3.0
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#include "GC/GCStats.hpp"
+#include "Misc.hpp"
+
+namespace Neuro {
+    namespace Runtime
+    {
+        LatencyHistogram::LatencyHistogram() {
+            reset();
+        }
+        
+        
+        void LatencyHistogram::record(uint64 value) {
+            ++counters[getCounterIndex(value)];
+            ++numValues;
+            minValue = std::min(minValue, value);
+            maxValue = std::max(maxValue, value);
+            sum += value;
+        }
+        
+        void LatencyHistogram::merge(const LatencyHistogram& other) {
+            for (uint32 i = 0; i < NumCounters; ++i) {
+                counters[i] += other.counters[i];
+            }
+            numValues += other.numValues;
+            minValue = std::min(minValue, other.minValue);
+            maxValue = std::max(maxValue, other.maxValue);
+            sum += other.sum;
+        }
+        
+        void LatencyHistogram::reset() {
+            std::memset(counters, 0, sizeof(counters));
+            numValues = 0;
+            minValue = std::numeric_limits<uint64>::max();
+            maxValue = 0;
+            sum = 0;
+        }
+        
+        uint64 LatencyHistogram::percentile(double percent) const {
+            if (!numValues) return 0;
+            
+            // The rank of the value sought, counting from 1.
+            const double clamped = std::min(std::max(percent, 0.0), 100.0);
+            const uint64 rank = std::max<uint64>(1, static_cast<uint64>(clamped / 100.0 * numValues + 0.5));
+            
+            uint64 seen = 0;
+            for (uint32 i = 0; i < NumCounters; ++i) {
+                seen += counters[i];
+                if (seen >= rank) return std::min(getHighestValue(i), maxValue);
+            }
+            return maxValue;
+        }
+        
+        
+        uint32 LatencyHistogram::getCounterIndex(uint64 value) {
+            if (value < SubBucketCount) return static_cast<uint32>(value);
+            
+            // The highest set bit selects the power of two, the bits right
+            // below it the sub-bucket.
+            const uint32 shift = 63 - countLeadingZeros(value) - SubBucketBits;
+            const uint32 subBucket = static_cast<uint32>(value >> shift) - SubBucketCount;
+            return (shift + 1) * SubBucketCount + subBucket;
+        }
+        
+        uint64 LatencyHistogram::getLowestValue(uint32 index) {
+            if (index < SubBucketCount) return index;
+            
+            const uint32 shift = index / SubBucketCount - 1;
+            return uint64(SubBucketCount + index % SubBucketCount) << shift;
+        }
+        
+        uint64 LatencyHistogram::getHighestValue(uint32 index) {
+            if (index < SubBucketCount) return index;
+            
+            const uint32 shift = index / SubBucketCount - 1;
+            return getLowestValue(index) + (uint64(1) << shift) - 1;
+        }
+    }
+}
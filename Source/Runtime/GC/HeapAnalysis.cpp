@@ -0,0 +1,278 @@
+////////////////////////////////////////////////////////////////////////////////
+// Implementation of the heap snapshot analysis.
+// -----
+// Copyright (c) Kiruse 2018
+// License: GPL 3.0
+#include <algorithm>
+
+#include "GC/HeapAnalysis.hpp"
+#include "GC/ManagedMemoryOverhead.hpp"
+
+namespace Neuro {
+    namespace Runtime
+    {
+        ////////////////////////////////////////////////////////////////////////
+        // RAII
+        ////////////////////////////////////////////////////////////////////////
+        
+        HeapAnalysis::HeapAnalysis(const HeapSnapshot& snapshot)
+         : snapshot(snapshot)
+         , numNodes(snapshot.objects.length())
+         , nodesByTableIndex()
+         , dominators(new uint32[snapshot.objects.length() + 1])
+         , shallowBytes(new uint64[snapshot.objects.length() + 1]())
+         , retainedBytes(new uint64[snapshot.objects.length() + 1]())
+         , retainedObjects(new uint32[snapshot.objects.length() + 1]())
+         , firstChild(new uint32[snapshot.objects.length() + 2]())
+         , children()
+        {
+            for (uint32 node = 0; node < numNodes; ++node) {
+                nodesByTableIndex[snapshot.objects[node].tableIndex] = node;
+            }
+            
+            // Objects occupy the blocks referred to by their table records.
+            for (const auto& block : snapshot.blocks) {
+                if (block.tableIndex == npos || block.garbageState == EGarbageState::Swept) continue;
+                const uint32 node = findNode(block.tableIndex);
+                if (node != npos) shallowBytes[node] = block.totalBytes;
+            }
+            
+            computeDominators();
+            computeRetainedSizes();
+        }
+        
+        
+        ////////////////////////////////////////////////////////////////////////
+        // Methods
+        ////////////////////////////////////////////////////////////////////////
+        
+        uint32 HeapAnalysis::findNode(uint32 tableIndex) const {
+            auto it = nodesByTableIndex.find(tableIndex);
+            return it != nodesByTableIndex.end() ? it->second : npos;
+        }
+        
+        void HeapAnalysis::getDominated(uint32 node, Buffer<uint32>& dominated) const {
+            dominated.clear();
+            for (uint32 i = firstChild[node]; i < firstChild[node + 1]; ++i) {
+                dominated.add(children[i]);
+            }
+            if (dominated.length()) {
+                std::stable_sort(&dominated[0], &dominated[0] + dominated.length(), [this](uint32 lhs, uint32 rhs) {
+                    return retainedBytes[lhs] > retainedBytes[rhs];
+                });
+            }
+        }
+        
+        void HeapAnalysis::summarizeRoots(Buffer<RootSummary>& roots) const {
+            roots.clear();
+            for (uint32 tableIndex : snapshot.roots) {
+                const uint32 node = findNode(tableIndex);
+                if (node == npos) continue;
+                roots.add({ tableIndex, node, retainedBytes[node], retainedObjects[node] });
+            }
+            if (roots.length()) {
+                std::stable_sort(&roots[0], &roots[0] + roots.length(), [](const RootSummary& lhs, const RootSummary& rhs) {
+                    return lhs.retainedBytes > rhs.retainedBytes;
+                });
+            }
+        }
+        
+        void HeapAnalysis::summarizePropertyCounts(Buffer<PropertyBucket>& buckets) const {
+            buckets.clear();
+            for (uint32 node = 0; node < numNodes; ++node) {
+                const auto& object = snapshot.objects[node];
+                uint32 bucket = 0;
+                while (bucket < 32 && (object.numProperties >> bucket)) ++bucket;
+                
+                while (buckets.length() <= bucket) {
+                    const uint32 index = buckets.length();
+                    const uint32 min = index ? 1u << (index - 1) : 0;
+                    const uint32 max = index ? min * 2 - 1 : 0;
+                    buckets.add({ min, max, 0, 0 });
+                }
+                buckets[bucket].numObjects++;
+                buckets[bucket].bytes += shallowBytes[node];
+            }
+        }
+        
+        void HeapAnalysis::summarizeSegments(Buffer<SegmentSummary>& segments) const {
+            segments.clear();
+            for (uint32 i = 0; i < snapshot.segments.length(); ++i) {
+                segments.add({ i, snapshot.segments[i].usedBytes, 0, 0, 0, 0, 0, 0.0 });
+            }
+            
+            for (const auto& block : snapshot.blocks) {
+                auto& summary = segments[block.segment];
+                if (block.garbageState == EGarbageState::Swept) {
+                    summary.freeBytes += block.totalBytes;
+                    summary.largestFreeBlock = std::max<uint64>(summary.largestFreeBlock, block.totalBytes);
+                    summary.numFreeBlocks++;
+                }
+                else {
+                    summary.liveBytes += block.totalBytes;
+                    summary.numLiveBlocks++;
+                }
+            }
+            
+            for (auto& summary : segments) {
+                if (summary.freeBytes) {
+                    summary.fragmentation = 1.0 - double(summary.largestFreeBlock) / double(summary.freeBytes);
+                }
+            }
+        }
+        
+        
+        ////////////////////////////////////////////////////////////////////////
+        // Helpers
+        ////////////////////////////////////////////////////////////////////////
+        
+        void HeapAnalysis::computeDominators() {
+            const uint32 root = numNodes;
+            const uint32 numAll = numNodes + 1;
+            
+            // Successors of every node, the virtual root's being the roots.
+            std::unique_ptr<uint32[]> firstSuccessor(new uint32[numAll + 1]);
+            Buffer<uint32> successors;
+            for (uint32 node = 0; node < numNodes; ++node) {
+                firstSuccessor[node] = successors.length();
+                const auto& object = snapshot.objects[node];
+                for (uint32 i = 0; i < object.numReferences; ++i) {
+                    const uint32 target = findNode(snapshot.references[object.firstReference + i].target);
+                    if (target != npos) successors.add(target);
+                }
+            }
+            firstSuccessor[root] = successors.length();
+            for (uint32 tableIndex : snapshot.roots) {
+                const uint32 target = findNode(tableIndex);
+                if (target != npos) successors.add(target);
+            }
+            firstSuccessor[numAll] = successors.length();
+            
+            // Number the nodes reachable from the virtual root in postorder
+            // through an iterative depth-first search, as object graphs may
+            // be far deeper than the native stack.
+            std::unique_ptr<uint32[]> postorder(new uint32[numAll]);
+            std::fill(postorder.get(), postorder.get() + numAll, npos);
+            std::unique_ptr<uint8[]> visited(new uint8[numAll]());
+            Buffer<uint32> order, stack, nextEdge;
+            
+            visited[root] = 1;
+            stack.add(root);
+            nextEdge.add(firstSuccessor[root]);
+            while (stack.length()) {
+                const uint32 node = stack.last();
+                uint32& edge = nextEdge.last();
+                if (edge < firstSuccessor[node + 1]) {
+                    const uint32 next = successors[edge++];
+                    if (!visited[next]) {
+                        visited[next] = 1;
+                        stack.add(next);
+                        nextEdge.add(firstSuccessor[next]);
+                    }
+                    continue;
+                }
+                
+                postorder[node] = order.length();
+                order.add(node);
+                stack.drop();
+                nextEdge.drop();
+            }
+            
+            // Predecessors of every reachable node.
+            std::unique_ptr<uint32[]> firstPredecessor(new uint32[numAll + 1]());
+            for (uint32 node = 0; node < numAll; ++node) {
+                if (!visited[node]) continue;
+                for (uint32 i = firstSuccessor[node]; i < firstSuccessor[node + 1]; ++i) {
+                    firstPredecessor[successors[i] + 1]++;
+                }
+            }
+            for (uint32 node = 0; node < numAll; ++node) {
+                firstPredecessor[node + 1] += firstPredecessor[node];
+            }
+            std::unique_ptr<uint32[]> predecessors(new uint32[firstPredecessor[numAll]]);
+            {
+                std::unique_ptr<uint32[]> fill(new uint32[numAll]);
+                std::copy(firstPredecessor.get(), firstPredecessor.get() + numAll, fill.get());
+                for (uint32 node = 0; node < numAll; ++node) {
+                    if (!visited[node]) continue;
+                    for (uint32 i = firstSuccessor[node]; i < firstSuccessor[node + 1]; ++i) {
+                        predecessors[fill[successors[i]]++] = node;
+                    }
+                }
+            }
+            
+            // Refine the dominators in reverse postorder until they settle.
+            uint32* idom = dominators.get();
+            std::fill(idom, idom + numAll, npos);
+            idom[root] = root;
+            
+            auto intersect = [&](uint32 lhs, uint32 rhs) {
+                while (lhs != rhs) {
+                    while (postorder[lhs] < postorder[rhs]) lhs = idom[lhs];
+                    while (postorder[rhs] < postorder[lhs]) rhs = idom[rhs];
+                }
+                return lhs;
+            };
+            
+            bool changed = true;
+            while (changed) {
+                changed = false;
+                for (uint32 i = order.length() - 1; i-- > 0;) {
+                    const uint32 node = order[i];
+                    uint32 newIdom = npos;
+                    for (uint32 j = firstPredecessor[node]; j < firstPredecessor[node + 1]; ++j) {
+                        const uint32 pred = predecessors[j];
+                        if (idom[pred] == npos) continue;
+                        newIdom = newIdom == npos ? pred : intersect(pred, newIdom);
+                    }
+                    if (idom[node] != newIdom) {
+                        idom[node] = newIdom;
+                        changed = true;
+                    }
+                }
+            }
+            idom[root] = npos;
+            
+            // Children of every node in the dominator tree.
+            for (uint32 node = 0; node < numNodes; ++node) {
+                if (idom[node] != npos) firstChild[idom[node] + 1]++;
+            }
+            for (uint32 node = 0; node < numAll; ++node) {
+                firstChild[node + 1] += firstChild[node];
+            }
+            children.reset(new uint32[firstChild[numAll]]);
+            std::unique_ptr<uint32[]> fill(new uint32[numAll]);
+            std::copy(firstChild.get(), firstChild.get() + numAll, fill.get());
+            for (uint32 node = 0; node < numNodes; ++node) {
+                if (idom[node] != npos) children[fill[idom[node]]++] = node;
+            }
+        }
+        
+        void HeapAnalysis::computeRetainedSizes() {
+            // Walk the dominator tree depth-first, accumulating the sizes of
+            // the children into their parent once all of them are done.
+            Buffer<uint32> stack, nextChild;
+            stack.add(numNodes);
+            nextChild.add(firstChild[numNodes]);
+            while (stack.length()) {
+                const uint32 node = stack.last();
+                uint32& child = nextChild.last();
+                if (child < firstChild[node + 1]) {
+                    const uint32 next = children[child++];
+                    stack.add(next);
+                    nextChild.add(firstChild[next]);
+                    continue;
+                }
+                
+                stack.drop();
+                nextChild.drop();
+                if (node == numNodes) break;
+                
+                retainedBytes[node] += shallowBytes[node];
+                retainedObjects[node] += 1;
+                retainedBytes[dominators[node]] += retainedBytes[node];
+                retainedObjects[dominators[node]] += retainedObjects[node];
+            }
+        }
+    }
+}
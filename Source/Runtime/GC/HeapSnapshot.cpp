@@ -0,0 +1,169 @@
+////////////////////////////////////////////////////////////////////////////////
+// Implementation of the heap snapshot's binary format.
+// -----
+// Copyright (c) Kiruse 2018
+// License: GPL 3.0
+#include "GC/HeapSnapshot.hpp"
+
+namespace Neuro {
+    namespace Runtime
+    {
+        ////////////////////////////////////////////////////////////////////////
+        // Helpers
+        ////////////////////////////////////////////////////////////////////////
+        
+        template<typename T>
+        void writeSnapshotValue(std::ostream& out, T value) {
+            out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+        }
+        
+        template<typename T>
+        bool readSnapshotValue(std::istream& in, T& value) {
+            return !!in.read(reinterpret_cast<char*>(&value), sizeof(T));
+        }
+        
+        /**
+         * Writes the number of entries followed by every entry, each written
+         * field by field through the given function.
+         */
+        template<typename T, typename Writer>
+        void writeSnapshotSection(std::ostream& out, const Buffer<T>& entries, Writer writer) {
+            writeSnapshotValue<uint32>(out, entries.length());
+            for (const T& entry : entries) writer(entry);
+        }
+        
+        template<typename T, typename Reader>
+        bool readSnapshotSection(std::istream& in, Buffer<T>& entries, Reader reader) {
+            uint32 count;
+            if (!readSnapshotValue(in, count)) return false;
+            
+            // Grow while reading so that a corrupt count fails on the first
+            // missing entry rather than allocating up front.
+            for (uint32 i = 0; i < count; ++i) {
+                T entry;
+                if (!reader(entry)) return false;
+                entries.add(entry);
+            }
+            return true;
+        }
+        
+        
+        ////////////////////////////////////////////////////////////////////////
+        // Methods
+        ////////////////////////////////////////////////////////////////////////
+        
+        Error HeapSnapshot::write(std::ostream& out) const {
+            writeSnapshotValue(out, Magic);
+            writeSnapshotValue(out, Version);
+            
+            writeSnapshotSection(out, segments, [&](const Segment& segment) {
+                writeSnapshotValue(out, segment.address);
+                writeSnapshotValue(out, segment.size);
+                writeSnapshotValue(out, segment.usedBytes);
+                writeSnapshotValue(out, segment.flags);
+            });
+            writeSnapshotSection(out, blocks, [&](const Block& block) {
+                writeSnapshotValue(out, block.address);
+                writeSnapshotValue(out, block.totalBytes);
+                writeSnapshotValue(out, block.tableIndex);
+                writeSnapshotValue(out, block.segment);
+                writeSnapshotValue(out, block.flags);
+                writeSnapshotValue(out, block.garbageState);
+                writeSnapshotValue(out, block.age);
+            });
+            writeSnapshotSection(out, records, [&](const Record& record) {
+                writeSnapshotValue(out, record.index);
+                writeSnapshotValue(out, record.generation);
+                writeSnapshotValue(out, record.address);
+            });
+            writeSnapshotSection(out, objects, [&](const ObjectNode& object) {
+                writeSnapshotValue(out, object.tableIndex);
+                writeSnapshotValue(out, object.capacity);
+                writeSnapshotValue(out, object.numProperties);
+                writeSnapshotValue(out, object.firstReference);
+                writeSnapshotValue(out, object.numReferences);
+            });
+            writeSnapshotSection(out, references, [&](const Reference& reference) {
+                writeSnapshotValue(out, reference.propertyId);
+                writeSnapshotValue(out, reference.target);
+            });
+            writeSnapshotSection(out, roots, [&](uint32 root) {
+                writeSnapshotValue(out, root);
+            });
+            
+            if (!out) return GenericError::instance();
+            return NoError::instance();
+        }
+        
+        Error HeapSnapshot::read(std::istream& in) {
+            clear();
+            
+            uint32 magic, version;
+            if (!readSnapshotValue(in, magic) || !readSnapshotValue(in, version) || magic != Magic || version != Version) {
+                return InvalidArgumentError::instance();
+            }
+            
+            const bool complete =
+                readSnapshotSection(in, segments, [&](Segment& segment) {
+                    return readSnapshotValue(in, segment.address)
+                        && readSnapshotValue(in, segment.size)
+                        && readSnapshotValue(in, segment.usedBytes)
+                        && readSnapshotValue(in, segment.flags);
+                })
+                && readSnapshotSection(in, blocks, [&](Block& block) {
+                    return readSnapshotValue(in, block.address)
+                        && readSnapshotValue(in, block.totalBytes)
+                        && readSnapshotValue(in, block.tableIndex)
+                        && readSnapshotValue(in, block.segment)
+                        && readSnapshotValue(in, block.flags)
+                        && readSnapshotValue(in, block.garbageState)
+                        && readSnapshotValue(in, block.age);
+                })
+                && readSnapshotSection(in, records, [&](Record& record) {
+                    return readSnapshotValue(in, record.index)
+                        && readSnapshotValue(in, record.generation)
+                        && readSnapshotValue(in, record.address);
+                })
+                && readSnapshotSection(in, objects, [&](ObjectNode& object) {
+                    return readSnapshotValue(in, object.tableIndex)
+                        && readSnapshotValue(in, object.capacity)
+                        && readSnapshotValue(in, object.numProperties)
+                        && readSnapshotValue(in, object.firstReference)
+                        && readSnapshotValue(in, object.numReferences);
+                })
+                && readSnapshotSection(in, references, [&](Reference& reference) {
+                    return readSnapshotValue(in, reference.propertyId)
+                        && readSnapshotValue(in, reference.target);
+                })
+                && readSnapshotSection(in, roots, [&](uint32& root) {
+                    return readSnapshotValue(in, root);
+                });
+                
+            // References must lie within their section for the analysis to
+            // walk them safely.
+            bool consistent = complete;
+            for (uint32 i = 0; i < objects.length() && consistent; ++i) {
+                const uint64 end = uint64(objects[i].firstReference) + objects[i].numReferences;
+                consistent = end <= references.length();
+            }
+            for (uint32 i = 0; i < blocks.length() && consistent; ++i) {
+                consistent = blocks[i].segment < segments.length();
+            }
+            
+            if (!consistent) {
+                clear();
+                return InvalidArgumentError::instance();
+            }
+            return NoError::instance();
+        }
+        
+        void HeapSnapshot::clear() {
+            segments.clear();
+            blocks.clear();
+            records.clear();
+            objects.clear();
+            references.clear();
+            roots.clear();
+        }
+    }
+}
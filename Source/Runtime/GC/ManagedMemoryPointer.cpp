@@ -14,13 +14,9 @@
 
 namespace Neuro {
     namespace Runtime {
-        void* ManagedMemoryPointerBase::get(uint32 index) const {
-            auto* head = getHeadPointer();
-            if (!head) return nullptr;
-			return (uint8*)(head->getBufferPointer()) + head->elementSize * index;
-        }
+        std::atomic<const std::atomic<ManagedMemoryTablePage*>*> ManagedMemoryPointerBase::residentPages(nullptr);
         
-        ManagedMemoryOverhead* ManagedMemoryPointerBase::getHeadPointer() const {
+        ManagedMemoryOverhead* ManagedMemoryPointerBase::resolveHeadPointer() const {
             void* buffer = GC::instance()->resolve(*this);
             if (!buffer) return nullptr;
             return reinterpret_cast<ManagedMemoryOverhead*>(reinterpret_cast<uint8*>(buffer) - sizeof(ManagedMemoryOverhead));
@@ -5,31 +5,47 @@
 // Implementation assumes the pointers point to a
 // Neuro::Runtime::ManagedMemoryOverhead prefixed buffer.
 // 
-// TODO: Remove empty pages
+// Pages are mapped directly so that released pages can be discarded. Threads
+// still holding a stale index of a released page read undefined links, which
+// is harmless as the tag of the free records changed meanwhile. Handles into
+// released pages remain stale, as the generations of reused pages continue
+// from the highest generation prior to release.
 // -----
 // Copyright (c) Kiruse 2018
 // License: GPL 3.0
 
+#include <algorithm>
 #include <cassert>
 
 #include "Assert.hpp"
-#include "HashCode.hpp"
-#include "Concurrency/ScopeLocks.hpp"
+#include "NeuroBuffer.hpp"
 #include "GC/ManagedMemoryTable.hpp"
 #include "GC/ManagedMemoryOverhead.hpp"
+#include "Platform/Broker.hpp"
 
 namespace Neuro {
     namespace Runtime
     {
-        using namespace Concurrency;
+        uint64 packFreeHead(uint64 head, uint32 index) {
+            return ((head >> 32) + 1) << 32 | index;
+        }
+        
+        /**
+         * Size of a page rounded up to whole pages of the operating system.
+         */
+        size_t getPageBytes() {
+            static const size_t pageMask = Platform::getPageSize() - 1;
+            return (sizeof(ManagedMemoryTablePage) + pageMask) & ~pageMask;
+        }
         
         ManagedMemoryTable::Iterator& ManagedMemoryTable::Iterator::operator++() {
-            const uint32 maxIdx = table->pages.size() * NEURO_MANAGEDMEMORYTABLE_RECORDS_PER_PAGE;
+            const uint32 maxIdx = table->countPages() * NEURO_MANAGEDMEMORYTABLE_RECORDS_PER_PAGE;
             
+            // Skip empty records, testing the bounds before touching the record.
             ManagedMemoryTableRecord* record;
             do {
-                record = table->getRecord(++tableIndex);
-            } while (record->ptr == nullptr && tableIndex < maxIdx);
+                ++tableIndex;
+            } while (tableIndex < maxIdx && (!(record = table->getRecord(tableIndex)) || record->ptr == nullptr));
             
             if (tableIndex >= maxIdx) {
                 tableIndex = npos;
@@ -39,33 +55,38 @@ namespace Neuro {
         }
         
         ManagedMemoryTable::Iterator& ManagedMemoryTable::Iterator::operator--() {
-            const uint32 maxIdx = table->pages.size() * NEURO_MANAGEDMEMORYTABLE_RECORDS_PER_PAGE;
+            const uint32 maxIdx = table->countPages() * NEURO_MANAGEDMEMORYTABLE_RECORDS_PER_PAGE;
+            if (tableIndex > maxIdx) tableIndex = maxIdx;
             
             ManagedMemoryTableRecord* record;
             do {
-                record = table->getRecord(++tableIndex);
-            } while (record->ptr == nullptr && tableIndex < maxIdx);
-            
-            if (tableIndex >= maxIdx) {
-                tableIndex = npos;
-            }
+                --tableIndex;
+            } while (tableIndex != npos && (!(record = table->getRecord(tableIndex)) || record->ptr == nullptr));
             
             return *this;
         }
         
-
+        
         ManagedMemoryTable::ManagedMemoryTable()
-         : shouldExpand(false)
-         , shouldScanGaps(false)
-         , semaphore()
-         , pages(10)
+         : shouldScanGaps(false)
+         , pages(new std::atomic<ManagedMemoryTablePage*>[MaxPages]())
+         , numPages(0)
          , nextRecordIdx(0)
-         , gapsSemaphore()
-         , gaps(nullptr)
-         , numGaps(0)
-         , uidsalt(0)
+         , numRecords(0)
+         , freeHead(npos)
+         , releasedPages()
+         , releasedPagesMutex()
+         , numReleasedPages(0)
         {
-            pages.override_length(pages.size());
+            reservePage(0);
+        }
+        
+        ManagedMemoryTable::~ManagedMemoryTable() {
+            const uint32 count = numPages.load();
+            for (uint32 pageIndex = 0; pageIndex < count; ++pageIndex) {
+                if (auto* page = pages[pageIndex].load()) Platform::unmapPages(page, getPageBytes());
+            }
+            delete[] pages;
         }
         
         
@@ -73,65 +94,62 @@ namespace Neuro {
             ManagedMemoryPointerBase result;
             
             uint32 tableIndex = claimIndex(), pageIndex, recordIndex;
-            Assert::Value("Table index is valid", tableIndex != npos);
+            Assert::Value("Table index is valid", tableIndex < MaxPages * PageSize);
             decomposeTableIndex(tableIndex, pageIndex, recordIndex);
+            if (pageIndex >= MaxPages) return result;
             
-            // Double-checked lock
-            if (pageIndex >= pages.size()) {
-                UniqueLock lock(semaphore);
-                if (pageIndex >= pages.size()) {
-                    pages.resize(pages.size() + 10);
-                    pages.override_length(pages.size());
-                }
-            }
-            
-            const hashT addrHash = calculateHash(addr);
-            const hashT saltHash = calculateHash(uidsalt.fetch_add(1));
-            const hashT uid = combineHashOrdered(addrHash, saltHash);
+            ManagedMemoryTableRecord& record = reservePage(pageIndex)->records[recordIndex];
+            record.ptr = addr;
+            addr->tableIndex = tableIndex;
+            numRecords.fetch_add(1, std::memory_order_relaxed);
             
-            {
-                SharedLock lock(semaphore);
-                ManagedMemoryTableRecord& record = *getRecord(tableIndex);
-                record.ptr = addr;
-                record.uid = uid;
-            }
-            
-            result.tableIndex = tableIndex;
-            result.rowuid = uid;
+            result.setHandle(tableIndex, record.generation);
             return result;
         }
         
         Error ManagedMemoryTable::replacePointer(const ManagedMemoryPointerBase& ptr, ManagedMemoryOverhead* newAddr) {
-            SharedLock lock(semaphore);
-            
-            ManagedMemoryTableRecord& record = *getRecord(ptr.tableIndex);
-            if (record.uid != ptr.rowuid) return NotFoundError::instance();
+            ManagedMemoryTableRecord* record = getRecord(ptr.getTableIndex());
+            if (!record || !record->ptr || record->generation != ptr.getGeneration()) return NotFoundError::instance();
             
-            record.ptr = newAddr;
+            record->ptr = newAddr;
+            newAddr->tableIndex = ptr.getTableIndex();
             return NoError::instance();
         }
         
         Error ManagedMemoryTable::removePointer(const ManagedMemoryPointerBase& ptr) {
-            SharedLock lock(semaphore);
+            ManagedMemoryTableRecord* record = getRecord(ptr.getTableIndex());
+            if (!record || !record->ptr || record->generation != ptr.getGeneration()) return NotFoundError::instance();
             
-            ManagedMemoryTableRecord& record = *getRecord(ptr.tableIndex);
-            if (record.uid != ptr.rowuid) return NotFoundError::instance();
-            
-            record.ptr = nullptr;
-            record.uid = 0;
+            record->ptr = nullptr;
+            ++record->generation;
+            releaseIndices(ptr.getTableIndex(), ptr.getTableIndex());
+            numRecords.fetch_sub(1, std::memory_order_relaxed);
             shouldScanGaps = true;
             return NoError::instance();
         }
         
         void* ManagedMemoryTable::get(const ManagedMemoryPointerBase& ptr) const {
-			auto& tmp = *getRecord(ptr.tableIndex);
-            ManagedMemoryTableRecord& record = *getRecord(ptr.tableIndex);
-            if (record.uid != ptr.rowuid) return nullptr;
-            return reinterpret_cast<uint8*>(record.ptr) + sizeof(ManagedMemoryOverhead);
+            ManagedMemoryOverhead* head = resolveRecord(pages, ptr.getTableIndex(), ptr.getGeneration());
+            return head ? head->getBufferPointer() : nullptr;
+        }
+        
+        ManagedMemoryPointerBase ManagedMemoryTable::getPointer(uint32 tableIndex) const {
+            ManagedMemoryPointerBase result;
+            const ManagedMemoryTableRecord* record = getRecord(tableIndex);
+            if (!record || !record->ptr) return result;
+            
+            result.setHandle(tableIndex, record->generation);
+            return result;
+        }
+        
+        ManagedMemoryTable::Iterator ManagedMemoryTable::begin() const {
+            // Start right before the first record so the increment skips
+            // leading empty records.
+            return ++Iterator(this, npos);
         }
         
         void ManagedMemoryTable::collect(StandardHashSet<ManagedMemoryPointerBase>& pointers) const {
-            pointers.reserve(countRecordsEstimate());
+            pointers.reserve(countRecords());
             
             for (auto ptr : *this) {
                 pointers.add(ptr);
@@ -144,19 +162,53 @@ namespace Neuro {
         ////////////////////////////////////////////////////////////////////////
         // Management
         
-        uint32 ManagedMemoryTable::countRecordsEstimate() const {
-            uint32 max = nextRecordIdx.load();
+        void ManagedMemoryTable::findGaps() {
+            if (!shouldScanGaps.exchange(false)) return;
             
-            SharedLock lock(gapsSemaphore);
-            for (uint32 gapIdx = 0; gapIdx < numGaps; ++gapIdx) {
-                max = max - (gaps[gapIdx].end - gaps[gapIdx].start.load());
+            // Detach the free records entirely. Concurrent claims fail their
+            // exchange on the changed tag, so the detached records are ours.
+            uint64 head = freeHead.load(std::memory_order_acquire);
+            while (static_cast<uint32>(head) != npos && !freeHead.compare_exchange_weak(head, packFreeHead(head, npos), std::memory_order_acquire)) {}
+            
+            Buffer<uint32> detached;
+            for (uint32 index = static_cast<uint32>(head); index != npos; index = getRecord(index)->next) {
+                detached.add(index);
             }
+            if (!detached.length()) return;
+            std::sort(detached.begin(), detached.end());
             
-            return max;
-        }
-        
-        void ManagedMemoryTable::findGaps(uint32 minGapSize) {
-            Assert::notYetImplemented();
+            // Pages entirely made up of detached records cannot be claimed
+            // from, hence can be released.
+            Buffer<uint32> indices(detached.length());
+            for (uint32 i = 0; i < detached.length();) {
+                const uint32 pageIndex = detached[i] / PageSize;
+                uint32 next = i + 1;
+                while (next < detached.length() && detached[next] / PageSize == pageIndex) ++next;
+                
+                if (next - i == PageSize) {
+                    releasePage(pageIndex);
+                }
+                else {
+                    indices.add(detached.data() + i, detached.data() + next);
+                }
+                i = next;
+            }
+            if (!indices.length()) return;
+            
+            // Records right before the unclaimed remainder join it, unless
+            // another record was claimed meanwhile.
+            uint32 end = nextRecordIdx.load();
+            uint32 count = indices.length();
+            while (count && indices[count - 1] == end - (indices.length() - count) - 1) --count;
+            if (count < indices.length() && !nextRecordIdx.compare_exchange_strong(end, indices[count])) {
+                count = indices.length();
+            }
+            if (!count) return;
+            
+            for (uint32 i = 0; i + 1 < count; ++i) {
+                getRecord(indices[i])->next = indices[i + 1];
+            }
+            releaseIndices(indices[0], indices[count - 1]);
         }
         
         
@@ -171,25 +223,91 @@ namespace Neuro {
         ManagedMemoryTableRecord* ManagedMemoryTable::getRecord(uint32 tableIndex) const {
             uint32 pageIndex, recordIndex;
             decomposeTableIndex(tableIndex, pageIndex, recordIndex);
-            Assert::Value("Page and record indices valid", pages.size() > pageIndex && recordIndex < NEURO_MANAGEDMEMORYTABLE_RECORDS_PER_PAGE);
-            auto* that = const_cast<ManagedMemoryTable*>(this);
-            return &that->pages[pageIndex].records[recordIndex];
+            if (pageIndex >= MaxPages) return nullptr;
+            
+            ManagedMemoryTablePage* page = pages[pageIndex].load(std::memory_order_acquire);
+            if (!page) return nullptr;
+            return page->records + recordIndex;
+        }
+        
+        ManagedMemoryTablePage* ManagedMemoryTable::reservePage(uint32 pageIndex) {
+            ManagedMemoryTablePage* page = pages[pageIndex].load(std::memory_order_acquire);
+            if (page) return page;
+            
+            // Several threads may race to allocate the same page. Only one
+            // publishes its page, the others discard theirs.
+            auto* fresh = reinterpret_cast<ManagedMemoryTablePage*>(Platform::mapPages(getPageBytes(), Platform::getPageSize()));
+            Assert::Value("Table page mapped", fresh != nullptr);
+            if (!pages[pageIndex].compare_exchange_strong(page, fresh, std::memory_order_acq_rel, std::memory_order_acquire)) {
+                Platform::unmapPages(fresh, getPageBytes());
+                return page;
+            }
+            
+            uint32 count = numPages.load(std::memory_order_relaxed);
+            while (count <= pageIndex && !numPages.compare_exchange_weak(count, pageIndex + 1, std::memory_order_release, std::memory_order_relaxed)) {}
+            if (count <= pageIndex) onGrow(pageIndex + 1);
+            return fresh;
         }
         
         uint32 ManagedMemoryTable::claimIndex() {
-            // Try to acquire soft lock on gaps semaphore. If unavailable, don't
-            // wait and instead just append to end of table.
-            TrySharedLock lock(gapsSemaphore);
-            
-            if (lock && gaps) {
-                uint32 index = npos;
-                for (uint32 i = 0; i < numGaps; ++i) {
-                    index = gaps[i].claim();
-                    if (index != npos) return index;
-                }
+            uint64 head = freeHead.load(std::memory_order_acquire);
+            while (static_cast<uint32>(head) != npos) {
+                // The link may be stale if the record was claimed meanwhile,
+                // in which case the tag changed as well.
+                const uint32 index = static_cast<uint32>(head);
+                const uint32 next = getRecord(index)->next;
+                if (freeHead.compare_exchange_weak(head, packFreeHead(head, next), std::memory_order_acquire)) return index;
+            }
+            
+            if (numReleasedPages.load(std::memory_order_relaxed)) {
+                const uint32 index = reclaimPage();
+                if (index != npos) return index;
             }
             
             return nextRecordIdx.fetch_add(1);
         }
+        
+        void ManagedMemoryTable::releaseIndices(uint32 first, uint32 last) {
+            ManagedMemoryTableRecord& record = *getRecord(last);
+            uint64 head = freeHead.load(std::memory_order_relaxed);
+            do {
+                record.next = static_cast<uint32>(head);
+            } while (!freeHead.compare_exchange_weak(head, packFreeHead(head, first), std::memory_order_release, std::memory_order_relaxed));
+        }
+        
+        void ManagedMemoryTable::releasePage(uint32 pageIndex) {
+            ManagedMemoryTablePage* page = pages[pageIndex].load(std::memory_order_relaxed);
+            uint32 generation = 0;
+            for (const auto& record : page->records) {
+                generation = std::max(generation, record.generation);
+            }
+            Platform::discardPages(page, getPageBytes());
+            
+            std::scoped_lock lock(releasedPagesMutex);
+            releasedPages.add(ReleasedPage{ pageIndex, generation });
+            numReleasedPages.fetch_add(1, std::memory_order_relaxed);
+        }
+        
+        uint32 ManagedMemoryTable::reclaimPage() {
+            ReleasedPage released;
+            {
+                std::scoped_lock lock(releasedPagesMutex);
+                if (!releasedPages.length()) return npos;
+                released = releasedPages.last();
+                releasedPages.drop();
+                numReleasedPages.fetch_sub(1, std::memory_order_relaxed);
+            }
+            
+            // Discarded memory is undefined, hence rebuild every record.
+            ManagedMemoryTableRecord* records = pages[released.index].load(std::memory_order_acquire)->records;
+            const uint32 first = released.index * PageSize;
+            for (uint32 i = 0; i < PageSize; ++i) {
+                records[i].ptr = nullptr;
+                records[i].generation = released.generation;
+                records[i].next = first + i + 1;
+            }
+            releaseIndices(first + 1, first + PageSize - 1);
+            return first;
+        }
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,92 @@
+////////////////////////////////////////////////////////////////////////////////
+// Implementation of the GC's mark bitmap.
+// -----
+// Copyright (c) Kiruse 2018
+// License: GPL 3.0
+#include <algorithm>
+
+#include "GC/MarkBitmap.hpp"
+#include "Misc.hpp"
+
+namespace Neuro {
+    namespace Runtime
+    {
+        MarkBitmap::MarkBitmap()
+         : words(nullptr)
+         , numWordsAllocated(0)
+         , numBits(0)
+        {}
+        
+        MarkBitmap::~MarkBitmap() {
+            delete[] words;
+        }
+        
+        
+        void MarkBitmap::reset(uint32 numRecords) {
+            numBits = 0;
+            resize(numRecords);
+        }
+        
+        void MarkBitmap::resize(uint32 numRecords) {
+            const uint32 numWords = (numRecords + BitsPerWord - 1) / BitsPerWord;
+            const uint32 numOldWords = countWords();
+            
+            // Grow geometrically as the table grows in steps of a few pages.
+            if (numWords > numWordsAllocated) {
+                const uint32 numAlloc = std::max(numWords, numWordsAllocated * 2);
+                auto* newWords = new std::atomic<uint64>[numAlloc];
+                for (uint32 i = 0; i < numOldWords; ++i) {
+                    newWords[i].store(getWord(i), std::memory_order_relaxed);
+                }
+                
+                delete[] words;
+                words = newWords;
+                numWordsAllocated = numAlloc;
+            }
+            
+            // The previous padding may cover actual records now.
+            const uint32 oldUsed = numBits % BitsPerWord;
+            if (oldUsed && numOldWords <= numWords) {
+                words[numOldWords - 1].fetch_and(~(~uint64(0) << oldUsed), std::memory_order_relaxed);
+            }
+            for (uint32 i = numOldWords; i < numWords; ++i) {
+                words[i].store(0, std::memory_order_relaxed);
+            }
+            numBits = numRecords;
+            
+            // Permanently mark the padding of the last word.
+            const uint32 used = numRecords % BitsPerWord;
+            if (used) {
+                words[numWords - 1].fetch_or(~uint64(0) << used, std::memory_order_relaxed);
+            }
+        }
+        
+        void MarkBitmap::merge(const MarkBitmap& other) {
+            const uint32 numWords = std::min(countWords(), other.countWords());
+            const uint32 otherUsed = other.numBits % BitsPerWord;
+            
+            for (uint32 i = 0; i < numWords; ++i) {
+                uint64 bits = other.getWord(i);
+                
+                // Don't mistake the other bitmap's padding for marks.
+                if (otherUsed && i == other.countWords() - 1) {
+                    bits &= ~(~uint64(0) << otherUsed);
+                }
+                words[i].fetch_or(bits, std::memory_order_relaxed);
+            }
+        }
+        
+        uint32 MarkBitmap::countMarked() const {
+            const uint32 numWords = countWords();
+            uint32 count = 0;
+            for (uint32 i = 0; i < numWords; ++i) {
+                count += countSetBits(getWord(i));
+            }
+            
+            // Discount the padding of the last word.
+            const uint32 used = numBits % BitsPerWord;
+            if (used) count -= BitsPerWord - used;
+            return count;
+        }
+    }
+}
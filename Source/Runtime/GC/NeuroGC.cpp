@@ -3,28 +3,116 @@
 // 
 //   Object Management Lifecycle
 // 
-// Whenever a Neuro::Value is reassigned and it previously contained a pointer
-// to a managed object, said managed object is flagged for scanning.
+// Whenever a managed pointer is stored into a Neuro::Value, a write barrier
+// dirties the card of the memory segment containing the Value.
 // 
-// The GC will then in the next Scanning Phase trace the roots until it finds at
-// least one living pointer to the object.
+// The GC traces the roots in the next Scanning Phase until it finds at least
+// one living pointer to any object. Objects without such a pointer are flagged
+// as garbage and will be collected in the next Sweep Phase.
 // 
-// If no such pointer is found, the object is flagged as garbage and will be
-// collected in the next Sweep Phase.
+// Explicit collections end with a Compact Phase which slides surviving memory
+// towards the beginning of its segment. Since managed pointers only ever refer
+// to their table record, moving a block merely requires updating that single
+// record; no pointers scattered across managed memory need to be touched.
+// Blocks moved onto an overlapping location take a detour through a temporary
+// staging block so that the table never refers to partially overwritten memory.
+// Newborns and blocks which cannot be moved stay put, and segments left entirely
+// empty are retired until the next compaction. Mutators may hold native
+// pointers into managed memory between safepoints, hence compaction first
+// stops every registered mutator at a safepoint, and is skipped for the cycle
+// if they do not get there in time. Unregistered threads must be idle. The
+// background thread's cycles compact as well unless background compaction is
+// turned off, as only the compactor ages and promotes memory.
 // 
-// Sweeping may trigger a Compact Phase, which is a rather complicated algorithm.
-// At the beginning of the compaction, objects will be predetermined for
-// relocation. Next, these objects are moved to their new assigned location and
-// the old overhead is updated to redirect indirection resolutions of the
-// ManagedMemoryPointer. This rule is in place to avoid stopping the world just
-// to update an unknown number old pointers scattered across the entire managed
-// memory. Instead, we can now update pointers at our own leisure. New pointers
-// to the old data (e.g. through copying) are immediately redirected to point to
-// the new address.
+// The heap is split into two generations. New memory is bump-allocated in the
+// nursery, and memory surviving a few cycles there is promoted into dormant
+// segments of the old generation by the compactor. Most cycles are minor
+// cycles, which consider the old generation reached up front and trace only the
+// young generation from the roots and the old objects on dirty cards, i.e. old
+// objects which may refer to young memory. Cards are dirtied by the write
+// barrier and by promotion, and cleaned again after every cycle unless they
+// still hold a pointer to young memory. Every so often a major cycle collects
+// the entire heap.
 // 
-// Currently, the garbage collector supports managing native types within limits.
-// Native types are not consulted when tracing objects, their pointers are merely
-// weak pointers that can be updated after registering them.
+// Threads allocate nursery memory from their own allocation buffers, chunks of
+// a segment reserved with a single compare-exchange, by bumping a pointer
+// without any synchronization. The unused remainder of a buffer is covered by
+// a swept filler block so that the segment remains walkable. Compaction
+// invalidates all buffers by advancing the allocation epoch.
+// 
+// Between compactions, swept nursery memory is reused in place. Every sweep
+// merges adjacent garbage and hands it to segregated free lists by size class.
+// Allocations first take a block of the right size class off these lists, and
+// buffers are refilled from large free blocks before fresh segment memory is
+// bumped, so cycles which do not compact reclaim memory nonetheless.
+// 
+// Nursery garbage is swept lazily. The sweep phase merely queues it in groups
+// of limited size, each within a single segment, and an allocation missing the
+// free lists sweeps the next group before looking again. Buffers are refilled
+// from fresh segment memory only once no garbage is left to sweep. Sweeping is
+// thus spread across allocations rather than adding to the cycle. Compaction
+// sweeps the remainder up front, spread across the workers, while garbage of
+// the old generation and large objects is swept right away. Non-trivial garbage
+// is destroyed in batches per type, and so is all remaining memory upon
+// teardown.
+// 
+// Memory above the large object threshold bypasses the segments altogether.
+// Each such block is mapped into a large object region of its own, which is
+// never moved, promoted in place, and unmapped as soon as its block is swept.
+// Neither compaction nor promotion ever copies multi-megabyte buffers.
+// 
+// Segments are carved out of a single reservation of address space. Their pages
+// are committed on creation and decommitted as soon as compaction retires them,
+// and the pages a compaction empties at the end of surviving segments are
+// discarded, so the heap shrinks back after a load spike.
+// 
+// Cycles run on the GC's background thread. The thread sleeps until either the
+// scan interval elapses or the number of bytes allocated since the last cycle
+// crosses the allocation threshold, whichever happens first. Mutators keep
+// running meanwhile, and may move a reference out of an object yet to be traced
+// into one traced already. The nursery's cards are cleaned when the scan starts,
+// hence such stores dirty them anew. Newborns on the cleaned cards are traced
+// along with the roots since they are spared whether reached or not. The scan
+// concludes with the mutators stopped at a safepoint, rescanning the roots and
+// the objects on dirty cards until a rescan reaches nothing new. If the
+// mutators cannot be stopped in time, the cycle frees no memory.
+// 
+// Hosts bound to frame deadlines may drive incremental cycles instead, which
+// advance by a time budget per step. Incremental marking traces gray objects
+// off a deque of its own. Since mutators run between steps, marking concludes
+// with an uninterrupted rescan of the roots and of the objects on dirty cards
+// until a rescan reaches nothing new. Garbage is then swept in batches.
+// 
+// Every cycle records the durations of its phases into latency histograms, and
+// explicit collections and incremental steps record how long they blocked the
+// host. Live bytes are derived from the segments' allocation pointers less the
+// free blocks, so that no cycle needs to walk the heap just for statistics.
+// 
+// Optionally, the GC records timestamped events of its phases, of segment
+// creation, table growth and reallocations into a lock-free ring buffer, which
+// is dumped in the Chrome trace format to line GC activity up against the
+// host's own timeline. Disabled tracing costs a single atomic load per event.
+// 
+// Allocations are sampled on demand, roughly every so many bytes, capturing the
+// backtrace and the allocation site labelled by the host. The aggregated samples
+// are written as pprof profiles to find out who churns through memory.
+// 
+// For offline analysis, the GC dumps snapshots of the heap: its segments, the
+// headers of all blocks, the table records and the property graph of all
+// objects. The NeuroHeap tool derives retained sizes, property distributions
+// and fragmentation from them, so production processes need not be debugged.
+// 
+// Marking is parallelized across a configurable number of workers. Each worker
+// traces objects off its own Chase-Lev deque and steals from its siblings when
+// its own deque runs dry, so that wide as well as deep object graphs keep all
+// workers busy. Reached memory is recorded in a bitmap with one bit per table
+// record, and garbage is found by scanning that bitmap for unset bits. The
+// workers run the rescans of background cycles as well, a few while the
+// mutators are still running, and the final remark once they are stopped.
+// 
+// Native types are traced precisely through the pointer maps registered with
+// their type descriptors, which list the offsets of their managed pointers.
+// Pointers a native type does not declare are merely weak pointers.
 // 
 // TODO: Track which objects are commonly used together and group them up.
 // TODO: Track memory use over the past x minutes in an attempt to predict
@@ -32,13 +120,19 @@
 // -----
 // Copyright (c) Kiruse 2018
 // License: GPL 3.0
+#include <algorithm>
 #include <chrono>
+#include <limits>
 #include <utility>
+#include <cstdlib>
 #include <cstring>
+#include <fstream>
+#include <unordered_set>
 
 #include "GC/NeuroGC.h"
 #include "GC/NeuroGC.hpp"
 #include "GC/Queue.hpp"
+#include "Platform/Broker.hpp"
 
 #include "NeuroString.hpp"
 #include "NeuroValue.hpp"
@@ -52,33 +146,99 @@ namespace Neuro {
         std::mutex gcMainInstanceMutex;
         GCInterface* gcMainInstance = nullptr;
         
+        /**
+         * Chunk of a nursery segment reserved by a single thread, which it
+         * allocates from without synchronization. The unused remainder of the
+         * chunk is always covered by a swept filler block.
+         */
+        struct AllocationBuffer {
+            const GC* owner = nullptr;
+            uint64 epoch = 0;
+            
+            /**
+             * Segment the chunk was reserved in. Refills resume here, as the
+             * segments before it were full at that time already.
+             */
+            ManagedMemorySegment* segment = nullptr;
+            uint8* cursor = nullptr;
+            uint8* end = nullptr;
+        };
+        
+        /**
+         * Every thread keeps one buffer for trivial and one for non-trivial
+         * memory. Buffers of a different GC or an earlier epoch are stale.
+         */
+        thread_local AllocationBuffer localBuffers[2];
+        std::atomic<uint64> allocationEpoch(1);
+        
+        /**
+         * Adds the time elapsed during its lifetime to the given duration.
+         */
+        struct PhaseTimer {
+            std::chrono::nanoseconds& duration;
+            const std::chrono::steady_clock::time_point start;
+            
+            PhaseTimer(std::chrono::nanoseconds& duration) : duration(duration), start(std::chrono::steady_clock::now()) {}
+            PhaseTimer(const PhaseTimer&) = delete;
+            PhaseTimer& operator=(const PhaseTimer&) = delete;
+            ~PhaseTimer() {
+                duration += std::chrono::steady_clock::now() - start;
+            }
+        };
+        
+        /**
+         * Records a span spanning its lifetime into the given trace buffer,
+         * if any.
+         */
+        struct TraceScope {
+            TraceBuffer* const tracer;
+            const char* const name;
+            
+            TraceScope(TraceBuffer* tracer, const char* name, const char* argName = nullptr, uint64 arg = 0) : tracer(tracer), name(name) {
+                if (tracer) tracer->begin(name, argName, arg);
+            }
+            TraceScope(const TraceScope&) = delete;
+            TraceScope& operator=(const TraceScope&) = delete;
+            ~TraceScope() {
+                if (tracer) tracer->end(name);
+            }
+        };
+        
         
         ////////////////////////////////////////////////////////////////////////
         // Local Forward Declarations
         ////////////////////////////////////////////////////////////////////////
         
-        ManagedMemorySegment* createSegment(uint32 minSize);
+        ManagedMemorySegment* createSegment(SegmentHeap& heap, uint32 minSize, bool dormant = false);
+        void destroySegment(SegmentHeap& heap, ManagedMemorySegment* segment);
         void appendSegment(ManagedMemorySegment* segment, ManagedMemorySegment* chain);
         bool segmentContainsHead(ManagedMemorySegment* segment, ManagedMemoryOverhead* head);
         
+        LargeObjectRegion* createLargeObjectRegion(uint32 minSize);
+        void destroyLargeObjectRegion(LargeObjectRegion* region);
+        LargeObjectRegion* getLargeObjectRegion(ManagedMemoryOverhead* head);
+        
         ManagedMemoryOverhead* getFirstOverhead(ManagedMemorySegment* segment);
         ManagedMemoryOverhead* getNextOverhead(ManagedMemoryOverhead* head);
         
+        void moveBlock(ManagedMemoryOverhead* from, ManagedMemoryOverhead* to, bool trivial);
+        void makeFiller(void* addr, uint32 bytes, bool trivial);
+        void destroyBlocks(Buffer<ManagedMemoryOverhead*>& heads);
+        
         
         ////////////////////////////////////////////////////////////////////////
         // GCInterface
         ////////////////////////////////////////////////////////////////////////
         
-        ManagedMemoryPointerBase GCInterface::makePointer(uint32 index, hashT hash) {
+        ManagedMemoryPointerBase GCInterface::makePointer(uint32 index, uint32 generation) {
             ManagedMemoryPointerBase pointer;
-            pointer.tableIndex = index;
-            pointer.rowuid = hash;
+            pointer.setHandle(index, generation);
             return pointer;
         }
         
-        void GCInterface::extractPointerData(ManagedMemoryPointerBase pointer, uint32& index, hashT& hash) {
-            index = pointer.tableIndex;
-            hash  = pointer.rowuid;
+        void GCInterface::extractPointerData(ManagedMemoryPointerBase pointer, uint32& index, uint32& generation) {
+            index      = pointer.getTableIndex();
+            generation = pointer.getGeneration();
         }
         
         
@@ -90,54 +250,149 @@ namespace Neuro {
          : scannersMutex()
          , rootsMutex()
          , markedObjectsMutex()
+         , markersMutex()
+         , cycleMutex()
+         , cycleNotif()
+         , collectMutex()
          , terminate(false)
+         , cycleRequested(false)
+         , majorCycleRequested(false)
          , backgroundThread()
          , scanners()
+         , segmentHeap(NEURO_GC_HEAP_RESERVE)
          , dataTable()
-         , firstTrivialMemSeg(createSegment(2048))
-         , firstNonTrivialMemSeg(createSegment(512))
+         , firstTrivialMemSeg(createSegment(segmentHeap, 2048))
+         , firstNonTrivialMemSeg(createSegment(segmentHeap, 512))
+         , firstDormantTrivialMemSeg(createSegment(segmentHeap, 2048, true))
+         , firstDormantNonTrivialMemSeg(createSegment(segmentHeap, 512, true))
+         , trivialFreeBlocks()
+         , nonTrivialFreeBlocks()
+         , unsweptMutex()
+         , unsweptBlocks()
+         , unsweptGroups()
+         , numUnsweptGroups()
+         , unsweptBytes(0)
+         , largeObjectsMutex()
+         , firstLargeObject(nullptr)
+         , largeObjectThreshold(NEURO_GC_LARGE_OBJECT_THRESHOLD)
          , roots()
          , markedObjects()
+         , retiredSegments()
+         , stagingBuffers()
+         , dyingMutex()
+         , recentlyDying()
+         , dyingBlocks()
          , scanInterval(std::chrono::seconds(3))
+         , safepointTimeout(NEURO_GC_SAFEPOINT_TIMEOUT)
+         , backgroundCompaction(true)
+         , allocatedSinceCycle(0)
+         , allocationThreshold(NEURO_GC_ALLOCATION_THRESHOLD)
+         , allocatedBeforeCycle(0)
+         , promotionAge(NEURO_GC_PROMOTION_AGE)
+         , majorCycleInterval(NEURO_GC_MAJOR_CYCLE_INTERVAL)
+         , cyclesSinceMajor(0)
+         , majorCycle(false)
+         , markers(std::max(1u, std::thread::hardware_concurrency() / 2))
+         , markDeques(new Concurrency::WorkStealingDeque<ManagedMemoryOverhead*>[markers.count()])
+         , numActiveMarkers(0)
+         , numTracedBlocks(0)
+         , marks()
+         , dormantRecords()
+         , incrementalPhase(EIncrementalPhase::Idle)
+         , incrementalGray()
+         , statsMutex()
+         , stats()
+         , cycleScanTime(0)
+         , cycleSweepTime(0)
+         , cycleCompactTime(0)
+         , unreclaimedBytes(0)
+         , tracingMutex()
+         , traceBuffer()
+         , tracer(nullptr)
+         , profilingMutex()
+         , allocationProfiler()
+         , profiler(nullptr)
         {
             // Add our default Object scanner.
             scanners.add(ScannerDelegate::MethodDelegate<GC, &GC::scanForObjects>(this));
             
+            dataTable.onGrow.add(Delegate<void, uint32>::MethodDelegate<GC, &GC::traceTableGrowth>(this));
+            segmentHeap.onAllocate.add(Delegate<void, size_t>::MethodDelegate<GC, &GC::traceSegmentAllocation>(this));
+            
             // Start up the main thread
             backgroundThread = std::thread(Delegate<void>::MethodDelegate<GC, &GC::threadMain>(this));
         }
         
         GC::~GC() {
-            terminate = true;
+            {
+                std::scoped_lock lock(cycleMutex);
+                terminate = true;
+            }
+            cycleNotif.notify_all();
             backgroundThread.join();
             terminate = false; // Should the GC be restarted afterwards we need to make sure it won't shut down immediately again.
             
+            // Another GC may be constructed at our address later on, which must
+            // not mistake our threads' allocation buffers for its own.
+            allocationEpoch.fetch_add(1, std::memory_order_acq_rel);
+            
             // Trivial memory is easy to clean up. Just free everything in batches!
-            ManagedMemorySegment* curr = firstTrivialMemSeg;
-            while (curr) {
-                ManagedMemorySegment* next = curr->next;
-                std::free(curr);
-                curr = next;
+            for (auto* chain : { firstTrivialMemSeg, firstDormantTrivialMemSeg }) {
+                ManagedMemorySegment* curr = chain;
+                while (curr) {
+                    ManagedMemorySegment* next = curr->next;
+                    destroySegment(segmentHeap, curr);
+                    curr = next;
+                }
             }
-            firstTrivialMemSeg = nullptr;
+            firstTrivialMemSeg = firstDormantTrivialMemSeg = nullptr;
             
             // Non-trivial memory is harder to clean up. All valid memory sections
-            // must be cleaned up individually!
-            curr = firstNonTrivialMemSeg;
-            while (curr) {
-                ManagedMemorySegment* next = curr->next;
-                
-                // First allocated object is always immediately behind the
-                // segment overhead.
-                ManagedMemoryOverhead* head = reinterpret_cast<ManagedMemoryOverhead*>(reinterpret_cast<uint8*>(curr) + sizeof(ManagedMemoryOverhead));
-                if (head->destroyDelegate) {
-                    head->destroyDelegate.get()(head->getBufferPointer());
+            // must be cleaned up individually! The workers destroy a segment
+            // at a time, batching the destructors of each type.
+            Buffer<ManagedMemorySegment*> segments;
+            for (auto* chain : { firstNonTrivialMemSeg, firstDormantNonTrivialMemSeg }) {
+                for (auto* segment = chain; segment; segment = segment->next) {
+                    segments.add(segment);
                 }
-                
-                std::free(curr);
-                curr = next;
             }
-            firstNonTrivialMemSeg = nullptr;
+            
+            std::atomic<uint32> nextSegment(0);
+            auto destroySegments = [&](uint32) {
+                Buffer<ManagedMemoryOverhead*> heads;
+                for (uint32 index = nextSegment.fetch_add(1); index < segments.length(); index = nextSegment.fetch_add(1)) {
+                    // Swept memory was already destroyed.
+                    heads.clear();
+                    for (auto* head : SegmentBlocks(segments[index])) {
+                        if (head->garbageState != EGarbageState::Swept && head->typeId) heads.add(head);
+                    }
+                    destroyBlocks(heads);
+                }
+            };
+            {
+                std::scoped_lock lock(markersMutex);
+                markers.run(Concurrency::WorkerPool::JobDelegate::fromLambda(destroySegments));
+            }
+            
+            for (auto* segment : segments) {
+                destroySegment(segmentHeap, segment);
+            }
+            firstNonTrivialMemSeg = firstDormantNonTrivialMemSeg = nullptr;
+            
+            // Large objects likewise, but each of them has a region of its own.
+            while (firstLargeObject) {
+                LargeObjectRegion* next = firstLargeObject->next;
+                auto* head = firstLargeObject->getHead();
+                auto* type = head->getType();
+                if (!head->isTrivial && head->garbageState != EGarbageState::Swept && type) {
+                    type->destroy(head->getBufferPointer());
+                }
+                destroyLargeObjectRegion(firstLargeObject);
+                firstLargeObject = next;
+            }
+            
+            // Retired segments contain no live memory anymore.
+            releaseRetired();
         }
         
         
@@ -145,11 +400,14 @@ namespace Neuro {
         // Managed Memory Segment Helpers
         ////////////////////////////////////////////////////////////////////////
         
-        ManagedMemorySegment* createSegment(uint32 minSize) {
-            const uint32 size = std::max<uint32>(sizeof(ManagedMemorySegment) + minSize, 2 * 1024 * 1024); // At least 2MB
+        ManagedMemorySegment* createSegment(SegmentHeap& heap, uint32 minSize, bool dormant) {
+            // Segments occupy entire regions of the card tables' region map,
+            // i.e. at least 2MB.
+            const uint32 regionMask = CardTable::RegionSize - 1;
+            const uint32 size = (sizeof(ManagedMemorySegment) + minSize + regionMask) & ~regionMask;
             
             // TODO: Optimize the sizes of the chunks of memory based on recent memory usage!
-            void* newMemory = std::malloc(size);
+            void* newMemory = heap.allocate(size);
             if (!newMemory) return nullptr;
             
             auto* segment = reinterpret_cast<ManagedMemorySegment*>(newMemory);
@@ -158,11 +416,55 @@ namespace Neuro {
             segment->compacting = false;
             segment->ptr = reinterpret_cast<uint8*>(segment) + sizeof(ManagedMemorySegment);
             segment->size = size;
-            segment->dormant = false;
+            segment->dormant = dormant;
+            
+            new (&segment->cards) CardTable();
+            if (!segment->cards.attach(segment, size)) {
+                destroySegment(heap, segment);
+                return nullptr;
+            }
             
             return segment;
         }
         
+        void destroySegment(SegmentHeap& heap, ManagedMemorySegment* segment) {
+            segment->cards.~CardTable();
+            heap.free(segment, segment->size);
+        }
+        
+        LargeObjectRegion* createLargeObjectRegion(uint32 minSize) {
+            // Like segments, regions occupy entire regions of the card tables'
+            // region map. Pages beyond the block are never touched.
+            const size_t regionMask = CardTable::RegionSize - 1;
+            const size_t size = (sizeof(LargeObjectRegion) + size_t(minSize) + regionMask) & ~regionMask;
+            if (size > std::numeric_limits<uint32>::max()) return nullptr;
+            
+            void* newMemory = Platform::mapPages(size, CardTable::RegionSize);
+            if (!newMemory) return nullptr;
+            
+            auto* region = reinterpret_cast<LargeObjectRegion*>(newMemory);
+            region->prev = nullptr;
+            region->next = nullptr;
+            region->size = size;
+            
+            new (&region->cards) CardTable();
+            if (!region->cards.attach(region, static_cast<uint32>(size))) {
+                destroyLargeObjectRegion(region);
+                return nullptr;
+            }
+            
+            return region;
+        }
+        
+        void destroyLargeObjectRegion(LargeObjectRegion* region) {
+            region->cards.~CardTable();
+            Platform::unmapPages(region, region->size);
+        }
+        
+        LargeObjectRegion* getLargeObjectRegion(ManagedMemoryOverhead* head) {
+            return reinterpret_cast<LargeObjectRegion*>(head) - 1;
+        }
+        
         void appendSegment(ManagedMemorySegment* segment, ManagedMemorySegment* chain) {
             ManagedMemorySegment* compare = nullptr;
             while (!chain->next.compare_exchange_strong(compare, segment)) {
@@ -172,9 +474,12 @@ namespace Neuro {
         }
         
         bool segmentContainsHead(ManagedMemorySegment* segment, ManagedMemoryOverhead* head) {
-            const intptr_t nSegment = reinterpret_cast<intptr_t>(segment),
-                           nHead    = reinterpret_cast<intptr_t>(head);
-            return nSegment < nHead && nHead + head->elementSize * head->count + sizeof(ManagedMemoryOverhead) < nSegment + segment->size;
+            const uint8* first = reinterpret_cast<uint8*>(getFirstOverhead(segment));
+            const uint8* addr  = reinterpret_cast<uint8*>(head);
+            
+            // Only memory up to the allocation pointer has been handed out.
+            if (addr < first || addr + sizeof(ManagedMemoryOverhead) > segment->ptr) return false;
+            return addr + head->getTotalBytes() <= segment->ptr;
         }
         
         ManagedMemoryOverhead* getFirstOverhead(ManagedMemorySegment* segment) {
@@ -185,7 +490,63 @@ namespace Neuro {
         }
         
         ManagedMemoryOverhead* getNextOverhead(ManagedMemoryOverhead* head) {
-            return reinterpret_cast<ManagedMemoryOverhead*>(reinterpret_cast<uint8*>(head) + head->elementSize * head->count);
+            return reinterpret_cast<ManagedMemoryOverhead*>(reinterpret_cast<uint8*>(head) + sizeof(ManagedMemoryOverhead) + head->elementSize * head->count);
+        }
+        
+        /**
+         * Moves a block to a location it does not overlap with. Non-trivial
+         * memory is copy constructed at the target and destroyed at the
+         * source, trivial memory is copied including its overhead.
+         */
+        void moveBlock(ManagedMemoryOverhead* from, ManagedMemoryOverhead* to, bool trivial) {
+            if (trivial) {
+                std::memcpy(to, from, from->getTotalBytes());
+                return;
+            }
+            
+            new (to) ManagedMemoryOverhead(from->elementSize, from->count);
+            to->isTrivial = false;
+            to->garbageState = from->garbageState;
+            to->age = from->age;
+            to->isDormant = from->isDormant;
+            to->tableIndex = from->tableIndex;
+            to->typeId = from->typeId;
+            
+            auto* type = from->getType();
+            type->copy(to->getBufferPointer(), from->getBufferPointer());
+            type->destroy(from->getBufferPointer());
+        }
+        
+        /**
+         * Turns the given range of bytes into a single swept block, which
+         * walkers skip and the compactor slides over.
+         */
+        void makeFiller(void* addr, uint32 bytes, bool trivial) {
+            auto* filler = new (addr) ManagedMemoryOverhead(1, bytes - sizeof(ManagedMemoryOverhead));
+            filler->isTrivial = trivial;
+            filler->garbageState = EGarbageState::Swept;
+        }
+        
+        /**
+         * Destroys the given non-trivial blocks, invoking the destructors of
+         * each type in a single batch. Sorts the blocks by type, and by
+         * address within each type.
+         */
+        void destroyBlocks(Buffer<ManagedMemoryOverhead*>& heads) {
+            std::sort(heads.begin(), heads.end(), [](const ManagedMemoryOverhead* a, const ManagedMemoryOverhead* b) {
+                return a->typeId != b->typeId ? a->typeId < b->typeId : a < b;
+            });
+            
+            Buffer<void*> targets;
+            uint32 index = 0;
+            while (index < heads.length()) {
+                const uint16 typeId = heads[index]->typeId;
+                targets.clear();
+                while (index < heads.length() && heads[index]->typeId == typeId) {
+                    targets.add(heads[index++]->getBufferPointer());
+                }
+                if (typeId) TypeTable::get(typeId).destroyBatch(targets.data(), targets.length());
+            }
         }
         
         
@@ -193,64 +554,235 @@ namespace Neuro {
         // Allocation
         ////////////////////////////////////////////////////////////////////////
         
-        uint8* allocate_inner(ManagedMemorySegment* chain, uint32 size) {
+        /**
+         * Reserves up to `desired`, but at least `minSize` bytes at the end of
+         * the segment's used memory. Returns nullptr if the segment is being
+         * compacted or too full.
+         */
+        uint8* reserveChunk(ManagedMemorySegment* segment, uint32 minSize, uint32 desired, uint32& reserved) {
+            uint8* const end = reinterpret_cast<uint8*>(segment) + segment->size;
+            uint8* addr = segment->ptr.load();
+            do {
+                if (segment->compacting || addr + minSize > end) return nullptr;
+                reserved = static_cast<uint32>(std::min<uintptr_t>(desired, end - addr));
+            } while (!segment->ptr.compare_exchange_weak(addr, addr + reserved));
+            return addr;
+        }
+        
+        /**
+         * Shrinks the free block to `bytes` bytes, returning the remainder to
+         * the free lists unless it is too small to hold any memory.
+         */
+        void splitFreeBlock(FreeLists& freeBlocks, ManagedMemoryOverhead* block, uint32 bytes, bool trivial) {
+            const uint32 remainder = block->getTotalBytes() - bytes;
+            if (!remainder) return;
+            
+            auto* rest = reinterpret_cast<ManagedMemoryOverhead*>(reinterpret_cast<uint8*>(block) + bytes);
+            makeFiller(rest, remainder, trivial);
+            if (remainder > sizeof(ManagedMemoryOverhead)) freeBlocks.add(rest);
+        }
+        
+        /**
+         * Refills the allocation buffer from a large swept block, large enough
+         * for at least `minSize` bytes. Returns the number of bytes reserved,
+         * or 0 if there is no such block.
+         */
+        uint32 refillFromFreeBlocks(AllocationBuffer& buffer, FreeLists& freeBlocks, uint32 minSize, bool trivial) {
+            // Blocks too small to be worth a buffer are left to allocations of
+            // their own size class.
+            auto* block = freeBlocks.takeAtLeast(std::max<uint32>(minSize, NEURO_GC_ALLOCATION_BUFFER_SIZE / 4));
+            if (!block) return 0;
+            
+            uint32 reserved = std::min<uint32>(block->getTotalBytes(), NEURO_GC_ALLOCATION_BUFFER_SIZE);
+            if (!FreeLists::fits(block, reserved)) reserved = block->getTotalBytes();
+            splitFreeBlock(freeBlocks, block, reserved, trivial);
+            
+            makeFiller(block, reserved, trivial);
+            buffer.cursor = reinterpret_cast<uint8*>(block);
+            buffer.end = buffer.cursor + reserved;
+            return reserved;
+        }
+        
+        /**
+         * Reserves a new chunk of fresh segment memory for the allocation
+         * buffer, large enough for at least `minSize` bytes. Returns the
+         * number of bytes reserved, or 0 if no memory could be obtained.
+         */
+        uint32 refillBuffer(SegmentHeap& heap, AllocationBuffer& buffer, ManagedMemorySegment* chain, uint32 minSize, bool trivial) {
+            uint32 reserved = 0;
+            uint8* chunk = nullptr;
+            
+            ManagedMemorySegment* segment = buffer.segment;
+            while (segment && !(chunk = reserveChunk(segment, minSize, NEURO_GC_ALLOCATION_BUFFER_SIZE, reserved))) {
+                segment = segment->next;
+            }
+            
+            // Nobody else knows about a new segment before it is appended.
+            if (!segment) {
+                segment = createSegment(heap, std::max<uint32>(minSize, NEURO_GC_ALLOCATION_BUFFER_SIZE), chain->dormant);
+                if (!segment) return 0;
+                chunk = reserveChunk(segment, minSize, NEURO_GC_ALLOCATION_BUFFER_SIZE, reserved);
+                appendSegment(segment, chain);
+            }
+            
+            makeFiller(chunk, reserved, trivial);
+            buffer.segment = segment;
+            buffer.cursor = chunk;
+            buffer.end = chunk + reserved;
+            return reserved;
+        }
+        
+        /**
+         * Allocates memory for `count` elements of `elementSize` bytes in the
+         * given chain of segments. The overhead is constructed while the
+         * segment is still locked so that the compactor never encounters a
+         * half-initialized block.
+         */
+        ManagedMemoryOverhead* allocate_inner(SegmentHeap& heap, ManagedMemorySegment* chain, uint32 elementSize, uint32 count) {
+            const uint32 size = sizeof(ManagedMemoryOverhead) + elementSize * count;
+            
             // Attempt to find a memory segment that has enough capacity for us still.
             ManagedMemorySegment* segment = chain;
             uint8* addr = nullptr;
             
             while (segment && !addr) {
-                // Lock the segment!
-                // Uses a spinlock since we don't anticipate at most a few hundred nanoseconds until the lock is released again.
-                ManagedMemorySegment::Lock{segment};
-                
-                // Compaction takes a while, so just move on.
-                // If the memory can't hold the requested size, move on too.
-                if (segment->compacting || (segment->ptr + size > reinterpret_cast<uint8*>(segment) + segment->size)) {
-                    segment = segment->next;
-                }
-                else {
-                    addr = segment->ptr;
-                    segment->ptr += size;
+                {
+                    // Lock the segment!
+                    // Uses a spinlock since we don't anticipate at most a few hundred nanoseconds until the lock is released again.
+                    ManagedMemorySegment::Lock lock(segment);
+                    
+                    // Compaction takes a while, so just move on.
+                    // If the memory can't hold the requested size, move on too.
+                    uint32 reserved;
+                    addr = reserveChunk(segment, size, size, reserved);
+                    if (addr) new (addr) ManagedMemoryOverhead(elementSize, count);
                 }
+                
+                if (!addr) segment = segment->next;
             }
             
             // If no suitable segment was found, we need to create a new one.
             if (!segment) {
                 // Create segment with at least `size` bytes.
-                segment = createSegment(size);
+                segment = createSegment(heap, size, chain->dormant);
                 
                 // Failed to allocate memory chunk!
                 if (!segment) return nullptr;
                 
                 addr = segment->ptr;
-                segment->ptr += size;
+                segment->ptr = addr + size;
+                new (addr) ManagedMemoryOverhead(elementSize, count);
                 appendSegment(segment, chain);
             }
             
-            return addr;
+            return reinterpret_cast<ManagedMemoryOverhead*>(addr);
+        }
+        
+        ManagedMemoryOverhead* GC::allocateNursery(bool trivial, uint32 elementSize, uint32 count) {
+            const uint32 size = sizeof(ManagedMemoryOverhead) + elementSize * count;
+            ManagedMemorySegment* chain = trivial ? firstTrivialMemSeg : firstNonTrivialMemSeg;
+            FreeLists& freeBlocks = trivial ? trivialFreeBlocks : nonTrivialFreeBlocks;
+            
+            if (size > largeObjectThreshold.load(std::memory_order_relaxed)) {
+                return allocateLarge(elementSize, count);
+            }
+            
+            // Swept memory of the right size class is reused before bumping.
+            // Garbage of the last cycle is swept lazily, one group per
+            // allocation missing the free lists.
+            auto* block = freeBlocks.take(size);
+            if (!block && sweepNextGroup(trivial)) block = freeBlocks.take(size);
+            if (block) {
+                splitFreeBlock(freeBlocks, block, size, trivial);
+                trackAllocation(size);
+                return new (block) ManagedMemoryOverhead(elementSize, count);
+            }
+            
+            // Large memory would use up most of a buffer at once.
+            if (size > NEURO_GC_ALLOCATION_BUFFER_SIZE / 4) {
+                auto* head = allocate_inner(segmentHeap, chain, elementSize, count);
+                if (head) trackAllocation(size);
+                return head;
+            }
+            
+            // Compaction may have slid memory over stale buffers.
+            AllocationBuffer& buffer = localBuffers[trivial];
+            const uint64 epoch = allocationEpoch.load(std::memory_order_acquire);
+            if (buffer.owner != this || buffer.epoch != epoch) {
+                buffer = AllocationBuffer{ this, epoch, chain, nullptr, nullptr };
+            }
+            
+            // The remainder of the buffer must either be used up entirely or
+            // fit a filler block.
+            const uint32 remaining = static_cast<uint32>(buffer.end - buffer.cursor);
+            if (size != remaining && size + sizeof(ManagedMemoryOverhead) > remaining) {
+                // The filler covering the remainder is free for the taking.
+                if (remaining > sizeof(ManagedMemoryOverhead)) {
+                    freeBlocks.add(reinterpret_cast<ManagedMemoryOverhead*>(buffer.cursor));
+                }
+                buffer.cursor = buffer.end = nullptr;
+                
+                // Large swept blocks are preferred over fresh segment memory,
+                // hence garbage is swept until it yields one or none is left.
+                const uint32 minSize = size + sizeof(ManagedMemoryOverhead);
+                uint32 reserved = refillFromFreeBlocks(buffer, freeBlocks, minSize, trivial);
+                while (!reserved && sweepNextGroup(trivial)) {
+                    reserved = refillFromFreeBlocks(buffer, freeBlocks, minSize, trivial);
+                }
+                if (!reserved) reserved = refillBuffer(segmentHeap, buffer, chain, minSize, trivial);
+                if (!reserved) return nullptr;
+                trackAllocation(reserved);
+            }
+            
+            uint8* addr = buffer.cursor;
+            buffer.cursor += size;
+            if (buffer.cursor != buffer.end) {
+                makeFiller(buffer.cursor, static_cast<uint32>(buffer.end - buffer.cursor), trivial);
+            }
+            return new (addr) ManagedMemoryOverhead(elementSize, count);
+        }
+        
+        ManagedMemoryOverhead* GC::allocateLarge(uint32 elementSize, uint32 count) {
+            const uint32 size = sizeof(ManagedMemoryOverhead) + elementSize * count;
+            LargeObjectRegion* region = createLargeObjectRegion(size);
+            if (!region) return nullptr;
+            if (auto* tracer = getTracer()) tracer->instant("MapLargeObject", "bytes", region->size);
+            
+            // The block is not linked into the object graph yet, hence it is
+            // skipped until it ages even though it is visible to the GC now.
+            auto* head = new (region->getHead()) ManagedMemoryOverhead(elementSize, count);
+            head->isLarge = true;
+            {
+                std::scoped_lock lock(largeObjectsMutex);
+                region->next = firstLargeObject;
+                if (firstLargeObject) firstLargeObject->prev = region;
+                firstLargeObject = region;
+            }
+            
+            trackAllocation(size);
+            return head;
         }
         
         ManagedMemoryPointerBase GC::allocateTrivial(uint32 elementSize, uint32 count) {
             // Actually allocate the buffer.
-            auto* head = reinterpret_cast<ManagedMemoryOverhead*>(allocate_inner(firstTrivialMemSeg, sizeof(ManagedMemoryOverhead) + elementSize * count));
+            auto* head = allocateNursery(true, elementSize, count);
             
-            // Create the overhead & initialize with data
-            new (head) ManagedMemoryOverhead(elementSize, count);
+            // Initialize the overhead with data
             head->isTrivial = true;
+            if (auto* profiler = getProfiler()) profiler->allocated(head->getTotalBytes());
             
             // Return a managed pointer wrapper.
             return dataTable.addPointer(head);
         }
         
-        ManagedMemoryPointerBase GC::allocateNonTrivial(uint32 elementSize, uint32 count, const Delegate<void, void*, const void*>& copyDelegate, const Delegate<void, void*>& destroyDelegate) {
+        ManagedMemoryPointerBase GC::allocateNonTrivial(uint32 elementSize, uint32 count, uint16 typeId) {
             // Actually allocate the buffer.
-            auto* head = reinterpret_cast<ManagedMemoryOverhead*>(allocate_inner(firstNonTrivialMemSeg, sizeof(ManagedMemoryOverhead) + elementSize * count));
+            auto* head = allocateNursery(false, elementSize, count);
             
-            // Create the overhead & populate with data
-            new (head) ManagedMemoryOverhead(elementSize, count);
+            // Populate the overhead with data
             head->isTrivial = false;
-            copyDelegate.copyTo(&head->copyDelegate.get());
-            destroyDelegate.copyTo(&head->destroyDelegate.get());
+            head->typeId = typeId;
+            if (auto* profiler = getProfiler()) profiler->allocated(head->getTotalBytes());
             
             // Return a managed pointer wrapper.
             return dataTable.addPointer(head);
@@ -258,24 +790,69 @@ namespace Neuro {
         
         Error GC::reallocate(ManagedMemoryPointerBase ptr, uint32 elementSize, uint32 count, bool autocopy) {
             auto* oldHead = ptr.getHeadPointer();
-            auto* newHead = reinterpret_cast<ManagedMemoryOverhead*>(allocate_inner(oldHead->isTrivial ? firstTrivialMemSeg : firstNonTrivialMemSeg, sizeof(ManagedMemoryOverhead) + elementSize * count));
+            TraceScope trace(getTracer(), "Reallocate", "bytes", sizeof(ManagedMemoryOverhead) + elementSize * count);
+            auto* newHead = allocateReplacement(oldHead, elementSize, count);
             
-            new (newHead) ManagedMemoryOverhead(elementSize, count);
-            newHead->isTrivial = oldHead->isTrivial;
-            if (newHead->isTrivial) {
-                if (autocopy) {
+            if (autocopy) {
+                if (oldHead->isTrivial) {
                     // IMPORTANT: circumstances predict that new buffer cannot intersect with old buffer, hence
                     // DO NOT use memmove as it comes with a small performance penalty!
                     std::memcpy(newHead->getBufferPointer(), oldHead->getBufferPointer(), oldHead->elementSize * oldHead->count);
                 }
+                else {
+                    oldHead->getType()->copy(newHead->getBufferPointer(), oldHead->getBufferPointer());
+                }
+            }
+            
+            return publishReplacement(ptr, oldHead, newHead);
+        }
+        
+        Error GC::reallocate(ManagedMemoryPointerBase ptr, uint32 elementSize, uint32 count, const ReallocateDelegate& construct) {
+            auto* oldHead = ptr.getHeadPointer();
+            TraceScope trace(getTracer(), "Reallocate", "bytes", sizeof(ManagedMemoryOverhead) + elementSize * count);
+            auto* newHead = allocateReplacement(oldHead, elementSize, count);
+            construct(newHead->getBufferPointer(), oldHead->getBufferPointer());
+            return publishReplacement(ptr, oldHead, newHead);
+        }
+        
+        ManagedMemoryOverhead* GC::allocateReplacement(ManagedMemoryOverhead* oldHead, uint32 elementSize, uint32 count) {
+            // Memory of the old generation stays there, as its referrers are
+            // not tracked and hence could not keep it alive in the nursery.
+            // Large memory is old as soon as it is flagged dormant below.
+            const uint32 size = sizeof(ManagedMemoryOverhead) + elementSize * count;
+            ManagedMemoryOverhead* newHead;
+            if (oldHead->isDormant && size <= largeObjectThreshold.load(std::memory_order_relaxed)) {
+                newHead = allocate_inner(segmentHeap, oldHead->isTrivial ? firstDormantTrivialMemSeg : firstDormantNonTrivialMemSeg, elementSize, count);
+                trackAllocation(newHead->getTotalBytes());
             }
             else {
-                oldHead->copyDelegate.get().copyTo(&newHead->copyDelegate.get());
-                oldHead->destroyDelegate.get().copyTo(&newHead->destroyDelegate.get());
-                
-                if (autocopy) {
-                    newHead->copyDelegate.get()(newHead->getBufferPointer(), oldHead->getBufferPointer());
-                }
+                newHead = allocateNursery(oldHead->isTrivial, elementSize, count);
+            }
+            
+            newHead->isTrivial = oldHead->isTrivial;
+            newHead->isDormant = oldHead->isDormant;
+            newHead->age = oldHead->age;
+            if (auto* profiler = getProfiler()) profiler->allocated(size);
+            return newHead;
+        }
+        
+        Error GC::publishReplacement(ManagedMemoryPointerBase ptr, ManagedMemoryOverhead* oldHead, ManagedMemoryOverhead* newHead) {
+            // Card scans may come across the new memory any time, but only
+            // trace it once it is flagged an Object or typed.
+            newHead->typeId = oldHead->typeId;
+            newHead->isObject = oldHead->isObject;
+            
+            // The old memory may still be read by the caller. The next cycle
+            // but one sweeps it, unless the compactor reclaims it first.
+            oldHead->garbageState = EGarbageState::Dying;
+            {
+                std::scoped_lock lock(dyingMutex);
+                recentlyDying.add(oldHead);
+            }
+            
+            // The copied memory may refer to young memory.
+            if (newHead->isDormant) {
+                writeBarrier(newHead->getBufferPointer(), newHead->elementSize * newHead->count);
             }
             
             return dataTable.replacePointer(ptr, newHead);
@@ -287,13 +864,13 @@ namespace Neuro {
         ////////////////////////////////////////////////////////////////////////
         
         Error GC::root(Pointer obj) {
-            std::scoped_lock{rootsMutex};
+            std::scoped_lock lock(rootsMutex);
             roots.add(obj);
             return NoError::instance();
         }
         
         Error GC::unroot(Pointer obj) {
-            std::scoped_lock{rootsMutex};
+            std::scoped_lock lock(rootsMutex);
             roots.remove(obj);
             return NoError::instance();
         }
@@ -309,164 +886,1456 @@ namespace Neuro {
         ////////////////////////////////////////////////////////////////////////
         
         void GC::threadMain() {
-            uint32 marks = 0;
-            
-            // Use of .load() method should make it clear to the compiler to
-            // not optimize the loop condition away.
             while (!terminate.load()) {
-				// std::this_thread::sleep_for(scanInterval);
-                // marks += scan();
-                // if (marks) {
-                //     sweep();
-                //     compact();
-                //     marks = 0;
-                // }
+                {
+                    // Sleep until the scan interval elapses, unless an allocation
+                    // burst or an explicit request wakes us up early. The
+                    // interval may be changed while we sleep.
+                    std::unique_lock<std::mutex> lock(cycleMutex);
+                    const auto start = std::chrono::steady_clock::now();
+                    while (!terminate.load() && !cycleRequested.load() && allocatedSinceCycle.load() < allocationThreshold.load()) {
+                        if (std::chrono::steady_clock::now() >= start + scanInterval) break;
+                        cycleNotif.wait_until(lock, start + scanInterval);
+                    }
+                }
+                
+                if (terminate.load()) break;
+                cycle(backgroundCompaction.load(), false);
             }
         }
         
-        
-        ////////////////////////////////////////////////////////////////////////
-        // Scan Phase
-        ////////////////////////////////////////////////////////////////////////
-        
-        uint32 GC::scan() {
-            StandardHashSet<ManagedMemoryPointerBase> garbage;
-            dataTable.collect(garbage);
-            scanners(garbage);
-            return garbage.count();
-        }
-        
-        void GC::scanForObjects(StandardHashSet<ManagedMemoryPointerBase>& scans) {
-            Buffer<Pointer> processList;
+        void GC::cycle(bool compacting, bool major) {
+            auto lock = lockCollection();
+            TraceBuffer* tracer = getTracer();
+            TraceScope trace(tracer, "Cycle", "compacting", compacting);
             
-            // Start with scanning roots first.
-            {
-                std::scoped_lock{rootsMutex};
-                processList = roots;
+            // The host drives incremental cycles. Explicit collections complete
+            // them though, as compaction relies on their marks.
+            if (incrementalPhase != EIncrementalPhase::Idle) {
+                if (!compacting) {
+                    allocatedBeforeCycle += allocatedSinceCycle.exchange(0);
+                    cycleRequested = false;
+                    return;
+                }
+                advanceIncremental(std::chrono::steady_clock::time_point::max());
             }
-            
-            // Set of objects we've already visited. Avoids cyclic references
-            // resulting in infinite loops.
-            StandardHashSet<Pointer> visited(processList.begin(), processList.end());
-            uint32 numScans = scans.count();
-            
-            // Iterate through the roots and attempt to find at least one
-            // reference to the flagged objects.
-            while (processList.length()) {
-                Pointer curr = processList.first();
-                processList.splice(0);
-                
-                for (Property& prop : *curr) {
-                    if (prop.value.isManagedObject()) {
-                        Pointer other = prop.value.getManagedObject();
-                        
-                        // Remove from trace list, if it is in it!
-                        scans.remove(other);
-                        
-                        // If we've found at least one reference to all trace targets, we're done for good.
-                        if (!--numScans) return;
-                        
-                        // Only process the found object once per phase.
-                        if (!visited.contains(other)) {
-                            processList.add(other);
-                            visited.add(other);
-                        }
-                    }
+            else {
+                beginCycle(major);
+                {
+                    PhaseTimer timer(cycleScanTime);
+                    TraceScope trace(tracer, "Scan", "major", majorCycle);
+                    scan();
+                }
+                {
+                    PhaseTimer timer(cycleSweepTime);
+                    TraceScope trace(tracer, "Sweep");
+                    sweep();
                 }
             }
             
-            // Remove the pointers from the pointer table
-            for (auto garbage : scans) {
-                dataTable.removePointer(garbage);
+            // Compaction also ages the survivors, promotes them, and reclaims
+            // reallocated memory, hence it runs even if no garbage was found.
+            // But since mutators may hold native pointers into managed memory
+            // at any time, it may only run while they are stopped at a
+            // safepoint. If they cannot be stopped in time, compaction waits
+            // for the next cycle.
+            bool stopped = false;
+            if (compacting) {
+                {
+                    // Compaction only slides memory over swept blocks. The
+                    // mutators may help until they are stopped.
+                    PhaseTimer timer(cycleSweepTime);
+                    TraceScope trace(tracer, "Sweep");
+                    finishSweep();
+                }
+                TraceScope trace(tracer, "Safepoint");
+                const auto start = std::chrono::steady_clock::now();
+                stopped = Safepoints::stop(std::chrono::microseconds(safepointTimeout.load(std::memory_order_relaxed)));
+                recordSafepoint(std::chrono::steady_clock::now() - start, stopped, true);
+            }
+            if (stopped) {
+                {
+                    PhaseTimer timer(cycleCompactTime);
+                    TraceScope trace(tracer, "Compact");
+                    compact();
+                }
+                Safepoints::resume();
+            }
+            {
+                TraceScope trace(tracer, "RefineCards");
+                refineCards();
             }
+            finishCycle(stopped);
+        }
+        
+        void GC::beginCycle(bool major) {
+            allocatedBeforeCycle += allocatedSinceCycle.exchange(0);
+            cycleRequested = false;
+            cycleScanTime = cycleSweepTime = cycleCompactTime = std::chrono::nanoseconds(0);
             
+            // Most cycles only collect the nursery. Every so often, the entire
+            // heap is collected to find garbage in the old generation as well.
+            majorCycle = major || majorCycleRequested.exchange(false) || cyclesSinceMajor + 1 >= majorCycleInterval;
+            cyclesSinceMajor = majorCycle ? 0 : cyclesSinceMajor + 1;
+        }
+        
+        void GC::finishCycle(bool compacted) {
+            // Free blocks and garbage awaiting its sweep or compaction do not
+            // count as live, whereas the segments are considered used up to
+            // their pointers.
+            uint64 liveBytes = 0;
+            uint32 numNurserySegments = 0, numDormantSegments = 0, numLargeObjects = 0;
+            for (auto* chain : { firstTrivialMemSeg, firstNonTrivialMemSeg, firstDormantTrivialMemSeg, firstDormantNonTrivialMemSeg }) {
+                for (auto* segment = chain; segment; segment = segment->next) {
+                    liveBytes += segment->ptr.load() - reinterpret_cast<uint8*>(getFirstOverhead(segment));
+                    ++(segment->dormant ? numDormantSegments : numNurserySegments);
+                }
+            }
+            const uint64 freeBytes = trivialFreeBlocks.countBytes() + nonTrivialFreeBlocks.countBytes() + unreclaimedBytes + unsweptBytes.load(std::memory_order_relaxed);
+            liveBytes -= std::min(liveBytes, freeBytes);
             {
-                std::scoped_lock{markedObjectsMutex};
-                markedObjects.add(scans.begin(), scans.end());
+                std::scoped_lock lock(largeObjectsMutex);
+                for (auto* region = firstLargeObject; region; region = region->next) {
+                    if (region->getHead()->garbageState != EGarbageState::Swept) liveBytes += region->getHead()->getTotalBytes();
+                    ++numLargeObjects;
+                }
             }
+            
+            std::scoped_lock lock(statsMutex);
+            ++stats.numCycles;
+            if (majorCycle) ++stats.numMajorCycles;
+            stats.liveBytes = liveBytes;
+            stats.numNurserySegments = numNurserySegments;
+            stats.numDormantSegments = numDormantSegments;
+            stats.numLargeObjects = numLargeObjects;
+            
+            stats.lastScan = cycleScanTime;
+            stats.lastSweep = cycleSweepTime;
+            stats.lastCompact = cycleCompactTime;
+            stats.scanTimes.record(cycleScanTime);
+            stats.sweepTimes.record(cycleSweepTime);
+            if (compacted) stats.compactTimes.record(cycleCompactTime);
         }
         
+        void GC::recordPause(std::chrono::nanoseconds duration) {
+            std::scoped_lock lock(statsMutex);
+            stats.pauseTimes.record(duration);
+        }
         
-        ////////////////////////////////////////////////////////////////////////
-        // Sweep Phase
-        ////////////////////////////////////////////////////////////////////////
+        void GC::recordSafepoint(std::chrono::nanoseconds duration, bool stopped, bool compacting) {
+            std::scoped_lock lock(statsMutex);
+            stats.safepointTimes.record(duration);
+            if (!stopped) ++(compacting ? stats.numSkippedCompactions : stats.numSkippedCollections);
+        }
         
-        void GC::sweep() {
-            sweep(true);
-            sweep(false);
+        std::unique_lock<std::mutex> GC::lockCollection() {
+            std::unique_lock<std::mutex> lock(collectMutex, std::defer_lock);
+            if (lock.try_lock()) return lock;
+            
+            // The cycle in progress may need to stop the world.
+            SafeRegion region;
+            lock.lock();
+            return lock;
         }
         
-        void GC::sweep(bool trivial) {
-            Buffer<ManagedMemoryPointerBase> processList, oldMarked;
-            {
-                std::scoped_lock{markedObjectsMutex};
-                oldMarked = std::move(markedObjects);
-                processList = oldMarked;
-            }
+        void GC::traceTableGrowth(uint32 numPages) {
+            if (auto* tracer = getTracer()) tracer->instant("GrowTable", "pages", numPages);
+        }
+        
+        void GC::traceSegmentAllocation(size_t bytes) {
+            if (auto* tracer = getTracer()) tracer->instant("CreateSegment", "bytes", bytes);
+        }
+        
+        void GC::trackAllocation(uint32 bytes) {
+            const uint64 threshold = allocationThreshold.load();
+            const uint64 before = allocatedSinceCycle.fetch_add(bytes);
             
-            // Clean up the data, distinguishing between trivial and non-trivial data.
-            while (processList.length()) {
-                auto pointer = processList.first();
-                processList.splice(0);
-                
-                auto* head = GC::getOverhead(pointer);
-                
-                // Call non-trivial memory's destruction delegate.
-                if (!trivial) {
-                    head->destroyDelegate.get()(pointer.get());
-                }
-                
-                head->garbageState = EGarbageState::Swept;
+            // Only the allocation crossing the threshold notifies the thread.
+            // Briefly acquiring the mutex ensures the wake-up cannot slip in
+            // between the thread testing the predicate and going to sleep.
+            if (before < threshold && before + bytes >= threshold) {
+                { std::scoped_lock lock(cycleMutex); }
+                cycleNotif.notify_one();
             }
         }
         
         
         ////////////////////////////////////////////////////////////////////////
-        // Compaction Phase
+        // Scan Phase
         ////////////////////////////////////////////////////////////////////////
         
         /**
-         * Find the first swept managed memory overhead in the given segment
-         * starting at `start`.
+         * Tests whether the GC traces the given memory, i.e. whether it is an
+         * Object or of a native type with managed pointers.
          */
-        ManagedMemoryOverhead* findSwept(ManagedMemorySegment* segment, ManagedMemoryOverhead* start) {
-            auto* head = start;
-            while (segmentContainsHead(segment, head) && head->garbageState != EGarbageState::Swept) head = getNextOverhead(head);
-            if (!segmentContainsHead(segment, head)) return nullptr;
-            return head;
+        bool isTraced(const ManagedMemoryOverhead* head) {
+            if (head->isObject) return true;
+            const TypeDescriptor* type = head->getType();
+            return type && type->hasPointers();
         }
         
         /**
-         * Find the first unswept managed memory overhead in the given segment
-         * starting at `start`.
+         * Invokes the callback with every block of the given segment which
+         * overlaps any of the given dirty cards, in ascending order.
          */
-        ManagedMemoryOverhead* findUnswept(ManagedMemorySegment* segment, ManagedMemoryOverhead* start) {
-            auto* head = start;
-            while (segmentContainsHead(segment, head) && head->garbageState == EGarbageState::Swept) head = getNextOverhead(head);
-            if (!segmentContainsHead(segment, head)) return nullptr;
-            return head;
+        template<typename Callback>
+        void forEachOnCards(ManagedMemorySegment* segment, const Buffer<uint32>& dirty, Callback callback) {
+            // Memory allocated from here on is not constructed yet.
+            uint8* end;
+            {
+                ManagedMemorySegment::Lock lock(segment);
+                end = segment->ptr;
+            }
+            
+            // Both the blocks and the dirty cards are in ascending order.
+            uint32 cursor = 0;
+            for (auto* head : SegmentBlocks(segment, end)) {
+                if (cursor >= dirty.length()) break;
+                
+                const uint32 lastCard = segment->cards.getCardIndex(reinterpret_cast<uint8*>(head) + head->getTotalBytes() - 1);
+                if (dirty[cursor] > lastCard) continue;
+                
+                const uint32 firstCard = segment->cards.getCardIndex(head);
+                while (cursor < dirty.length() && dirty[cursor] < firstCard) ++cursor;
+                if (cursor < dirty.length() && dirty[cursor] <= lastCard) callback(head);
+            }
         }
         
-        void GC::compact() {
-            compact(true);
-            compact(false);
+        uint32 GC::scan() {
+            resetMarks();
+            {
+                std::scoped_lock lock(scannersMutex);
+                scanners(marks);
+            }
+            if (!finishMark()) return 0;
+            return collectGarbage();
         }
         
-        void GC::compact(bool trivial) {
-            ManagedMemorySegment* sourceSegment = trivial ? firstTrivialMemSeg : firstNonTrivialMemSeg;
-            ManagedMemorySegment* targetSegment = nullptr;
+        bool GC::finishMark() {
+            // Mutators kept running while we traced, and may have moved
+            // references out of objects yet to be traced into objects traced
+            // already, or into newborns. Their stores dirtied the cards of the
+            // latter, which are hence rescanned with the mutators stopped. If
+            // they cannot be stopped in time, the cycle keeps all memory.
+            TraceScope trace(getTracer(), "Remark");
+            const auto start = std::chrono::steady_clock::now();
+            WorldStop stop(std::chrono::microseconds(safepointTimeout.load(std::memory_order_relaxed)));
+            recordSafepoint(std::chrono::steady_clock::now() - start, !!stop, false);
+            if (!stop) return false;
             
-            // TODO
+            std::scoped_lock lock(markersMutex);
+            while (!rescan());
+            return true;
         }
         
-        
-        ////////////////////////////////////////////////////////////////////////////
-        // Low Level API
-        ////////////////////////////////////////////////////////////////////////////
-        
-        Error GC::registerMemoryScanner(const Delegate<void, StandardHashSet<ManagedMemoryPointerBase>&>& scanner) {
-            scanners += scanner;
-            return NoError::instance();
+        void GC::cleanNurseryCards(Buffer<ManagedMemoryOverhead*>& newborns) {
+            // Only stores into young memory from here on are of interest to
+            // the rescans. The old generation's cards are left alone as they
+            // also track pointers to young memory. Newborns are spared whether
+            // reached or not, hence so must be the memory they refer to. The
+            // ones stored into before are found on the cards cleaned here.
+            Buffer<uint32> dirty;
+            for (auto* chain : { firstTrivialMemSeg, firstNonTrivialMemSeg }) {
+                for (auto* segment = chain; segment; segment = segment->next) {
+                    if (!segment->cards.takeDirty(dirty)) continue;
+                    forEachOnCards(segment, dirty, [&](ManagedMemoryOverhead* head) {
+                        if (!head->age && head->garbageState == EGarbageState::Live && isTraced(head)) newborns.add(head);
+                    });
+                    dirty.clear();
+                }
+            }
+            
+            std::scoped_lock lock(largeObjectsMutex);
+            for (auto* region = firstLargeObject; region; region = region->next) {
+                auto* head = region->getHead();
+                if (head->isDormant || !region->cards.takeDirty(dirty)) continue;
+                if (!head->age && head->garbageState == EGarbageState::Live && isTraced(head)) newborns.add(head);
+                dirty.clear();
+            }
+        }
+        
+        void GC::resetMarks() {
+            const uint32 numRecords = dataTable.countPages() * NEURO_MANAGEDMEMORYTABLE_RECORDS_PER_PAGE;
+            marks.reset(numRecords);
+            dormantRecords.resize(numRecords);
+            
+            // Minor cycles consider the old generation reached up front. It
+            // is neither traced nor collected.
+            if (!majorCycle) {
+                marks.merge(dormantRecords);
+            }
+        }
+        
+        uint32 GC::collectGarbage() {
+            // Whatever no scanner marked is unreachable, except for memory
+            // allocated since the previous cycle which is spared once as it
+            // may not have been linked into the graph yet. Heads need to be
+            // resolved before their table records are released.
+            Buffer<ManagedMemoryPointerBase> garbage;
+            Buffer<ManagedMemoryOverhead*> heads;
+            const uint32 numWords = marks.countWords();
+            for (uint32 wordIndex = 0; wordIndex < numWords; ++wordIndex) {
+                uint64 unmarked = ~marks.getWord(wordIndex);
+                while (unmarked) {
+                    const uint32 tableIndex = wordIndex * MarkBitmap::BitsPerWord + countTrailingZeros(unmarked);
+                    unmarked &= unmarked - 1;
+                    
+                    ManagedMemoryPointerBase pointer = dataTable.getPointer(tableIndex);
+                    if (!pointer) continue;
+                    auto* head = GC::getOverhead(pointer);
+                    
+                    if (!head->age) {
+                        head->age = 1;
+                        continue;
+                    }
+                    
+                    if (head->isDormant) {
+                        dormantRecords.unmark(tableIndex);
+                    }
+                    
+                    head->garbageState = EGarbageState::Marked;
+                    garbage.add(pointer);
+                    heads.add(head);
+                }
+            }
+            for (auto& pointer : garbage) {
+                dataTable.removePointer(pointer);
+            }
+            dataTable.findGaps();
+            
+            // Reallocated memory which has been dying for an entire cycle is
+            // no longer read, and swept just like garbage. Cycles which do not
+            // compact would otherwise never reclaim it.
+            {
+                std::scoped_lock lock(dyingMutex);
+                for (auto* head : dyingBlocks) {
+                    head->garbageState = EGarbageState::Marked;
+                    heads.add(head);
+                }
+                dyingBlocks.clear();
+                dyingBlocks.add(recentlyDying.begin(), recentlyDying.end());
+                recentlyDying.clear();
+            }
+            
+            {
+                std::scoped_lock lock(markedObjectsMutex);
+                markedObjects.add(heads.begin(), heads.end());
+            }
+            return heads.length();
+        }
+        
+        /**
+         * Collects the live objects and native blocks with pointers of the
+         * given chain of segments which overlap dirty cards.
+         */
+        void collectDirtyObjects(ManagedMemorySegment* chain, Buffer<ManagedMemoryOverhead*>& blocks) {
+            for (auto* segment = chain; segment; segment = segment->next) {
+                if (!segment->cards.anyDirty()) continue;
+                
+                // Memory allocated from here on is not constructed yet.
+                uint8* end;
+                {
+                    ManagedMemorySegment::Lock lock(segment);
+                    end = segment->ptr;
+                }
+                
+                for (auto* head : SegmentBlocks(segment, end)) {
+                    if (head->garbageState == EGarbageState::Live && isTraced(head) && segment->cards.isDirty(head, head->getTotalBytes())) {
+                        blocks.add(head);
+                    }
+                }
+            }
+        }
+        
+        void GC::collectDirtyLargeObjects(Buffer<ManagedMemoryOverhead*>& blocks, bool includeYoung) {
+            std::scoped_lock lock(largeObjectsMutex);
+            for (auto* region = firstLargeObject; region; region = region->next) {
+                auto* head = region->getHead();
+                if (head->garbageState == EGarbageState::Live && (head->isDormant || includeYoung) && isTraced(head) && region->cards.anyDirty()) {
+                    blocks.add(head);
+                }
+            }
+        }
+        
+        void GC::scanForObjects(MarkBitmap&) {
+            // Incremental cycles trace the objects step by step, and merely
+            // consult the other scanners once done.
+            if (incrementalPhase == EIncrementalPhase::Marking) return;
+            mark();
+        }
+        
+        void GC::mark() {
+            std::scoped_lock lock(markersMutex);
+            
+            Buffer<Pointer> rootsCopy;
+            {
+                std::scoped_lock lock(rootsMutex);
+                rootsCopy = roots;
+            }
+            
+            // Old objects on dirty cards may refer to young memory, hence are
+            // roots of minor cycles. They are reached already and thus seeded
+            // without marking them, just like the newborns stored into.
+            Buffer<ManagedMemoryOverhead*> dirtyObjects;
+            cleanNurseryCards(dirtyObjects);
+            if (!majorCycle) {
+                collectDirtyObjects(firstDormantTrivialMemSeg, dirtyObjects);
+                collectDirtyObjects(firstDormantNonTrivialMemSeg, dirtyObjects);
+                collectDirtyLargeObjects(dirtyObjects);
+            }
+            
+            // Objects allocated after the bitmap was reset are never marked,
+            // but they are newborns and hence spared by the current cycle.
+            for (auto& root : rootsCopy) {
+                if (!marks.mark(root)) continue;
+                if (auto* head = getOverhead(root)) dirtyObjects.add(head);
+            }
+            traceInParallel(dirtyObjects);
+            
+            // Most stores racing the trace are caught up with while the
+            // mutators are still running, so the final remark has little left
+            // to do with the world stopped. Mutators storing newborns faster
+            // than we rescan would keep us from concluding though, hence the
+            // number of passes is limited.
+            for (uint32 pass = 0; pass < 4 && !rescan(); ++pass);
+        }
+        
+        uint32 GC::traceInParallel(const Buffer<ManagedMemoryOverhead*>& blocks) {
+            // Distribute the blocks evenly as initial work.
+            const uint32 numWorkers = markers.count();
+            uint32 next = 0;
+            for (auto* head : blocks) {
+                markDeques[next++ % numWorkers].push(head);
+            }
+            
+            numActiveMarkers = numWorkers;
+            numTracedBlocks = 0;
+            markers.run(Concurrency::WorkerPool::JobDelegate::MethodDelegate<GC, &GC::markWorker>(this));
+            return numTracedBlocks.load();
+        }
+        
+        bool GC::rescan() {
+            // A rescan which reaches nothing beyond the rescanned objects
+            // concludes marking.
+            Buffer<ManagedMemoryOverhead*> objects;
+            collectRescanObjects(objects);
+            return traceInParallel(objects) == objects.length();
+        }
+        
+        void GC::markWorker(uint32 workerIndex) {
+            auto& own = markDeques[workerIndex];
+            ManagedMemoryOverhead* head;
+            uint32 traced = 0;
+            
+            while (true) {
+                while (own.pop(head) || stealMarkWork(workerIndex, head)) {
+                    markBlock(own, head);
+                    ++traced;
+                }
+                
+                // Out of work. Only active workers push new work, so once no
+                // worker is active anymore, the entire graph has been traced.
+                numActiveMarkers.fetch_sub(1);
+                bool resumed = false;
+                while (!resumed) {
+                    if (numActiveMarkers.load() == 0) {
+                        numTracedBlocks.fetch_add(traced);
+                        return;
+                    }
+                    
+                    bool hasWork = false;
+                    for (uint32 i = 0; i < markers.count() && !hasWork; ++i) {
+                        hasWork = !markDeques[i].empty();
+                    }
+                    if (!hasWork) {
+                        std::this_thread::yield();
+                        continue;
+                    }
+                    
+                    // Announce ourselves as active again before stealing so
+                    // our siblings don't terminate while we trace the object.
+                    numActiveMarkers.fetch_add(1);
+                    if (stealMarkWork(workerIndex, head)) {
+                        markBlock(own, head);
+                        ++traced;
+                        resumed = true;
+                    }
+                    else {
+                        numActiveMarkers.fetch_sub(1);
+                        std::this_thread::yield();
+                    }
+                }
+            }
+        }
+        
+        void GC::markBlock(Concurrency::WorkStealingDeque<ManagedMemoryOverhead*>& deque, ManagedMemoryOverhead* head) {
+            // Objects are allocated as trivial memory, hence never have a type.
+            if (head->typeId) markNative(deque, head, TypeTable::get(head->typeId));
+            else markObject(deque, reinterpret_cast<Object*>(head->getBufferPointer()));
+        }
+        
+        void GC::markObject(Concurrency::WorkStealingDeque<ManagedMemoryOverhead*>& deque, Object* obj) {
+            // Objects reside at the very beginning of their buffer. Knowing the
+            // memory is an Object allows tracing it from its cards once it is
+            // promoted.
+            auto* head = reinterpret_cast<ManagedMemoryOverhead*>(obj) - 1;
+            if (!head->isObject) head->isObject = true;
+            
+            for (uint32 i = 0; i < obj->capacity(); ++i) {
+                Property& prop = obj->props()[i];
+                if (prop.id == -1 || !prop.value.isManagedObject()) continue;
+                
+                Pointer other = prop.value.getManagedObject();
+                
+                // Only trace the found object once per phase.
+                if (marks.mark(other)) {
+                    if (void* next = dataTable.get(other)) deque.push(reinterpret_cast<ManagedMemoryOverhead*>(next) - 1);
+                }
+            }
+        }
+        
+        void GC::markNative(Concurrency::WorkStealingDeque<ManagedMemoryOverhead*>& deque, ManagedMemoryOverhead* head, const TypeDescriptor& type) {
+            const uint32* objectOffsets = type.getObjectOffsets();
+            const uint32* memoryOffsets = type.getMemoryOffsets();
+            uint8* element = reinterpret_cast<uint8*>(head->getBufferPointer());
+            
+            for (uint32 i = 0; i < head->count; ++i, element += head->elementSize) {
+                for (uint32 j = 0; j < type.numObjectPointers; ++j) {
+                    const auto& other = *reinterpret_cast<const ManagedMemoryPointerBase*>(element + objectOffsets[j]);
+                    if (marks.mark(other)) {
+                        if (void* next = dataTable.get(other)) deque.push(reinterpret_cast<ManagedMemoryOverhead*>(next) - 1);
+                    }
+                }
+                
+                // Other memory only needs tracing if it holds pointers itself.
+                for (uint32 j = 0; j < type.numMemoryPointers; ++j) {
+                    const auto& other = *reinterpret_cast<const ManagedMemoryPointerBase*>(element + memoryOffsets[j]);
+                    if (!marks.mark(other)) continue;
+                    if (void* next = dataTable.get(other)) {
+                        auto* nextHead = reinterpret_cast<ManagedMemoryOverhead*>(next) - 1;
+                        if (nextHead->typeId && TypeTable::get(nextHead->typeId).hasPointers()) deque.push(nextHead);
+                    }
+                }
+            }
+        }
+        
+        bool GC::stealMarkWork(uint32 workerIndex, ManagedMemoryOverhead*& head) {
+            const uint32 numWorkers = markers.count();
+            for (uint32 i = 1; i < numWorkers; ++i) {
+                if (markDeques[(workerIndex + i) % numWorkers].steal(head)) return true;
+            }
+            return false;
+        }
+        
+        
+        ////////////////////////////////////////////////////////////////////////
+        // Sweep Phase
+        ////////////////////////////////////////////////////////////////////////
+        
+        void GC::sweep() {
+            Buffer<ManagedMemoryOverhead*> processList;
+            {
+                std::scoped_lock lock(markedObjectsMutex);
+                processList = markedObjects;
+                markedObjects.clear();
+            }
+            
+            sweepGarbage(processList);
+        }
+        
+        void GC::sweepGarbage(Buffer<ManagedMemoryOverhead*>& heads) {
+            // Allocations never reuse the memory of the old generation, and
+            // large memory is better unmapped right away. Only the nursery's
+            // garbage is left to the allocations.
+            Buffer<ManagedMemoryOverhead*> trivial, nonTrivial, youngTrivial, youngNonTrivial;
+            for (auto* head : heads) {
+                if (head->isLarge || head->isDormant) (head->isTrivial ? trivial : nonTrivial).add(head);
+                else (head->isTrivial ? youngTrivial : youngNonTrivial).add(head);
+            }
+            
+            sweepBlocks(trivial, true);
+            sweepBlocks(nonTrivial, false);
+            queueUnswept(youngTrivial, firstTrivialMemSeg, true);
+            queueUnswept(youngNonTrivial, firstNonTrivialMemSeg, false);
+        }
+        
+        void GC::sweepBlocks(Buffer<ManagedMemoryOverhead*>& heads, bool trivial) {
+            // Clean up the data, distinguishing between trivial and non-trivial data.
+            if (!trivial) destroyBlocks(heads);
+            
+            Buffer<ManagedMemoryOverhead*> young, large;
+            for (auto* head : heads) {
+                head->garbageState = EGarbageState::Swept;
+                if (head->isLarge) large.add(head);
+                else if (!head->isDormant) young.add(head);
+                else unreclaimedBytes += head->getTotalBytes();
+            }
+            
+            // Memory is only ever moved into the old generation by promotion
+            // and reallocation, which bump its segments. Its garbage is left
+            // to the compactor of major cycles.
+            recycleSwept(young, trivial);
+            releaseLarge(large);
+        }
+        
+        void GC::queueUnswept(Buffer<ManagedMemoryOverhead*>& heads, ManagedMemorySegment* chain, bool trivial) {
+            if (!heads.length()) return;
+            std::sort(heads.begin(), heads.end());
+            
+            // Segments are not linked in address order.
+            Buffer<uint8*> starts;
+            for (auto* segment = chain; segment; segment = segment->next) {
+                starts.add(reinterpret_cast<uint8*>(segment));
+            }
+            std::sort(starts.begin(), starts.end());
+            
+            // A new group starts with every block beyond the start of the
+            // segment following the current group's, and once a group is
+            // large enough to be swept on the allocation path.
+            Buffer<uint32> groups;
+            uint64 bytes = 0;
+            uint32 first = 0, next = 0;
+            for (uint32 i = 0; i < heads.length(); ++i) {
+                uint8* addr = reinterpret_cast<uint8*>(heads[i]);
+                if (next < starts.length() && addr >= starts[next]) {
+                    if (i > first) groups.add(i - first);
+                    first = i;
+                    while (next < starts.length() && addr >= starts[next]) ++next;
+                }
+                else if (i - first == NEURO_GC_LAZY_SWEEP_BLOCKS) {
+                    groups.add(i - first);
+                    first = i;
+                }
+                bytes += heads[i]->getTotalBytes();
+            }
+            groups.add(heads.length() - first);
+            
+            std::scoped_lock lock(unsweptMutex);
+            unsweptBlocks[trivial].add(heads.begin(), heads.end());
+            unsweptGroups[trivial].add(groups.begin(), groups.end());
+            unsweptBytes.fetch_add(bytes, std::memory_order_relaxed);
+            numUnsweptGroups[trivial].fetch_add(groups.length(), std::memory_order_release);
+        }
+        
+        bool GC::sweepNextGroup(bool trivial) {
+            if (!numUnsweptGroups[trivial].load(std::memory_order_acquire)) return false;
+            
+            Buffer<ManagedMemoryOverhead*> heads;
+            {
+                std::scoped_lock lock(unsweptMutex);
+                Buffer<uint32>& groups = unsweptGroups[trivial];
+                Buffer<ManagedMemoryOverhead*>& blocks = unsweptBlocks[trivial];
+                if (!groups.length()) return false;
+                
+                const uint32 count = groups.last();
+                heads.add(blocks.end() - count, blocks.end());
+                blocks.drop(count);
+                groups.drop(1);
+                numUnsweptGroups[trivial].fetch_sub(1, std::memory_order_relaxed);
+            }
+            
+            TraceScope trace(getTracer(), "LazySweep", "blocks", heads.length());
+            uint64 bytes = 0;
+            for (auto* head : heads) bytes += head->getTotalBytes();
+            sweepBlocks(heads, trivial);
+            unsweptBytes.fetch_sub(bytes, std::memory_order_relaxed);
+            return true;
+        }
+        
+        void GC::finishSweep() {
+            if (!numUnsweptGroups[0].load() && !numUnsweptGroups[1].load()) return;
+            
+            std::scoped_lock lock(markersMutex);
+            markers.run(Concurrency::WorkerPool::JobDelegate::MethodDelegate<GC, &GC::sweepWorker>(this));
+        }
+        
+        void GC::sweepWorker(uint32 workerIndex) {
+            // Groups never span segments, hence the workers never merge the
+            // same garbage.
+            while (sweepNextGroup(true) || sweepNextGroup(false)) {}
+        }
+        
+        void GC::recycleSwept(Buffer<ManagedMemoryOverhead*>& blocks, bool trivial) {
+            FreeLists& freeBlocks = trivial ? trivialFreeBlocks : nonTrivialFreeBlocks;
+            std::sort(blocks.begin(), blocks.end());
+            
+            // Adjacent blocks always share a segment, as every segment starts
+            // with its own meta data.
+            uint32 index = 0;
+            while (index < blocks.length()) {
+                ManagedMemoryOverhead* first = blocks[index++];
+                uint8* end = reinterpret_cast<uint8*>(getNextOverhead(first));
+                while (index < blocks.length() && reinterpret_cast<uint8*>(blocks[index]) == end) {
+                    end = reinterpret_cast<uint8*>(getNextOverhead(blocks[index++]));
+                }
+                
+                makeFiller(first, static_cast<uint32>(end - reinterpret_cast<uint8*>(first)), trivial);
+                freeBlocks.add(first);
+            }
+        }
+        
+        
+        void GC::releaseLarge(const Buffer<ManagedMemoryOverhead*>& heads) {
+            if (!heads.length()) return;
+            
+            std::scoped_lock lock(largeObjectsMutex);
+            for (auto* head : heads) {
+                LargeObjectRegion* region = getLargeObjectRegion(head);
+                if (region->prev) region->prev->next = region->next;
+                else firstLargeObject = region->next;
+                if (region->next) region->next->prev = region->prev;
+                destroyLargeObjectRegion(region);
+            }
+        }
+        
+        
+        ////////////////////////////////////////////////////////////////////////
+        // Incremental Cycles
+        ////////////////////////////////////////////////////////////////////////
+        
+        uint64 GC::step(std::chrono::microseconds budget) {
+            // Waiting for a cycle of the background thread counts against the
+            // budget as well.
+            const auto start = std::chrono::steady_clock::now();
+            const auto deadline = start + budget;
+            auto lock = lockCollection();
+            TraceBuffer* tracer = getTracer();
+            TraceScope trace(tracer, "Step", "budget", budget.count());
+            
+            if (incrementalPhase == EIncrementalPhase::Idle) {
+                beginCycle(false);
+                PhaseTimer timer(cycleScanTime);
+                TraceScope trace(tracer, "Scan", "major", majorCycle);
+                beginIncrementalMark();
+            }
+            
+            const uint64 remaining = advanceIncremental(deadline);
+            if (!remaining) {
+                TraceScope trace(tracer, "RefineCards");
+                refineCards();
+                finishCycle(false);
+            }
+            recordPause(std::chrono::steady_clock::now() - start);
+            return remaining;
+        }
+        
+        uint64 GC::advanceIncremental(std::chrono::steady_clock::time_point deadline) {
+            if (incrementalPhase == EIncrementalPhase::Marking) {
+                PhaseTimer timer(cycleScanTime);
+                TraceScope trace(getTracer(), "Scan", "major", majorCycle);
+                if (!stepMark(deadline)) return incrementalGray.size() + 1;
+                
+                {
+                    std::scoped_lock lock(scannersMutex);
+                    scanners(marks);
+                }
+                collectGarbage();
+                incrementalPhase = EIncrementalPhase::Sweeping;
+            }
+            
+            if (incrementalPhase == EIncrementalPhase::Sweeping) {
+                PhaseTimer timer(cycleSweepTime);
+                TraceScope trace(getTracer(), "Sweep");
+                if (!stepSweep(deadline)) {
+                    std::scoped_lock lock(markedObjectsMutex);
+                    return std::max<uint64>(markedObjects.length(), 1);
+                }
+                incrementalPhase = EIncrementalPhase::Idle;
+            }
+            return 0;
+        }
+        
+        void GC::beginIncrementalMark() {
+            resetMarks();
+            incrementalPhase = EIncrementalPhase::Marking;
+            
+            Buffer<ManagedMemoryOverhead*> objects;
+            cleanNurseryCards(objects);
+            if (!majorCycle) {
+                collectDirtyObjects(firstDormantTrivialMemSeg, objects);
+                collectDirtyObjects(firstDormantNonTrivialMemSeg, objects);
+                collectDirtyLargeObjects(objects);
+            }
+            {
+                std::scoped_lock lock(rootsMutex);
+                for (auto& root : roots) {
+                    if (!marks.mark(root)) continue;
+                    if (auto* head = getOverhead(root)) objects.add(head);
+                }
+            }
+            for (auto* head : objects) {
+                incrementalGray.push(head);
+            }
+        }
+        
+        bool GC::stepMark(std::chrono::steady_clock::time_point deadline) {
+            uint32 traced = 0;
+            ManagedMemoryOverhead* head;
+            while (incrementalGray.pop(head)) {
+                markBlock(incrementalGray, head);
+                if (++traced % 64 == 0 && std::chrono::steady_clock::now() >= deadline) return false;
+            }
+            
+            // The rescans disregard the deadline, as the mutator might otherwise
+            // dirty cards faster than they are rescanned. A rescan which
+            // reaches nothing beyond the rescanned objects concludes marking.
+            while (true) {
+                const uint32 seeded = remark();
+                traced = 0;
+                while (incrementalGray.pop(head)) {
+                    markBlock(incrementalGray, head);
+                    ++traced;
+                }
+                if (traced == seeded) return true;
+            }
+        }
+        
+        uint32 GC::remark() {
+            Buffer<ManagedMemoryOverhead*> objects;
+            collectRescanObjects(objects);
+            for (auto* head : objects) {
+                incrementalGray.push(head);
+            }
+            return objects.length();
+        }
+        
+        void GC::collectRescanObjects(Buffer<ManagedMemoryOverhead*>& objects) {
+            {
+                std::scoped_lock lock(rootsMutex);
+                for (auto& root : roots) {
+                    if (!marks.mark(root)) continue;
+                    if (auto* head = getOverhead(root)) objects.add(head);
+                }
+            }
+            
+            // Objects on dirty cards are traced again, which is harmless for
+            // those traced before.
+            for (auto* chain : { firstTrivialMemSeg, firstNonTrivialMemSeg, firstDormantTrivialMemSeg, firstDormantNonTrivialMemSeg }) {
+                collectDirtyObjects(chain, objects);
+            }
+            collectDirtyLargeObjects(objects, true);
+        }
+        
+        bool GC::stepSweep(std::chrono::steady_clock::time_point deadline) {
+            constexpr uint32 batchSize = 256;
+            
+            while (true) {
+                Buffer<ManagedMemoryOverhead*> batch;
+                {
+                    std::scoped_lock lock(markedObjectsMutex);
+                    const uint32 count = std::min(batchSize, markedObjects.length());
+                    if (!count) return true;
+                    
+                    batch.add(markedObjects.end() - count, markedObjects.end());
+                    markedObjects.drop(count);
+                }
+                
+                sweepGarbage(batch);
+                if (std::chrono::steady_clock::now() >= deadline) return false;
+            }
+        }
+        
+        
+        ////////////////////////////////////////////////////////////////////////
+        // Compaction Phase
+        ////////////////////////////////////////////////////////////////////////
+        
+        /**
+         * Find the first swept managed memory overhead in the given segment
+         * starting at `start`.
+         */
+        ManagedMemoryOverhead* findSwept(ManagedMemorySegment* segment, ManagedMemoryOverhead* start) {
+            auto* head = start;
+            while (segmentContainsHead(segment, head) && head->garbageState != EGarbageState::Swept) head = getNextOverhead(head);
+            if (!segmentContainsHead(segment, head)) return nullptr;
+            return head;
+        }
+        
+        /**
+         * Find the first unswept managed memory overhead in the given segment
+         * starting at `start`.
+         */
+        ManagedMemoryOverhead* findUnswept(ManagedMemorySegment* segment, ManagedMemoryOverhead* start) {
+            auto* head = start;
+            while (segmentContainsHead(segment, head) && head->garbageState == EGarbageState::Swept) head = getNextOverhead(head);
+            if (!segmentContainsHead(segment, head)) return nullptr;
+            return head;
+        }
+        
+        void GC::compact() {
+            releaseRetired();
+            
+            // Memory is about to be slid over the threads' allocation buffers
+            // and the free blocks.
+            allocationEpoch.fetch_add(1, std::memory_order_acq_rel);
+            trivialFreeBlocks.clear();
+            nonTrivialFreeBlocks.clear();
+            
+            // The compactor reclaims the reallocated memory of whatever it
+            // compacts, after which the lists might refer to moved memory.
+            {
+                std::scoped_lock lock(dyingMutex);
+                for (auto* list : { &recentlyDying, &dyingBlocks }) {
+                    Buffer<ManagedMemoryOverhead*> kept;
+                    for (auto* head : *list) {
+                        if (!majorCycle && head->isDormant && !head->isLarge) kept.add(head);
+                    }
+                    *list = std::move(kept);
+                }
+            }
+            
+            // The nursery is evacuated by every collection, while the old
+            // generation only changes during major cycles.
+            compact(firstTrivialMemSeg, true);
+            compact(firstNonTrivialMemSeg, false);
+            if (majorCycle) {
+                compact(firstDormantTrivialMemSeg, true);
+                compact(firstDormantNonTrivialMemSeg, false);
+                unreclaimedBytes = 0;
+            }
+            compactLargeObjects();
+        }
+        
+        void GC::compactLargeObjects() {
+            Buffer<ManagedMemoryOverhead*> released;
+            {
+                std::scoped_lock lock(largeObjectsMutex);
+                for (auto* region = firstLargeObject; region; region = region->next) {
+                    auto* head = region->getHead();
+                    
+                    // Just like in segments, reallocated memory is destroyed now
+                    // but only unmapped by the next compaction.
+                    if (head->garbageState == EGarbageState::Swept) {
+                        released.add(head);
+                        continue;
+                    }
+                    if (head->garbageState == EGarbageState::Dying) {
+                        if (auto* type = head->isTrivial ? nullptr : head->getType()) {
+                            type->destroy(head->getBufferPointer());
+                        }
+                        head->garbageState = EGarbageState::Swept;
+                        continue;
+                    }
+                    
+                    if (head->garbageState != EGarbageState::Live || head->isDormant || !marks.isMarked(head->tableIndex)) continue;
+                    if (head->age < 3) ++head->age;
+                    
+                    // Large memory is promoted in place, which merely requires
+                    // flagging it. The same rules as for promotion apply.
+                    if (head->age >= promotionAge) {
+                        head->isDormant = true;
+                        dormantRecords.mark(head->tableIndex);
+                        if (isTraced(head)) {
+                            writeBarrier(head->getBufferPointer(), head->getBufferBytes());
+                        }
+                    }
+                }
+            }
+            releaseLarge(released);
+        }
+        
+        void GC::compact(ManagedMemorySegment* chain, bool trivial) {
+            ManagedMemorySegment* prev = nullptr;
+            ManagedMemorySegment* segment = chain;
+            while (segment) {
+                ManagedMemorySegment* next = segment->next;
+                
+                // The first segment anchors the chain, and new segments are
+                // appended to the last one, so neither may be unlinked.
+                const bool mayRetire = prev && next;
+                
+                if (compactSegment(segment, trivial, mayRetire) && mayRetire) {
+                    // Nobody appends to a segment with a successor, hence it is
+                    // safe to simply bypass it.
+                    prev->next = next;
+                    retiredSegments.add(segment);
+                }
+                else {
+                    prev = segment;
+                }
+                
+                segment = next;
+            }
+        }
+        
+        bool GC::compactSegment(ManagedMemorySegment* segment, bool trivial, bool mayRetire) {
+            // Keep allocators out of the segment while we are moving memory.
+            uint8* end;
+            {
+                ManagedMemorySegment::Lock lock(segment);
+                segment->compacting = true;
+                end = segment->ptr;
+            }
+            
+            ManagedMemoryOverhead* first = getFirstOverhead(segment);
+            ManagedMemoryOverhead* target = first;
+            ManagedMemoryOverhead* head = findUnswept(segment, first);
+            
+            while (head) {
+                ManagedMemoryOverhead* next = getNextOverhead(head);
+                
+                // Reallocated memory is destroyed now but reclaimed only by the
+                // next compaction in case a thread is still reading from it.
+                if (head->garbageState == EGarbageState::Dying) {
+                    if (auto* type = trivial ? nullptr : head->getType()) {
+                        type->destroy(head->getBufferPointer());
+                    }
+                    head->garbageState = EGarbageState::Swept;
+                }
+                
+                // Age the memory which survived the scan.
+                if (head->garbageState == EGarbageState::Live && head->age < 3 && marks.isMarked(head->tableIndex)) {
+                    ++head->age;
+                }
+                
+                // Newborn memory may still be under construction by its
+                // allocating thread, and memory pending a sweep is referred
+                // to by the marked objects list. Neither may move.
+                const bool movable = head->garbageState == EGarbageState::Live && head->age > 0;
+                
+                // Memory reached this cycle which has grown old enough leaves
+                // the nursery, leaving its space to be slid over.
+                if (movable && !segment->dormant && head->age >= promotionAge && marks.isMarked(head->tableIndex) && promote(head, trivial)) {
+                    head = findUnswept(segment, next);
+                    continue;
+                }
+                
+                if (head != target && !(movable && relocate(head, target, trivial))) {
+                    // Pinned memory behind a gap. Turn the gap into a single
+                    // swept filler block to keep the segment walkable.
+                    makeFiller(target, static_cast<uint32>(reinterpret_cast<uint8*>(head) - reinterpret_cast<uint8*>(target)), trivial);
+                    target = head;
+                }
+                
+                target = getNextOverhead(target);
+                head = findUnswept(segment, next);
+            }
+            
+            const bool empty = target == first;
+            {
+                ManagedMemorySegment::Lock lock(segment);
+                segment->ptr = reinterpret_cast<uint8*>(target);
+                segment->compacting = empty && mayRetire;
+            }
+            
+            // The pages beyond the allocation pointer have not been touched
+            // since the previous compaction, except for those just vacated.
+            // Retired segments are decommitted entirely later on.
+            if (!(empty && mayRetire)) {
+                segmentHeap.discard(target, end - reinterpret_cast<uint8*>(target));
+            }
+            return empty;
+        }
+        
+        bool GC::relocate(ManagedMemoryOverhead* head, ManagedMemoryOverhead* target, bool trivial) {
+            ManagedMemoryPointerBase pointer = dataTable.getPointer(head->tableIndex);
+            if (!pointer || GC::getOverhead(pointer) != head) return false;
+            
+            const uint32 bytes = head->getTotalBytes();
+            
+            // Dirty cards move along with the memory of the old generation.
+            if (head->isDormant && isTraced(head) && CardTable::lookup(head)->isDirty(head, bytes)) {
+                writeBarrier(target, bytes);
+            }
+            
+            if (reinterpret_cast<uint8*>(target) + bytes <= reinterpret_cast<uint8*>(head)) {
+                moveBlock(head, target, trivial);
+                dataTable.replacePointer(pointer, target);
+                return true;
+            }
+            
+            // Source and target overlap. Move through a temporary block so
+            // the table never refers to partially overwritten memory.
+            auto* staging = reinterpret_cast<ManagedMemoryOverhead*>(std::malloc(bytes));
+            if (!staging) return false;
+            
+            moveBlock(head, staging, trivial);
+            dataTable.replacePointer(pointer, staging);
+            moveBlock(staging, target, trivial);
+            dataTable.replacePointer(pointer, target);
+            stagingBuffers.add(staging);
+            return true;
+        }
+        
+        bool GC::promote(ManagedMemoryOverhead* head, bool trivial) {
+            ManagedMemoryPointerBase pointer = dataTable.getPointer(head->tableIndex);
+            if (!pointer || GC::getOverhead(pointer) != head) return false;
+            
+            auto* target = allocate_inner(segmentHeap, trivial ? firstDormantTrivialMemSeg : firstDormantNonTrivialMemSeg, head->elementSize, head->count);
+            if (!target) return false;
+            
+            moveBlock(head, target, trivial);
+            target->isDormant = true;
+            dataTable.replacePointer(pointer, target);
+            dormantRecords.mark(target->tableIndex);
+            
+            // The promoted memory may still refer to young memory. Cards of
+            // objects which don't are cleaned again after the cycle.
+            if (isTraced(target)) {
+                writeBarrier(target->getBufferPointer(), target->elementSize * target->count);
+            }
+            return true;
+        }
+        
+        /**
+         * Tests whether the given pointer or value refers to memory of the
+         * young generation.
+         */
+        bool refersToYoung(const ManagedMemoryPointerBase& pointer) {
+            if (pointer.isNull()) return false;
+            void* buffer = GC::instance()->resolve(pointer);
+            return buffer && !(reinterpret_cast<ManagedMemoryOverhead*>(buffer) - 1)->isDormant;
+        }
+        
+        bool refersToYoung(const Value& value) {
+            return value.isManagedObject() && refersToYoung(value.getManagedObject());
+        }
+        
+        /**
+         * Dirties precisely the cards of the pointer fields of the given
+         * native block which refer to young memory.
+         */
+        void refineNativeCards(ManagedMemoryOverhead* head, CardTable& cards) {
+            const TypeDescriptor* type = head->getType();
+            const uint32 numPointers = type->numObjectPointers + type->numMemoryPointers;
+            uint8* element = reinterpret_cast<uint8*>(head->getBufferPointer());
+            for (uint32 i = 0; i < head->count; ++i, element += head->elementSize) {
+                for (uint32 j = 0; j < numPointers; ++j) {
+                    const auto* field = reinterpret_cast<const ManagedMemoryPointerBase*>(element + type->pointerOffsets[j]);
+                    if (refersToYoung(*field)) cards.dirty(field);
+                }
+            }
+        }
+        
+        void GC::refineCards() {
+            for (auto* chain : { firstDormantTrivialMemSeg, firstDormantNonTrivialMemSeg }) {
+                for (auto* segment = chain; segment; segment = segment->next) {
+                    refineCards(segment);
+                }
+            }
+            
+            std::scoped_lock lock(largeObjectsMutex);
+            for (auto* region = firstLargeObject; region; region = region->next) {
+                refineCards(region);
+            }
+        }
+        
+        void GC::refineCards(ManagedMemorySegment* segment) {
+            // Cards are cleaned before inspecting the objects on them, so a
+            // concurrent store is either seen below or dirties its card anew.
+            Buffer<uint32> dirty;
+            if (!segment->cards.takeDirty(dirty)) return;
+            
+            forEachOnCards(segment, dirty, [&](ManagedMemoryOverhead* head) {
+                if (head->garbageState != EGarbageState::Live || !isTraced(head)) return;
+                if (!head->isObject) {
+                    refineNativeCards(head, segment->cards);
+                    return;
+                }
+                
+                // Keep precisely the cards of properties referring to young memory.
+                Object* obj = reinterpret_cast<Object*>(head->getBufferPointer());
+                for (auto& prop : *obj) {
+                    if (refersToYoung(prop.value)) segment->cards.dirty(&prop.value);
+                }
+            });
+        }
+        
+        void GC::refineCards(LargeObjectRegion* region) {
+            Buffer<uint32> dirty;
+            if (!region->cards.takeDirty(dirty)) return;
+            
+            auto* head = region->getHead();
+            if (head->garbageState != EGarbageState::Live || !head->isDormant || !isTraced(head)) return;
+            if (!head->isObject) {
+                refineNativeCards(head, region->cards);
+                return;
+            }
+            
+            // Large objects span many cards, hence only the properties on the
+            // dirty cards are inspected, including those straddling them.
+            Object* obj = reinterpret_cast<Object*>(head->getBufferPointer());
+            Property* props = obj->props();
+            const uint8* first = reinterpret_cast<uint8*>(props);
+            const uint8* last = reinterpret_cast<uint8*>(props + obj->capacity());
+            for (uint32 card : dirty) {
+                const uint8* begin = std::max<const uint8*>(region->cards.getCardPointer(card), first);
+                const uint8* end = std::min<const uint8*>(region->cards.getCardPointer(card + 1), last);
+                if (begin >= end) continue;
+                
+                const uint32 lastIndex = static_cast<uint32>((end - first + sizeof(Property) - 1) / sizeof(Property));
+                for (uint32 i = static_cast<uint32>((begin - first) / sizeof(Property)); i < lastIndex; ++i) {
+                    if (props[i].id != -1 && refersToYoung(props[i].value)) region->cards.dirty(&props[i].value);
+                }
+            }
+        }
+        
+        void GC::releaseRetired() {
+            for (auto* segment : retiredSegments) {
+                destroySegment(segmentHeap, segment);
+            }
+            retiredSegments.clear();
+            
+            for (auto* staging : stagingBuffers) {
+                std::free(staging);
+            }
+            stagingBuffers.clear();
+        }
+        
+        
+        ////////////////////////////////////////////////////////////////////////////
+        // Low Level API
+        ////////////////////////////////////////////////////////////////////////////
+        
+        Error GC::registerMemoryScanner(const ScannerDelegate& scanner) {
+            std::scoped_lock lock(scannersMutex);
+            scanners += scanner;
+            return NoError::instance();
+        }
+        
+        void GC::setScanInterval(std::chrono::milliseconds interval) {
+            {
+                std::scoped_lock lock(cycleMutex);
+                scanInterval = interval;
+            }
+            cycleNotif.notify_one();
+        }
+        
+        void GC::setAllocationThreshold(uint64 bytes) {
+            allocationThreshold = bytes;
+            { std::scoped_lock lock(cycleMutex); }
+            cycleNotif.notify_one();
+        }
+        
+        void GC::setWorkerThreads(uint32 count) {
+            std::scoped_lock lock(markersMutex);
+            markers.resize(count);
+            markDeques.reset(new Concurrency::WorkStealingDeque<ManagedMemoryOverhead*>[markers.count()]);
+        }
+        
+        void GC::setPromotionAge(uint32 cycles) {
+            promotionAge = std::clamp(cycles, 1u, 3u);
+        }
+        
+        void GC::setMajorCycleInterval(uint32 cycles) {
+            majorCycleInterval = std::max(cycles, 1u);
+        }
+        
+        void GC::setLargeObjectThreshold(uint32 bytes) {
+            largeObjectThreshold = bytes;
+        }
+        
+        void GC::setHugePages(bool enable) {
+            segmentHeap.setHugePages(enable);
+        }
+        
+        void GC::setSafepointTimeout(std::chrono::microseconds timeout) {
+            safepointTimeout = static_cast<uint32>(std::min<int64>(timeout.count(), std::numeric_limits<uint32>::max()));
+        }
+        
+        void GC::setBackgroundCompaction(bool enable) {
+            backgroundCompaction = enable;
+        }
+        
+        void GC::collect(bool major) {
+            const auto start = std::chrono::steady_clock::now();
+            TraceScope trace(getTracer(), "Collect", "major", major);
+            cycle(true, major);
+            recordPause(std::chrono::steady_clock::now() - start);
+        }
+        
+        GCStats GC::getStats() {
+            GCStats snapshot;
+            {
+                std::scoped_lock lock(statsMutex);
+                snapshot = stats;
+            }
+            snapshot.bytesAllocated = allocatedBeforeCycle.load() + allocatedSinceCycle.load();
+            snapshot.committedBytes = segmentHeap.countCommittedBytes();
+            snapshot.numRecords = dataTable.countRecords();
+            return snapshot;
+        }
+        
+        void GC::resetStats() {
+            std::scoped_lock lock(statsMutex);
+            stats.scanTimes.reset();
+            stats.sweepTimes.reset();
+            stats.compactTimes.reset();
+            stats.pauseTimes.reset();
+            stats.safepointTimes.reset();
+        }
+        
+        void GC::enableTracing(uint32 capacity) {
+            std::scoped_lock lock(tracingMutex);
+            if (!traceBuffer) traceBuffer.reset(new TraceBuffer(capacity));
+            tracer.store(traceBuffer.get(), std::memory_order_release);
+        }
+        
+        void GC::disableTracing() {
+            tracer.store(nullptr, std::memory_order_release);
+        }
+        
+        bool GC::writeTrace(std::ostream& out) {
+            std::scoped_lock lock(tracingMutex);
+            if (!traceBuffer) return false;
+            traceBuffer->writeChromeTrace(out);
+            return out.good();
+        }
+        
+        void GC::clearTrace() {
+            std::scoped_lock lock(tracingMutex);
+            if (traceBuffer) traceBuffer->clear();
+        }
+        
+        void GC::enableProfiling(uint64 interval) {
+            std::scoped_lock lock(profilingMutex);
+            if (!allocationProfiler) allocationProfiler.reset(new AllocationProfiler(interval));
+            profiler.store(allocationProfiler.get(), std::memory_order_release);
+        }
+        
+        void GC::disableProfiling() {
+            profiler.store(nullptr, std::memory_order_release);
+        }
+        
+        bool GC::writeProfile(std::ostream& out) {
+            std::scoped_lock lock(profilingMutex);
+            if (!allocationProfiler) return false;
+            allocationProfiler->writePprof(out);
+            return out.good();
+        }
+        
+        void GC::clearProfile() {
+            std::scoped_lock lock(profilingMutex);
+            if (allocationProfiler) allocationProfiler->clear();
+        }
+        
+        void GC::takeSnapshot(HeapSnapshot& snapshot) {
+            auto lock = lockCollection();
+            snapshot.clear();
+            
+            // Garbage awaiting its sweep would pass for live memory.
+            finishSweep();
+            
+            auto addBlock = [&](ManagedMemoryOverhead* head, uint32 segment) {
+                HeapSnapshot::Block block;
+                block.address = reinterpret_cast<uintptr_t>(head);
+                block.totalBytes = head->getTotalBytes();
+                block.tableIndex = head->garbageState == EGarbageState::Swept ? npos : head->tableIndex;
+                block.segment = segment;
+                block.flags = (head->isTrivial ? EHeapBlockFlags::Trivial : 0)
+                            | (head->isDormant ? EHeapBlockFlags::Dormant : 0)
+                            | (head->isObject  ? EHeapBlockFlags::Object  : 0)
+                            | (head->isLarge   ? EHeapBlockFlags::Large   : 0);
+                block.garbageState = head->garbageState;
+                block.age = head->age;
+                snapshot.blocks.add(block);
+            };
+            
+            // Segments and the blocks laid out back to back within them.
+            const std::pair<ManagedMemorySegment*, uint32> chains[] = {
+                { firstTrivialMemSeg, EHeapSegmentFlags::Trivial },
+                { firstNonTrivialMemSeg, 0 },
+                { firstDormantTrivialMemSeg, EHeapSegmentFlags::Trivial | EHeapSegmentFlags::Dormant },
+                { firstDormantNonTrivialMemSeg, EHeapSegmentFlags::Dormant },
+            };
+            for (const auto& chain : chains) {
+                for (auto* segment = chain.first; segment; segment = segment->next) {
+                    auto* first = getFirstOverhead(segment);
+                    uint8* const end = segment->ptr;
+                    snapshot.segments.add({ reinterpret_cast<uintptr_t>(segment), segment->size, static_cast<uint64>(end - reinterpret_cast<uint8*>(first)), chain.second });
+                    for (auto* head : SegmentBlocks(segment, end)) {
+                        addBlock(head, snapshot.segments.length() - 1);
+                    }
+                }
+            }
+            {
+                std::scoped_lock lock(largeObjectsMutex);
+                for (auto* region = firstLargeObject; region; region = region->next) {
+                    auto* head = region->getHead();
+                    snapshot.segments.add({ reinterpret_cast<uintptr_t>(region), region->size, head->getTotalBytes(), EHeapSegmentFlags::Large | (head->isTrivial ? EHeapSegmentFlags::Trivial : 0u) | (head->isDormant ? EHeapSegmentFlags::Dormant : 0u) });
+                    addBlock(head, snapshot.segments.length() - 1);
+                }
+            }
+            
+            for (auto ptr : dataTable) {
+                void* buffer = dataTable.get(ptr);
+                if (!buffer) continue;
+                snapshot.records.add({ ptr.getTableIndex(), ptr.getGeneration(), reinterpret_cast<uintptr_t>(reinterpret_cast<ManagedMemoryOverhead*>(buffer) - 1) });
+            }
+            
+            // The object graph, starting from the roots, but also including
+            // unswept objects no longer reachable. Memory is only known to be
+            // an object once it has been traced, hence garbage which never
+            // survived a cycle is left out.
+            Buffer<Pointer> rootsCopy;
+            {
+                std::scoped_lock lock(rootsMutex);
+                rootsCopy = roots;
+            }
+            
+            std::unordered_set<uint32> seen;
+            Buffer<ManagedMemoryPointerBase> pending;
+            for (auto& root : rootsCopy) {
+                if (!dataTable.get(root)) continue;
+                snapshot.roots.add(root.getTableIndex());
+                if (seen.insert(root.getTableIndex()).second) pending.add(root);
+            }
+            for (const auto& record : snapshot.records) {
+                auto* head = reinterpret_cast<ManagedMemoryOverhead*>(record.address);
+                if (!head->isObject || head->garbageState == EGarbageState::Dying || !seen.insert(record.index).second) continue;
+                pending.add(dataTable.getPointer(record.index));
+            }
+            
+            while (pending.length()) {
+                const ManagedMemoryPointerBase ptr = pending.last();
+                pending.drop();
+                
+                // Rooted native memory is not part of the object graph.
+                auto* obj = reinterpret_cast<Object*>(dataTable.get(ptr));
+                if (!obj || (reinterpret_cast<ManagedMemoryOverhead*>(obj) - 1)->typeId) continue;
+                
+                HeapSnapshot::ObjectNode node;
+                node.tableIndex = ptr.getTableIndex();
+                node.capacity = obj->capacity();
+                node.numProperties = 0;
+                node.firstReference = snapshot.references.length();
+                for (uint32 i = 0; i < obj->capacity(); ++i) {
+                    Property& prop = obj->props()[i];
+                    if (prop.id == -1) continue;
+                    ++node.numProperties;
+                    if (!prop.value.isManagedObject()) continue;
+                    
+                    Pointer other = prop.value.getManagedObject();
+                    if (!dataTable.get(other)) continue;
+                    snapshot.references.add(HeapSnapshot::Reference{ prop.id, other.getTableIndex() });
+                    if (seen.insert(other.getTableIndex()).second) pending.add(other);
+                }
+                node.numReferences = snapshot.references.length() - node.firstReference;
+                snapshot.objects.add(node);
+            }
+        }
+        
+        Error GC::dumpHeap(std::ostream& out) {
+            HeapSnapshot snapshot;
+            takeSnapshot(snapshot);
+            return snapshot.write(out);
+        }
+        
+        Error GC::dumpHeap(const char* path) {
+            if (!path) return NullPointerError::instance();
+            
+            std::ofstream file(path, std::ios::binary | std::ios::trunc);
+            if (!file) return InvalidArgumentError::instance();
+            return dumpHeap(file);
+        }
+        
+        void GC::requestCycle(bool major) {
+            {
+                std::scoped_lock lock(cycleMutex);
+                cycleRequested = true;
+                if (major) majorCycleRequested = true;
+            }
+            cycleNotif.notify_one();
         }
         
         
@@ -479,26 +2348,29 @@ namespace Neuro {
         }
         
         MaybeAnError<GC*> GC::init() {
-            std::scoped_lock{gcMainInstanceMutex};
+            std::scoped_lock lock(gcMainInstanceMutex);
             if (gcMainInstance) return InvalidStateError::instance();
             
             auto gc = new GC();
             gcMainInstance = gc;
+            ManagedMemoryTable::makeResident(gc->getTable());
             return gc;
         }
         
         Error GC::init(GCInterface* instance) {
-            std::scoped_lock{gcMainInstanceMutex};
+            std::scoped_lock lock(gcMainInstanceMutex);
             if (gcMainInstance) return InvalidStateError::instance();
             
             gcMainInstance = instance;
+            ManagedMemoryTable::makeResident(instance->getTable());
             return NoError::instance();
         }
         
         Error GC::destroy() {
-            std::scoped_lock{gcMainInstanceMutex};
+            std::scoped_lock lock(gcMainInstanceMutex);
             if (!gcMainInstance) return InvalidStateError::instance();
             
+            ManagedMemoryTable::makeResident(nullptr);
             delete gcMainInstance;
             gcMainInstance = nullptr;
             
@@ -508,3 +2380,153 @@ namespace Neuro {
 }
 
 
+////////////////////////////////////////////////////////////////////////////////
+// C Interface
+////////////////////////////////////////////////////////////////////////////////
+
+static Neuro::Runtime::GC* getMainGC() {
+    return dynamic_cast<Neuro::Runtime::GC*>(Neuro::Runtime::GC::instance());
+}
+
+static const Neuro::Runtime::LatencyHistogram* getHistogram(const Neuro::Runtime::GCStats& stats, neuroGCHistogram histogram) {
+    switch (histogram) {
+    case NGCH_Scan:      return &stats.scanTimes;
+    case NGCH_Sweep:     return &stats.sweepTimes;
+    case NGCH_Compact:   return &stats.compactTimes;
+    case NGCH_Pause:     return &stats.pauseTimes;
+    case NGCH_Safepoint: return &stats.safepointTimes;
+    default:             return nullptr;
+    }
+}
+
+uint64_t neuroGCStep(uint32_t budgetMicroseconds) {
+    auto* gc = getMainGC();
+    if (!gc) return 0;
+    return gc->step(std::chrono::microseconds(budgetMicroseconds));
+}
+
+int neuroGCGetStats(neuroGCStats* stats) {
+    auto* gc = getMainGC();
+    if (!gc || !stats) return 1;
+    
+    const auto snapshot = gc->getStats();
+    stats->bytesAllocated = snapshot.bytesAllocated;
+    stats->liveBytes = snapshot.liveBytes;
+    stats->committedBytes = snapshot.committedBytes;
+    stats->numNurserySegments = snapshot.numNurserySegments;
+    stats->numDormantSegments = snapshot.numDormantSegments;
+    stats->numLargeObjects = snapshot.numLargeObjects;
+    stats->numRecords = snapshot.numRecords;
+    stats->numCycles = snapshot.numCycles;
+    stats->numMajorCycles = snapshot.numMajorCycles;
+    stats->lastScanNanoseconds = snapshot.lastScan.count();
+    stats->lastSweepNanoseconds = snapshot.lastSweep.count();
+    stats->lastCompactNanoseconds = snapshot.lastCompact.count();
+    stats->numSkippedCompactions = snapshot.numSkippedCompactions;
+    stats->numSkippedCollections = snapshot.numSkippedCollections;
+    return 0;
+}
+
+uint64_t neuroGCGetLatencyPercentile(neuroGCHistogram histogram, double percentile) {
+    auto* gc = getMainGC();
+    if (!gc) return 0;
+    
+    const auto snapshot = gc->getStats();
+    const auto* latencies = getHistogram(snapshot, histogram);
+    return latencies ? latencies->percentile(percentile) : 0;
+}
+
+uint64_t neuroGCGetLatencyCount(neuroGCHistogram histogram) {
+    auto* gc = getMainGC();
+    if (!gc) return 0;
+    
+    const auto snapshot = gc->getStats();
+    const auto* latencies = getHistogram(snapshot, histogram);
+    return latencies ? latencies->count() : 0;
+}
+
+int neuroGCResetStats() {
+    auto* gc = getMainGC();
+    if (!gc) return 1;
+    gc->resetStats();
+    return 0;
+}
+
+int neuroGCEnableTracing(uint32_t capacity) {
+    auto* gc = getMainGC();
+    if (!gc) return 1;
+    gc->enableTracing(capacity ? capacity : NEURO_GC_TRACE_CAPACITY);
+    return 0;
+}
+
+int neuroGCDisableTracing() {
+    auto* gc = getMainGC();
+    if (!gc) return 1;
+    gc->disableTracing();
+    return 0;
+}
+
+int neuroGCWriteTrace(const char* path) {
+    auto* gc = getMainGC();
+    if (!gc || !path) return 1;
+    
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file || !gc->writeTrace(file)) return 1;
+    return 0;
+}
+
+int neuroGCEnableProfiling(uint64_t interval) {
+    auto* gc = getMainGC();
+    if (!gc) return 1;
+    gc->enableProfiling(interval ? interval : NEURO_GC_PROFILE_INTERVAL);
+    return 0;
+}
+
+int neuroGCDisableProfiling() {
+    auto* gc = getMainGC();
+    if (!gc) return 1;
+    gc->disableProfiling();
+    return 0;
+}
+
+int neuroGCWriteProfile(const char* path) {
+    auto* gc = getMainGC();
+    if (!gc || !path) return 1;
+    
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file || !gc->writeProfile(file)) return 1;
+    return 0;
+}
+
+int neuroGCDumpHeap(const char* path) {
+    auto* gc = getMainGC();
+    if (!gc) return 1;
+    return gc->dumpHeap(path).code();
+}
+
+int neuroGCRegisterThread() {
+    Neuro::Runtime::Safepoints::registerThread();
+    return 0;
+}
+
+int neuroGCUnregisterThread() {
+    Neuro::Runtime::Safepoints::unregisterThread();
+    return 0;
+}
+
+int neuroGCSafepoint() {
+    Neuro::Runtime::Safepoints::poll();
+    return 0;
+}
+
+int neuroGCEnterSafeRegion() {
+    Neuro::Runtime::Safepoints::enterSafeRegion();
+    return 0;
+}
+
+int neuroGCLeaveSafeRegion() {
+    Neuro::Runtime::Safepoints::leaveSafeRegion();
+    return 0;
+}
+
+
@@ -39,25 +39,21 @@ namespace Neuro {
             return (number << bits) | (number >> (uint32bits - bits));
         }
         
-        Property* getPropertyMapAddress(Object* ptr) {
-            return reinterpret_cast<Property*>(reinterpret_cast<uint8*>(ptr) + sizeof(Object));
-        }
-        
         
         ////////////////////////////////////////////////////////////////////////
         // RAII
         ////////////////////////////////////////////////////////////////////////
         
-        Object::Object(Pointer self, uint32 propCount) : propertyWriteMutex(), self(self), props(getPropertyMapAddress(this)), propCount(propCount) {
+        Object::Object(Pointer self, uint32 propCount) : propertyWriteMutex(), self(self), propCount(propCount) {
             initProps();
         }
         
-        Object::Object(Pointer self, Object* other) : propertyWriteMutex(), self(self), props(getPropertyMapAddress(this)), propCount(other->propCount) {
+        Object::Object(Pointer self, Object* other) : propertyWriteMutex(), self(self), propCount(other->propCount) {
             copyProps(other);
             onMove(other);
         }
         
-        Object::Object(Pointer self, Object* other, uint32 newPropCount) : propertyWriteMutex(), self(self), props(getPropertyMapAddress(this)), propCount(newPropCount) {
+        Object::Object(Pointer self, Object* other, uint32 newPropCount) : propertyWriteMutex(), self(self), propCount(newPropCount) {
             initProps();
             copyRehashProps(other);
             onMove(other);
@@ -68,7 +64,7 @@ namespace Neuro {
             
             // Clearing every single property triggers heuristics for gc scans
             for (uint32 i = 0; i < propCount; ++i) {
-                props[i].value.clear();
+                props()[i].value.clear();
             }
         }
         
@@ -87,7 +83,7 @@ namespace Neuro {
             
             // Find property based on hash index
             for (uint8 i = 0; i < 8; ++i) {
-                prop = props + (cycleBits(number, propCount * i) % cap);
+                prop = props() + (cycleBits(number, propCount * i) % cap);
                 if (prop->id == -1) {
                     prop->id = number;
                     return prop->value;
@@ -96,7 +92,7 @@ namespace Neuro {
             
             // Find property by iterating linearly
             for (uint32 i = 0; i < length(); ++i) {
-                prop = props + i;
+                prop = props() + i;
                 if (prop->id == -1) {
                     prop->id = number;
                     return prop->value;
@@ -117,20 +113,21 @@ namespace Neuro {
         uint32 Object::length() const {
             uint32 count = 0;
             for (uint32 i = 0; i < propCount; ++i) {
-                if (props[i].id != -1) ++count;
+                if (props()[i].id != -1) ++count;
             }
             return count;
         }
         
         void Object::initProps() {
             for (uint32 i = 0; i < propCount; ++i) {
-                props[i].id = -1;
-                props[i].value = Value::undefined;
+                props()[i].id = -1;
+                props()[i].value = Value::undefined;
             }
         }
         
         void Object::copyProps(Object* other) {
-            std::memcpy(props, other->props, propCount * sizeof(Property));
+            std::memcpy(props(), other->props(), propCount * sizeof(Property));
+            writeBarrier(props(), propCount * sizeof(Property));
         }
         
         void Object::copyRehashProps(Object* other) {
@@ -148,13 +145,13 @@ namespace Neuro {
             
             // Try to find 8 distinct positions based on ID
             for (uint8 i = 0; i < 8; ++i) {
-                auto& prop = props[cycleBits(number, propCount * i) % cap];
+                auto& prop = props()[cycleBits(number, propCount * i) % cap];
                 if (prop.id == number) return &prop;
             }
             
             // Try to find the property by linearly iterating over the map!
             for (uint32 start = number % propCount, index = start + 1; index != start; index = (index + 1) % propCount) {
-                if (props[index].id == number) return props + index;
+                if (props()[index].id == number) return props() + index;
             }
             
             return nullptr;
@@ -179,23 +176,28 @@ namespace Neuro {
             
             Pointer self(rawptr);
             new (self.get()) Object(self, totalPropsCount);
+            
+            // Allows the GC to trace newborn Objects off their cards before
+            // it first reaches them.
+            GC::getOverhead(self)->isObject = true;
             return self;
         }
         
         Pointer Object::recreateObject(Pointer object, uint32 propsCount, uint32 propsSlack) {
             // TODO: More dynamic algorithm for property map upsizing
             const uint32 totalPropsCount = propsCount + propsSlack;
-			auto oldptr = object.get();
             
             // Only recreate if we're actually resizing!
             if (totalPropsCount == object->propCount) return object;
             
-            Error err = GC::instance()->reallocate(object, sizeof(Object) + sizeof(Property) * totalPropsCount, 1, false);
+            // Construct the new Object before the GC publishes it, as it may
+            // trace the Object as soon as it is published.
+            auto construct = [&](void* newBuffer, void* oldBuffer) {
+                new (newBuffer) Object(object, reinterpret_cast<Object*>(oldBuffer), totalPropsCount);
+            };
+            Error err = GC::instance()->reallocate(object, sizeof(Object) + sizeof(Property) * totalPropsCount, 1, GCInterface::ReallocateDelegate::fromLambda(construct));
             if (err) return Pointer();
             
-			auto newptr = object.get();
-            
-            new (object.get()) Object(object, oldptr, totalPropsCount);
             return object;
         }
     }
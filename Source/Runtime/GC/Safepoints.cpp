@@ -0,0 +1,159 @@
+////////////////////////////////////////////////////////////////////////////////
+// Implementation of mutator registration and the stop-the-world handshake.
+// -----
+// Copyright (c) Kiruse 2018
+// License: GPL 3.0
+#include <condition_variable>
+#include <mutex>
+
+#include "GC/Safepoints.hpp"
+#include "NeuroBuffer.hpp"
+
+namespace Neuro {
+    namespace Runtime
+    {
+        ////////////////////////////////////////////////////////////////////////
+        // Statics
+        ////////////////////////////////////////////////////////////////////////
+        
+        std::atomic<bool> Safepoints::stopRequested(false);
+        
+        /**
+         * Guards the states of all registered mutators and the stop. Every
+         * transition of a registered thread notifies `safepointNotif`, which
+         * both the stopping thread and the parked threads wait on.
+         */
+        std::mutex safepointMutex;
+        std::condition_variable safepointNotif;
+        
+        struct MutatorState;
+        Buffer<MutatorState*> registeredMutators;
+        
+        /**
+         * Whether a thread currently has the world stopped, as opposed to
+         * merely attempting to.
+         */
+        bool worldStopped = false;
+        
+        struct MutatorState {
+            uint32 registrations = 0;
+            uint32 state = EMutatorState::Detached;
+            
+            ~MutatorState() {
+                // Threads exiting without unregistering must not be waited for.
+                if (!registrations) return;
+                std::scoped_lock lock(safepointMutex);
+                registeredMutators.remove(this);
+                safepointNotif.notify_all();
+            }
+        };
+        thread_local MutatorState localMutator;
+        
+        
+        ////////////////////////////////////////////////////////////////////////
+        // Mutators
+        ////////////////////////////////////////////////////////////////////////
+        
+        void Safepoints::registerThread() {
+            MutatorState& self = localMutator;
+            if (self.registrations++) return;
+            
+            std::scoped_lock lock(safepointMutex);
+            self.state = EMutatorState::Running;
+            registeredMutators.add(&self);
+        }
+        
+        void Safepoints::unregisterThread() {
+            MutatorState& self = localMutator;
+            if (!self.registrations || --self.registrations) return;
+            
+            std::scoped_lock lock(safepointMutex);
+            self.state = EMutatorState::Detached;
+            registeredMutators.remove(&self);
+            safepointNotif.notify_all();
+        }
+        
+        bool Safepoints::isRegistered() {
+            return localMutator.registrations > 0;
+        }
+        
+        uint32 Safepoints::countThreads() {
+            std::scoped_lock lock(safepointMutex);
+            return registeredMutators.length();
+        }
+        
+        void Safepoints::park() {
+            MutatorState& self = localMutator;
+            if (!self.registrations || self.state != EMutatorState::Running) return;
+            
+            std::unique_lock<std::mutex> lock(safepointMutex);
+            self.state = EMutatorState::Parked;
+            safepointNotif.notify_all();
+            safepointNotif.wait(lock, []() { return !stopRequested.load(std::memory_order_relaxed); });
+            self.state = EMutatorState::Running;
+        }
+        
+        void Safepoints::enterSafeRegion() {
+            MutatorState& self = localMutator;
+            if (!self.registrations) return;
+            
+            std::scoped_lock lock(safepointMutex);
+            self.state = EMutatorState::Safe;
+            safepointNotif.notify_all();
+        }
+        
+        void Safepoints::leaveSafeRegion() {
+            MutatorState& self = localMutator;
+            if (!self.registrations) return;
+            
+            std::unique_lock<std::mutex> lock(safepointMutex);
+            safepointNotif.wait(lock, []() { return !stopRequested.load(std::memory_order_relaxed); });
+            self.state = EMutatorState::Running;
+        }
+        
+        
+        ////////////////////////////////////////////////////////////////////////
+        // Handshake
+        ////////////////////////////////////////////////////////////////////////
+        
+        bool Safepoints::stop(std::chrono::microseconds timeout) {
+            const auto deadline = std::chrono::steady_clock::now() + timeout;
+            MutatorState& self = localMutator;
+            
+            std::unique_lock<std::mutex> lock(safepointMutex);
+            
+            // Wait for a concurrent stop to end. The calling thread does not
+            // touch managed memory meanwhile, hence counts as parked.
+            const uint32 previous = self.state;
+            if (self.registrations) self.state = EMutatorState::Parked;
+            safepointNotif.notify_all();
+            const bool available = safepointNotif.wait_until(lock, deadline, []() { return !stopRequested.load(std::memory_order_relaxed); });
+            self.state = previous;
+            if (!available) return false;
+            
+            stopRequested.store(true, std::memory_order_release);
+            const bool stopped = safepointNotif.wait_until(lock, deadline, [&self]() {
+                for (auto* mutator : registeredMutators) {
+                    if (mutator != &self && mutator->state == EMutatorState::Running) return false;
+                }
+                return true;
+            });
+            
+            if (!stopped) {
+                stopRequested.store(false, std::memory_order_release);
+                safepointNotif.notify_all();
+                return false;
+            }
+            worldStopped = true;
+            return true;
+        }
+        
+        void Safepoints::resume() {
+            std::scoped_lock lock(safepointMutex);
+            if (!worldStopped) return;
+            worldStopped = false;
+            stopRequested.store(false, std::memory_order_release);
+            safepointNotif.notify_all();
+        }
+    }
+}
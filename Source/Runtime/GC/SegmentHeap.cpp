@@ -0,0 +1,142 @@
+////////////////////////////////////////////////////////////////////////////////
+// Implementation of the virtual memory backing the GC's segments.
+// -----
+// Copyright (c) Kiruse 2018
+// License: GPL 3.0
+#include "GC/SegmentHeap.hpp"
+#include "Platform/Broker.hpp"
+
+namespace Neuro {
+    namespace Runtime
+    {
+        ////////////////////////////////////////////////////////////////////////
+        // RAII
+        ////////////////////////////////////////////////////////////////////////
+        
+        SegmentHeap::SegmentHeap(size_t reservedBytes)
+         : mutex()
+         , base(nullptr)
+         , reservedBytes(reservedBytes / GranuleSize * GranuleSize)
+         , reserveFailed(false)
+         , used()
+         , committedBytes(0)
+         , hugePages(false)
+        {}
+        
+        SegmentHeap::~SegmentHeap() {
+            if (base) Platform::unmapPages(base, reservedBytes);
+        }
+        
+        
+        ////////////////////////////////////////////////////////////////////////
+        // Methods
+        ////////////////////////////////////////////////////////////////////////
+        
+        void* SegmentHeap::allocate(size_t bytes) {
+            const size_t count = (bytes + GranuleSize - 1) / GranuleSize;
+            bytes = count * GranuleSize;
+            void* addr = nullptr;
+            
+            {
+                std::scoped_lock lock(mutex);
+                
+                // Reserving is deferred so that merely linking the runtime
+                // does not claim any address space.
+                if (!base && !reserveFailed && reservedBytes) {
+                    base = reinterpret_cast<uint8*>(Platform::reservePages(reservedBytes, GranuleSize));
+                    reserveFailed = !base;
+                    if (base) {
+                        const uint32 numWords = (countGranules() + 63) / 64;
+                        used.reset(new uint64[numWords]());
+                    }
+                }
+                
+                const uint32 first = base && count <= countGranules() ? findUnused(static_cast<uint32>(count)) : npos;
+                if (first != npos) {
+                    addr = base + size_t(first) * GranuleSize;
+                    if (Platform::commitPages(addr, bytes)) {
+                        setUsed(first, static_cast<uint32>(count), true);
+                    }
+                    else {
+                        addr = nullptr;
+                    }
+                }
+            }
+            
+            // Beyond the reservation, every segment is mapped on its own.
+            if (!addr) addr = Platform::mapPages(bytes, GranuleSize);
+            if (!addr) return nullptr;
+            
+            // Only effective before the pages are first touched.
+            if (hugePages.load(std::memory_order_relaxed)) {
+                Platform::adviseHugePages(addr, bytes);
+            }
+            
+            committedBytes.fetch_add(bytes, std::memory_order_relaxed);
+            onAllocate(bytes);
+            return addr;
+        }
+        
+        void SegmentHeap::free(void* addr, size_t bytes) {
+            bytes = (bytes + GranuleSize - 1) / GranuleSize * GranuleSize;
+            committedBytes.fetch_sub(bytes, std::memory_order_relaxed);
+            
+            if (!contains(addr)) {
+                Platform::unmapPages(addr, bytes);
+                return;
+            }
+            
+            // Decommit before the granules may be handed out again.
+            Platform::decommitPages(addr, bytes);
+            
+            std::scoped_lock lock(mutex);
+            const uint32 first = static_cast<uint32>((reinterpret_cast<uint8*>(addr) - base) / GranuleSize);
+            setUsed(first, static_cast<uint32>(bytes / GranuleSize), false);
+        }
+        
+        void SegmentHeap::discard(void* addr, size_t bytes) {
+            const uintptr_t pageMask = Platform::getPageSize() - 1;
+            const uintptr_t begin = (reinterpret_cast<uintptr_t>(addr) + pageMask) & ~pageMask;
+            const uintptr_t end = (reinterpret_cast<uintptr_t>(addr) + bytes) & ~pageMask;
+            if (begin < end) Platform::discardPages(reinterpret_cast<void*>(begin), end - begin);
+        }
+        
+        
+        ////////////////////////////////////////////////////////////////////////
+        // Helpers
+        ////////////////////////////////////////////////////////////////////////
+        
+        uint32 SegmentHeap::findUnused(uint32 count) const {
+            // First fit. Segments are created rarely enough for a linear scan,
+            // and most of them span a single granule anyway.
+            const uint32 numGranules = countGranules();
+            uint32 runStart = 0;
+            uint32 runLength = 0;
+            for (uint32 granule = 0; granule < numGranules; ++granule) {
+                // Skip entirely used words at once.
+                if (granule % 64 == 0 && used[granule / 64] == ~uint64(0)) {
+                    granule += 63;
+                    runLength = 0;
+                    continue;
+                }
+                
+                if (used[granule / 64] & (uint64(1) << (granule % 64))) {
+                    runLength = 0;
+                    continue;
+                }
+                
+                if (!runLength++) runStart = granule;
+                if (runLength == count) return runStart;
+            }
+            return npos;
+        }
+        
+        void SegmentHeap::setUsed(uint32 first, uint32 count, bool value) {
+            for (uint32 granule = first; granule < first + count; ++granule) {
+                const uint64 mask = uint64(1) << (granule % 64);
+                if (value) used[granule / 64] |= mask;
+                else used[granule / 64] &= ~mask;
+            }
+        }
+    }
+}
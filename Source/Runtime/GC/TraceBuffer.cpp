@@ -0,0 +1,152 @@
+////////////////////////////////////////////////////////////////////////////////
+// Implementation of the GC's trace event ring buffer.
+// -----
+// Copyright (c) Kiruse 2018
+// License: GPL 3.0
+#include <algorithm>
+#include <iomanip>
+#include <unordered_map>
+
+#include "GC/TraceBuffer.hpp"
+
+namespace Neuro {
+    namespace Runtime
+    {
+        ////////////////////////////////////////////////////////////////////////
+        // Statics
+        ////////////////////////////////////////////////////////////////////////
+        
+        std::atomic<uint32> nextTraceThreadId(1);
+        thread_local uint32 traceThreadId = 0;
+        
+        uint32 getTraceThreadId() {
+            if (!traceThreadId) traceThreadId = nextTraceThreadId.fetch_add(1, std::memory_order_relaxed);
+            return traceThreadId;
+        }
+        
+        /**
+         * Rounds the capacity up to the next power of two, so that slots are
+         * found by masking the event index.
+         */
+        uint32 getTraceMask(uint32 capacity) {
+            uint32 size = 2;
+            while (size < capacity && size < (1u << 31)) size <<= 1;
+            return size - 1;
+        }
+        
+        void writeTraceString(std::ostream& out, const char* str) {
+            out << '"';
+            for (; *str; ++str) {
+                if (*str == '"' || *str == '\\') out << '\\';
+                out << *str;
+            }
+            out << '"';
+        }
+        
+        
+        ////////////////////////////////////////////////////////////////////////
+        // RAII
+        ////////////////////////////////////////////////////////////////////////
+        
+        TraceBuffer::TraceBuffer(uint32 capacity)
+         : slots()
+         , mask(getTraceMask(capacity))
+         , head(0)
+         , tail(0)
+        {
+            slots.reset(new Slot[mask + 1]);
+            for (uint32 i = 0; i <= mask; ++i) {
+                slots[i].sequence.store(0, std::memory_order_relaxed);
+            }
+        }
+        
+        
+        ////////////////////////////////////////////////////////////////////////
+        // Methods
+        ////////////////////////////////////////////////////////////////////////
+        
+        void TraceBuffer::record(char phase, const char* name, const char* argName, uint64 arg) {
+            const uint64 timestamp = now();
+            const uint64 index = head.fetch_add(1, std::memory_order_relaxed);
+            Slot& slot = slots[index & mask];
+            
+            // Readers must not mistake the slot for complete before all of
+            // its fields have been overwritten.
+            slot.sequence.store(0, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            
+            slot.name.store(name, std::memory_order_relaxed);
+            slot.argName.store(argName, std::memory_order_relaxed);
+            slot.arg.store(arg, std::memory_order_relaxed);
+            slot.timestamp.store(timestamp, std::memory_order_relaxed);
+            slot.threadId.store(getTraceThreadId(), std::memory_order_relaxed);
+            slot.phase.store(phase, std::memory_order_relaxed);
+            slot.sequence.store(index + 1, std::memory_order_release);
+        }
+        
+        void TraceBuffer::collect(Buffer<Event>& events) const {
+            const uint64 last = head.load(std::memory_order_acquire);
+            const uint64 first = std::max(tail.load(std::memory_order_acquire), last > capacity() ? last - capacity() : 0);
+            
+            for (uint64 index = first; index < last; ++index) {
+                const Slot& slot = slots[index & mask];
+                if (slot.sequence.load(std::memory_order_acquire) != index + 1) continue;
+                
+                Event event;
+                event.name = slot.name.load(std::memory_order_relaxed);
+                event.argName = slot.argName.load(std::memory_order_relaxed);
+                event.arg = slot.arg.load(std::memory_order_relaxed);
+                event.timestamp = slot.timestamp.load(std::memory_order_relaxed);
+                event.threadId = slot.threadId.load(std::memory_order_relaxed);
+                event.phase = slot.phase.load(std::memory_order_relaxed);
+                
+                // Overwritten while copying.
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (slot.sequence.load(std::memory_order_relaxed) != index + 1) continue;
+                
+                events.add(event);
+            }
+        }
+        
+        void TraceBuffer::writeChromeTrace(std::ostream& out) const {
+            Buffer<Event> events;
+            collect(events);
+            
+            // Number of spans open per thread. An end without an open span
+            // belongs to a beginning which has been overwritten.
+            std::unordered_map<uint32, uint32> depths;
+            
+            out << "{\"traceEvents\":[";
+            bool first = true;
+            for (const Event& event : events) {
+                uint32& depth = depths[event.threadId];
+                if (event.phase == 'B') ++depth;
+                else if (event.phase == 'E') {
+                    if (!depth) continue;
+                    --depth;
+                }
+                
+                if (!first) out << ',';
+                first = false;
+                
+                out << "{\"name\":";
+                writeTraceString(out, event.name);
+                out << ",\"cat\":\"gc\",\"ph\":\"" << event.phase << '"';
+                out << ",\"ts\":" << event.timestamp / 1000 << '.' << std::setw(3) << std::setfill('0') << event.timestamp % 1000 << std::setfill(' ');
+                out << ",\"pid\":0,\"tid\":" << event.threadId;
+                if (event.phase == 'i') out << ",\"s\":\"t\"";
+                if (event.argName) {
+                    out << ",\"args\":{";
+                    writeTraceString(out, event.argName);
+                    out << ':' << event.arg << '}';
+                }
+                out << '}';
+            }
+            out << "],\"displayTimeUnit\":\"ms\"}";
+        }
+        
+        void TraceBuffer::clear() {
+            tail.store(head.load(std::memory_order_acquire), std::memory_order_release);
+        }
+    }
+}
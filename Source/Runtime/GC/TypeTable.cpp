@@ -0,0 +1,91 @@
+////////////////////////////////////////////////////////////////////////////////
+// Implementation of the table of non-trivial managed types.
+// -----
+// Copyright (c) Kiruse 2018
+// License: GPL 3.0
+#include <algorithm>
+#include <mutex>
+
+#include "GC/TypeTable.hpp"
+
+namespace Neuro {
+    namespace Runtime
+    {
+        ////////////////////////////////////////////////////////////////////////
+        // Statics
+        ////////////////////////////////////////////////////////////////////////
+        
+        std::atomic<TypeDescriptor*> TypeTable::pages[TypeTable::NumPages] = {};
+        
+        /**
+         * Serializes registrations. Ids are handed out in order, starting at 1.
+         */
+        std::mutex typeTableMutex;
+        uint32 nextTypeId = 1;
+        
+        
+        ////////////////////////////////////////////////////////////////////////
+        // PointerOffsets
+        ////////////////////////////////////////////////////////////////////////
+        
+        bool equalOffsets(const Buffer<uint32>& offsets, const uint32* other, uint32 count) {
+            if (offsets.length() != count) return false;
+            for (uint32 i = 0; i < count; ++i) {
+                if (offsets[i] != other[i]) return false;
+            }
+            return true;
+        }
+        
+        bool PointerOffsets::operator==(const PointerOffsets& other) const {
+            return equalOffsets(objects, other.objects.data(), other.objects.length()) && equalOffsets(memory, other.memory.data(), other.memory.length());
+        }
+        
+        
+        ////////////////////////////////////////////////////////////////////////
+        // Static Methods
+        ////////////////////////////////////////////////////////////////////////
+        
+        uint16 TypeTable::registerType(const Delegate<void, void*, const void*>& copy, const Delegate<void, void*>& destroy, const PointerOffsets& pointers, const Delegate<void, void* const*, uint32>* destroyBatch) {
+            std::scoped_lock lock(typeTableMutex);
+            
+            // Types are registered once each, hence a linear search suffices.
+            for (uint32 id = 1; id < nextTypeId; ++id) {
+                const TypeDescriptor& type = get(id);
+                if (type.copyDelegate.get() == copy && type.destroyDelegate.get() == destroy
+                 && equalOffsets(pointers.objects, type.getObjectOffsets(), type.numObjectPointers)
+                 && equalOffsets(pointers.memory, type.getMemoryOffsets(), type.numMemoryPointers))
+                {
+                    return id;
+                }
+            }
+            if (nextTypeId > MaxTypes) return 0;
+            
+            const uint32 id = nextTypeId;
+            TypeDescriptor* page = pages[id / PageSize].load(std::memory_order_relaxed);
+            if (!page) page = new TypeDescriptor[PageSize];
+            
+            TypeDescriptor& type = page[id % PageSize];
+            type.copyDelegate.construct([&](auto* target) { copy.copyTo(target); });
+            type.destroyDelegate.construct([&](auto* target) { destroy.copyTo(target); });
+            if (destroyBatch) type.destroyBatchDelegate.construct([&](auto* target) { destroyBatch->copyTo(target); });
+            
+            if (!pointers.empty()) {
+                type.numObjectPointers = pointers.objects.length();
+                type.numMemoryPointers = pointers.memory.length();
+                type.pointerOffsets = new uint32[type.numObjectPointers + type.numMemoryPointers];
+                std::copy(pointers.objects.begin(), pointers.objects.end(), type.pointerOffsets);
+                std::copy(pointers.memory.begin(), pointers.memory.end(), type.pointerOffsets + type.numObjectPointers);
+            }
+            
+            // Publish the page only once the descriptor is complete.
+            pages[id / PageSize].store(page, std::memory_order_release);
+            ++nextTypeId;
+            return id;
+        }
+        
+        uint32 TypeTable::countTypes() {
+            std::scoped_lock lock(typeTableMutex);
+            return nextTypeId - 1;
+        }
+    }
+}
@@ -3,13 +3,68 @@
 // -----
 // Copyright (c) Kiruse 2018 Germany
 // License: GNU GPL 3.0
+#include <cstdlib>
+#include <cstring>
+
 #include "Platform/PlatformGeneric.hpp"
 
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
 namespace Neuro {
     namespace Platform {
         namespace Generic
         {
+            void* mapPages(size_t bytes, size_t alignment) {
+                // Without any means to map pages, fall back to the heap. MSVC
+                // lacks std::aligned_alloc since its free cannot release it.
+#ifdef _WIN32
+                void* result = _aligned_malloc(bytes, alignment);
+#else
+                void* result = std::aligned_alloc(alignment, bytes);
+#endif
+                if (result) std::memset(result, 0, bytes);
+                return result;
+            }
+            
+            void unmapPages(void* addr, size_t) {
+#ifdef _WIN32
+                _aligned_free(addr);
+#else
+                std::free(addr);
+#endif
+            }
+            
+            void* reservePages(size_t, size_t) {
+                // Address space cannot be reserved without committing it.
+                return nullptr;
+            }
+            
+            bool commitPages(void*, size_t) {
+                return true;
+            }
+            
+            void decommitPages(void*, size_t) {}
+            void discardPages(void*, size_t) {}
+            
+            bool adviseHugePages(void*, size_t) {
+                return false;
+            }
+            
+            size_t getPageSize() {
+                return 4096;
+            }
+            
+            uint32_t captureBacktrace(void**, uint32_t, uint32_t) {
+                return 0;
+            }
             
+            bool describeAddress(const void*, std::string& function, std::string& module) {
+                function.clear();
+                module.clear();
+                return false;
+            }
         }
     }
 }
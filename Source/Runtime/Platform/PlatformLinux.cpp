@@ -5,11 +5,23 @@
 // License: GNU GPL 3.0
 #include "Platform/PlatformLinux.hpp"
 
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
 namespace Neuro {
     namespace Platform {
         namespace Linux
         {
-            
+#ifdef __linux__
+            bool adviseHugePages(void* addr, size_t bytes) {
+#ifdef MADV_HUGEPAGE
+                return !madvise(addr, bytes, MADV_HUGEPAGE);
+#else
+                return false;
+#endif
+            }
+#endif
         }
     }
-}
\ No newline at end of file
+}
@@ -3,13 +3,125 @@
 // -----
 // Copyright (c) Kiruse 2018 Germany
 // License: GNU GPL 3.0
+#include <algorithm>
+
 #include "Platform/PlatformUnix.hpp"
 
+#ifndef _WIN32
+#include <cstdint>
+#include <cstdlib>
+#include <dlfcn.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#if __has_include(<execinfo.h>)
+#include <execinfo.h>
+#define NEURO_HAS_EXECINFO
+#endif
+#ifdef __GNUC__
+#include <cxxabi.h>
+#endif
+#endif
+
 namespace Neuro {
     namespace Platform {
         namespace Unix
         {
+#ifndef _WIN32
+            /**
+             * mmap merely guarantees page alignment. Map enough to contain an
+             * aligned range and unmap the excess on either side.
+             */
+            void* mapAligned(size_t bytes, size_t alignment, int protection, int flags) {
+                const size_t mapped = bytes + alignment;
+                void* result = mmap(nullptr, mapped, protection, flags, -1, 0);
+                if (result == MAP_FAILED) return nullptr;
+                
+                char* begin = reinterpret_cast<char*>(result);
+                char* aligned = reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(begin) + alignment - 1) & ~(uintptr_t(alignment) - 1));
+                if (aligned != begin) munmap(begin, aligned - begin);
+                if (aligned + bytes != begin + mapped) munmap(aligned + bytes, begin + mapped - (aligned + bytes));
+                return aligned;
+            }
+            
+            void* mapPages(size_t bytes, size_t alignment) {
+                return mapAligned(bytes, alignment, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS);
+            }
+            
+            void unmapPages(void* addr, size_t bytes) {
+                munmap(addr, bytes);
+            }
+            
+            void* reservePages(size_t bytes, size_t alignment) {
+                // Inaccessible pages are not accounted against the commit
+                // limit, but the kernel still needs to be told not to reserve
+                // swap for them.
+                int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#ifdef MAP_NORESERVE
+                flags |= MAP_NORESERVE;
+#endif
+                return mapAligned(bytes, alignment, PROT_NONE, flags);
+            }
+            
+            bool commitPages(void* addr, size_t bytes) {
+                return !mprotect(addr, bytes, PROT_READ | PROT_WRITE);
+            }
+            
+            void decommitPages(void* addr, size_t bytes) {
+                madvise(addr, bytes, MADV_DONTNEED);
+                mprotect(addr, bytes, PROT_NONE);
+            }
+            
+            void discardPages(void* addr, size_t bytes) {
+                madvise(addr, bytes, MADV_DONTNEED);
+            }
+            
+            bool adviseHugePages(void*, size_t) {
+                return false;
+            }
+            
+            size_t getPageSize() {
+                static const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+                return pageSize;
+            }
+            
+            uint32_t captureBacktrace(void** frames, uint32_t maxFrames, uint32_t skip) {
+#ifdef NEURO_HAS_EXECINFO
+                // backtrace cannot skip frames itself, hence capture into a
+                // scratch buffer large enough for the skipped frames as well.
+                void* scratch[128];
+                const int wanted = static_cast<int>(std::min<uint32_t>(maxFrames + skip + 1, 128));
+                const int captured = backtrace(scratch, wanted);
+                const int first = static_cast<int>(skip) + 1;
+                if (captured <= first) return 0;
+                
+                const uint32_t count = std::min<uint32_t>(captured - first, maxFrames);
+                for (uint32_t i = 0; i < count; ++i) frames[i] = scratch[first + i];
+                return count;
+#else
+                return 0;
+#endif
+            }
             
+            bool describeAddress(const void* addr, std::string& function, std::string& module) {
+                function.clear();
+                module.clear();
+                
+                Dl_info info;
+                if (!dladdr(addr, &info)) return false;
+                if (info.dli_fname) module = info.dli_fname;
+                if (info.dli_sname) {
+#ifdef __GNUC__
+                    int status = 0;
+                    char* demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+                    function = demangled && !status ? demangled : info.dli_sname;
+                    std::free(demangled);
+#else
+                    function = info.dli_sname;
+#endif
+                }
+                return true;
+            }
+#endif
         }
     }
 }
@@ -3,13 +3,89 @@
 // -----
 // Copyright (c) Kiruse 2018 Germany
 // License: GNU GPL 3.0
+#include <cstdint>
+
 #include "Platform/PlatformWindows.hpp"
 
 namespace Neuro {
     namespace Platform {
         namespace Windows
         {
+            /**
+             * Parts of a reservation cannot be released. Instead, find an
+             * aligned address within an oversized reservation, release it, and
+             * allocate exactly the aligned range. Another thread may snatch the
+             * range in between, in which case we simply try again.
+             */
+            void* allocateAligned(size_t bytes, size_t alignment, DWORD type, DWORD protection) {
+                for (int attempt = 0; attempt < 8; ++attempt) {
+                    void* probe = VirtualAlloc(nullptr, bytes + alignment, MEM_RESERVE, PAGE_NOACCESS);
+                    if (!probe) return nullptr;
+                    
+                    const uintptr_t aligned = (reinterpret_cast<uintptr_t>(probe) + alignment - 1) & ~(uintptr_t(alignment) - 1);
+                    VirtualFree(probe, 0, MEM_RELEASE);
+                    
+                    if (void* result = VirtualAlloc(reinterpret_cast<void*>(aligned), bytes, type, protection)) {
+                        return result;
+                    }
+                }
+                return nullptr;
+            }
+            
+            void* mapPages(size_t bytes, size_t alignment) {
+                return allocateAligned(bytes, alignment, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+            }
+            
+            void unmapPages(void* addr, size_t) {
+                VirtualFree(addr, 0, MEM_RELEASE);
+            }
+            
+            void* reservePages(size_t bytes, size_t alignment) {
+                return allocateAligned(bytes, alignment, MEM_RESERVE, PAGE_NOACCESS);
+            }
+            
+            bool commitPages(void* addr, size_t bytes) {
+                return VirtualAlloc(addr, bytes, MEM_COMMIT, PAGE_READWRITE) != nullptr;
+            }
+            
+            void decommitPages(void* addr, size_t bytes) {
+                VirtualFree(addr, bytes, MEM_DECOMMIT);
+            }
+            
+            void discardPages(void* addr, size_t bytes) {
+                VirtualAlloc(addr, bytes, MEM_RESET, PAGE_READWRITE);
+            }
+            
+            bool adviseHugePages(void*, size_t) {
+                // Large pages need to be allocated as such up front and
+                // require a privilege most processes lack.
+                return false;
+            }
+            
+            size_t getPageSize() {
+                SYSTEM_INFO info;
+                GetSystemInfo(&info);
+                return info.dwPageSize;
+            }
+            
+            uint32_t captureBacktrace(void** frames, uint32_t maxFrames, uint32_t skip) {
+                return CaptureStackBackTrace(skip + 1, maxFrames, frames, nullptr);
+            }
             
+            bool describeAddress(const void* addr, std::string& function, std::string& module) {
+                // Function names require DbgHelp and the program's symbols,
+                // which pprof can resolve offline from the module instead.
+                function.clear();
+                module.clear();
+                
+                HMODULE handle;
+                if (!GetModuleHandleExA(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT, reinterpret_cast<LPCSTR>(addr), &handle)) return false;
+                
+                char path[MAX_PATH];
+                const DWORD length = GetModuleFileNameA(handle, path, MAX_PATH);
+                if (length) module.assign(path, length);
+                return true;
+            }
         }
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,184 @@
+////////////////////////////////////////////////////////////////////////////////
+// Offline analyzer of heap snapshots written by `GC::dumpHeap`. Reports the
+// memory retained by every root, the distribution of objects by their number
+// of properties, the fragmentation of every segment, and the dominator tree of
+// the object graph down to the given depth, listing only the largest subtrees
+// on every level.
+//
+// Usage: NeuroHeap <snapshot> [depth] [subtrees per level]
+// -----
+// Copyright (c) Kiruse 2018
+// License: GPL 3.0
+#include "GC/HeapAnalysis.hpp"
+#include "GC/HeapSnapshot.hpp"
+
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+using namespace Neuro;
+using namespace Neuro::Runtime;
+
+
+std::string formatBytes(uint64 bytes) {
+    static const char* const units[] = { "B", "KB", "MB", "GB", "TB" };
+    double value = static_cast<double>(bytes);
+    uint32 unit = 0;
+    while (value >= 1024 && unit < 4) {
+        value /= 1024;
+        ++unit;
+    }
+    
+    std::ostringstream out;
+    if (unit) out << std::fixed << std::setprecision(1);
+    out << value << ' ' << units[unit];
+    return out.str();
+}
+
+std::string describeSegment(uint32 flags) {
+    std::string kind = flags & EHeapSegmentFlags::Large ? "large" : flags & EHeapSegmentFlags::Dormant ? "old" : "nursery";
+    return kind + (flags & EHeapSegmentFlags::Trivial ? " trivial" : "");
+}
+
+/**
+ * Finds the property through which the dominator refers to the node, if it
+ * refers to it directly at all. Objects below the virtual root are either
+ * roots or shared between several roots.
+ */
+std::string describeEdge(const HeapAnalysis& analysis, const HeapSnapshot& snapshot, uint32 dominator, uint32 node) {
+    if (dominator == analysis.getVirtualRoot()) {
+        for (uint32 root : snapshot.roots) {
+            if (root == analysis.getObject(node).tableIndex) return "root ";
+        }
+        return "shared ";
+    }
+    
+    const auto& object = analysis.getObject(dominator);
+    for (uint32 i = 0; i < object.numReferences; ++i) {
+        const auto& reference = snapshot.references[object.firstReference + i];
+        if (reference.target == analysis.getObject(node).tableIndex) {
+            return "prop " + std::to_string(reference.propertyId) + " -> ";
+        }
+    }
+    return "";
+}
+
+void printDominated(const HeapAnalysis& analysis, const HeapSnapshot& snapshot, uint32 node, uint32 depth, uint32 maxDepth, uint32 maxChildren) {
+    Buffer<uint32> dominated;
+    analysis.getDominated(node, dominated);
+    
+    uint64 restBytes = 0;
+    uint32 restObjects = 0;
+    for (uint32 i = 0; i < dominated.length(); ++i) {
+        const uint32 child = dominated[i];
+        if (i >= maxChildren) {
+            restBytes += analysis.getRetainedBytes(child);
+            restObjects += analysis.getRetainedObjects(child);
+            continue;
+        }
+        
+        const auto& object = analysis.getObject(child);
+        std::cout << std::string(2 * depth + 2, ' ')
+                  << describeEdge(analysis, snapshot, node, child) << '#' << object.tableIndex
+                  << "  retained " << formatBytes(analysis.getRetainedBytes(child))
+                  << " in " << analysis.getRetainedObjects(child) << " objects"
+                  << ", shallow " << formatBytes(analysis.getShallowBytes(child))
+                  << ", " << object.numProperties << " properties" << std::endl;
+                  
+        if (depth + 1 < maxDepth) printDominated(analysis, snapshot, child, depth + 1, maxDepth, maxChildren);
+    }
+    
+    if (restObjects) {
+        std::cout << std::string(2 * depth + 2, ' ') << "... " << dominated.length() - maxChildren << " more retaining "
+                  << formatBytes(restBytes) << " in " << restObjects << " objects" << std::endl;
+    }
+}
+
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "Usage: NeuroHeap <snapshot> [depth] [subtrees per level]" << std::endl;
+        return 1;
+    }
+    const uint32 maxDepth    = argc > 2 ? std::atoi(argv[2]) : 4;
+    const uint32 maxChildren = argc > 3 ? std::atoi(argv[3]) : 5;
+    
+    HeapSnapshot snapshot;
+    {
+        std::ifstream file(argv[1], std::ios::binary);
+        if (!file) {
+            std::cerr << "Cannot open " << argv[1] << std::endl;
+            return 1;
+        }
+        
+        Error error = snapshot.read(file);
+        if (error) {
+            std::cerr << "Cannot read " << argv[1] << ": " << error.message() << std::endl;
+            return 1;
+        }
+    }
+    
+    HeapAnalysis analysis(snapshot);
+    std::cout << "Snapshot of " << snapshot.segments.length() << " segments, " << snapshot.blocks.length() << " blocks, "
+              << snapshot.records.length() << " table records, " << snapshot.objects.length() << " objects and "
+              << snapshot.roots.length() << " roots" << std::endl;
+              
+              
+    std::cout << std::endl << "Retained size by root" << std::endl;
+    Buffer<HeapAnalysis::RootSummary> roots;
+    analysis.summarizeRoots(roots);
+    for (const auto& root : roots) {
+        std::cout << "  #" << std::left << std::setw(10) << root.tableIndex << std::right
+                  << std::setw(12) << formatBytes(root.retainedBytes) << std::setw(10) << root.retainedObjects << " objects" << std::endl;
+    }
+    
+    const uint32 virtualRoot = analysis.getVirtualRoot();
+    uint64 sharedBytes = analysis.getRetainedBytes(virtualRoot), unreachableBytes = 0;
+    uint32 sharedObjects = analysis.getRetainedObjects(virtualRoot), unreachableObjects = 0;
+    for (const auto& root : roots) {
+        sharedBytes -= root.retainedBytes;
+        sharedObjects -= root.retainedObjects;
+    }
+    for (uint32 node = 0; node < analysis.countNodes(); ++node) {
+        if (analysis.isReachable(node)) continue;
+        unreachableBytes += analysis.getShallowBytes(node);
+        ++unreachableObjects;
+    }
+    std::cout << "  shared     " << std::setw(12) << formatBytes(sharedBytes) << std::setw(10) << sharedObjects << " objects" << std::endl;
+    std::cout << "  unreachable" << std::setw(12) << formatBytes(unreachableBytes) << std::setw(10) << unreachableObjects << " objects" << std::endl;
+    
+    
+    std::cout << std::endl << "Objects by property count" << std::endl;
+    Buffer<HeapAnalysis::PropertyBucket> buckets;
+    analysis.summarizePropertyCounts(buckets);
+    for (const auto& bucket : buckets) {
+        if (!bucket.numObjects) continue;
+        
+        std::string range = std::to_string(bucket.minProperties);
+        if (bucket.maxProperties != bucket.minProperties) range += "-" + std::to_string(bucket.maxProperties);
+        std::cout << "  " << std::left << std::setw(12) << range << std::right
+                  << std::setw(10) << bucket.numObjects << " objects" << std::setw(12) << formatBytes(bucket.bytes) << std::endl;
+    }
+    
+    
+    std::cout << std::endl << "Segments" << std::endl;
+    std::cout << "  " << std::left << std::setw(20) << "kind" << std::right << std::setw(12) << "used" << std::setw(12) << "live"
+              << std::setw(12) << "free" << std::setw(12) << "free blocks" << std::setw(14) << "largest free" << std::setw(15) << "fragmentation" << std::endl;
+    Buffer<HeapAnalysis::SegmentSummary> segments;
+    analysis.summarizeSegments(segments);
+    for (const auto& segment : segments) {
+        std::cout << "  " << std::left << std::setw(20) << describeSegment(snapshot.segments[segment.segment].flags) << std::right
+                  << std::setw(12) << formatBytes(segment.usedBytes) << std::setw(12) << formatBytes(segment.liveBytes)
+                  << std::setw(12) << formatBytes(segment.freeBytes) << std::setw(12) << segment.numFreeBlocks
+                  << std::setw(14) << formatBytes(segment.largestFreeBlock)
+                  << std::setw(14) << std::fixed << std::setprecision(1) << segment.fragmentation * 100 << '%' << std::endl;
+    }
+    
+    
+    std::cout << std::endl << "Dominator tree" << std::endl;
+    printDominated(analysis, snapshot, virtualRoot, 0, maxDepth, maxChildren);
+    return 0;
+}
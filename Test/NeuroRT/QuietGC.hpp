@@ -0,0 +1,51 @@
+////////////////////////////////////////////////////////////////////////////////
+// Helpers shared by the GC's unit tests and benchmarks. The GC's background
+// thread would otherwise interfere with the memory under test.
+// -----
+// Copyright (c) Kiruse 2018 Germany
+// License: GPL 3.0
+#pragma once
+
+#include <chrono>
+#include <limits>
+
+#include "GC/NeuroGC.hpp"
+
+namespace Neuro {
+    namespace Runtime
+    {
+        /**
+         * Keeps the background thread from running cycles of its own. Cycles
+         * only run when asked for, and are minor unless asked otherwise. Tests
+         * subclass it to expose the internals they inspect.
+         */
+        class QuietGC : public GC {
+        public:
+            QuietGC() {
+                setScanInterval(std::chrono::hours(1));
+                setAllocationThreshold(std::numeric_limits<uint64>::max());
+                setMajorCycleInterval(std::numeric_limits<uint32>::max());
+            }
+            
+            /**
+             * Runs a cycle the way the background thread does, i.e. without
+             * moving any memory.
+             */
+            void sweepCycle() {
+                cycle(false, false);
+            }
+        };
+        
+        /**
+         * Memory kept alive by `scanBlocks` without rooting it.
+         */
+        inline Buffer<ManagedMemoryPointerBase> keptBlocks;
+        
+        /**
+         * Memory scanner marking `keptBlocks`.
+         */
+        inline void scanBlocks(MarkBitmap& marks) {
+            for (auto& ptr : keptBlocks) marks.mark(ptr);
+        }
+    }
+}
@@ -0,0 +1,56 @@
+////////////////////////////////////////////////////////////////////////////////
+// Unit Test for the card tables of the GC's memory segments and the write
+// barrier.
+// -----
+// Copyright (c) Kiruse 2018 Germany
+// License: GPL 3.0
+#include "CLInterface.hpp"
+#include "GC/CardTable.hpp"
+
+#include <cstdlib>
+
+using namespace Neuro;
+using namespace Neuro::Runtime;
+
+
+int main(int argc, char** argv) {
+    Testing::section("CardTable", []() {
+        Testing::test("Lookup & write barrier", []() {
+            const uint32 size = 2 * CardTable::RegionSize;
+            void* allocation = std::malloc(size + CardTable::RegionSize);
+            uint8* memory = reinterpret_cast<uint8*>((reinterpret_cast<uintptr_t>(allocation) + CardTable::RegionSize - 1) & ~uintptr_t(CardTable::RegionSize - 1));
+            uint32 local = 0;
+            
+            CardTable cards;
+            Testing::assert(cards.attach(memory, size), "Expected cards to be attached");
+            Testing::assert(cards.countCards() == size / CardTable::CardSize, "Wrong number of cards");
+            Testing::assert(CardTable::lookup(memory) == &cards, "Expected lookup of first address to find the table");
+            Testing::assert(CardTable::lookup(memory + size - 1) == &cards, "Expected lookup of last address to find the table");
+            Testing::assert(CardTable::lookup(&local) == nullptr, "Expected stack address to map to no table");
+            Testing::assert(!cards.anyDirty(), "Expected attached cards to be clean");
+            
+            writeBarrier(&local);
+            writeBarrier(memory + CardTable::RegionSize + 3);
+            writeBarrier(memory + 5);
+            writeBarrier(memory + 7);
+            Testing::assert(cards.countDirty() == 2, "Expected exactly 2 dirty cards");
+            Testing::assert(cards.isDirty(0) && cards.isDirty(CardTable::RegionSize / CardTable::CardSize), "Wrong cards dirtied");
+            
+            writeBarrier(memory + CardTable::CardSize - 1, 2 * CardTable::CardSize);
+            Testing::assert(cards.countDirty() == 4, "Expected range to dirty 3 overlapping cards");
+            
+            Buffer<uint32> dirty;
+            Testing::assert(cards.takeDirty(dirty) == 4, "Expected all dirty cards to be taken");
+            Testing::assert(dirty[0] == 0 && dirty[1] == 1 && dirty[2] == 2 && dirty[3] == CardTable::RegionSize / CardTable::CardSize, "Expected dirty cards in ascending order");
+            Testing::assert(!cards.anyDirty(), "Expected taken cards to be clean");
+            
+            cards.detach();
+            Testing::assert(CardTable::lookup(memory) == nullptr, "Expected detached table not to be found");
+            writeBarrier(memory);
+            
+            std::free(allocation);
+        });
+    });
+    
+    return 0;
+}
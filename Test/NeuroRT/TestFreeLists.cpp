@@ -0,0 +1,85 @@
+////////////////////////////////////////////////////////////////////////////////
+// Unit Test for the GC's segregated free lists.
+// -----
+// Copyright (c) Kiruse 2018 Germany
+// License: GPL 3.0
+#include <new>
+
+#include "CLInterface.hpp"
+#include "GC/FreeLists.hpp"
+
+using namespace Neuro;
+using namespace Neuro::Runtime;
+
+
+alignas(ManagedMemoryOverhead) uint8 memory[4096];
+
+/**
+ * Constructs a swept block of `bytes` bytes in total at the given offset.
+ */
+ManagedMemoryOverhead* makeBlock(uint32 offset, uint32 bytes) {
+    auto* block = new (memory + offset) ManagedMemoryOverhead(1, bytes - sizeof(ManagedMemoryOverhead));
+    block->garbageState = EGarbageState::Swept;
+    return block;
+}
+
+
+int main(int argc, char** argv) {
+    Testing::section("FreeLists", []() {
+        Testing::test("Size classes", []() {
+            Testing::assert(FreeLists::getSizeClass(0) == 0 && FreeLists::getSizeClass(63) == 0, "Expected blocks below 64 bytes to share the first class");
+            Testing::assert(FreeLists::getSizeClass(64) == 1 && FreeLists::getSizeClass(79) == 1, "Expected [64,80) to be the second class");
+            Testing::assert(FreeLists::getSizeClass(80) == 2 && FreeLists::getSizeClass(127) == 4, "Expected four classes per power of two");
+            Testing::assert(FreeLists::getSizeClass(128) == 5, "Expected 128 bytes to start the next power of two");
+            Testing::assert(FreeLists::getSizeClass(0xFFFFFFFF) == FreeLists::NumClasses - 1, "Expected the largest block to fall into the last class");
+            
+            for (uint32 bytes = 1; bytes < 1 << 20; bytes += 7) {
+                const uint32 sizeClass = FreeLists::getSizeClass(bytes);
+                if (FreeLists::getClassBytes(sizeClass) > bytes || FreeLists::getClassBytes(sizeClass + 1) <= bytes) {
+                    Testing::assert(false, "Expected class bounds to enclose the block size");
+                    break;
+                }
+            }
+        });
+        
+        Testing::test("Take fitting blocks", []() {
+            FreeLists lists;
+            auto* exact = makeBlock(0, 100);
+            auto* tight = makeBlock(256, 112);
+            auto* large = makeBlock(512, 2000);
+            lists.add(exact);
+            lists.add(tight);
+            lists.add(large);
+            Testing::assert(lists.count() == 3, "Expected 3 free blocks");
+            
+            Testing::assert(lists.take(100) == exact, "Expected the exactly fitting block");
+            Testing::assert(!lists.take(100), "Expected no block to fit 100 bytes and a filler");
+            Testing::assert(!lists.take(40), "Expected larger size classes to be left alone");
+            Testing::assert(lists.take(112) == tight, "Expected the block of the next size class");
+            
+            Testing::assert(!lists.takeAtLeast(4000), "Expected no block of at least 4000 bytes");
+            Testing::assert(lists.takeAtLeast(150) == large, "Expected the large block");
+            Testing::assert(lists.empty(), "Expected all blocks to be taken");
+        });
+        
+        Testing::test("Fits", []() {
+            auto* block = makeBlock(0, 200);
+            Testing::assert(FreeLists::fits(block, 200), "Expected exact size to fit");
+            Testing::assert(FreeLists::fits(block, 200 - sizeof(ManagedMemoryOverhead)), "Expected room for a filler to fit");
+            Testing::assert(!FreeLists::fits(block, 199), "Expected a remainder smaller than a filler not to fit");
+            Testing::assert(!FreeLists::fits(block, 201), "Expected larger sizes not to fit");
+        });
+        
+        Testing::test("Clear", []() {
+            FreeLists lists;
+            for (uint32 i = 0; i < 8; ++i) lists.add(makeBlock(i * 256, 64 + i * 24));
+            Testing::assert(lists.count(FreeLists::getSizeClass(64)) == 1, "Expected one block in the smallest used class");
+            
+            lists.clear();
+            Testing::assert(lists.empty(), "Expected no blocks after clearing");
+            Testing::assert(!lists.takeAtLeast(0), "Expected cleared lists to hand out nothing");
+        });
+    });
+    
+    return 0;
+}
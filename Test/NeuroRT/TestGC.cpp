@@ -90,6 +90,10 @@ int main(int argc, char** argv)
 {
     GC::init();
     
+    // Background cycles compact, and may only move memory while this thread
+    // is parked at a safepoint, where it holds no native pointers into it.
+    Safepoints::registerThread();
+    
     root = createNeuron();
 	Pointer prev = root;
     root->root();
@@ -103,8 +107,10 @@ int main(int argc, char** argv)
         Pointer neuron = createNeuron();
         //Pointer parent = getRandomNeuron(root);
         link(prev, neuron);
+        Safepoints::poll();
     }
     
+    Safepoints::unregisterThread();
     GC::destroy();
     
     std::cout << "Wooh! :O" << std::endl;
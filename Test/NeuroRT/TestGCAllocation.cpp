@@ -0,0 +1,277 @@
+////////////////////////////////////////////////////////////////////////////////
+// Unit Test for the GC's thread-local allocation buffers and free lists.
+// Allocates from several threads at once, then verifies that no memory was
+// handed out twice and that the segments remain walkable, before and after
+// compaction, that swept memory is reused without compaction, that garbage is
+// swept lazily by allocations, and that so is reallocated memory.
+// -----
+// Copyright (c) Kiruse 2018 Germany
+// License: GPL 3.0
+#include "CLInterface.hpp"
+#include "GC/NeuroGC.hpp"
+#include "NeuroRT/QuietGC.hpp"
+
+#include <thread>
+
+using namespace Neuro;
+using namespace Neuro::Runtime;
+
+
+constexpr uint32 numThreads = 4;
+constexpr uint32 numBlocks = 20000;
+constexpr uint32 numCounted = 200000;
+
+/**
+ * Counts its destructions, which the GC performs upon sweeping it.
+ */
+uint32 numDestroyed = 0;
+struct Counted {
+    uint64 value = 0;
+    ~Counted() { ++numDestroyed; }
+};
+
+Buffer<ManagedMemoryPointerBase> keptInterleaved;
+
+void scanInterleaved(MarkBitmap& marks) {
+    for (auto& ptr : keptInterleaved) marks.mark(ptr);
+}
+
+
+/**
+ * Walks the segments.
+ */
+class AllocationGC : public QuietGC {
+public:
+    /**
+     * Counts the blocks of either generation which are not swept, or returns
+     * npos if the blocks do not end exactly at a segment's allocation pointer.
+     */
+    uint32 countBlocks(bool trivial) const {
+        uint32 count = 0;
+        for (auto* chain : { trivial ? firstTrivialMemSeg : firstNonTrivialMemSeg, trivial ? firstDormantTrivialMemSeg : firstDormantNonTrivialMemSeg }) {
+            for (auto* segment = chain; segment; segment = segment->next) {
+                uint8* addr = reinterpret_cast<uint8*>(segment + 1);
+                while (addr < segment->ptr) {
+                    auto* head = reinterpret_cast<ManagedMemoryOverhead*>(addr);
+                    if (head->garbageState != EGarbageState::Swept) ++count;
+                    addr += head->getTotalBytes();
+                }
+                if (addr != segment->ptr) return npos;
+            }
+        }
+        return count;
+    }
+    
+    /**
+     * Counts the bytes of the nursery which have been handed out, including
+     * free blocks.
+     */
+    uint64 countReservedBytes(bool trivial) const {
+        uint64 bytes = 0;
+        for (auto* segment = trivial ? firstTrivialMemSeg : firstNonTrivialMemSeg; segment; segment = segment->next) {
+            bytes += segment->ptr - reinterpret_cast<uint8*>(segment + 1);
+        }
+        return bytes;
+    }
+    
+    uint32 countFreeBlocks(bool trivial) const {
+        return trivial ? trivialFreeBlocks.count() : nonTrivialFreeBlocks.count();
+    }
+    
+    /**
+     * Counts the groups of garbage awaiting their sweep.
+     */
+    uint32 countUnswept(bool trivial) const {
+        return numUnsweptGroups[trivial].load();
+    }
+};
+
+/**
+ * Allocates blocks of varying sizes from several threads at once, then fills
+ * each block with a pattern unique to it. Overlapping blocks hence corrupt
+ * each other's patterns.
+ */
+Buffer<ManagedMemoryPointerBase> allocateConcurrently(GC* gc) {
+    Buffer<ManagedMemoryPointerBase> perThread[numThreads];
+    std::thread threads[numThreads];
+    
+    for (uint32 t = 0; t < numThreads; ++t) {
+        threads[t] = std::thread([gc, t, &perThread]() {
+            for (uint32 i = 0; i < numBlocks; ++i) {
+                perThread[t].add(gc->allocateTrivial(sizeof(uint32), 1 + i % 7));
+            }
+        });
+    }
+    
+    Buffer<ManagedMemoryPointerBase> blocks;
+    for (uint32 t = 0; t < numThreads; ++t) {
+        threads[t].join();
+        blocks.add(perThread[t].begin(), perThread[t].end());
+    }
+    
+    // Resolving pointers races with the table growing on other threads, so
+    // the patterns are only written once all threads are done.
+    for (uint32 index = 0; index < blocks.length(); ++index) {
+        auto* data = reinterpret_cast<uint32*>(blocks[index].get());
+        for (uint32 j = 0; j < 1 + index % numBlocks % 7; ++j) data[j] = index;
+    }
+    return blocks;
+}
+
+bool verifyBlocks(const Buffer<ManagedMemoryPointerBase>& blocks) {
+    for (uint32 index = 0; index < blocks.length(); ++index) {
+        auto* data = reinterpret_cast<uint32*>(blocks[index].get());
+        if (!data) return false;
+        
+        for (uint32 j = 0; j < 1 + index % numBlocks % 7; ++j) {
+            if (data[j] != index) return false;
+        }
+    }
+    return true;
+}
+
+
+int main(int argc, char** argv) {
+    auto* gc = new AllocationGC();
+    GC::init(gc);
+    gc->registerMemoryScanner(GC::ScannerDelegate::FunctionDelegate<scanBlocks>());
+    gc->registerMemoryScanner(GC::ScannerDelegate::FunctionDelegate<scanInterleaved>());
+    
+    Testing::section("GC Allocation Buffers", [&]() {
+        Testing::test("Concurrent allocation", [&]() {
+            auto blocks = allocateConcurrently(gc);
+            Testing::assert(verifyBlocks(blocks), "Concurrently allocated blocks overlap");
+            
+            // Garbage allocated by this thread leaves it with a buffer to be
+            // invalidated by the compaction below.
+            for (uint32 i = 0; i < 10; ++i) gc->allocateTrivial(sizeof(uint32), 1);
+            Testing::assert(gc->countBlocks(true) == numThreads * numBlocks + 10, "Expected segments to consist of the allocated blocks and fillers");
+            keptBlocks = blocks;
+        });
+        
+        Testing::test("Buffers are invalidated by compaction", [&]() {
+            gc->collect();
+            gc->collect();
+            Testing::assert(verifyBlocks(keptBlocks), "Relocated blocks corrupted");
+            Testing::assert(gc->countBlocks(true) == numThreads * numBlocks, "Expected compaction to retain exactly the kept blocks");
+            
+            // Buffers reserved before the compaction must not be reused, as
+            // the kept blocks have been slid over them.
+            auto blocks = allocateConcurrently(gc);
+            for (uint32 i = 0; i < 1000; ++i) gc->allocateTrivial(sizeof(uint32), 1);
+            Testing::assert(verifyBlocks(keptBlocks) && verifyBlocks(blocks), "Stale allocation buffer reused after compaction");
+            Testing::assert(gc->countBlocks(true) == 2 * numThreads * numBlocks + 1000, "Expected segments to remain walkable after compaction");
+        });
+        
+        Testing::test("Swept blocks are reused", [&]() {
+            // The blocks allocated by the previous test are spared once.
+            gc->sweepCycle();
+            gc->sweepCycle();
+            Testing::assert(gc->countUnswept(true) > 0, "Expected sweep to queue the garbage");
+            
+            const uint64 reserved = gc->countReservedBytes(true);
+            auto blocks = allocateConcurrently(gc);
+            Testing::assert(verifyBlocks(keptBlocks) && verifyBlocks(blocks), "Free block handed out twice");
+            Testing::assert(gc->countBlocks(true) == 2 * numThreads * numBlocks, "Expected segments to remain walkable");
+            Testing::assert(gc->countReservedBytes(true) < reserved + reserved / 10, "Expected allocations to reuse swept memory");
+        });
+        
+        Testing::test("Interleaved garbage is reused in place", [&]() {
+            for (uint32 i = 0; i < 2000; ++i) {
+                auto ptr = gc->allocateTrivial(sizeof(uint32), 5);
+                auto* data = reinterpret_cast<uint32*>(ptr.get());
+                for (uint32 j = 0; j < 5; ++j) data[j] = i;
+                if (i % 2) keptInterleaved.add(ptr);
+            }
+            gc->sweepCycle();
+            gc->sweepCycle();
+            
+            // Every other block is garbage framed by live blocks, i.e. there is
+            // an exactly fitting free block for every new allocation.
+            const uint64 reserved = gc->countReservedBytes(true);
+            for (uint32 i = 0; i < 1000; ++i) {
+                auto* data = reinterpret_cast<uint32*>(gc->allocateTrivial(sizeof(uint32), 5).get());
+                for (uint32 j = 0; j < 5; ++j) data[j] = ~i;
+            }
+            Testing::assert(gc->countReservedBytes(true) == reserved, "Expected no memory to be bumped");
+            
+            bool intact = verifyBlocks(keptBlocks);
+            for (uint32 i = 0; i < keptInterleaved.length(); ++i) {
+                auto* data = reinterpret_cast<uint32*>(keptInterleaved[i].get());
+                for (uint32 j = 0; j < 5; ++j) intact = intact && data[j] == 2 * i + 1;
+            }
+            Testing::assert(intact, "Kept blocks overwritten by reused memory");
+        });
+        
+        Testing::test("Garbage is swept lazily", [&]() {
+            gc->collect();
+            Testing::assert(!gc->countUnswept(true) && !gc->countUnswept(false), "Expected compaction to sweep all garbage");
+            
+            // Enough garbage to span several groups and segments.
+            const uint16 typeId = TypeTable::getTypeId<Counted>();
+            for (uint32 i = 0; i < numCounted; ++i) {
+                new (gc->allocateNonTrivial(sizeof(Counted), 1, typeId).get()) Counted();
+            }
+            gc->sweepCycle();
+            gc->sweepCycle();
+            const uint32 unswept = gc->countUnswept(false);
+            Testing::assert(unswept > 1 && numDestroyed == 0, "Expected the garbage to await its sweep");
+            
+            new (gc->allocateNonTrivial(sizeof(Counted), 1, typeId).get()) Counted();
+            Testing::assert(gc->countUnswept(false) == unswept - 1, "Expected an allocation to sweep a single group");
+            Testing::assert(numDestroyed > 0 && numDestroyed < numCounted, "Expected only the swept group's garbage to be destroyed");
+            
+            gc->collect();
+            Testing::assert(!gc->countUnswept(false) && numDestroyed >= numCounted, "Expected compaction to sweep the remainder");
+        });
+        
+        Testing::test("Reallocated blocks are swept without compaction", [&]() {
+            // Sweeps the newborn garbage of the previous test.
+            gc->collect();
+            gc->collect();
+            
+            const uint16 typeId = TypeTable::getTypeId<Counted>();
+            auto ptr = gc->allocateNonTrivial(sizeof(Counted), 1, typeId);
+            new (ptr.get()) Counted();
+            reinterpret_cast<Counted*>(ptr.get())->value = 42;
+            keptBlocks.add(ptr);
+            
+            numDestroyed = 0;
+            gc->reallocate(ptr, sizeof(Counted), 1);
+            gc->sweepCycle();
+            Testing::assert(numDestroyed == 0 && !gc->countUnswept(false), "Expected the old block to be left alone for a cycle");
+            
+            gc->sweepCycle();
+            Testing::assert(gc->countUnswept(false) == 1, "Expected the old block to await its sweep");
+            
+            new (gc->allocateNonTrivial(sizeof(Counted), 1, typeId).get()) Counted();
+            Testing::assert(numDestroyed == 1 && !gc->countUnswept(false), "Expected the old block to be destroyed by its sweep");
+            Testing::assert(reinterpret_cast<Counted*>(ptr.get())->value == 42, "Expected the reallocated block to remain intact");
+            keptBlocks.clear();
+        });
+        
+        Testing::test("Teardown destroys every block", [&]() {
+            // Live memory spanning several segments, interspersed with swept
+            // memory.
+            auto* other = new AllocationGC();
+            const uint16 typeId = TypeTable::getTypeId<Counted>();
+            for (uint32 i = 0; i < numCounted; ++i) {
+                new (other->resolve(other->allocateNonTrivial(sizeof(Counted), 1, typeId))) Counted();
+            }
+            other->sweepCycle();
+            other->sweepCycle();
+            for (uint32 i = 0; i < numCounted; ++i) {
+                new (other->resolve(other->allocateNonTrivial(sizeof(Counted), 1, typeId))) Counted();
+            }
+            
+            numDestroyed = 0;
+            delete other;
+            Testing::assert(numDestroyed == 2 * numCounted, "Expected every block to be destroyed exactly once");
+        });
+    });
+    
+    keptBlocks.clear();
+    keptInterleaved.clear();
+    GC::destroy();
+    return 0;
+}
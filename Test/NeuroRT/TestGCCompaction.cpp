@@ -0,0 +1,152 @@
+////////////////////////////////////////////////////////////////////////////////
+// Unit Test for the GC's Compact Phase. Fills a few segments with objects of
+// which only a fraction survives, then verifies that the survivors have been
+// slid together and are still intact behind their original pointers.
+// -----
+// Copyright (c) Kiruse 2018 Germany
+// License: GPL 3.0
+#include "CLInterface.hpp"
+#include "GC/NeuroGC.hpp"
+#include "NeuroObject.hpp"
+#include "NeuroRT/QuietGC.hpp"
+
+#include <sstream>
+
+using namespace Neuro;
+using namespace Neuro::Runtime;
+
+
+uint32 numLiveCounters = 0;
+
+struct Counter {
+    uint32 value;
+    
+    Counter(uint32 value) : value(value) { ++numLiveCounters; }
+    Counter(const Counter& other) : value(other.value) { ++numLiveCounters; }
+    ~Counter() { --numLiveCounters; }
+};
+
+Buffer<ManagedMemoryPointerBase> keptCounters;
+
+void scanCounters(MarkBitmap& marks) {
+    for (auto& ptr : keptCounters) marks.mark(ptr);
+}
+
+
+/**
+ * Exposes the segments' usage.
+ */
+class CompactionGC : public QuietGC {
+public:
+    uint64 countUsedBytes(bool trivial) const {
+        uint64 used = 0;
+        for (auto* segment = trivial ? firstTrivialMemSeg : firstNonTrivialMemSeg; segment; segment = segment->next) {
+            used += segment->ptr - reinterpret_cast<uint8*>(segment + 1);
+        }
+        return used;
+    }
+    
+    size_t countCommittedBytes() const {
+        return segmentHeap.countCommittedBytes();
+    }
+};
+
+
+int main(int argc, char** argv) {
+    constexpr uint32 numObjects = 40000;
+    constexpr uint32 numCounters = 1000;
+    
+    auto* gc = new CompactionGC();
+    GC::init(gc);
+    gc->registerMemoryScanner(GC::ScannerDelegate::FunctionDelegate<scanCounters>());
+    
+    Testing::section("GC Compaction", [&]() {
+        Testing::test("Objects survive relocation", [&]() {
+            Pointer root = Object::createObject(4);
+            root->root();
+            Pointer keep = Object::createObject(numObjects / 100, numObjects / 100);
+            root->getProperty("keep") = keep;
+            
+            Buffer<Pointer> objects;
+            for (uint32 i = 0; i < numObjects; ++i) {
+                Pointer obj = Object::createObject(8);
+                obj->getProperty("value") = i;
+                objects.add(obj);
+                
+                // Only every 100th object is reachable from the root.
+                if (i % 100 == 0) {
+                    std::stringstream ss;
+                    ss << i;
+                    keep->getProperty(ss.str().c_str()) = obj;
+                }
+            }
+            
+            const uint64 usedBefore = gc->countUsedBytes(true);
+            
+            // Newborns are spared once before they may be moved.
+            gc->collect();
+            gc->collect();
+            
+            Testing::assert(gc->countUsedBytes(true) < usedBefore / 10, "Expected trivial segments to shrink substantially");
+            
+            for (uint32 i = 0; i < numObjects; ++i) {
+                if (i % 100 == 0) {
+                    Testing::assert(objects[i] && objects[i]->getProperty("value").getUInt() == i, "Relocated object corrupted");
+                }
+                else {
+                    Testing::assert(!objects[i], "Unreachable object not collected");
+                }
+            }
+            
+            root->unroot();
+        });
+        
+        Testing::test("Non-trivial types are copied and destroyed", [&]() {
+            Buffer<ManagedMemoryPointerBase> counters;
+            for (uint32 i = 0; i < numCounters; ++i) {
+                auto ptr = gc->allocateNonTrivial(sizeof(Counter), 1, TypeTable::getTypeId<Counter>());
+                new (ptr.get()) Counter(i);
+                counters.add(ptr);
+                if (i % 2 == 0) keptCounters.add(ptr);
+            }
+            
+            const uint64 usedBefore = gc->countUsedBytes(false);
+            
+            gc->collect();
+            gc->collect();
+            
+            Testing::assert(numLiveCounters == numCounters / 2, "Expected collected counters to be destroyed exactly once");
+            Testing::assert(gc->countUsedBytes(false) < usedBefore, "Expected non-trivial segments to shrink");
+            
+            for (uint32 i = 0; i < numCounters; ++i) {
+                auto* counter = reinterpret_cast<Counter*>(counters[i].get());
+                if (i % 2 == 0) {
+                    Testing::assert(counter && counter->value == i, "Relocated counter corrupted");
+                }
+                else {
+                    Testing::assert(!counter, "Unreachable counter not collected");
+                }
+            }
+        });
+        
+        Testing::test("Retired segments are decommitted", [&]() {
+            const size_t committedBefore = gc->countCommittedBytes();
+            for (uint32 i = 0; i < 4096; ++i) gc->allocateTrivial(4096, 1);
+            const size_t committedPeak = gc->countCommittedBytes();
+            Testing::assert(committedPeak >= committedBefore + 16 * 1024 * 1024, "Expected garbage to commit new segments");
+            
+            // Garbage is spared once, and retired segments are only released
+            // by the compaction after retiring them.
+            gc->collect();
+            gc->collect();
+            gc->collect();
+            Testing::assert(gc->countCommittedBytes() < committedBefore + (committedPeak - committedBefore) / 4, "Expected emptied segments to be decommitted");
+        });
+    });
+    
+    keptCounters.clear();
+    GC::destroy();
+    
+    Testing::assert(numLiveCounters == 0, "Expected GC destruction to destroy all remaining counters");
+    return 0;
+}
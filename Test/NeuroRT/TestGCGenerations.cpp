@@ -0,0 +1,146 @@
+////////////////////////////////////////////////////////////////////////////////
+// Unit Test for the GC's generations. Verifies that surviving memory is
+// promoted out of the nursery, that minor cycles leave the old generation
+// alone, and that dirty cards of old objects referring to young memory keep it
+// alive.
+// -----
+// Copyright (c) Kiruse 2018 Germany
+// License: GPL 3.0
+#include "CLInterface.hpp"
+#include "GC/NeuroGC.hpp"
+#include "NeuroObject.hpp"
+#include "NeuroRT/QuietGC.hpp"
+
+
+using namespace Neuro;
+using namespace Neuro::Runtime;
+
+
+/**
+ * Exposes the cards of the old generation.
+ */
+class GenerationalGC : public QuietGC {
+public:
+    GenerationalGC() {
+        setPromotionAge(2);
+    }
+    
+    uint32 countDirtyCards() {
+        uint32 count = 0;
+        for (auto* chain : { firstDormantTrivialMemSeg, firstDormantNonTrivialMemSeg }) {
+            for (auto* segment = chain; segment; segment = segment->next) {
+                count += segment->cards.countDirty();
+            }
+        }
+        return count;
+    }
+};
+
+bool isDormant(const ManagedMemoryPointerBase& ptr) {
+    return GC::getOverhead(ptr)->isDormant;
+}
+
+
+int main(int argc, char** argv) {
+    auto* gc = new GenerationalGC();
+    GC::init(gc);
+    
+    Testing::section("GC Generations", [&]() {
+        Testing::test("Survivors are promoted", [&]() {
+            Pointer root = Object::createObject(4);
+            root->root();
+            Pointer child = Object::createObject(4);
+            child->getProperty("value") = 42;
+            root->getProperty("child") = child;
+            
+            gc->collect();
+            Testing::assert(!isDormant(root) && !isDormant(child), "Memory promoted too early");
+            
+            gc->collect();
+            Testing::assert(isDormant(root) && isDormant(child), "Memory not promoted after surviving enough cycles");
+            Testing::assert(child->getProperty("value").getInt() == 42, "Promoted object corrupted");
+            
+            root->unroot();
+            gc->collect(true);
+        });
+        
+        Testing::test("Minor cycles spare the old generation", [&]() {
+            Pointer root = Object::createObject(4);
+            root->root();
+            Pointer child = Object::createObject(4);
+            root->getProperty("child") = child;
+            
+            gc->collect();
+            gc->collect();
+            Testing::assert(isDormant(child), "Expected child to be promoted");
+            
+            Pointer young = Object::createObject(4);
+            root->getProperty("child") = Value::undefined;
+            
+            gc->collect();
+            gc->collect();
+            Testing::assert(!!child, "Minor cycle collected old memory");
+            Testing::assert(!young, "Minor cycle did not collect unreachable young memory");
+            
+            gc->collect(true);
+            gc->collect(true);
+            Testing::assert(!child, "Major cycle did not collect unreachable old memory");
+            Testing::assert(!!root, "Major cycle collected rooted memory");
+            
+            root->unroot();
+            gc->collect(true);
+        });
+        
+        Testing::test("Dirty cards keep young memory alive", [&]() {
+            Pointer root = Object::createObject(4);
+            root->root();
+            
+            gc->collect();
+            gc->collect();
+            Testing::assert(isDormant(root), "Expected root to be promoted");
+            Testing::assert(gc->countDirtyCards() == 0, "Expected cards of objects without young references to be cleaned");
+            
+            // Storing into the old root must dirty its card.
+            Pointer young = Object::createObject(4);
+            young->getProperty("value") = 69;
+            Testing::assert(gc->countDirtyCards() == 0, "Expected stores into young memory not to dirty old cards");
+            root->getProperty("young") = young;
+            Testing::assert(gc->countDirtyCards() == 1, "Expected store into old object to dirty exactly one card");
+            
+            gc->collect();
+            Testing::assert(!!young && !isDormant(young), "Young memory referred to by old object collected");
+            
+            gc->collect();
+            Testing::assert(!!young && isDormant(young), "Expected young memory to be promoted");
+            Testing::assert(gc->countDirtyCards() == 0, "Expected cards to be cleaned after promotion");
+            Testing::assert(young->getProperty("value").getInt() == 69, "Promoted object corrupted");
+            
+            root->unroot();
+            gc->collect(true);
+        });
+        
+        Testing::test("Promoted objects referring to young memory stay dirty", [&]() {
+            Pointer root = Object::createObject(4);
+            root->root();
+            gc->collect();
+            
+            // The child is one cycle younger and hence stays in the nursery
+            // when its parent is promoted.
+            Pointer child = Object::createObject(4);
+            root->getProperty("child") = child;
+            gc->collect();
+            Testing::assert(isDormant(root) && !isDormant(child), "Expected only the parent to be promoted");
+            Testing::assert(gc->countDirtyCards() == 1, "Expected card of promoted parent to stay dirty");
+            
+            gc->collect();
+            Testing::assert(!!child && isDormant(child), "Young memory referred to by promoted object collected");
+            Testing::assert(gc->countDirtyCards() == 0, "Expected cards to be cleaned after promotion");
+            
+            root->unroot();
+            gc->collect(true);
+        });
+    });
+    
+    GC::destroy();
+    return 0;
+}
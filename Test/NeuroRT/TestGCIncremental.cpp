@@ -0,0 +1,174 @@
+////////////////////////////////////////////////////////////////////////////////
+// Unit Test for the GC's incremental cycles. Verifies that steps complete a
+// cycle, that stores made by the mutator between steps do not cause reachable
+// objects to be collected, and that explicit collections complete an
+// incremental cycle in progress.
+// -----
+// Copyright (c) Kiruse 2018 Germany
+// License: GPL 3.0
+#include "CLInterface.hpp"
+#include "GC/NeuroGC.h"
+#include "GC/NeuroGC.hpp"
+#include "NeuroObject.hpp"
+#include "NeuroRT/QuietGC.hpp"
+
+
+using namespace Neuro;
+using namespace Neuro::Runtime;
+
+
+constexpr uint32 listLength = 20000;
+
+
+/**
+ * Exposes the incremental phase.
+ */
+class IncrementalGC : public QuietGC {
+public:
+    IncrementalGC() {
+        setPromotionAge(3);
+    }
+    
+    bool isIncremental() const {
+        return incrementalPhase != EIncrementalPhase::Idle;
+    }
+    
+    /**
+     * Steps with the given budget until the cycle completes. Returns the
+     * number of steps taken.
+     */
+    uint32 finish(std::chrono::microseconds budget) {
+        uint32 steps = 1;
+        while (step(budget)) ++steps;
+        return steps;
+    }
+};
+
+/**
+ * Creates a linked list of the given length, each link referring to the next
+ * through its "next" property.
+ */
+Pointer createList(uint32 length) {
+    Pointer head = Object::createObject(2);
+    Pointer link = head;
+    for (uint32 i = 1; i < length; ++i) {
+        Pointer next = Object::createObject(2);
+        next->getProperty("value") = static_cast<int32>(i);
+        link->getProperty("next") = next;
+        link = next;
+    }
+    return head;
+}
+
+Pointer getLast(Pointer link) {
+    while (link->hasProperty("next")) link = link->getProperty("next").getManagedObject();
+    return link;
+}
+
+
+int main(int argc, char** argv) {
+    auto* gc = new IncrementalGC();
+    GC::init(gc);
+    
+    Testing::section("GC Incremental Cycles", [&]() {
+        Testing::test("Steps complete a cycle", [&]() {
+            Pointer root = Object::createObject(2);
+            root->root();
+            root->getProperty("list") = createList(100);
+            
+            Pointer garbage = Object::createObject(2);
+            garbage->getProperty("value") = 42;
+            Pointer young = Object::createObject(2);
+            
+            // Unmarked memory is spared once as a newborn.
+            gc->finish(std::chrono::microseconds(100));
+            Testing::assert(!!garbage && !!young, "Expected newborns to be spared");
+            Testing::assert(!gc->isIncremental(), "Expected the cycle to be completed");
+            
+            root->getProperty("young") = young;
+            gc->finish(std::chrono::microseconds(100));
+            Testing::assert(!garbage, "Expected unreachable object to be collected");
+            Testing::assert(!!young, "Reachable object collected by incremental cycle");
+            Testing::assert(getLast(root->getProperty("list").getManagedObject())->getProperty("value").getInt() == 99, "Reachable list corrupted by incremental cycle");
+            
+            root->unroot();
+        });
+        
+        Testing::test("Steps report remaining work", [&]() {
+            Pointer root = Object::createObject(2);
+            root->root();
+            root->getProperty("list") = createList(listLength);
+            gc->sweepCycle();
+            
+            Testing::assert(gc->step(std::chrono::microseconds(0)) > 0, "Expected a zero budget not to complete the cycle");
+            Testing::assert(gc->isIncremental(), "Expected the cycle to be in progress");
+            
+            const uint32 steps = gc->finish(std::chrono::microseconds(0));
+            Testing::assert(steps > 1, "Expected the cycle to take several steps");
+            Testing::assert(!gc->isIncremental(), "Expected the cycle to be completed");
+            
+            root->unroot();
+            gc->collect(true);
+        });
+        
+        Testing::test("Stores between steps are not lost", [&]() {
+            Pointer root = Object::createObject(4);
+            root->root();
+            root->getProperty("list") = createList(listLength);
+            
+            Pointer last = getLast(root->getProperty("list").getManagedObject());
+            Pointer target = Object::createObject(2);
+            target->getProperty("value") = 69;
+            last->getProperty("target") = target;
+            
+            // Memory is aged by compaction only. Otherwise, the target would
+            // be spared as a newborn regardless.
+            gc->collect();
+            
+            // The root has already been traced by the time the reference is
+            // moved, while the end of the list has not.
+            gc->step(std::chrono::microseconds(0));
+            Testing::assert(gc->isIncremental(), "Expected the cycle to be in progress");
+            root->getProperty("target") = target;
+            last->getProperty("target") = Value::undefined;
+            
+            gc->finish(std::chrono::microseconds(0));
+            Testing::assert(!!target, "Object moved between steps collected");
+            Testing::assert(target->getProperty("value").getInt() == 69, "Object moved between steps corrupted");
+            
+            root->unroot();
+            gc->collect(true);
+        });
+        
+        Testing::test("Explicit collections complete incremental cycles", [&]() {
+            Pointer root = Object::createObject(2);
+            root->root();
+            root->getProperty("list") = createList(listLength);
+            gc->sweepCycle();
+            
+            gc->step(std::chrono::microseconds(0));
+            Testing::assert(gc->isIncremental(), "Expected the cycle to be in progress");
+            
+            gc->sweepCycle();
+            Testing::assert(gc->isIncremental(), "Expected the background cycle to leave incremental cycles to the host");
+            
+            gc->collect();
+            Testing::assert(!gc->isIncremental(), "Expected the collection to complete the cycle");
+            Testing::assert(getLast(root->getProperty("list").getManagedObject())->getProperty("value").getInt() == listLength - 1, "Reachable list corrupted by completed cycle");
+            
+            root->unroot();
+            gc->collect(true);
+        });
+        
+        Testing::test("C interface", [&]() {
+            Pointer garbage = Object::createObject(2);
+            gc->sweepCycle();
+            
+            while (neuroGCStep(1000));
+            Testing::assert(!garbage, "Expected garbage to be collected by C steps");
+        });
+    });
+    
+    GC::destroy();
+    return 0;
+}
@@ -0,0 +1,174 @@
+////////////////////////////////////////////////////////////////////////////////
+// Unit Test for the GC's large object space. Verifies that memory above the
+// threshold is mapped into regions of its own, which are never moved, are
+// promoted in place, and are unmapped once their memory is swept, be it
+// garbage or reallocated.
+// -----
+// Copyright (c) Kiruse 2018 Germany
+// License: GPL 3.0
+#include "CLInterface.hpp"
+#include "GC/NeuroGC.hpp"
+#include "NeuroObject.hpp"
+#include "NeuroRT/QuietGC.hpp"
+
+
+using namespace Neuro;
+using namespace Neuro::Runtime;
+
+
+constexpr uint32 threshold = 64 * 1024;
+
+
+/**
+ * Walks the large object space.
+ */
+class LargeObjectGC : public QuietGC {
+public:
+    LargeObjectGC() {
+        setPromotionAge(2);
+        setLargeObjectThreshold(threshold);
+    }
+    
+    uint32 countRegions() {
+        std::scoped_lock lock(largeObjectsMutex);
+        uint32 count = 0;
+        for (auto* region = firstLargeObject; region; region = region->next) ++count;
+        return count;
+    }
+    
+    uint32 countDirtyCards() {
+        std::scoped_lock lock(largeObjectsMutex);
+        uint32 count = 0;
+        for (auto* region = firstLargeObject; region; region = region->next) {
+            count += region->cards.countDirty();
+        }
+        return count;
+    }
+};
+
+bool isLarge(const ManagedMemoryPointerBase& ptr) {
+    return GC::getOverhead(ptr)->isLarge;
+}
+
+bool isDormant(const ManagedMemoryPointerBase& ptr) {
+    return GC::getOverhead(ptr)->isDormant;
+}
+
+
+int main(int argc, char** argv) {
+    auto* gc = new LargeObjectGC();
+    GC::init(gc);
+    gc->registerMemoryScanner(GC::ScannerDelegate::FunctionDelegate<scanBlocks>());
+    
+    Testing::section("GC Large Objects", [&]() {
+        Testing::test("Memory above the threshold is mapped separately", [&]() {
+            auto small = gc->allocateTrivial(1, threshold - sizeof(ManagedMemoryOverhead));
+            auto large = gc->allocateTrivial(1, threshold);
+            Testing::assert(!isLarge(small), "Expected memory up to the threshold to reside in a segment");
+            Testing::assert(isLarge(large), "Expected memory above the threshold to be large");
+            Testing::assert(gc->countRegions() == 1, "Expected exactly one large object region");
+            Testing::assert(reinterpret_cast<uintptr_t>(GC::getOverhead(large)) % CardTable::RegionSize == sizeof(LargeObjectRegion), "Expected the region to start at a region boundary");
+            
+            gc->sweepCycle();
+            gc->sweepCycle();
+            Testing::assert(!large, "Expected unreachable large memory to be collected");
+            Testing::assert(gc->countRegions() == 0, "Expected swept large memory to be unmapped");
+        });
+        
+        Testing::test("Large memory is never moved", [&]() {
+            auto ptr = gc->allocateTrivial(sizeof(uint32), threshold);
+            auto* data = reinterpret_cast<uint32*>(ptr.get());
+            for (uint32 i = 0; i < threshold; ++i) data[i] = i;
+            keptBlocks.add(ptr);
+            
+            gc->collect();
+            Testing::assert(ptr.get() == data && !isDormant(ptr), "Expected large memory to stay put");
+            
+            gc->collect();
+            Testing::assert(ptr.get() == data && isDormant(ptr), "Expected large memory to be promoted in place");
+            
+            gc->collect(true);
+            bool intact = ptr.get() == data;
+            for (uint32 i = 0; i < threshold && intact; ++i) intact = data[i] == i;
+            Testing::assert(intact, "Large memory moved or corrupted by a major collection");
+            
+            keptBlocks.clear();
+            gc->collect(true);
+            gc->collect(true);
+            Testing::assert(!ptr && gc->countRegions() == 0, "Expected unreachable old large memory to be unmapped");
+        });
+        
+        Testing::test("Reallocated large memory", [&]() {
+            auto ptr = gc->allocateTrivial(sizeof(uint32), threshold);
+            reinterpret_cast<uint32*>(ptr.get())[threshold - 1] = 42;
+            keptBlocks.add(ptr);
+            
+            gc->reallocate(ptr, sizeof(uint32), 2 * threshold);
+            Testing::assert(isLarge(ptr) && reinterpret_cast<uint32*>(ptr.get())[threshold - 1] == 42, "Expected the contents to be copied into a new region");
+            Testing::assert(gc->countRegions() == 2, "Expected the old region to linger until compaction");
+            
+            gc->collect();
+            gc->collect();
+            Testing::assert(gc->countRegions() == 1, "Expected the old region to be unmapped by compaction");
+            
+            gc->reallocate(ptr, sizeof(uint32), 16);
+            Testing::assert(!isLarge(ptr) && isDormant(ptr), "Expected shrunk old memory to move into the old generation");
+            
+            keptBlocks.clear();
+            gc->collect(true);
+            gc->collect(true);
+            gc->collect(true);
+            Testing::assert(gc->countRegions() == 0, "Expected all regions to be unmapped");
+        });
+        
+        Testing::test("Reallocated large memory is unmapped without compaction", [&]() {
+            auto ptr = gc->allocateTrivial(sizeof(uint32), threshold);
+            keptBlocks.add(ptr);
+            
+            gc->reallocate(ptr, sizeof(uint32), 2 * threshold);
+            gc->sweepCycle();
+            Testing::assert(gc->countRegions() == 2, "Expected the old region to linger for a cycle");
+            
+            gc->sweepCycle();
+            Testing::assert(gc->countRegions() == 1, "Expected the old region to be unmapped by the next cycle");
+            
+            keptBlocks.clear();
+            gc->collect(true);
+            gc->collect(true);
+            Testing::assert(gc->countRegions() == 0, "Expected all regions to be unmapped");
+        });
+        
+        Testing::test("Dirty cards of large objects keep young memory alive", [&]() {
+            Pointer root = Object::createObject(threshold / sizeof(Property) * 2);
+            root->root();
+            Testing::assert(isLarge(root), "Expected the object to be large");
+            
+            gc->collect();
+            gc->collect();
+            Testing::assert(isDormant(root), "Expected the object to be promoted in place");
+            Testing::assert(gc->countDirtyCards() == 0, "Expected cards of objects without young references to be cleaned");
+            
+            Pointer young = Object::createObject(4);
+            young->getProperty("value") = 69;
+            root->getProperty("young") = young;
+            Testing::assert(gc->countDirtyCards() == 1, "Expected store into large object to dirty exactly one card");
+            
+            gc->collect();
+            Testing::assert(!!young && !isDormant(young), "Young memory referred to by large object collected");
+            Testing::assert(gc->countDirtyCards() == 1, "Expected card referring to young memory to stay dirty");
+            
+            gc->collect();
+            Testing::assert(!!young && isDormant(young) && young->getProperty("value").getInt() == 69, "Expected young memory to be promoted intact");
+            Testing::assert(gc->countDirtyCards() == 0, "Expected cards to be cleaned after promotion");
+            
+            root->unroot();
+            gc->collect(true);
+            gc->collect(true);
+            Testing::assert(gc->countRegions() == 0, "Expected unrooted large object to be unmapped");
+        });
+    });
+    
+    keptBlocks.clear();
+    GC::destroy();
+    return 0;
+}
@@ -0,0 +1,169 @@
+////////////////////////////////////////////////////////////////////////////////
+// Unit Test for the pointer maps of native types. Verifies that the declared
+// fields are registered with the type, that the GC traces them from rooted
+// native memory in full, minor and incremental cycles, and that undeclared
+// fields are left alone.
+// -----
+// Copyright (c) Kiruse 2018 Germany
+// License: GPL 3.0
+#include "CLInterface.hpp"
+#include "GC/NeuroGC.hpp"
+#include "NeuroObject.hpp"
+#include "NeuroRT/QuietGC.hpp"
+
+#include <cstddef>
+#include <string>
+
+using namespace Neuro;
+using namespace Neuro::Runtime;
+
+
+struct Node {
+    ManagedMemoryPointer<Node> next;
+    Pointer object;
+    ManagedMemoryPointer<uint32> data;
+    Pointer children[2];
+    std::string name;
+    
+    static void describePointers(PointerMap<Node>& map) {
+        map.add(&Node::next).add(&Node::object).add(&Node::data).add(&Node::children);
+    }
+};
+
+/**
+ * Holds a managed pointer without declaring it.
+ */
+struct Opaque {
+    ManagedMemoryPointer<Node> hidden;
+    std::string name;
+};
+
+QuietGC* gc;
+
+ManagedMemoryPointer<Node> createNode(const char* name) {
+    auto node = gc->allocate<Node>();
+    new (node.get()) Node();
+    node->name = name;
+    return node;
+}
+
+bool isDormant(const ManagedMemoryPointerBase& ptr) {
+    return GC::getOverhead(ptr)->isDormant;
+}
+
+
+int main(int argc, char** argv) {
+    gc = new QuietGC();
+    gc->setPromotionAge(2);
+    GC::init(gc);
+    
+    Testing::section("Pointer Maps", [&]() {
+        Testing::test("Fields are registered", [&]() {
+            const TypeDescriptor& node = TypeTable::get(TypeTable::getTypeId<Node>());
+            Testing::assert(node.numObjectPointers == 3 && node.numMemoryPointers == 2, "Expected the declared fields");
+            Testing::assert(node.getObjectOffsets()[0] == offsetof(Node, object) && node.getObjectOffsets()[2] == offsetof(Node, children) + sizeof(Pointer), "Expected the offsets of the object fields");
+            Testing::assert(node.getMemoryOffsets()[0] == offsetof(Node, next) && node.getMemoryOffsets()[1] == offsetof(Node, data), "Expected the offsets of the memory fields");
+            
+            const TypeDescriptor& opaque = TypeTable::get(TypeTable::getTypeId<Opaque>());
+            Testing::assert(!opaque.hasPointers(), "Expected no pointers without a pointer map");
+        });
+        
+        Testing::test("Rooted native memory keeps its referents alive", [&]() {
+            auto root = createNode("root");
+            gc->root(root);
+            
+            auto next = createNode("next");
+            ManagedMemoryPointer<uint32> data = gc->allocateTrivial(sizeof(uint32), 4);
+            data[3] = 42;
+            Pointer object = Object::createObject(2);
+            object->getProperty("value") = 13;
+            Pointer child = Object::createObject(2);
+            Pointer grandchild = Object::createObject(2);
+            child->getProperty("child") = grandchild;
+            
+            root->next = next;
+            next->object = object;
+            next->data = data;
+            root->children[1] = child;
+            
+            gc->collect(true);
+            gc->collect(true);
+            Testing::assert(!!next && !!data && !!object && !!child && !!grandchild, "Expected the referents to survive");
+            Testing::assert(next->name == "next" && data[3] == 42 && object->getProperty("value").getInt() == 13, "Expected the referents to be intact");
+            Testing::assert(root->next == next && root->children[1] == child, "Expected the pointers to be intact");
+            
+            gc->unroot(root);
+            gc->collect(true);
+            gc->collect(true);
+            Testing::assert(!root && !next && !data && !object && !child && !grandchild, "Expected unrooted memory to be collected");
+        });
+        
+        Testing::test("Undeclared pointers are not traced", [&]() {
+            auto opaque = gc->allocate<Opaque>();
+            new (opaque.get()) Opaque();
+            gc->root(opaque);
+            
+            auto hidden = createNode("hidden");
+            opaque->hidden = hidden;
+            gc->collect(true);
+            gc->collect(true);
+            Testing::assert(!!opaque && !hidden, "Expected the undeclared referent to be collected");
+            
+            gc->unroot(opaque);
+            gc->collect(true);
+            gc->collect(true);
+        });
+        
+        Testing::test("Old native memory referring to young memory", [&]() {
+            auto root = createNode("root");
+            gc->root(root);
+            gc->collect();
+            gc->collect();
+            Testing::assert(isDormant(root), "Expected the node to be promoted");
+            
+            auto young = createNode("young");
+            root->next = young;
+            writeBarrier(&root->next);
+            gc->collect();
+            gc->collect();
+            Testing::assert(!!young && root->next->name == "young", "Young memory referred to by old native memory collected");
+            
+            gc->unroot(root);
+            gc->collect(true);
+            gc->collect(true);
+        });
+        
+        Testing::test("Incremental cycles", [&]() {
+            auto root = createNode("root");
+            gc->root(root);
+            
+            auto curr = root;
+            for (uint32 i = 0; i < 100; ++i) {
+                auto next = createNode("link");
+                next->object = Object::createObject(2);
+                curr->next = next;
+                curr = next;
+            }
+            
+            for (uint32 cycle = 0; cycle < 2; ++cycle) {
+                while (gc->step(std::chrono::microseconds(100))) {}
+            }
+            
+            uint32 length = 0;
+            bool intact = true;
+            for (auto node = root->next; node; node = node->next) {
+                intact = intact && node->name == "link" && !!node->object;
+                ++length;
+            }
+            Testing::assert(length == 100 && intact, "Expected the list to survive incremental cycles");
+            
+            gc->unroot(root);
+            gc->collect(true);
+            gc->collect(true);
+            Testing::assert(!curr, "Expected the unrooted list to be collected");
+        });
+    });
+    
+    GC::destroy();
+    return 0;
+}
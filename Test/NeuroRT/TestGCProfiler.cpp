@@ -0,0 +1,283 @@
+////////////////////////////////////////////////////////////////////////////////
+// Unit Test for the allocation sampling profiler. Verifies that the sampled
+// estimates are unbiased, that samples are aggregated by allocation site, that
+// profiles are valid pprof protocol buffers, and that the GC samples objects
+// created and recreated while profiling is enabled.
+// -----
+// Copyright (c) Kiruse 2018 Germany
+// License: GPL 3.0
+#include "CLInterface.hpp"
+#include "GC/AllocationProfiler.hpp"
+#include "GC/NeuroGC.h"
+#include "GC/NeuroGC.hpp"
+#include "NeuroObject.hpp"
+#include "Platform/Broker.hpp"
+#include "NeuroRT/QuietGC.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace Neuro;
+using namespace Neuro::Runtime;
+
+
+constexpr uint32 numAllocations = 100000;
+constexpr uint32 allocationSize = 64;
+constexpr uint32 numObjects = 2000;
+
+
+/**
+ * Exposes the profiler.
+ */
+class ProfilingGC : public QuietGC {
+public:
+    using GC::getProfiler;
+};
+
+/**
+ * Top level fields of a protocol buffer message, as far as the tests need.
+ */
+struct ProtoField {
+    uint32 field;
+    uint64 value;
+    std::string bytes;
+};
+
+uint64 readVarint(const std::string& data, size_t& pos) {
+    uint64 value = 0;
+    for (uint32 shift = 0; pos < data.length(); shift += 7) {
+        const uint8 byte = data[pos++];
+        value |= uint64(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) break;
+    }
+    return value;
+}
+
+bool parseMessage(const std::string& data, std::vector<ProtoField>& fields) {
+    size_t pos = 0;
+    while (pos < data.length()) {
+        const uint64 tag = readVarint(data, pos);
+        ProtoField field = { static_cast<uint32>(tag >> 3), 0, "" };
+        switch (tag & 7) {
+        case 0:
+            field.value = readVarint(data, pos);
+            break;
+        case 2: {
+            const uint64 length = readVarint(data, pos);
+            if (pos + length > data.length()) return false;
+            field.bytes = data.substr(pos, length);
+            pos += length;
+            break;
+        }
+        default:
+            return false;
+        }
+        fields.push_back(field);
+    }
+    return true;
+}
+
+bool hasString(const std::vector<ProtoField>& profile, const char* str) {
+    for (const auto& field : profile) {
+        if (field.field == 6 && field.bytes == str) return true;
+    }
+    return false;
+}
+
+uint32 countFields(const std::vector<ProtoField>& message, uint32 number) {
+    uint32 count = 0;
+    for (const auto& field : message) count += field.field == number;
+    return count;
+}
+
+bool isNear(double actual, double expected, double tolerance) {
+    return std::abs(actual - expected) <= expected * tolerance;
+}
+
+void sumSamples(const Buffer<AllocationProfiler::Sample>& samples, const char* site, uint64& numSamples, double& numObjects, double& bytes) {
+    numSamples = 0;
+    numObjects = bytes = 0;
+    for (const auto& sample : samples) {
+        if (site ? !sample.site || std::strcmp(sample.site, site) : !!sample.site) continue;
+        numSamples += sample.numSamples;
+        numObjects += sample.numObjects;
+        bytes += sample.bytes;
+    }
+}
+
+
+int main(int argc, char** argv) {
+    Testing::section("Allocation Profiler", [&]() {
+        Testing::test("Estimates are unbiased", [&]() {
+            AllocationProfiler profiler(4096);
+            for (uint32 i = 0; i < numAllocations; ++i) profiler.allocated(allocationSize);
+            
+            Buffer<AllocationProfiler::Sample> samples;
+            profiler.collect(samples);
+            uint64 count;
+            double objects, bytes;
+            sumSamples(samples, nullptr, count, objects, bytes);
+            
+            Testing::assert(count == profiler.countSamples() && count > 0 && count < numAllocations / 10, "Expected a fraction of allocations to be sampled");
+            Testing::assert(isNear(objects, numAllocations, 0.1), "Expected the number of allocations to be estimated");
+            Testing::assert(isNear(bytes, double(numAllocations) * allocationSize, 0.1), "Expected the allocated bytes to be estimated");
+        });
+        
+        Testing::test("Large allocations are always sampled", [&]() {
+            AllocationProfiler profiler(64);
+            profiler.allocated(1024 * 1024);
+            
+            Buffer<AllocationProfiler::Sample> samples;
+            profiler.collect(samples);
+            Testing::assert(samples.length() == 1 && samples[0].numSamples == 1, "Expected the allocation to be sampled");
+            Testing::assert(isNear(samples[0].numObjects, 1, 0.001) && isNear(samples[0].bytes, 1024 * 1024, 0.001), "Expected the sample to count once");
+        });
+        
+        Testing::test("Samples are aggregated by site", [&]() {
+            AllocationProfiler profiler(1);
+            {
+                // Sites' labels need not outlive the samples.
+                std::string label = "alpha";
+                AllocationSite alpha(label.c_str());
+                for (uint32 i = 0; i < 10; ++i) profiler.allocated(1024);
+                {
+                    AllocationSite beta("beta");
+                    Testing::assert(std::strcmp(AllocationSite::current(), "beta") == 0, "Expected the innermost site");
+                    for (uint32 i = 0; i < 5; ++i) profiler.allocated(1024);
+                }
+                label = "clobbered";
+            }
+            Testing::assert(AllocationSite::current() == nullptr, "Expected the sites to be left");
+            for (uint32 i = 0; i < 3; ++i) profiler.allocated(1024);
+            
+            Buffer<AllocationProfiler::Sample> samples;
+            profiler.collect(samples);
+            uint64 alpha, beta, none;
+            double objects, bytes;
+            sumSamples(samples, "alpha", alpha, objects, bytes);
+            sumSamples(samples, "beta", beta, objects, bytes);
+            sumSamples(samples, nullptr, none, objects, bytes);
+            Testing::assert(alpha == 10 && beta == 5 && none == 3, "Expected samples to be attributed to their sites");
+            Testing::assert(samples.length() < 18, "Expected samples of the same call site to be aggregated");
+            
+            profiler.clear();
+            samples.clear();
+            profiler.collect(samples);
+            Testing::assert(samples.length() == 0 && profiler.countSamples() == 0, "Expected cleared samples to be gone");
+        });
+        
+        Testing::test("pprof profile", [&]() {
+            AllocationProfiler profiler(1);
+            {
+                AllocationSite site("alpha");
+                for (uint32 i = 0; i < 4; ++i) profiler.allocated(1024);
+            }
+            profiler.allocated(1024);
+            
+            std::ostringstream out;
+            profiler.writePprof(out);
+            std::vector<ProtoField> profile;
+            Testing::assert(parseMessage(out.str(), profile), "Expected a valid protocol buffer");
+            
+            Buffer<AllocationProfiler::Sample> samples;
+            profiler.collect(samples);
+            Testing::assert(countFields(profile, 2) == samples.length(), "Expected a sample per aggregate");
+            Testing::assert(countFields(profile, 1) == 2 && countFields(profile, 11) == 1 && countFields(profile, 12) == 1, "Expected sample types and the period");
+            for (const char* str : { "", "alloc_objects", "count", "alloc_space", "bytes", "space", "site", "alpha" }) {
+                Testing::assert(hasString(profile, str), (std::string("Expected string ") + str).c_str());
+            }
+            
+            std::vector<ProtoField> sample;
+            for (const auto& field : profile) {
+                if (field.field == 2 && sample.empty()) parseMessage(field.bytes, sample);
+            }
+            Testing::assert(countFields(sample, 2) == 1, "Expected packed values");
+            
+            void* frame;
+            if (Platform::captureBacktrace(&frame, 1, 0)) {
+                Testing::assert(countFields(profile, 4) > 0, "Expected locations of the captured frames");
+            }
+        });
+    });
+    
+    auto* gc = new ProfilingGC();
+    GC::init(gc);
+    
+    Testing::section("GC Profiling", [&]() {
+        Testing::test("Disabled by default", [&]() {
+            std::ostringstream out;
+            Testing::assert(!gc->writeProfile(out) && !gc->getProfiler(), "Expected no profile before profiling is enabled");
+        });
+        
+        Testing::test("Objects are sampled", [&]() {
+            gc->enableProfiling(1024);
+            auto* profiler = gc->getProfiler();
+            Testing::assert(profiler && profiler->getInterval() == 1024, "Expected a profiler of the given interval");
+            
+            Buffer<Pointer> objects;
+            {
+                AllocationSite site("create.neuro");
+                for (uint32 i = 0; i < numObjects; ++i) objects.add(Object::createObject(4));
+            }
+            {
+                AllocationSite site("recreate.neuro");
+                for (uint32 i = 0; i < numObjects; ++i) Object::recreateObject(objects[i], 20);
+            }
+            
+            Buffer<AllocationProfiler::Sample> samples;
+            profiler->collect(samples);
+            uint64 count;
+            double estimate, bytes;
+            sumSamples(samples, "create.neuro", count, estimate, bytes);
+            Testing::assert(count > 0 && isNear(estimate, numObjects, 0.25), "Expected created objects to be estimated");
+            sumSamples(samples, "recreate.neuro", count, estimate, bytes);
+            Testing::assert(count > 0 && isNear(estimate, numObjects, 0.25), "Expected recreated objects to be estimated");
+            
+            objects.clear();
+            gc->collect();
+        });
+        
+        Testing::test("Disabling stops sampling", [&]() {
+            auto* profiler = gc->getProfiler();
+            gc->disableProfiling();
+            Testing::assert(!gc->getProfiler(), "Expected profiling to be disabled");
+            
+            const uint64 count = profiler->countSamples();
+            for (uint32 i = 0; i < numObjects; ++i) Object::createObject(4);
+            Testing::assert(profiler->countSamples() == count, "Expected no samples while disabled");
+            
+            std::ostringstream out;
+            Testing::assert(gc->writeProfile(out) && out.str().length() > 0, "Expected samples to be retained");
+            gc->clearProfile();
+            Testing::assert(profiler->countSamples() == 0, "Expected cleared samples to be gone");
+            gc->collect();
+        });
+        
+        Testing::test("C interface", [&]() {
+            const char* path = "TestGCProfiler.pb";
+            Testing::assert(neuroGCEnableProfiling(0) == 0, "Expected profiling to be enabled");
+            for (uint32 i = 0; i < numObjects; ++i) Object::createObject(4);
+            Testing::assert(neuroGCWriteProfile(path) == 0, "Expected the profile to be written");
+            Testing::assert(neuroGCDisableProfiling() == 0, "Expected profiling to be disabled");
+            Testing::assert(neuroGCWriteProfile(nullptr) != 0, "Expected a missing path to fail");
+            
+            std::ifstream file(path, std::ios::binary);
+            std::stringstream contents;
+            contents << file.rdbuf();
+            file.close();
+            std::remove(path);
+            
+            std::vector<ProtoField> profile;
+            Testing::assert(parseMessage(contents.str(), profile) && hasString(profile, "alloc_space"), "Expected the written profile");
+            gc->collect();
+        });
+    });
+    
+    GC::destroy();
+    return 0;
+}
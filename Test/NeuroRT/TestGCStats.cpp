@@ -0,0 +1,153 @@
+////////////////////////////////////////////////////////////////////////////////
+// Unit Test for the GC's statistics. Verifies that the latency histograms
+// reproduce recorded values within their precision, and that the statistics
+// follow the cycles run, both through the C++ and the C interface.
+// -----
+// Copyright (c) Kiruse 2018 Germany
+// License: GPL 3.0
+#include "CLInterface.hpp"
+#include "GC/GCStats.hpp"
+#include "GC/NeuroGC.h"
+#include "GC/NeuroGC.hpp"
+#include "NeuroRT/QuietGC.hpp"
+
+#include <limits>
+
+using namespace Neuro;
+using namespace Neuro::Runtime;
+
+
+constexpr uint32 numBlocks = 1000;
+constexpr uint32 blockSize = 1024;
+
+
+/**
+ * Tests whether the value reported for `expected` lies within the precision of
+ * the histogram.
+ */
+bool isClose(uint64 actual, uint64 expected) {
+    const uint64 tolerance = expected / LatencyHistogram::SubBucketCount;
+    return actual + tolerance >= expected && actual <= expected + tolerance;
+}
+
+
+int main(int argc, char** argv) {
+    Testing::section("Latency Histogram", [&]() {
+        Testing::test("Small values are exact", [&]() {
+            LatencyHistogram histogram;
+            for (uint64 value = 0; value < LatencyHistogram::SubBucketCount; ++value) {
+                Testing::assert(LatencyHistogram::getLowestValue(LatencyHistogram::getCounterIndex(value)) == value, "Expected small values to have counters of their own");
+            }
+            histogram.record(uint64(3));
+            histogram.record(uint64(7));
+            Testing::assert(histogram.percentile(50) == 3 && histogram.percentile(100) == 7, "Expected exact percentiles of small values");
+        });
+        
+        Testing::test("Counters cover all values", [&]() {
+            for (uint32 index = 0; index + 1 < LatencyHistogram::NumCounters; ++index) {
+                Testing::assert(LatencyHistogram::getHighestValue(index) + 1 == LatencyHistogram::getLowestValue(index + 1), "Expected counters to be contiguous");
+            }
+            Testing::assert(LatencyHistogram::getCounterIndex(std::numeric_limits<uint64>::max()) == LatencyHistogram::NumCounters - 1, "Expected the largest value to fall into the last counter");
+            Testing::assert(LatencyHistogram::getHighestValue(LatencyHistogram::NumCounters - 1) == std::numeric_limits<uint64>::max(), "Expected the last counter to end at the largest value");
+        });
+        
+        Testing::test("Percentiles", [&]() {
+            LatencyHistogram histogram;
+            for (uint64 value = 1; value <= 100000; ++value) histogram.record(value * 1000);
+            
+            Testing::assert(histogram.count() == 100000, "Expected every value to be counted");
+            Testing::assert(histogram.min() == 1000 && histogram.max() == 100000000, "Expected exact extremes");
+            Testing::assert(histogram.mean() == 50000500, "Expected exact mean");
+            Testing::assert(isClose(histogram.percentile(50), 50000000), "Median out of precision");
+            Testing::assert(isClose(histogram.percentile(99), 99000000), "99th percentile out of precision");
+            Testing::assert(isClose(histogram.percentile(99.9), 99900000), "99.9th percentile out of precision");
+            Testing::assert(histogram.percentile(100) == 100000000, "Expected the 100th percentile to be the maximum");
+        });
+        
+        Testing::test("Merge and reset", [&]() {
+            LatencyHistogram lhs, rhs;
+            lhs.record(std::chrono::microseconds(10));
+            rhs.record(std::chrono::milliseconds(10));
+            lhs.merge(rhs);
+            Testing::assert(lhs.count() == 2 && lhs.min() == 10000 && lhs.max() == 10000000, "Expected merged histogram to hold both values");
+            
+            lhs.reset();
+            Testing::assert(lhs.count() == 0 && lhs.percentile(50) == 0 && lhs.max() == 0, "Expected reset histogram to be empty");
+        });
+    });
+    
+    auto* gc = new QuietGC();
+    GC::init(gc);
+    gc->registerMemoryScanner(GC::ScannerDelegate::FunctionDelegate<scanBlocks>());
+    
+    Testing::section("GC Statistics", [&]() {
+        Testing::test("Cycles are counted", [&]() {
+            const auto before = gc->getStats();
+            gc->sweepCycle();
+            gc->collect();
+            gc->collect(true);
+            
+            const auto after = gc->getStats();
+            Testing::assert(after.numCycles == before.numCycles + 3, "Expected every cycle to be counted");
+            Testing::assert(after.numMajorCycles == before.numMajorCycles + 1, "Expected the major cycle to be counted");
+            Testing::assert(after.scanTimes.count() == 3 && after.sweepTimes.count() == 3, "Expected scan and sweep of every cycle to be recorded");
+            Testing::assert(after.compactTimes.count() == 2, "Expected only compactions to be recorded");
+            Testing::assert(after.pauseTimes.count() == 2, "Expected only explicit collections to pause the host");
+            Testing::assert(after.pauseTimes.max() >= static_cast<uint64>(after.lastScan.count() + after.lastSweep.count() + after.lastCompact.count()), "Expected pauses to include all phases");
+        });
+        
+        Testing::test("Allocated and live bytes", [&]() {
+            const auto before = gc->getStats();
+            for (uint32 i = 0; i < 2 * numBlocks; ++i) {
+                auto ptr = gc->allocateTrivial(1, blockSize);
+                if (i % 2) keptBlocks.add(ptr);
+            }
+            
+            const auto allocated = gc->getStats();
+            Testing::assert(allocated.bytesAllocated >= before.bytesAllocated + 2 * numBlocks * blockSize, "Expected allocations to be counted");
+            Testing::assert(allocated.numRecords >= before.numRecords + 2 * numBlocks, "Expected table records to be counted");
+            
+            // The garbage is spared once as a newborn.
+            gc->collect();
+            gc->collect();
+            const auto collected = gc->getStats();
+            const uint64 keptBytes = numBlocks * (blockSize + sizeof(ManagedMemoryOverhead));
+            Testing::assert(collected.liveBytes >= keptBytes, "Expected live bytes to include the kept blocks");
+            Testing::assert(collected.liveBytes < keptBytes + keptBytes / 4, "Expected live bytes to exclude the garbage");
+            Testing::assert(collected.numRecords < allocated.numRecords, "Expected collected records not to be counted");
+            Testing::assert(collected.numNurserySegments >= 1 && collected.numDormantSegments >= 1, "Expected segments to be counted");
+            Testing::assert(collected.committedBytes >= collected.liveBytes, "Expected live memory to be committed");
+            
+            keptBlocks.clear();
+            gc->collect(true);
+            gc->collect(true);
+        });
+        
+        Testing::test("Incremental steps", [&]() {
+            const auto before = gc->getStats();
+            while (gc->step(std::chrono::microseconds(100)));
+            
+            const auto after = gc->getStats();
+            Testing::assert(after.numCycles == before.numCycles + 1, "Expected incremental cycle to be counted once");
+            Testing::assert(after.pauseTimes.count() > before.pauseTimes.count(), "Expected steps to pause the host");
+            Testing::assert(after.compactTimes.count() == before.compactTimes.count(), "Expected steps not to compact");
+        });
+        
+        Testing::test("C interface", [&]() {
+            const auto snapshot = gc->getStats();
+            neuroGCStats stats;
+            Testing::assert(neuroGCGetStats(&stats) == 0, "Expected stats to be available");
+            Testing::assert(stats.numCycles == snapshot.numCycles && stats.liveBytes == snapshot.liveBytes, "Expected C stats to match");
+            Testing::assert(neuroGCGetLatencyCount(NGCH_Pause) == snapshot.pauseTimes.count(), "Expected C pause count to match");
+            Testing::assert(neuroGCGetLatencyPercentile(NGCH_Pause, 100) == snapshot.pauseTimes.max(), "Expected C pause maximum to match");
+            
+            Testing::assert(neuroGCResetStats() == 0, "Expected stats to be reset");
+            Testing::assert(neuroGCGetLatencyCount(NGCH_Pause) == 0 && neuroGCGetLatencyCount(NGCH_Scan) == 0, "Expected reset histograms to be empty");
+            Testing::assert(gc->getStats().numCycles == snapshot.numCycles, "Expected counters to survive a reset");
+        });
+    });
+    
+    keptBlocks.clear();
+    GC::destroy();
+    return 0;
+}
@@ -0,0 +1,188 @@
+////////////////////////////////////////////////////////////////////////////////
+// Unit Test for the GC's trace events. Verifies that the ring buffer retains
+// the newest events, that concurrently recorded events are never torn, and that
+// the GC's phases are exported as Chrome trace JSON once tracing is enabled.
+// -----
+// Copyright (c) Kiruse 2018 Germany
+// License: GPL 3.0
+#include "CLInterface.hpp"
+#include "GC/NeuroGC.h"
+#include "GC/NeuroGC.hpp"
+#include "GC/TraceBuffer.hpp"
+#include "NeuroRT/QuietGC.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace Neuro;
+using namespace Neuro::Runtime;
+
+
+constexpr uint32 numBlocks = 20000;
+constexpr uint32 blockSize = 256;
+constexpr uint32 numWriters = 4;
+constexpr uint32 eventsPerWriter = 20000;
+
+
+/**
+ * Dumps the trace into a string.
+ */
+class TracingGC : public QuietGC {
+public:
+    std::string dump() {
+        std::ostringstream out;
+        writeTrace(out);
+        return out.str();
+    }
+};
+
+uint32 countOccurrences(const std::string& haystack, const std::string& needle) {
+    uint32 count = 0;
+    for (size_t pos = haystack.find(needle); pos != std::string::npos; pos = haystack.find(needle, pos + needle.length())) ++count;
+    return count;
+}
+
+bool hasEvent(const std::string& trace, const char* name) {
+    return countOccurrences(trace, std::string("\"name\":\"") + name + "\"") > 0;
+}
+
+
+int main(int argc, char** argv) {
+    Testing::section("Trace Buffer", [&]() {
+        Testing::test("Capacity is a power of two", [&]() {
+            Testing::assert(TraceBuffer(5).capacity() == 8, "Expected capacity to be rounded up");
+            Testing::assert(TraceBuffer(64).capacity() == 64, "Expected power of two capacity to be kept");
+        });
+        
+        Testing::test("Full ring keeps the newest events", [&]() {
+            TraceBuffer buffer(8);
+            for (uint32 i = 0; i < 20; ++i) buffer.instant("Event", "index", i);
+            
+            Buffer<TraceBuffer::Event> events;
+            buffer.collect(events);
+            Testing::assert(events.length() == 8 && buffer.countRecorded() == 20, "Expected the ring to hold its capacity");
+            
+            bool ordered = true;
+            for (uint32 i = 0; i < events.length(); ++i) ordered = ordered && events[i].arg == 12 + i && events[i].phase == 'i';
+            Testing::assert(ordered, "Expected the newest events, oldest first");
+            
+            buffer.clear();
+            events.clear();
+            buffer.collect(events);
+            Testing::assert(events.length() == 0, "Expected cleared events to be gone");
+        });
+        
+        Testing::test("Chrome trace JSON", [&]() {
+            TraceBuffer buffer(4);
+            buffer.begin("Outer");
+            buffer.begin("Inner", "bytes", 42);
+            buffer.end("Inner");
+            buffer.instant("Mark");
+            buffer.end("Outer");
+            
+            std::ostringstream out;
+            buffer.writeChromeTrace(out);
+            const std::string json = out.str();
+            
+            Testing::assert(json.rfind("{\"traceEvents\":[", 0) == 0, "Expected a trace event document");
+            Testing::assert(json.find("],\"displayTimeUnit\":\"ms\"}") == json.length() - 25, "Expected the document to be closed");
+            Testing::assert(json.find("\"args\":{\"bytes\":42}") != std::string::npos, "Expected the argument to be written");
+            Testing::assert(json.find("\"ph\":\"i\"") != std::string::npos && json.find("\"s\":\"t\"") != std::string::npos, "Expected a thread-scoped instant event");
+            Testing::assert(countOccurrences(json, "\"ph\":\"E\"") == 1 && !hasEvent(json, "Outer"), "Expected the end of the overwritten span to be dropped");
+        });
+        
+        Testing::test("Concurrent events are never torn", [&]() {
+            TraceBuffer buffer(1024);
+            std::atomic_bool done(false);
+            bool intact = true;
+            
+            std::thread reader([&]() {
+                Buffer<TraceBuffer::Event> events;
+                while (!done.load()) {
+                    events.clear();
+                    buffer.collect(events);
+                    for (auto& event : events) {
+                        // Every writer pairs its name with its own argument.
+                        intact = intact && event.name && event.argName && event.phase == 'i' && event.arg == event.name[0] - 'A';
+                    }
+                }
+            });
+            
+            static const char* const names[numWriters] = { "A", "B", "C", "D" };
+            std::vector<std::thread> writers;
+            for (uint32 i = 0; i < numWriters; ++i) {
+                writers.emplace_back([&buffer, i]() {
+                    for (uint32 j = 0; j < eventsPerWriter; ++j) buffer.instant(names[i], "writer", i);
+                });
+            }
+            for (auto& writer : writers) writer.join();
+            done = true;
+            reader.join();
+            
+            Testing::assert(intact, "Expected every collected event to be consistent");
+            Testing::assert(buffer.countRecorded() == numWriters * eventsPerWriter, "Expected every event to be recorded");
+        });
+    });
+    
+    auto* gc = new TracingGC();
+    GC::init(gc);
+    
+    Testing::section("GC Tracing", [&]() {
+        Testing::test("Disabled by default", [&]() {
+            gc->collect();
+            Testing::assert(gc->dump().empty(), "Expected no trace before tracing is enabled");
+        });
+        
+        Testing::test("Phases are traced", [&]() {
+            gc->enableTracing();
+            
+            Buffer<ManagedMemoryPointerBase> blocks;
+            for (uint32 i = 0; i < numBlocks; ++i) blocks.add(gc->allocateTrivial(1, blockSize));
+            gc->reallocate(blocks[0], 1, 2 * blockSize);
+            gc->collect();
+            while (gc->step(std::chrono::microseconds(100)));
+            
+            const std::string trace = gc->dump();
+            for (const char* name : { "Collect", "Cycle", "Scan", "Sweep", "Compact", "RefineCards", "Step", "Reallocate", "GrowTable", "CreateSegment" }) {
+                Testing::assert(hasEvent(trace, name), (std::string("Expected event ") + name).c_str());
+            }
+            Testing::assert(countOccurrences(trace, "\"ph\":\"B\"") == countOccurrences(trace, "\"ph\":\"E\""), "Expected every span to be closed");
+            
+            blocks.clear();
+            gc->collect();
+        });
+        
+        Testing::test("Disabling stops recording", [&]() {
+            gc->disableTracing();
+            const uint32 cycles = countOccurrences(gc->dump(), "\"name\":\"Cycle\"");
+            gc->collect();
+            Testing::assert(countOccurrences(gc->dump(), "\"name\":\"Cycle\"") == cycles, "Expected no events while disabled");
+            
+            gc->clearTrace();
+            Testing::assert(!hasEvent(gc->dump(), "Cycle"), "Expected cleared events to be gone");
+        });
+        
+        Testing::test("C interface", [&]() {
+            const char* path = "TestGCTrace.json";
+            Testing::assert(neuroGCEnableTracing(0) == 0, "Expected tracing to be enabled");
+            gc->collect();
+            Testing::assert(neuroGCWriteTrace(path) == 0, "Expected the trace to be written");
+            Testing::assert(neuroGCDisableTracing() == 0, "Expected tracing to be disabled");
+            
+            std::ifstream file(path);
+            std::stringstream contents;
+            contents << file.rdbuf();
+            file.close();
+            std::remove(path);
+            Testing::assert(hasEvent(contents.str(), "Cycle"), "Expected the written trace to hold the cycle");
+        });
+    });
+    
+    GC::destroy();
+    return 0;
+}
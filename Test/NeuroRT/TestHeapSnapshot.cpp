@@ -0,0 +1,243 @@
+////////////////////////////////////////////////////////////////////////////////
+// Unit Test for heap snapshots and their analysis. Verifies that snapshots
+// survive their binary format, that retained sizes follow the dominator tree,
+// and that snapshots of a live GC capture its roots and object graph.
+// -----
+// Copyright (c) Kiruse 2018 Germany
+// License: GPL 3.0
+#include "CLInterface.hpp"
+#include "GC/HeapAnalysis.hpp"
+#include "GC/HeapSnapshot.hpp"
+#include "GC/ManagedMemoryOverhead.hpp"
+#include "GC/NeuroGC.h"
+#include "GC/NeuroGC.hpp"
+#include "NeuroObject.hpp"
+#include "NeuroRT/QuietGC.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+using namespace Neuro;
+using namespace Neuro::Runtime;
+
+
+void addObject(HeapSnapshot& snapshot, uint32 tableIndex, uint32 numProperties, uint32 bytes, std::initializer_list<uint32> targets) {
+    HeapSnapshot::ObjectNode object = { tableIndex, numProperties, numProperties, snapshot.references.length(), static_cast<uint32>(targets.size()) };
+    uint32 propertyId = 0;
+    for (uint32 target : targets) snapshot.references.add(HeapSnapshot::Reference{ propertyId++, target });
+    snapshot.objects.add(object);
+    snapshot.blocks.add({ 0, bytes, tableIndex, 0, EHeapBlockFlags::Object, EGarbageState::Live, 0 });
+}
+
+/**
+ * Finds the table index of the pointer through the address of its record.
+ */
+uint32 findTableIndex(const HeapSnapshot& snapshot, const ManagedMemoryPointerBase& ptr) {
+    const uint64 address = reinterpret_cast<uintptr_t>(GC::getOverhead(ptr));
+    for (const auto& record : snapshot.records) {
+        if (record.address == address) return record.index;
+    }
+    return npos;
+}
+
+/**
+ * Diamond below the first root, an object shared between both roots, and an
+ * unreachable object:
+ *
+ *     A(10) -> B(11), C(12), S(14)    B -> D(13)    C -> D
+ *     R(20) -> S                      E(15)
+ */
+void buildSnapshot(HeapSnapshot& snapshot) {
+    snapshot.segments.add({ 0x1000, 4096, 1024, 0 });
+    addObject(snapshot, 10, 3, 100, { 11, 12, 14 });
+    addObject(snapshot, 11, 1, 100, { 13 });
+    addObject(snapshot, 12, 1, 100, { 13 });
+    addObject(snapshot, 13, 0, 400, {});
+    addObject(snapshot, 14, 5, 100, {});
+    addObject(snapshot, 15, 8, 100, { 10 });
+    addObject(snapshot, 20, 2, 100, { 14 });
+    snapshot.roots.add(10);
+    snapshot.roots.add(20);
+    
+    // Second segment with 128 free bytes, split into 64 + 32 + 32.
+    snapshot.segments.add({ 0x2000, 4096, 256, EHeapSegmentFlags::Dormant });
+    snapshot.blocks.add({ 0x2000, 64, npos, 1, 0, EGarbageState::Swept, 0 });
+    snapshot.blocks.add({ 0x2040, 128, npos, 1, 0, EGarbageState::Live, 0 });
+    snapshot.blocks.add({ 0x20c0, 32, npos, 1, 0, EGarbageState::Swept, 0 });
+    snapshot.blocks.add({ 0x20e0, 32, npos, 1, 0, EGarbageState::Swept, 0 });
+}
+
+
+int main(int argc, char** argv) {
+    Testing::section("Heap Snapshot", [&]() {
+        Testing::test("Binary round trip", [&]() {
+            HeapSnapshot snapshot, copy;
+            buildSnapshot(snapshot);
+            snapshot.records.add({ 10, 0x12345678, 0x1000 });
+            
+            std::stringstream stream;
+            Testing::assert(!snapshot.write(stream), "Expected the snapshot to be written");
+            Testing::assert(!copy.read(stream), "Expected the snapshot to be read");
+            
+            Testing::assert(copy.segments.length() == snapshot.segments.length() && copy.blocks.length() == snapshot.blocks.length()
+                         && copy.objects.length() == snapshot.objects.length() && copy.references.length() == snapshot.references.length()
+                         && copy.roots.length() == 2 && copy.records.length() == 1, "Expected every section to be restored");
+            Testing::assert(copy.records[0].generation == 0x12345678 && copy.blocks[3].totalBytes == 400 && copy.objects[6].tableIndex == 20
+                         && copy.references[2].target == 14 && copy.segments[1].flags == EHeapSegmentFlags::Dormant, "Expected entries to be restored");
+        });
+        
+        Testing::test("Invalid snapshots are rejected", [&]() {
+            HeapSnapshot snapshot;
+            std::stringstream garbage("definitely not a heap snapshot");
+            Testing::assert(snapshot.read(garbage) == InvalidArgumentError::instance(), "Expected a wrong magic number to be rejected");
+            
+            buildSnapshot(snapshot);
+            std::stringstream stream;
+            snapshot.write(stream);
+            const std::string truncated = stream.str().substr(0, stream.str().length() - 4);
+            std::stringstream truncatedStream(truncated);
+            Testing::assert(snapshot.read(truncatedStream) == InvalidArgumentError::instance() && snapshot.objects.length() == 0, "Expected a truncated snapshot to be rejected");
+            
+            buildSnapshot(snapshot);
+            snapshot.objects[0].numReferences = 1000;
+            std::stringstream inconsistent;
+            snapshot.write(inconsistent);
+            Testing::assert(snapshot.read(inconsistent) == InvalidArgumentError::instance(), "Expected out of range references to be rejected");
+        });
+    });
+    
+    Testing::section("Heap Analysis", [&]() {
+        HeapSnapshot snapshot;
+        buildSnapshot(snapshot);
+        HeapAnalysis analysis(snapshot);
+        const uint32 a = analysis.findNode(10), d = analysis.findNode(13), s = analysis.findNode(14), e = analysis.findNode(15), r = analysis.findNode(20);
+        
+        Testing::test("Dominator tree", [&]() {
+            Testing::assert(analysis.countNodes() == 7 && analysis.findNode(99) == npos, "Expected a node per object");
+            Testing::assert(analysis.getDominator(d) == a, "Expected the diamond to be dominated by its top");
+            Testing::assert(analysis.getDominator(s) == analysis.getVirtualRoot(), "Expected shared objects to be dominated by the virtual root");
+            Testing::assert(analysis.getDominator(a) == analysis.getVirtualRoot() && analysis.getDominator(r) == analysis.getVirtualRoot(), "Expected roots to be dominated by the virtual root");
+            Testing::assert(!analysis.isReachable(e) && analysis.isReachable(analysis.getVirtualRoot()), "Expected unreachable objects to be outside the tree");
+            
+            Buffer<uint32> dominated;
+            analysis.getDominated(a, dominated);
+            Testing::assert(dominated.length() == 3 && dominated[0] == d, "Expected the largest dominated object first");
+        });
+        
+        Testing::test("Retained sizes", [&]() {
+            Testing::assert(analysis.getShallowBytes(d) == 400, "Expected the block size as shallow size");
+            Testing::assert(analysis.getRetainedBytes(a) == 700 && analysis.getRetainedObjects(a) == 4, "Expected the diamond to be retained by its top");
+            Testing::assert(analysis.getRetainedBytes(analysis.getVirtualRoot()) == 900 && analysis.getRetainedObjects(analysis.getVirtualRoot()) == 6, "Expected the virtual root to retain all reachable objects");
+            
+            Buffer<HeapAnalysis::RootSummary> roots;
+            analysis.summarizeRoots(roots);
+            Testing::assert(roots.length() == 2 && roots[0].tableIndex == 10 && roots[1].tableIndex == 20, "Expected the largest root first");
+            Testing::assert(roots[1].retainedBytes == 100 && roots[1].retainedObjects == 1, "Expected shared objects to be retained by neither root");
+        });
+        
+        Testing::test("Property count buckets", [&]() {
+            Buffer<HeapAnalysis::PropertyBucket> buckets;
+            analysis.summarizePropertyCounts(buckets);
+            Testing::assert(buckets.length() == 5, "Expected buckets up to the largest object");
+            Testing::assert(buckets[0].numObjects == 1 && buckets[1].numObjects == 2 && buckets[2].numObjects == 2 && buckets[3].numObjects == 1 && buckets[4].numObjects == 1, "Expected objects to be counted per bucket");
+            Testing::assert(buckets[2].minProperties == 2 && buckets[2].maxProperties == 3 && buckets[4].minProperties == 8 && buckets[4].maxProperties == 15, "Expected power of two ranges");
+            Testing::assert(buckets[0].bytes == 400, "Expected bytes to be counted per bucket");
+        });
+        
+        Testing::test("Segment fragmentation", [&]() {
+            Buffer<HeapAnalysis::SegmentSummary> segments;
+            analysis.summarizeSegments(segments);
+            Testing::assert(segments.length() == 2, "Expected a summary per segment");
+            Testing::assert(segments[0].freeBytes == 0 && segments[0].fragmentation == 0, "Expected a full segment to be unfragmented");
+            Testing::assert(segments[1].freeBytes == 128 && segments[1].liveBytes == 128 && segments[1].numFreeBlocks == 3 && segments[1].largestFreeBlock == 64, "Expected free blocks to be counted");
+            Testing::assert(segments[1].fragmentation == 0.5, "Expected half the free memory outside the largest block");
+        });
+    });
+    
+    auto* gc = new QuietGC();
+    GC::init(gc);
+    
+    Testing::section("GC Snapshots", [&]() {
+        Testing::test("Roots and object graph", [&]() {
+            Pointer root = Object::createObject(4);
+            root->root();
+            Pointer left = Object::createObject(4);
+            Pointer right = Object::createObject(4);
+            Pointer shared = Object::createObject(4);
+            root->getProperty("left") = left;
+            root->getProperty("right") = right;
+            left->getProperty("shared") = shared;
+            right->getProperty("shared") = shared;
+            shared->getProperty("value") = 42;
+            
+            // Only objects traced before are known to be objects.
+            Pointer garbage = Object::createObject(4);
+            garbage->root();
+            gc->collect();
+            garbage->unroot();
+            
+            HeapSnapshot snapshot;
+            gc->takeSnapshot(snapshot);
+            HeapAnalysis analysis(snapshot);
+            
+            const uint32 rootIndex = findTableIndex(snapshot, root), leftIndex = findTableIndex(snapshot, left);
+            Testing::assert(snapshot.roots.length() == 1 && snapshot.roots[0] == rootIndex, "Expected the rooted object");
+            Testing::assert(snapshot.records.length() >= 5 && snapshot.segments.length() > 0, "Expected the table and segments");
+            
+            const uint32 rootNode = analysis.findNode(rootIndex);
+            const uint32 sharedNode = analysis.findNode(findTableIndex(snapshot, shared));
+            const uint32 garbageNode = analysis.findNode(findTableIndex(snapshot, garbage));
+            Testing::assert(rootNode != npos && sharedNode != npos && garbageNode != npos, "Expected every object in the graph");
+            Testing::assert(analysis.getDominator(sharedNode) == rootNode, "Expected the root to dominate the diamond");
+            Testing::assert(analysis.getRetainedObjects(rootNode) == 4 && analysis.getRetainedBytes(rootNode) > 0, "Expected the root to retain the diamond");
+            Testing::assert(!analysis.isReachable(garbageNode), "Expected unswept garbage to be unreachable");
+            Testing::assert(analysis.getObject(sharedNode).numProperties == 1 && analysis.getObject(sharedNode).numReferences == 0, "Expected primitive properties to be counted, not referenced");
+            
+            const auto& object = analysis.getObject(rootNode);
+            bool foundLeft = false;
+            for (uint32 i = 0; i < object.numReferences; ++i) {
+                const auto& reference = snapshot.references[object.firstReference + i];
+                foundLeft = foundLeft || (reference.propertyId == Identifier::lookup("left").number && reference.target == leftIndex);
+            }
+            Testing::assert(foundLeft, "Expected references to carry their property");
+            
+            // Blocks tile every segment up to its used bytes.
+            bool tiled = true;
+            for (uint32 i = 0; i < snapshot.segments.length(); ++i) {
+                uint64 bytes = 0;
+                for (const auto& block : snapshot.blocks) if (block.segment == i) bytes += block.totalBytes;
+                tiled = tiled && bytes == snapshot.segments[i].usedBytes;
+            }
+            Testing::assert(tiled, "Expected blocks to cover the used bytes of their segment");
+            
+            root->unroot();
+            gc->collect(true);
+        });
+        
+        Testing::test("Dumping to a file", [&]() {
+            const char* path = "TestHeapSnapshot.bin";
+            Pointer root = Object::createObject(4);
+            root->root();
+            root->getProperty("child") = Object::createObject(4);
+            
+            Testing::assert(!gc->dumpHeap(path), "Expected the heap to be dumped");
+            HeapSnapshot snapshot;
+            {
+                std::ifstream file(path, std::ios::binary);
+                Testing::assert(!snapshot.read(file), "Expected the dump to be readable");
+            }
+            Testing::assert(snapshot.roots.length() == 1 && snapshot.objects.length() == 2, "Expected the dumped object graph");
+            
+            Testing::assert(neuroGCDumpHeap(path) == 0, "Expected the C interface to dump the heap");
+            Testing::assert(neuroGCDumpHeap(nullptr) != 0, "Expected a missing path to fail");
+            std::remove(path);
+            
+            root->unroot();
+            gc->collect(true);
+        });
+    });
+    
+    GC::destroy();
+    return 0;
+}
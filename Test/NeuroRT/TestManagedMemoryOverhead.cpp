@@ -20,8 +20,8 @@ int main() {
         Testing::assert(head->getBufferBytes() == numBufferBytes, "Wrong count of bytes in buffer");
         Testing::assert(head->getTotalBytes()  == numBufferBytes + sizeof(ManagedMemoryOverhead), "Wrong count of total bytes of memory region");
         
-        Testing::assert(!head->copyDelegate.valid(), "Unexpected copy delegate");
-        Testing::assert(!head->destroyDelegate.valid(), "Unexpected destroy delegate");
+        Testing::assert(head->typeId == 0 && !head->getType(), "Unexpected type descriptor");
+        Testing::assert(sizeof(ManagedMemoryOverhead) == 16, "Expected a compact header");
         
         Testing::assert((uint8*)head->getBufferPointer() == buffer + sizeof(ManagedMemoryOverhead), "Incorrect buffer start address");
         Testing::assert((uint8*)head->getBeyondPointer() == buffer + sizeof(ManagedMemoryOverhead) + numBufferBytes, "Incorrect beyond address");
@@ -3,6 +3,8 @@
 // License: GPL 3.0
 ////////////////////////////////////////////////////////////////////////////////
 #include <cstdlib>
+#include <memory>
+#include <thread>
 
 #include "Assert.hpp"
 #include "CLInterface.hpp"
@@ -49,10 +51,9 @@ public: // GCInterface
         return dataTable.addPointer(head);
     }
     
-    virtual ManagedMemoryPointerBase allocateNonTrivial(uint32 elementSize, uint32 count, const Delegate<void, void*, const void*>& copyDeleg, const Delegate<void, void*>& destroyDeleg) override {
+    virtual ManagedMemoryPointerBase allocateNonTrivial(uint32 elementSize, uint32 count, uint16 typeId) override {
         auto head = new (mainBuffer + cursor) ManagedMemoryOverhead(elementSize, count);
-        copyDeleg.copyTo(&head->copyDelegate.get());
-        destroyDeleg.copyTo(&head->destroyDelegate.get());
+        head->typeId = typeId;
         cursor += head->getTotalBytes();
         return dataTable.addPointer(head);
     }
@@ -62,6 +63,11 @@ public: // GCInterface
         return GenericError::instance();
     }
     
+    virtual Error reallocate(ManagedMemoryPointerBase ptr, uint32 size, uint32 count, const ReallocateDelegate& construct) override {
+        Assert::shouldNotEnter();
+        return GenericError::instance();
+    }
+    
     virtual Error root(Pointer obj) override {
         // Fake GC doesn't scan, so no roots
         return NoError::instance();
@@ -75,7 +81,7 @@ public: // GCInterface
     virtual void* resolve(ManagedMemoryPointerBase pointer) override {
         return dataTable.get(pointer);
     }
-
+    
 public: // Methods
     template<typename T>
     ManagedMemoryPointer<T> alloc(uint32 count = 1) {
@@ -163,6 +169,121 @@ int main() {
             
             Testing::assert(ptr.get() == nullptr, "Failed to remove from table");
         });
+        
+        Testing::test("Recycle", [&]() {
+            auto ptr = gc->alloc<int32>();
+            const uint32 tableIndex = GC::getOverhead(ptr)->tableIndex;
+            gc->removePointer(ptr);
+            
+            auto other = gc->alloc<int32>();
+            Testing::assert(GC::getOverhead(other)->tableIndex == tableIndex, "Expected the freed record to be reused");
+            Testing::assert(ptr.get() == nullptr && other.get() != nullptr, "Expected stale pointers to remain invalid");
+            Testing::assert(!!gc->dataTable.removePointer(ptr), "Expected removing a stale pointer to fail");
+            Testing::assert(ptr != other, "Expected pointers to distinct generations of a record to differ");
+            gc->removePointer(other);
+        });
+        
+        Testing::test("Concurrent recycling", [&]() {
+            constexpr uint32 numThreads = 4;
+            constexpr uint32 batchSize = 16;
+            ManagedMemoryTable& table = gc->dataTable;
+            const uint32 numRecords = table.countRecords();
+            const uint32 numClaimed = table.countClaimedRecords();
+            
+            std::thread threads[numThreads];
+            for (uint32 i = 0; i < numThreads; ++i) {
+                threads[i] = std::thread([&]() {
+                    ManagedMemoryOverhead heads[batchSize];
+                    ManagedMemoryPointerBase pointers[batchSize];
+                    for (uint32 round = 0; round < 10000; ++round) {
+                        for (uint32 j = 0; j < batchSize; ++j) pointers[j] = table.addPointer(heads + j);
+                        for (uint32 j = 0; j < batchSize; ++j) table.removePointer(pointers[j]);
+                    }
+                });
+            }
+            for (auto& thread : threads) thread.join();
+            
+            Testing::assert(table.countRecords() == numRecords, "Expected every record to be removed");
+            Testing::assert(table.countClaimedRecords() <= numClaimed + numThreads * batchSize, "Expected the table to grow with the live records only");
+        });
+        
+        Testing::test("Concurrent growth", [&]() {
+            constexpr uint32 numPointers = 20 * ManagedMemoryTable::PageSize;
+            ManagedMemoryTable table;
+            ManagedMemoryOverhead first;
+            const ManagedMemoryPointerBase ptr = table.addPointer(&first);
+            const uint32 numPages = table.countPages();
+            
+            std::atomic_bool growing(true);
+            std::atomic_bool stable(true);
+            std::thread reader([&]() {
+                while (growing.load()) {
+                    if (table.get(ptr) != first.getBufferPointer()) stable = false;
+                }
+            });
+            
+            std::unique_ptr<ManagedMemoryOverhead[]> heads(new ManagedMemoryOverhead[numPointers]);
+            for (uint32 i = 0; i < numPointers; ++i) table.addPointer(heads.get() + i);
+            growing = false;
+            reader.join();
+            
+            Testing::assert(stable.load(), "Expected records to remain resolvable while the table grows");
+            Testing::assert(table.countPages() > numPages && table.countRecords() == numPointers + 1, "Expected the table to grow");
+            Testing::assert(table.get(table.getPointer(numPointers)) == heads[numPointers - 1].getBufferPointer(), "Expected records on new pages to resolve");
+        });
+        
+        Testing::test("Find gaps", [&]() {
+            ManagedMemoryTable table;
+            ManagedMemoryOverhead heads[100];
+            ManagedMemoryPointerBase pointers[100];
+            for (uint32 i = 0; i < 100; ++i) pointers[i] = table.addPointer(heads + i);
+            
+            // Free every other record of the front half and the entire back half.
+            for (uint32 i = 0; i < 50; i += 2) table.removePointer(pointers[i]);
+            for (uint32 i = 50; i < 100; ++i) table.removePointer(pointers[i]);
+            table.findGaps();
+            Testing::assert(table.countClaimedRecords() == 50, "Expected the trailing records to be unclaimed");
+            
+            bool ordered = true;
+            for (uint32 i = 0; i < 25; ++i) {
+                table.addPointer(heads + i);
+                ordered = ordered && heads[i].tableIndex == i * 2;
+            }
+            Testing::assert(ordered, "Expected the free records to be reused lowest first");
+            table.addPointer(heads);
+            Testing::assert(heads[0].tableIndex == 50, "Expected fresh records to follow");
+        });
+        
+        Testing::test("Release empty pages", [&]() {
+            constexpr uint32 numPointers = 4 * ManagedMemoryTable::PageSize;
+            ManagedMemoryTable table;
+            std::unique_ptr<ManagedMemoryOverhead[]> heads(new ManagedMemoryOverhead[numPointers]);
+            std::unique_ptr<ManagedMemoryPointerBase[]> pointers(new ManagedMemoryPointerBase[numPointers]);
+            for (uint32 i = 0; i < numPointers; ++i) pointers[i] = table.addPointer(heads.get() + i);
+            
+            // Keep a single record alive on the first page only.
+            for (uint32 i = 1; i < numPointers; ++i) table.removePointer(pointers[i]);
+            table.findGaps();
+            Testing::assert(table.countReleasedPages() == 3, "Expected the empty pages to be released");
+            Testing::assert(table.countClaimedRecords() == numPointers, "Expected the records of released pages to remain reserved");
+            Testing::assert(table.get(pointers[0]) == heads[0].getBufferPointer(), "Expected the live record to be intact");
+            
+            // Reuse the free records of the first page before released pages.
+            for (uint32 i = 1; i < ManagedMemoryTable::PageSize; ++i) table.addPointer(heads.get() + i);
+            Testing::assert(table.countReleasedPages() == 3, "Expected free records to be reused first");
+            
+            const ManagedMemoryPointerBase reclaimed = table.addPointer(heads.get() + ManagedMemoryTable::PageSize);
+            Testing::assert(table.countReleasedPages() == 2 && table.countClaimedRecords() == numPointers, "Expected a released page to be reused");
+            Testing::assert(table.get(reclaimed) == heads[ManagedMemoryTable::PageSize].getBufferPointer(), "Expected the reused page to resolve");
+            Testing::assert(!table.get(pointers[ManagedMemoryTable::PageSize]) && !!table.removePointer(pointers[ManagedMemoryTable::PageSize]), "Expected stale pointers into the reused page to remain invalid");
+            
+            uint32 numLive = 0;
+            for (auto ptr : table) {
+                (void)ptr;
+                ++numLive;
+            }
+            Testing::assert(numLive == ManagedMemoryTable::PageSize + 1, "Expected only live records to be iterated");
+        });
     });
     
     GC::destroy();
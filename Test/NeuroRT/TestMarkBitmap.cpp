@@ -0,0 +1,74 @@
+////////////////////////////////////////////////////////////////////////////////
+// Unit Test for the GC's MarkBitmap.
+// -----
+// Copyright (c) Kiruse 2018 Germany
+// License: GPL 3.0
+#include "CLInterface.hpp"
+#include "GC/MarkBitmap.hpp"
+#include "Misc.hpp"
+
+using namespace Neuro;
+using namespace Neuro::Runtime;
+
+
+int main(int argc, char** argv) {
+    Testing::section("MarkBitmap", []() {
+        Testing::test("Mark & reset", []() {
+            MarkBitmap marks;
+            marks.reset(100);
+            
+            Testing::assert(marks.countWords() == 2, "Expected 100 records to occupy 2 words");
+            Testing::assert(marks.countMarked() == 0, "Expected no marks after reset");
+            
+            Testing::assert(marks.mark(3), "Expected first mark to succeed");
+            Testing::assert(!marks.mark(3), "Expected repeated mark to fail");
+            Testing::assert(marks.mark(99), "Expected mark of last record to succeed");
+            Testing::assert(!marks.mark(100), "Expected mark beyond the bitmap to fail");
+            
+            Testing::assert(marks.isMarked(3) && marks.isMarked(99), "Expected records 3 and 99 to be marked");
+            Testing::assert(!marks.isMarked(4), "Expected record 4 to be unmarked");
+            Testing::assert(marks.countMarked() == 2, "Expected exactly 2 marks");
+            
+            marks.reset(1000);
+            Testing::assert(marks.countWords() == 16, "Expected 1000 records to occupy 16 words");
+            Testing::assert(!marks.isMarked(3), "Expected reset to clear marks");
+            Testing::assert(marks.countMarked() == 0, "Expected no marks after growing");
+        });
+        
+        Testing::test("Padding bits count as marked", []() {
+            MarkBitmap marks;
+            marks.reset(70);
+            
+            // Only the 6 valid bits of the second word may be unmarked.
+            Testing::assert(countSetBits(~marks.getWord(1)) == 6, "Expected padding of the last word to be set");
+            
+            marks.mark(64);
+            Testing::assert(countTrailingZeros(~marks.getWord(1)) == 1, "Expected record 65 to be the first unmarked record of the second word");
+        });
+        
+        Testing::test("Resize & merge", []() {
+            MarkBitmap dormant;
+            dormant.reset(70);
+            dormant.mark(3);
+            dormant.mark(69);
+            
+            dormant.resize(1000);
+            Testing::assert(dormant.isMarked(3) && dormant.isMarked(69), "Expected resize to retain marks");
+            Testing::assert(!dormant.isMarked(70) && !dormant.isMarked(127), "Expected former padding to be cleared");
+            Testing::assert(dormant.countMarked() == 2, "Expected exactly 2 marks after resizing");
+            
+            dormant.unmark(3);
+            Testing::assert(!dormant.isMarked(3), "Expected record 3 to be unmarked");
+            
+            MarkBitmap marks;
+            marks.reset(2000);
+            marks.mark(5);
+            marks.merge(dormant);
+            Testing::assert(marks.isMarked(5) && marks.isMarked(69), "Expected merge to combine marks");
+            Testing::assert(!marks.isMarked(1000) && !marks.isMarked(1023), "Expected merge to ignore the padding of the other bitmap");
+            Testing::assert(marks.countMarked() == 2, "Expected exactly 2 marks after merging");
+        });
+    });
+    
+    return 0;
+}
@@ -32,10 +32,10 @@ using namespace Neuro::Runtime;
 struct FakeGCRecord
 {
     uint8* addr;
-    hashT hash;
+    uint32 hash;
     
     FakeGCRecord() = default;
-    FakeGCRecord(uint8* addr, hashT hash) : addr(addr), hash(hash) {}
+    FakeGCRecord(uint8* addr, uint32 hash) : addr(addr), hash(hash) {}
 };
 
 class FakeGC : public GCInterface
@@ -66,7 +66,7 @@ public: // RAII
 public: // GCInterface
     virtual ManagedMemoryPointerBase allocateTrivial(uint32 size, uint32 count) override {
         uint8* buffer = mainBuffer + cursor;
-        hashT hash = calculateHash(buffer);
+        uint32 hash = static_cast<uint32>(calculateHash(buffer));
         
         FakeGCRecord record(buffer, hash);
         auto* head = new (buffer) ManagedMemoryOverhead(size, count);
@@ -75,31 +75,30 @@ public: // GCInterface
         Pointer ptr = makePointer(records.length(), hash);
         records.add(record);
         
-        cursor += size * count;
+        cursor += sizeof(ManagedMemoryOverhead) + size * count;
         return ptr;
     }
     
-    virtual ManagedMemoryPointerBase allocateNonTrivial(uint32 size, uint32 count, const Delegate<void, void*, const void*>& copyDeleg, const Delegate<void, void*>& destroyDeleg) override {
+    virtual ManagedMemoryPointerBase allocateNonTrivial(uint32 size, uint32 count, uint16 typeId) override {
         uint8* buffer = mainBuffer + cursor;
-        hashT hash = calculateHash(buffer);
+        uint32 hash = static_cast<uint32>(calculateHash(buffer));
         
-        FakeGCRecord record(buffer, calculateHash(buffer));
+        FakeGCRecord record(buffer, hash);
         auto* head = new (buffer) ManagedMemoryOverhead(size, count);
 		head->isTrivial = false;
-        copyDeleg.copyTo(&head->copyDelegate.get());
-        destroyDeleg.copyTo(&head->destroyDelegate.get());
+        head->typeId = typeId;
         
         Pointer pointer = makePointer(records.length(), hash);
         records.add(record);
         
-        cursor += size * count;
+        cursor += sizeof(ManagedMemoryOverhead) + size * count;
         return pointer;
     }
     
     virtual Error reallocate(ManagedMemoryPointerBase ptr, uint32 size, uint32 count, bool autocopy = true) {
         ManagedMemoryOverhead* oldHead = GC::getOverhead(ptr);
         uint32 tableIndex;
-        hashT hash;
+        uint32 hash;
         extractPointerData(ptr, tableIndex, hash);
         
         auto& record = records[tableIndex];
@@ -110,23 +109,22 @@ public: // GCInterface
         
         uint8* oldBuffer = record.addr;
         uint8* newBuffer = mainBuffer + cursor;
-        cursor += size * count;
+        cursor += sizeof(ManagedMemoryOverhead) + size * count;
         
         ManagedMemoryOverhead* newHead = new (newBuffer) ManagedMemoryOverhead(size, count);
         newHead->isTrivial = oldHead->isTrivial;
         
         if (oldHead->isTrivial) {
-            std::memset(newBuffer, 0, size * count);
+            std::memset(newHead->getBufferPointer(), 0, size * count);
             if (autocopy) {
-                std::memcpy(newBuffer, oldBuffer, std::min(oldHead->elementSize * oldHead->count, size * count));
+                std::memcpy(newHead->getBufferPointer(), oldHead->getBufferPointer(), std::min(oldHead->elementSize * oldHead->count, size * count));
             }
         }
         else {
-            oldHead->copyDelegate.get().copyTo(&newHead->copyDelegate.get());
-            oldHead->destroyDelegate.get().copyTo(&newHead->destroyDelegate.get());
+            newHead->typeId = oldHead->typeId;
             
             if (autocopy) {
-                newHead->copyDelegate.get()(newHead->getBufferPointer(), oldHead->getBufferPointer());
+                newHead->getType()->copy(newHead->getBufferPointer(), oldHead->getBufferPointer());
             }
         }
         
@@ -134,6 +132,30 @@ public: // GCInterface
         return NoError::instance();
     }
     
+    virtual Error reallocate(ManagedMemoryPointerBase ptr, uint32 size, uint32 count, const ReallocateDelegate& construct) override {
+        ManagedMemoryOverhead* oldHead = GC::getOverhead(ptr);
+        uint32 tableIndex;
+        uint32 hash;
+        extractPointerData(ptr, tableIndex, hash);
+        
+        auto& record = records[tableIndex];
+        if (record.hash != hash) {
+            Assert::shouldNotEnter();
+            return GenericError::instance();
+        }
+        
+        uint8* newBuffer = mainBuffer + cursor;
+        cursor += sizeof(ManagedMemoryOverhead) + size * count;
+        
+        ManagedMemoryOverhead* newHead = new (newBuffer) ManagedMemoryOverhead(size, count);
+        newHead->isTrivial = oldHead->isTrivial;
+        newHead->typeId = oldHead->typeId;
+        construct(newHead->getBufferPointer(), oldHead->getBufferPointer());
+        
+        record.addr = newBuffer;
+        return NoError::instance();
+    }
+    
     virtual Error root(Pointer obj) override {
         // FakeGC does not actually manage memory, hence no roots
         return NoError::instance();
@@ -146,7 +168,7 @@ public: // GCInterface
     
     virtual void* resolve(ManagedMemoryPointerBase pointer) override {
         uint32 index;
-        hashT hash;
+        uint32 hash;
         extractPointerData(pointer, index, hash);
         
         auto& record = records[index];
@@ -0,0 +1,298 @@
+////////////////////////////////////////////////////////////////////////////////
+// Unit Test for mutator safepoints. Verifies that registrations nest, that
+// stopping the world parks polling threads and skips threads in safe regions,
+// that a stop times out on threads which never poll, that compaction and the
+// final remark run only once the registered mutators are stopped, and that
+// references moved and objects recreated during background marking survive.
+// -----
+// Copyright (c) Kiruse 2018 Germany
+// License: GPL 3.0
+#include "CLInterface.hpp"
+#include "GC/NeuroGC.h"
+#include "GC/NeuroGC.hpp"
+#include "NeuroObject.hpp"
+#include "NeuroRT/QuietGC.hpp"
+
+#include <atomic>
+#include <thread>
+
+using namespace Neuro;
+using namespace Neuro::Runtime;
+
+
+QuietGC* gc;
+
+/**
+ * Waits for the given condition up to a second.
+ */
+template<typename Predicate>
+bool waitFor(Predicate predicate) {
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+    while (!predicate()) {
+        if (std::chrono::steady_clock::now() > deadline) return false;
+        std::this_thread::yield();
+    }
+    return true;
+}
+
+
+int main(int argc, char** argv) {
+    gc = new QuietGC();
+    GC::init(gc);
+    
+    Testing::section("Safepoints", [&]() {
+        Testing::test("Registration", [&]() {
+            const uint32 count = Safepoints::countThreads();
+            {
+                MutatorRegistration outer;
+                MutatorRegistration inner;
+                Testing::assert(Safepoints::isRegistered() && Safepoints::countThreads() == count + 1, "Expected nested registrations to count once");
+            }
+            Testing::assert(!Safepoints::isRegistered() && Safepoints::countThreads() == count, "Expected the thread to be unregistered");
+            
+            std::thread thread([]() { Safepoints::registerThread(); });
+            thread.join();
+            Testing::assert(Safepoints::countThreads() == count, "Expected exiting threads to be unregistered");
+        });
+        
+        Testing::test("Stopping polling threads", [&]() {
+            std::atomic_bool running(true);
+            std::atomic<uint32> iterations(0);
+            std::thread mutator([&]() {
+                MutatorRegistration registration;
+                while (running.load()) {
+                    ++iterations;
+                    Safepoints::poll();
+                }
+            });
+            waitFor([&]() { return iterations.load() > 0; });
+            
+            {
+                WorldStop stop(std::chrono::seconds(1));
+                Testing::assert(!!stop, "Expected the polling thread to park");
+                const uint32 parked = iterations.load();
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                Testing::assert(iterations.load() == parked, "Expected the thread to remain parked");
+            }
+            
+            const uint32 resumed = iterations.load();
+            Testing::assert(waitFor([&]() { return iterations.load() > resumed; }), "Expected the thread to resume");
+            running = false;
+            mutator.join();
+        });
+        
+        Testing::test("Timeout", [&]() {
+            // Newborns are spared by their first cycle.
+            Pointer garbage = Object::createObject(2);
+            gc->collect();
+            
+            std::atomic_bool running(true);
+            std::atomic_bool registered(false);
+            std::thread mutator([&]() {
+                MutatorRegistration registration;
+                registered = true;
+                while (running.load()) std::this_thread::yield();
+            });
+            waitFor([&]() { return registered.load(); });
+            
+            {
+                WorldStop stop(std::chrono::milliseconds(5));
+                Testing::assert(!stop, "Expected the stop to time out");
+            }
+            Testing::assert(!Safepoints::isStopRequested(), "Expected the request to be withdrawn");
+            
+            Pointer object = Object::createObject(2);
+            gc->root(object);
+            gc->setSafepointTimeout(std::chrono::milliseconds(5));
+            const uint64 skipped = gc->getStats().numSkippedCompactions;
+            const uint64 skippedCollections = gc->getStats().numSkippedCollections;
+            gc->collect();
+            Testing::assert(gc->getStats().numSkippedCompactions == skipped + 1, "Expected compaction to be skipped");
+            Testing::assert(gc->getStats().numSkippedCollections == skippedCollections + 1, "Expected collection to be skipped");
+            Testing::assert(!!garbage, "Expected garbage to be kept without the final remark");
+            Testing::assert(!!object && !GC::getOverhead(object)->isDormant, "Expected the survivor to remain in the nursery");
+            gc->setSafepointTimeout(std::chrono::microseconds(NEURO_GC_SAFEPOINT_TIMEOUT));
+            
+            running = false;
+            mutator.join();
+            gc->collect();
+            Testing::assert(gc->getStats().numSkippedCompactions == skipped + 1, "Expected compaction to run without mutators");
+            Testing::assert(!garbage, "Expected garbage to be collected without mutators");
+            gc->unroot(object);
+            gc->collect(true);
+        });
+        
+        Testing::test("Safe regions", [&]() {
+            std::atomic<uint32> phase(0);
+            std::thread mutator([&]() {
+                MutatorRegistration registration;
+                {
+                    SafeRegion region;
+                    phase = 1;
+                    waitFor([&]() { return phase.load() == 2; });
+                }
+                phase = 3;
+            });
+            waitFor([&]() { return phase.load() == 1; });
+            
+            {
+                WorldStop stop(std::chrono::seconds(1));
+                Testing::assert(!!stop, "Expected threads in safe regions not to be waited for");
+                phase = 2;
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                Testing::assert(phase.load() == 2, "Expected the thread not to leave its safe region while stopped");
+            }
+            
+            Testing::assert(waitFor([&]() { return phase.load() == 3; }), "Expected the thread to leave its safe region once resumed");
+            mutator.join();
+        });
+        
+        Testing::test("Concurrent marking", [&]() {
+            // The payload's first holder is reached only through a long chain
+            // of objects, hence traced well after its second holder, a root.
+            Pointer chain = Object::createObject(2);
+            gc->root(chain);
+            Pointer from = chain;
+            for (uint32 i = 0; i < 20000; ++i) {
+                Pointer next = Object::createObject(2);
+                from->getProperty("next") = next;
+                from = next;
+            }
+            Pointer to = Object::createObject(2);
+            gc->root(to);
+            Pointer payload = Object::createObject(2);
+            payload->getProperty("value") = 42;
+            from->getProperty("ref") = payload;
+            to->getProperty("ref") = Value::undefined;
+            
+            // Moves the payload back and forth, storing it into its new holder
+            // before removing it from the old one, so that it always remains
+            // reachable even though the marker may visit the holders in any
+            // order.
+            std::atomic_bool running(true);
+            std::thread mutator([&]() {
+                MutatorRegistration registration;
+                Pointer source = from, target = to;
+                while (running.load()) {
+                    target->getProperty("ref") = source->getProperty("ref");
+                    source->getProperty("ref") = Value::undefined;
+                    std::swap(source, target);
+                    Safepoints::poll();
+                }
+            });
+            
+            for (uint32 i = 0; i < 50; ++i) {
+                const uint64 cycles = gc->getStats().numCycles;
+                gc->requestCycle(i % 5 == 0);
+                waitFor([&]() { return gc->getStats().numCycles > cycles; });
+            }
+            running = false;
+            mutator.join();
+            
+            Value ref = from->getProperty("ref").isManagedObject() ? from->getProperty("ref") : to->getProperty("ref");
+            Testing::assert(ref.isManagedObject() && !!ref.getManagedObject(), "Expected the moved reference to survive");
+            Testing::assert(ref.getManagedObject()->getProperty("value").getInt() == 42, "Expected the moved object to remain intact");
+            gc->unroot(chain);
+            gc->unroot(to);
+            
+            // The first collection merely sweeps the chain, the second one
+            // compacts its segments away so later tests start out small.
+            gc->collect(true);
+            gc->collect(true);
+        });
+        
+        Testing::test("Spared newborns", [&]() {
+            // The newborn is spared without being reached, and its card is
+            // cleaned when the scan starts. Memory only it refers to must
+            // survive nonetheless.
+            Pointer child = Object::createObject(2);
+            child->getProperty("value") = 42;
+            gc->sweepCycle();
+            
+            Pointer parent = Object::createObject(2);
+            parent->getProperty("child") = child;
+            gc->sweepCycle();
+            Testing::assert(!!parent && !!child, "Expected the newborn and its referent to survive");
+            Testing::assert(child->getProperty("value").getInt() == 42, "Expected the referent to remain intact");
+            
+            gc->sweepCycle();
+            Testing::assert(!parent && !child, "Expected both to be collected once the newborn has aged");
+        });
+        
+        Testing::test("Recreated objects", [&]() {
+            // The holder is recreated over and over while the background
+            // thread marks it. The marker must never come across its new
+            // memory before it is constructed.
+            Pointer holder = Object::createObject(2);
+            gc->root(holder);
+            Pointer child = Object::createObject(2);
+            child->getProperty("value") = 42;
+            holder->getProperty("child") = child;
+            
+            std::atomic_bool done(false);
+            std::thread mutator([&]() {
+                MutatorRegistration registration;
+                for (uint32 i = 0; i < 20000; ++i) {
+                    Object::recreateObject(holder, 1 + i % 8);
+                    Safepoints::poll();
+                }
+                done = true;
+            });
+            
+            while (!done.load()) {
+                const uint64 cycles = gc->getStats().numCycles;
+                gc->requestCycle(false);
+                waitFor([&]() { return gc->getStats().numCycles > cycles; });
+            }
+            mutator.join();
+            
+            Testing::assert(!!child && holder->getProperty("child").getManagedObject() == child, "Expected the recreated holder to keep its child");
+            Testing::assert(child->getProperty("value").getInt() == 42, "Expected the child to remain intact");
+            gc->unroot(holder);
+            gc->collect(true);
+        });
+        
+        Testing::test("Background compaction", [&]() {
+            std::atomic_bool running(true);
+            std::atomic_bool intact(true);
+            std::thread mutator([&]() {
+                MutatorRegistration registration;
+                while (running.load()) {
+                    Pointer object = Object::createObject(2);
+                    gc->root(object);
+                    object->getProperty("value") = 42;
+                    Safepoints::poll();
+                    if (object->getProperty("value").getInt() != 42) intact = false;
+                    gc->unroot(object);
+                }
+            });
+            
+            // Background cycles compact by default.
+            const uint64 cycles = gc->getStats().numCycles;
+            const uint64 compactions = gc->getStats().compactTimes.count();
+            gc->requestCycle(false);
+            waitFor([&]() { return gc->getStats().numCycles > cycles; });
+            
+            running = false;
+            mutator.join();
+            Testing::assert(intact.load(), "Expected objects to remain intact");
+            Testing::assert(gc->getStats().compactTimes.count() > compactions, "Expected the background cycle to compact");
+            gc->collect(true);
+        });
+        
+        Testing::test("C API", [&]() {
+            const uint32 count = Safepoints::countThreads();
+            Testing::assert(neuroGCRegisterThread() == 0 && Safepoints::countThreads() == count + 1, "Expected the thread to be registered");
+            Testing::assert(neuroGCSafepoint() == 0, "Expected polling without a stop to return immediately");
+            Testing::assert(neuroGCEnterSafeRegion() == 0 && neuroGCLeaveSafeRegion() == 0, "Expected safe regions to be entered and left");
+            Testing::assert(neuroGCUnregisterThread() == 0 && Safepoints::countThreads() == count, "Expected the thread to be unregistered");
+            
+            gc->collect();
+            neuroGCStats stats;
+            Testing::assert(neuroGCGetStats(&stats) == 0 && neuroGCGetLatencyCount(NGCH_Safepoint) > 0, "Expected safepoints to be recorded");
+        });
+    });
+    
+    GC::destroy();
+    return 0;
+}
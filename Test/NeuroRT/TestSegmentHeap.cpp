@@ -0,0 +1,98 @@
+////////////////////////////////////////////////////////////////////////////////
+// Unit Test for the virtual memory backing the GC's segments.
+// -----
+// Copyright (c) Kiruse 2018 Germany
+// License: GPL 3.0
+#include <cstring>
+
+#include "CLInterface.hpp"
+#include "GC/SegmentHeap.hpp"
+
+using namespace Neuro;
+using namespace Neuro::Runtime;
+
+
+constexpr size_t granule = SegmentHeap::GranuleSize;
+
+bool isAligned(const void* addr) {
+    return reinterpret_cast<uintptr_t>(addr) % granule == 0;
+}
+
+bool isZeroed(const void* addr, size_t bytes) {
+    const uint8* data = reinterpret_cast<const uint8*>(addr);
+    for (size_t i = 0; i < bytes; ++i) {
+        if (data[i]) return false;
+    }
+    return true;
+}
+
+
+int main(int argc, char** argv) {
+    Testing::section("SegmentHeap", []() {
+        Testing::test("Granule-aligned allocation", []() {
+            SegmentHeap heap(16 * granule);
+            void* single = heap.allocate(1);
+            void* triple = heap.allocate(2 * granule + 1);
+            Testing::assert(single && triple, "Expected allocations to succeed");
+            Testing::assert(isAligned(single) && isAligned(triple), "Expected granule-aligned memory");
+            Testing::assert(heap.contains(single) && heap.contains(triple), "Expected memory from the reservation");
+            Testing::assert(heap.countCommittedBytes() == 4 * granule, "Expected sizes to be rounded up to whole granules");
+            Testing::assert(isZeroed(triple, 3 * granule), "Expected committed memory to be zeroed");
+            
+            std::memset(single, 0xFF, granule);
+            std::memset(triple, 0xFF, 3 * granule);
+            heap.free(single, granule);
+            heap.free(triple, 3 * granule);
+            Testing::assert(heap.countCommittedBytes() == 0, "Expected freed memory to be decommitted");
+        });
+        
+        Testing::test("Freed granules are reused", []() {
+            SegmentHeap heap(16 * granule);
+            void* blocks[4];
+            for (auto& block : blocks) block = heap.allocate(granule);
+            std::memset(blocks[1], 0xFF, granule);
+            
+            heap.free(blocks[1], granule);
+            heap.free(blocks[2], granule);
+            void* pair = heap.allocate(2 * granule);
+            Testing::assert(pair == blocks[1], "Expected the first fitting gap to be reused");
+            Testing::assert(isZeroed(pair, 2 * granule), "Expected reused memory to be zeroed");
+            
+            heap.free(pair, 2 * granule);
+            heap.free(blocks[0], granule);
+            heap.free(blocks[3], granule);
+        });
+        
+        Testing::test("Exhausted reservation falls back to mapping", []() {
+            SegmentHeap heap(4 * granule);
+            void* reserved = heap.allocate(3 * granule);
+            void* mapped = heap.allocate(2 * granule);
+            Testing::assert(heap.contains(reserved), "Expected memory from the reservation");
+            Testing::assert(mapped && !heap.contains(mapped) && isAligned(mapped), "Expected aligned memory beyond the reservation");
+            Testing::assert(heap.countCommittedBytes() == 5 * granule, "Expected mapped memory to be accounted for");
+            
+            std::memset(mapped, 0xFF, 2 * granule);
+            heap.free(mapped, 2 * granule);
+            heap.free(reserved, 3 * granule);
+            Testing::assert(heap.countCommittedBytes() == 0, "Expected all memory to be returned");
+        });
+        
+        Testing::test("Discarded pages remain accessible", []() {
+            SegmentHeap heap(4 * granule);
+            heap.setHugePages(true);
+            auto* data = reinterpret_cast<uint8*>(heap.allocate(granule));
+            std::memset(data, 0xFF, granule);
+            
+            // Only whole pages are discarded, so the bytes around the range
+            // are retained.
+            heap.discard(data + 1, granule - 2);
+            Testing::assert(data[0] == 0xFF && data[granule - 1] == 0xFF, "Expected partially covered pages to be retained");
+            
+            std::memset(data, 0x42, granule);
+            Testing::assert(data[granule / 2] == 0x42, "Expected discarded pages to be writable");
+            heap.free(data, granule);
+        });
+    });
+    
+    return 0;
+}
@@ -0,0 +1,114 @@
+////////////////////////////////////////////////////////////////////////////////
+// Unit Test for the table of non-trivial types. Verifies that types are
+// registered once each, that their descriptors copy and destroy elements, and
+// that descriptors remain valid as the table grows beyond its first page.
+// -----
+// Copyright (c) Kiruse 2018 Germany
+// License: GPL 3.0
+#include "CLInterface.hpp"
+#include "GC/ManagedMemoryOverhead.hpp"
+#include "GC/TypeTable.hpp"
+
+#include <string>
+
+using namespace Neuro;
+using namespace Neuro::Runtime;
+
+
+/**
+ * Counts the copies and destructions performed through its delegates.
+ */
+struct Tracker {
+    uint32 copies = 0;
+    uint32 destructions = 0;
+    
+    void copy(void* target, const void* source) { ++copies; }
+    void destroy(void* target) { ++destructions; }
+};
+
+using CopyDelegate = Delegate<void, void*, const void*>;
+using DestroyDelegate = Delegate<void, void*>;
+
+uint16 registerTracker(Tracker* tracker) {
+    return TypeTable::registerType(CopyDelegate::MethodDelegate<Tracker, &Tracker::copy>(tracker), DestroyDelegate::MethodDelegate<Tracker, &Tracker::destroy>(tracker));
+}
+
+
+int main(int argc, char** argv) {
+    Testing::section("TypeTable", [&]() {
+        Testing::test("Registration", [&]() {
+            Tracker tracker;
+            const uint32 count = TypeTable::countTypes();
+            const uint16 id = registerTracker(&tracker);
+            Testing::assert(id != 0, "Expected a valid type id");
+            Testing::assert(registerTracker(&tracker) == id, "Expected equal delegates to yield the same type");
+            Testing::assert(TypeTable::countTypes() == count + 1, "Expected a single registration");
+            
+            Tracker other;
+            Testing::assert(registerTracker(&other) != id, "Expected different delegates to yield a different type");
+        });
+        
+        Testing::test("Native types", [&]() {
+            const uint16 id = TypeTable::getTypeId<std::string>();
+            Testing::assert(id != 0 && TypeTable::getTypeId<std::string>() == id, "Expected a stable type id");
+            Testing::assert(TypeTable::getTypeId<std::wstring>() != id, "Expected distinct types to have distinct ids");
+            
+            const TypeDescriptor& type = TypeTable::get(id);
+            std::string source = "a string too long for any small string optimization";
+            alignas(std::string) uint8 buffer[sizeof(std::string)];
+            type.copy(buffer, &source);
+            
+            auto* copy = reinterpret_cast<std::string*>(buffer);
+            Testing::assert(*copy == source, "Expected the string to be copy constructed");
+            type.destroy(buffer);
+        });
+        
+        Testing::test("Batch destruction", [&]() {
+            const TypeDescriptor& native = TypeTable::get(TypeTable::getTypeId<std::string>());
+            Testing::assert(!!native.destroyBatchDelegate, "Expected native types to destroy in batches");
+            
+            alignas(std::string) uint8 buffers[3][sizeof(std::string)];
+            void* targets[3];
+            for (uint32 i = 0; i < 3; ++i) {
+                targets[i] = new (buffers[i]) std::string("a string too long for any small string optimization");
+            }
+            native.destroyBatch(targets, 3);
+            
+            // Types without a batch delegate destroy element by element.
+            Tracker tracker;
+            const TypeDescriptor& custom = TypeTable::get(registerTracker(&tracker));
+            custom.destroyBatch(targets, 3);
+            Testing::assert(!custom.destroyBatchDelegate && tracker.destructions == 3, "Expected a destruction per element");
+        });
+        
+        Testing::test("Growth", [&]() {
+            // Span several pages of the table.
+            constexpr uint32 numTrackers = TypeTable::PageSize * 2 + 1;
+            Tracker trackers[numTrackers];
+            uint16 ids[numTrackers];
+            for (uint32 i = 0; i < numTrackers; ++i) ids[i] = registerTracker(trackers + i);
+            
+            for (uint32 i = 0; i < numTrackers; ++i) {
+                const TypeDescriptor& type = TypeTable::get(ids[i]);
+                type.copy(nullptr, nullptr);
+                type.destroy(nullptr);
+            }
+            
+            bool valid = true;
+            for (uint32 i = 0; i < numTrackers; ++i) {
+                valid = valid && trackers[i].copies == 1 && trackers[i].destructions == 1;
+            }
+            Testing::assert(valid, "Expected every descriptor to call its own delegates");
+        });
+        
+        Testing::test("Overhead", [&]() {
+            ManagedMemoryOverhead head(sizeof(std::string));
+            Testing::assert(!head.getType(), "Expected trivial memory to have no type");
+            
+            head.typeId = TypeTable::getTypeId<std::string>();
+            Testing::assert(head.getType() == &TypeTable::get(head.typeId), "Expected the header to refer to its type");
+        });
+    });
+    
+    return 0;
+}
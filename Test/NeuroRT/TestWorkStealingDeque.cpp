@@ -0,0 +1,84 @@
+////////////////////////////////////////////////////////////////////////////////
+// Unit Test for the Chase-Lev WorkStealingDeque.
+// -----
+// Copyright (c) Kiruse 2018 Germany
+// License: GPL 3.0
+#include "CLInterface.hpp"
+#include "Concurrency/WorkStealingDeque.hpp"
+
+#include <atomic>
+#include <thread>
+
+using namespace Neuro;
+using namespace Neuro::Runtime;
+using namespace Neuro::Runtime::Concurrency;
+
+
+int main(int argc, char** argv) {
+    Testing::section("WorkStealingDeque", []() {
+        Testing::test("Owner pops LIFO, thieves steal FIFO", []() {
+            WorkStealingDeque<uint32> deque(4);
+            uint32 value;
+            
+            Testing::assert(deque.empty(), "Expected deque to be empty after initialization");
+            Testing::assert(!deque.pop(value), "Unexpectedly popped from empty deque");
+            Testing::assert(!deque.steal(value), "Unexpectedly stole from empty deque");
+            
+            // Exceeds the initial capacity to force the deque to grow.
+            for (uint32 i = 0; i < 10; ++i) deque.push(i);
+            
+            Testing::assert(deque.pop(value) && value == 9, "Expected to pop the most recently pushed element");
+            Testing::assert(deque.steal(value) && value == 0, "Expected to steal the least recently pushed element");
+            
+            uint32 count = 0;
+            while (deque.pop(value)) ++count;
+            Testing::assert(count == 8, "Expected exactly the remaining 8 elements");
+            Testing::assert(deque.empty(), "Expected deque to be empty after draining it");
+        });
+        
+        Testing::test("Concurrent thieves", []() {
+            constexpr uint32 numElements = 200000;
+            constexpr uint32 numThieves = 3;
+            
+            WorkStealingDeque<uint32> deque(16);
+            std::atomic<uint8>* taken = new std::atomic<uint8>[numElements]();
+            std::atomic<uint32> numTaken(0);
+            std::atomic_bool done(false);
+            std::atomic_bool duplicate(false);
+            
+            auto take = [&](uint32 value) {
+                if (taken[value].exchange(1)) duplicate = true;
+                ++numTaken;
+            };
+            
+            auto thief = [&]() {
+                uint32 value;
+                while (!done.load() || !deque.empty()) {
+                    if (deque.steal(value)) take(value);
+                }
+            };
+            
+            std::thread thieves[numThieves];
+            for (auto& t : thieves) t = std::thread(thief);
+            
+            // Owner interleaves pushing and popping to race the thieves for
+            // the last element.
+            uint32 value;
+            for (uint32 i = 0; i < numElements; ++i) {
+                deque.push(i);
+                if (i % 3 == 0 && deque.pop(value)) take(value);
+            }
+            while (deque.pop(value)) take(value);
+            done = true;
+            
+            for (auto& t : thieves) t.join();
+            
+            Testing::assert(!duplicate.load(), "Element was taken more than once");
+            Testing::assert(numTaken.load() == numElements, "Not every element was taken exactly once");
+            
+            delete[] taken;
+        });
+    });
+    
+    return 0;
+}